@@ -0,0 +1,39 @@
+#!/bin/bash
+# Embeds a BRIG module into the binary (see rts/hsa/HsaModuleSource.hpp).
+#
+# usage: embed_brig.sh <output.cpp> <input.brig> <symbol>
+#
+# Generates a source file that defines the module as an aligned, read-only
+# array rts::hsa::kernel::<symbol> and its size as <symbol>Size.
+
+set -e
+
+if [[ $# -ne 3 ]]; then
+	echo "usage: $0 <output.cpp> <input.brig> <symbol>" >&2
+	exit 1
+fi
+
+output=$1
+input=$2
+symbol=$3
+
+{
+	echo "// Generated by $0 from $input, do not edit."
+	echo "#include <rts/hsa/HsaModuleSource.hpp>"
+	echo "#include <cstddef>"
+	echo ""
+	echo "namespace rts {"
+	echo "namespace hsa {"
+	echo "namespace kernel {"
+	echo ""
+	echo "alignas(HsaModuleSource::alignment) extern const char $symbol[] = {"
+	od -A n -v -t x1 "$input" | sed -e "s/ \([0-9a-f][0-9a-f]\)/'\\\\x\1',/g" -e 's/^/	/'
+	echo "};"
+	echo ""
+	echo "extern const std::size_t ${symbol}Size = sizeof($symbol);"
+	echo ""
+	echo "}"
+	echo "}"
+	echo "}"
+} > "$output.tmp"
+mv "$output.tmp" "$output"
@@ -0,0 +1,50 @@
+#!/bin/bash
+# Generates a placeholder BRIG module for the mock HSA runtime (HSA_MOCK=1).
+#
+# usage: mock_brig.sh <output.brig> <input.cl>
+#
+# The module consists of a BRIG module header without sections, followed by
+# the module name (the basename of the OpenCL source file) and the symbol
+# names of the kernels defined in the source file, one per line. The mock
+# finalizer binds these kernels to the registered host kernels.
+
+set -e
+
+if [[ $# -ne 2 ]]; then
+	echo "usage: $0 <output.brig> <input.cl>" >&2
+	exit 1
+fi
+
+output=$1
+input=$2
+
+module=$(basename "$input")
+module=${module%.*}
+body="module:$module"$'\n'
+for kernel in $(sed -n -e 's/^.*__kernel[[:space:]]\+void[[:space:]]\+\([A-Za-z_][A-Za-z0-9_]*\)[[:space:]]*(.*$/\1/p' "$input"); do
+	body+="&__OpenCL_${kernel}_kernel"$'\n'
+done
+
+# Writes a little-endian integer: le <value> <number of bytes>
+le() {
+	local value=$1
+	for ((i = 0; i < $2; i++)); do
+		printf "\\$(printf '%03o' $((value & 255)))"
+		value=$((value >> 8))
+	done
+}
+
+headerSize=104
+byteCount=$((headerSize + ${#body}))
+
+{
+	printf 'HSA BRIG'
+	le 1 4          # brigMajor
+	le 0 4          # brigMinor
+	le $byteCount 8 # byteCount
+	head -c 64 /dev/zero # hash
+	le 0 4          # reserved
+	le 0 4          # sectionCount
+	le 0 8          # sectionIndex
+	printf '%s' "$body"
+} > "$output"
@@ -0,0 +1,61 @@
+#include <rts/hsa/HsaAgent.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <utils/Utils.hpp>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace rts {
+namespace hsa {
+
+constexpr uint32_t HsaAgent::numLeadingParameters;
+constexpr uint32_t HsaAgent::maxBarrierDependencies;
+constexpr uint16_t HsaAgent::defaultWorkgroupSize;
+constexpr uint32_t HsaAgent::defaultQueueSize;
+
+/// A blocked reservation sleeps between the polls of the read index, first
+/// for the minimum duration, which doubles up to the maximum.
+static constexpr uint64_t queueFullMinSleepNanos = 1000;
+static constexpr uint64_t queueFullMaxSleepNanos = 100 * 1000;
+
+uint32_t HsaAgent::roundQueueSize(const uint32_t queueSize) {
+   if (queueSize == 0 || queueSize > (1u << 31)) {
+      throw HsaException("Invalid queue size: " + std::to_string(queueSize));
+   }
+   uint32_t size = 1;
+   while (size < queueSize) size <<= 1;
+   return size;
+}
+
+void HsaAgent::waitForQueueSpace(const uint64_t lastPacketId) {
+   const uint64_t queueSize = getQueueSize();
+   uint64_t readIndex = queueLoadReadIndex();
+   if (lastPacketId - readIndex < queueSize) return;
+
+   // The clock is only read if the queue is full.
+   const auto start = std::chrono::steady_clock::now();
+   uint64_t sleepNanos = queueFullMinSleepNanos;
+   do {
+      switch (queueFullPolicy) {
+         case HsaQueueFullPolicy::Spin:
+            Utils::pause();
+            break;
+         case HsaQueueFullPolicy::Yield:
+            std::this_thread::yield();
+            break;
+         case HsaQueueFullPolicy::Sleep:
+            std::this_thread::sleep_for(std::chrono::nanoseconds(sleepNanos));
+            sleepNanos = std::min(2 * sleepNanos, queueFullMaxSleepNanos);
+            break;
+      }
+      readIndex = queueLoadReadIndex();
+   } while (lastPacketId - readIndex >= queueSize);
+
+   numStalls.fetch_add(1, std::memory_order_relaxed);
+   stallNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+}
+
+}
+}
@@ -1,14 +1,276 @@
 #pragma once
 
 #include <hsa.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
 
-namespace rts { namespace hsa {
+namespace rts {
+namespace hsa {
 
+/// The condition of a barrier packet: all (AND) or any (OR) of its
+/// dependency signals has to be zero.
+enum class HsaBarrierType {
+   And,
+   Or
+};
+
+/// What the reservation of a packet does while the queue is full.
+enum class HsaQueueFullPolicy {
+   /// Polls the read index, with a pause instruction between the polls.
+   Spin,
+   /// Yields the processor between the polls.
+   Yield,
+   /// Sleeps between the polls, with an exponential backoff (1 us up to
+   /// 100 us). This is no signal-based wait: a slot is freed when its packet
+   /// is fetched (not when it completes), which no signal reports. Neither is
+   /// the queue grown, a waiting dispatch may oversleep the free slot by up to
+   /// the maximum backoff.
+   Sleep
+};
+
+class HsaCodeObjectCache;
+
+/// The interface through which a HsaContext dispatches kernels. An agent owns
+/// the code (modules, kernels), a dispatch queue with pre-allocated kernel
+/// argument buffers, and the signals used to report completion.
+///
+/// A dispatch follows the AQL protocol, regardless of the actual
+/// implementation:
+///   1. reserve a packet (requestPacketId),
+///   2. write the kernel arguments to the packet's argument buffer,
+///   3. populate and publish the packet (publishPacket),
+///   4. notify the agent (ringDoorbell).
 class HsaAgent {
 public:
+   struct KernelDescriptor {
+      uint64_t kernelObject;
+      uint32_t argumentSegmentSize;
+      uint32_t groupSegmentSize;
+      uint32_t privateSegmentSize;
+   };
+
+   struct KernelLaunchParameters {
+      /// The grid size. A single packet covers at most getMaxGridSize()
+      /// elements; HsaContext splits larger grids into several packets.
+      uint64_t numElements;
+      uint16_t workgroupSize;
+   };
+
+   /// The properties of an agent that limit the number of work-groups a
+   /// compute unit runs concurrently (see HsaOccupancy).
+   struct Properties {
+      uint32_t numComputeUnits;
+      /// The number of work-items that are executed in lock-step.
+      uint32_t wavefrontSize;
+      uint32_t maxWavefrontsPerComputeUnit;
+      /// Zero if only limited by the wavefronts.
+      uint32_t maxWorkgroupsPerComputeUnit;
+      uint32_t maxWorkgroupSize;
+      /// The group memory of a compute unit (zero if unlimited).
+      uint32_t groupSegmentSize;
+      /// The private memory of a compute unit (zero if unlimited).
+      uint64_t privateSegmentSize;
+   };
+
+   /// OpenCL kernels compiled with CLOC have 6 additional leading parameters:
+   /// the global offsets (x, y, z), the printf buffer, the device queue and
+   /// the AQL wrap pointer. All but the global offset of the x dimension,
+   /// which get_global_id(0) adds to the absolute work-item ID, are NULL.
+   static constexpr uint32_t numLeadingParameters = 6;
+
+   /// The maximum number of dependency signals of a barrier packet.
+   static constexpr uint32_t maxBarrierDependencies = 5;
+
+   /// The work-group size that is used if none is specified.
+   static constexpr uint16_t defaultWorkgroupSize = 128;
+
+   /// The number of packets of a queue if none is specified.
+   static constexpr uint32_t defaultQueueSize = 16;
+
+   /// The reservations that had to wait for a free packet, and the time they
+   /// waited.
+   struct QueueStats {
+      uint64_t numStalls;
+      std::chrono::nanoseconds stallTime;
+   };
+
+   HsaAgent() :
+         queueFullPolicy(HsaQueueFullPolicy::Yield), numStalls(0), stallNanos(0) {
+   }
+
+   virtual ~HsaAgent() {
+   }
+
+   /// Adds a BRIG module.
+   virtual void addModule(const char* brigModulePtr) = 0;
+
+   /// Finalizes the modules that have been added since the previous
+   /// finalization. The kernels of previous finalizations remain valid.
+   virtual void finalize() = 0;
+
+   /// Whether modules have been added that are not finalized yet (or are
+   /// being finalized).
+   virtual bool hasUnfinalizedModules() {
+      return false;
+   }
+
+   /// Lets finalize() load the code object from the cache (or store it
+   /// there). Only applies to agents that finalize BRIG modules, the others
+   /// ignore the cache. The cache is not owned by the agent; nullptr
+   /// disables caching.
+   virtual void setCodeObjectCache(HsaCodeObjectCache* /* cache */) {
+   }
+
+   /// Creates the dispatch queue with (at least) `queueSize` packets and
+   /// pre-allocates the kernel argument memory. The size is rounded up to a
+   /// power of two and clamped to the limits of the agent.
+   virtual void createQueue(const uint32_t queueSize) = 0;
+
+   void createQueue() {
+      createQueue(defaultQueueSize);
+   }
+
+   /// Looks up a kernel by its symbol name. The kernels are known after
+   /// finalize(), thus the lookup does not call into the HSA runtime.
+   virtual KernelDescriptor getKernelObject(const char* kernelSymbolName) = 0;
+
+   KernelDescriptor getKernelObject(const std::string& kernelSymbolName) {
+      return getKernelObject(kernelSymbolName.c_str());
+   }
+
+   /// The reverse of getKernelObject. Returns nullptr if the kernel object is
+   /// unknown.
+   virtual const char* getKernelSymbolName(const uint64_t kernelObject) = 0;
+
+   /// The name of the instruction set the kernels are executed with. Launch
+   /// parameters that have been tuned for one ISA do not apply to another
+   /// (see HsaAutotuner).
+   virtual std::string getIsaName() = 0;
+
+   /// Atomically requests a new packet ID. Waits while the queue is full (see
+   /// setQueueFullPolicy).
+   virtual uint64_t requestPacketId() = 0;
+
+   /// Atomically requests `count` consecutive packet IDs (with a single
+   /// update of the write index) and returns the first one. Waits until
+   /// there is room for all of them; `count` must not exceed the queue size.
+   virtual uint64_t requestPacketIds(const uint32_t count) = 0;
+
+   /// Atomically requests a new packet ID, unless the queue is full. Does not
+   /// wait, the write index is only updated if a packet is free.
+   virtual bool tryRequestPacketId(uint64_t& packetId) = 0;
+
+   void setQueueFullPolicy(const HsaQueueFullPolicy policy) {
+      queueFullPolicy = policy;
+   }
+
+   HsaQueueFullPolicy getQueueFullPolicy() const {
+      return queueFullPolicy;
+   }
+
+   QueueStats getQueueStats() const {
+      return QueueStats { numStalls.load(), std::chrono::nanoseconds(stallNanos.load()) };
+   }
+
+   void resetQueueStats() {
+      numStalls = 0;
+      stallNanos = 0;
+   }
+
+   /// The number of packets the queue can hold.
+   virtual uint32_t getQueueSize() = 0;
+
+   /// The ID of the oldest packet that has not been processed yet. The
+   /// packets before it have released their queue slots.
+   uint64_t loadReadIndex() {
+      return queueLoadReadIndex();
+   }
+
+   /// Returns the kernel argument buffer of the given packet, which is
+   /// sized for the argument segment of the kernel (see HsaKernargSlab).
+   virtual void* getArgBufferPtr(const uint64_t packetId, const KernelDescriptor& kernel) = 0;
+
+   /// Allocates memory that the kernels can read like their arguments (from
+   /// the kernel argument region), aligned to a cache line. Used for the
+   /// by-value arguments (see HsaConstantArena).
+   virtual void* allocateArgumentMemory(const std::size_t size) = 0;
+
+   virtual void freeArgumentMemory(void* ptr) = 0;
+
+   /// Whether the kernels can only access host memory that is registered
+   /// with the runtime (see HsaHostBuffer). Agents that run the kernels on
+   /// the host access any memory.
+   virtual bool requiresMemoryRegistration() {
+      return false;
+   }
+
+   /// The largest grid a single packet can cover (the grid size of a dispatch
+   /// packet is a 32-bit field).
+   virtual uint64_t getMaxGridSize() {
+      return UINT32_MAX;
+   }
+
+   /// The largest work-group size (the work-group size of the launch
+   /// parameters is a 16-bit field).
+   virtual uint32_t getMaxWorkgroupSize() {
+      return UINT16_MAX;
+   }
+
+   /// Queries the occupancy-relevant properties of the agent.
+   virtual Properties getProperties() = 0;
+
+   /// Populates the packet and atomically publishes its header. The kernel
+   /// arguments must have been written before. The grid size must not
+   /// exceed getMaxGridSize().
+   virtual void publishPacket(const uint64_t packetId, const KernelDescriptor& kernel,
+         const KernelLaunchParameters n, const hsa_signal_t completionSignal) = 0;
+
+   /// Populates a barrier packet and atomically publishes its header. The
+   /// packet completes (and decrements the completion signal, if any) once
+   /// all (AND) or any (OR) of the dependency signals are zero; until then,
+   /// the agent does not launch any subsequent packet of the queue. At most
+   /// maxBarrierDependencies signals.
+   virtual void publishBarrierPacket(const uint64_t packetId, const HsaBarrierType type,
+         const hsa_signal_t* dependencies, const uint32_t numDependencies, const hsa_signal_t completionSignal) = 0;
+
+   /// Notifies the agent that the packets up to the given ID are enqueued.
+   virtual void ringDoorbell(const uint64_t packetId) = 0;
+
+   /// Signal operations (semantics as specified by the HSA runtime API).
+   virtual hsa_signal_t createSignal(const hsa_signal_value_t initialValue) = 0;
+
+   virtual void destroySignal(const hsa_signal_t signal) = 0;
+
+   virtual hsa_signal_value_t loadSignal(const hsa_signal_t signal) = 0;
+
+   virtual void storeSignal(const hsa_signal_t signal, const hsa_signal_value_t value) = 0;
+
+   virtual void addSignal(const hsa_signal_t signal, const hsa_signal_value_t value) = 0;
+
+   virtual hsa_signal_value_t waitSignal(const hsa_signal_t signal,
+         const hsa_signal_condition_t condition, const hsa_signal_value_t compareValue,
+         const uint64_t timeoutHint, const hsa_wait_state_t waitStateHint) = 0;
 
 protected:
+   /// Rounds the requested number of packets up to a power of two.
+   static uint32_t roundQueueSize(const uint32_t queueSize);
+
+   /// The slow path of requestPacketId(s), which is taken once the queue has
+   /// been found full: waits according to the full-queue policy until the
+   /// packets up to `lastPacketId` fit into the queue and records the stall.
+   void waitForQueueSpace(const uint64_t lastPacketId);
+
+   virtual uint64_t queueLoadReadIndex() = 0;
+
+private:
+   HsaQueueFullPolicy queueFullPolicy;
 
+   std::atomic<uint64_t> numStalls;
+   std::atomic<uint64_t> stallNanos;
 };
 
-}}
+}
+}
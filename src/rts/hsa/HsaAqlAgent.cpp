@@ -0,0 +1,600 @@
+#include <rts/hsa/HsaAqlAgent.hpp>
+#include <rts/hsa/HsaCodeObjectCache.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaRuntime.hpp>
+#include <rts/hsa/HsaUtils.hpp>
+#include <hsa.h>
+#include <hsa_ext_finalize.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <string>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+using namespace std;
+
+constexpr uint32_t HsaAqlAgent::numPacketWords;
+constexpr uint32_t HsaAqlAgent::barrierPacketHeader;
+
+HsaAqlAgent::HsaAqlAgent(HsaRuntime& rt) :
+      queue(nullptr), argumentMemoryPtr(nullptr),
+            rt(&rt), finalizing(false), codeObjectCache(nullptr), kernels(nullptr) {
+
+   if (HsaUtils::isInitialized() == false) {
+      throw HsaException("HSA runtime not initialized.");
+   }
+   tables.emplace_back(new HsaKernelTable());
+   kernels = tables.back().get();
+}
+
+HsaAqlAgent::HsaAqlAgent() :
+      queue(nullptr), argumentMemoryPtr(nullptr),
+            rt(nullptr), finalizing(false), codeObjectCache(nullptr), kernels(nullptr) {
+   tables.emplace_back(new HsaKernelTable());
+   kernels = tables.back().get();
+}
+
+HsaAqlAgent::~HsaAqlAgent() {
+   if (rt == nullptr || HsaUtils::isInitialized() == false) return;
+
+   // Free argument memory-segment.
+   if (argumentMemoryPtr != nullptr) {
+      HsaUtils::apiCall([&] {
+         return hsa_memory_free(argumentMemoryPtr);
+      });
+   }
+
+   // Destroy queue. // TODO explicitly destroy signals
+   if (queue != nullptr) {
+      HsaUtils::apiCall([&] {
+         return hsa_queue_destroy(queue);
+      });
+   }
+
+   // The executables are destroyed along with the last agent that uses them
+   // (see HsaExecutableRegistry).
+}
+
+void HsaAqlAgent::addModule(const char* brigModulePtr) {
+   // The module is added to an HSA program by the finalization, and only if
+   // the executable is not shared with another agent already.
+   std::lock_guard<std::mutex> lock(moduleMutex);
+   modules.push_back(brigModulePtr);
+}
+
+bool HsaAqlAgent::hasUnfinalizedModules() {
+   std::lock_guard<std::mutex> lock(moduleMutex);
+   return !modules.empty() || finalizing;
+}
+
+/// Allocates the memory of a serialized code object.
+static hsa_status_t allocateSerializedCodeObject(size_t size, hsa_callback_data_t /* data */, void** address) {
+   *address = malloc(size);
+   return *address != nullptr ? HSA_STATUS_SUCCESS : HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+}
+
+void HsaAqlAgent::finalize() {
+   std::lock_guard<std::mutex> finalizeLock(finalizeMutex);
+
+   // Take the modules that have been added so far, the modules that are
+   // added meanwhile are finalized by the next finalization.
+   std::vector<const char*> finalizedModules;
+   {
+      std::lock_guard<std::mutex> lock(moduleMutex);
+      if (modules.empty()) return;
+      finalizedModules.swap(modules);
+      finalizing = true;
+   }
+   // If the modules fail to load (i.e., the finalizer or the runtime fails),
+   // they are put back, thus the next finalization retries them. Modules
+   // that have been loaded, but cannot be published (e.g., a kernel has been
+   // finalized before, or the argument buffers of the queue are too small),
+   // would fail again. They are dropped, so that they do not block the
+   // modules that are added later.
+   struct FinalizingGuard {
+      HsaAqlAgent& agent;
+      const std::vector<const char*>& finalizedModules;
+      bool loaded;
+      ~FinalizingGuard() {
+         std::lock_guard<std::mutex> lock(agent.moduleMutex);
+         if (!loaded) {
+            agent.modules.insert(agent.modules.begin(), finalizedModules.begin(), finalizedModules.end());
+         }
+         agent.finalizing = false;
+      }
+   } finalizingGuard { *this, finalizedModules, false };
+
+   // Share the executable with the other agents that finalize the same
+   // modules.
+   const std::string key = HsaExecutableRegistry::getKey(finalizedModules, getIsaName(), rt->kernelAgent);
+   std::shared_ptr<const HsaExecutableRegistry::Executable> e = HsaExecutableRegistry::getInstance().acquire(key,
+         [&](HsaExecutableRegistry::Executable& loaded) {
+            loadExecutable(finalizedModules, loaded);
+         });
+   finalizingGuard.loaded = true;
+
+   // Throws if a kernel has been finalized before.
+   std::vector<std::pair<std::string, KernelDescriptor>> finalizedDescriptors = descriptors;
+   finalizedDescriptors.insert(finalizedDescriptors.end(), e->kernels.begin(), e->kernels.end());
+   std::unique_ptr<HsaKernelTable> table;
+   try {
+      table.reset(new HsaKernelTable(finalizedDescriptors));
+   }
+   catch (const HsaException& ex) {
+      throw HsaException(std::string(ex.what()) + ". The modules of the finalization have been dropped.");
+   }
+
+   // Publish the kernels. The kernel argument buffers of an existing queue
+   // must be large enough for them.
+   std::lock_guard<std::mutex> lock(moduleMutex);
+   if (queue != nullptr && table->getMaxArgumentSegmentSize() > kernargs.getMaxArgumentSegmentSize()) {
+      throw HsaException("The kernel argument segment of a kernel exceeds the argument buffers of the queue ("
+            + std::to_string(kernargs.getMaxArgumentSegmentSize()) + " bytes). Add its module before creating the queue."
+            + " The modules of the finalization have been dropped.");
+   }
+   executables.push_back(std::move(e));
+   descriptors.swap(finalizedDescriptors);
+   tables.push_back(std::move(table));
+   kernels.store(tables.back().get(), std::memory_order_release);
+}
+
+void HsaAqlAgent::loadExecutable(const std::vector<const char*>& finalizedModules,
+      HsaExecutableRegistry::Executable& e) {
+   // Create an HSA program of the modules.
+   hsa_ext_program_t finalizedProgram;
+   HsaUtils::apiCall([&] {
+      return hsa_ext_program_create(
+            HSA_MACHINE_MODEL_LARGE,
+            HSA_PROFILE_FULL,
+            HSA_DEFAULT_FLOAT_ROUNDING_MODE_DEFAULT,
+            nullptr, /* no options */
+            &finalizedProgram);
+   });
+   try {
+      for (const char* brigModulePtr : finalizedModules) {
+         HsaUtils::apiCall([&] {
+            return hsa_ext_program_add_module(finalizedProgram, (hsa_ext_module_t)brigModulePtr);
+         });
+      }
+      e.codeObject = finalizeModules(finalizedProgram, finalizedModules, e.serializedCodeObject);
+   }
+   catch (...) {
+      hsa_ext_program_destroy(finalizedProgram);
+      throw;
+   }
+
+   // Destroy the HSA program as it is no longer needed.
+   HsaUtils::apiCall([&] {
+      return hsa_ext_program_destroy(finalizedProgram);
+   });
+
+   // Create an executable.
+   // Note, that the lifetime of the code object must exceed that of the executable.
+   HsaUtils::apiCall([&] {
+      return hsa_executable_create(
+            HSA_PROFILE_FULL,
+            HSA_EXECUTABLE_STATE_UNFROZEN,
+            nullptr, /* no options */
+            &e.executable);
+   });
+
+   HsaUtils::apiCall([&] {
+      return hsa_executable_load_code_object(
+            e.executable,
+            rt->kernelAgent,
+            e.codeObject,
+            nullptr);
+   });
+
+   HsaUtils::apiCall([&] {
+      return hsa_executable_freeze(
+            e.executable,
+            nullptr);
+   });
+
+   // Query the kernel descriptors once, so that name-based dispatches do not
+   // call into the runtime.
+   iterateKernelCodeSymbols(e.codeObject, [&](std::string& kernelSymbolName) {
+      e.kernels.emplace_back(kernelSymbolName, queryKernelObject(e.executable, kernelSymbolName));
+   });
+}
+
+hsa_code_object_t HsaAqlAgent::finalizeModules(const hsa_ext_program_t finalizedProgram,
+      const std::vector<const char*>& finalizedModules, std::string& serializedCodeObject) {
+   hsa_code_object_t codeObject = {0};
+
+   // Look up the code object in the cache. The key covers everything the
+   // finalization depends on, thus a changed module, ISA or finalizer option
+   // results in a miss.
+   std::string cacheKey;
+   if (codeObjectCache != nullptr) {
+      cacheKey = HsaCodeObjectCache::getKey(finalizedModules, getIsaName(), "");
+      if (codeObjectCache->load(cacheKey, serializedCodeObject)) {
+         const hsa_status_t status = hsa_code_object_deserialize(
+               &serializedCodeObject[0],
+               serializedCodeObject.size(),
+               nullptr, /* no options */
+               &codeObject);
+         if (status == HSA_STATUS_SUCCESS) {
+            return codeObject;
+         }
+         // E.g., written by a different version of the runtime.
+         codeObjectCache->remove(cacheKey);
+         serializedCodeObject.clear();
+         codeObject = {0};
+      }
+   }
+
+   // Finalize HSA modules (results in a ``code object'')
+   HsaUtils::apiCall([&] {
+      hsa_ext_control_directives_t finalizerControlDirectives;
+      finalizerControlDirectives.control_directives_mask = 0;
+      return hsa_ext_program_finalize(
+            finalizedProgram,
+            rt->kernelAgentIsa,
+            HSA_EXT_FINALIZER_CALL_CONVENTION_AUTO,
+            finalizerControlDirectives,
+            nullptr, /* no options */
+            HSA_CODE_OBJECT_TYPE_PROGRAM,
+            &codeObject);
+   });
+
+   if (codeObjectCache != nullptr) {
+      void* serialized;
+      size_t serializedSize;
+      HsaUtils::apiCall([&] {
+         return hsa_code_object_serialize(
+               codeObject,
+               allocateSerializedCodeObject,
+               {0}, /* no callback data */
+               nullptr, /* no options */
+               &serialized,
+               &serializedSize);
+      });
+      std::unique_ptr<void, decltype(&free)> guard(serialized, &free);
+      codeObjectCache->store(cacheKey, serialized, serializedSize);
+   }
+   return codeObject;
+}
+
+void HsaAqlAgent::createQueue(const uint32_t preferredQueueSize) {
+   // The kernels must not change while the queue is set up for them.
+   std::lock_guard<std::mutex> lock(moduleMutex);
+   const HsaKernelTable& table = *kernels.load(std::memory_order_acquire);
+
+   // Determine the sizes of memory segments. The kernels of modules that
+   // are not finalized yet are unknown.
+   const bool unknownKernels = !modules.empty() || finalizing;
+   const uint32_t maxKernelGroupSegmentSize = unknownKernels ? UINT32_MAX : table.getMaxGroupSegmentSize();
+   const uint32_t maxKernelPrivateSegmentSize = unknownKernels ? UINT32_MAX : table.getMaxPrivateSegmentSize();
+
+   // Determine the queue size.
+   uint32_t minQueueSize;
+   HsaUtils::apiCall([&] {
+      return hsa_agent_get_info(
+            rt->kernelAgent,
+            HSA_AGENT_INFO_QUEUE_MIN_SIZE,
+            &minQueueSize);
+   });
+   uint32_t maxQueueSize;
+   HsaUtils::apiCall([&] {
+      return hsa_agent_get_info(
+            rt->kernelAgent,
+            HSA_AGENT_INFO_QUEUE_MAX_SIZE,
+            &maxQueueSize);
+   });
+   // The limits are powers of two.
+   const uint32_t queueSize = std::min(std::max(roundQueueSize(preferredQueueSize), minQueueSize), maxQueueSize);
+
+   // Create the actual queue.
+   HsaUtils::apiCall([&] {
+      return hsa_queue_create(
+            rt->kernelAgent,
+            queueSize,
+            HSA_QUEUE_TYPE_SINGLE, /* not thread-safe! */
+            nullptr,
+            nullptr,
+            maxKernelPrivateSegmentSize,
+            maxKernelGroupSegmentSize,
+            &queue);
+   });
+
+   // (Pre-)Allocate memory for kernel arguments. The allocation granule of
+   // the kernel argument region is (at least) a page, thus the slots are
+   // aligned to cache lines.
+   const hsa_region_t kernelArgumentRegion = HsaUtils::determineKernelArgumentRegion(rt->kernelAgent);
+   // Reserve buffers of the largest regular size for the unknown kernels.
+   std::vector<uint32_t> argumentSegmentSizes = table.getArgumentSegmentSizes();
+   if (unknownKernels) {
+      argumentSegmentSizes.push_back(HsaKernargSlab::maxSlotSize);
+   }
+   kernargs = HsaKernargSlab(argumentSegmentSizes, queueSize);
+   HsaUtils::apiCall([&] {
+      return hsa_memory_allocate(kernelArgumentRegion, kernargs.getSize(), &argumentMemoryPtr);
+   });
+
+   // Initialize argument buffer
+   kernargs.bind(argumentMemoryPtr);
+
+   initializePackets();
+}
+
+void HsaAqlAgent::initializePackets() {
+   for (size_t i = 0; i < queue->size; i++) {
+      hsa_kernel_dispatch_packet_t* packetPtr = queueGetKernelDispatchPacketPtr(i);
+      std::memset(((uint8_t*) packetPtr) + 4, 0, sizeof(hsa_kernel_dispatch_packet_t) - 4);
+      packetPtr->workgroup_size_x = defaultWorkgroupSize; // Overwritten per dispatch (see HsaContext::getWorkgroupSize).
+      packetPtr->workgroup_size_y = 1;
+      packetPtr->workgroup_size_z = 1;
+      packetPtr->grid_size_x = 1;
+      packetPtr->grid_size_y = 1;
+      packetPtr->grid_size_z = 1;
+      packetPtr->kernarg_address = kernargs.getSlot(i);
+   }
+
+   // The packet contents as seen by publishPacket.
+   packetShadow.reset(new uint64_t[queue->size * numPacketWords]);
+   std::memcpy(packetShadow.get(), queue->base_address, queue->size * sizeof(hsa_kernel_dispatch_packet_t));
+}
+
+void HsaAqlAgent::publishBarrierPacket(const uint64_t packetId, const HsaBarrierType type,
+      const hsa_signal_t* dependencies, const uint32_t numDependencies, const hsa_signal_t completionSignal) {
+   if (numDependencies > maxBarrierDependencies) {
+      throw HsaException("A barrier packet has at most " + std::to_string(maxBarrierDependencies) + " dependencies.");
+   }
+   // Barrier-AND and barrier-OR packets have the same layout.
+   hsa_barrier_and_packet_t* packetPtr =
+         reinterpret_cast<hsa_barrier_and_packet_t*>(queueGetKernelDispatchPacketPtr(packetId));
+   uint64_t* shadowWords = &packetShadow[(packetId & (queue->size - 1)) * numPacketWords];
+
+   packetPtr->reserved1 = 0;
+   for (uint32_t i = 0; i < maxBarrierDependencies; i++) {
+      packetPtr->dep_signal[i] = i < numDependencies ? dependencies[i] : hsa_signal_t{0};
+      shadowWords[1 + i] = packetPtr->dep_signal[i].handle;
+   }
+   packetPtr->reserved2 = 0;
+   packetPtr->completion_signal = completionSignal;
+
+   // The next dispatch packet in this slot rewrites all fields.
+   shadowWords[0] = 0;
+   shadowWords[6] = 1;
+   shadowWords[7] = completionSignal.handle;
+
+   // Atomically set header and the reserved field.
+   const uint32_t packetType = type == HsaBarrierType::And ? HSA_PACKET_TYPE_BARRIER_AND : HSA_PACKET_TYPE_BARRIER_OR;
+   __atomic_store_n(reinterpret_cast<uint32_t*>(packetPtr),
+         barrierPacketHeader | (packetType << HSA_PACKET_HEADER_TYPE), __ATOMIC_RELEASE);
+}
+
+void HsaAqlAgent::restoreDispatchPacket(const uint64_t packetId) {
+   uint64_t* packetWords = reinterpret_cast<uint64_t*>(queueGetKernelDispatchPacketPtr(packetId));
+   uint64_t* shadowWords = &packetShadow[(packetId & (queue->size - 1)) * numPacketWords];
+   packetWords[5] = reinterpret_cast<uint64_t>(kernargs.getSlot(packetId));
+   packetWords[6] = 0;
+   shadowWords[5] = packetWords[5];
+   shadowWords[6] = 0;
+}
+
+void HsaAqlAgent::iterateKernelCodeSymbols(const hsa_code_object_t codeObject,
+      std::function<void(std::string&)> callback) {
+   hsa_code_object_iterate_symbols(codeObject,
+         [] (hsa_code_object_t /* code */, hsa_code_symbol_t symbol, void* data) -> hsa_status_t {
+            hsa_symbol_kind_t kind;
+            hsa_code_symbol_get_info(symbol, HSA_CODE_SYMBOL_INFO_TYPE, &kind);
+            if (kind != HSA_SYMBOL_KIND_KERNEL) {
+               /* continue iteration */
+               return HSA_STATUS_SUCCESS;
+            }
+            uint32_t length;
+            hsa_code_symbol_get_info(symbol, HSA_CODE_SYMBOL_INFO_NAME_LENGTH, &length);
+            std::string symbolName(length, '_');
+            hsa_code_symbol_get_info(symbol, HSA_CODE_SYMBOL_INFO_NAME, &symbolName[0]);
+            std::function<void(std::string&)> callback = *reinterpret_cast<std::function<void(std::string&)>*>(data);
+            callback(symbolName);
+            return HSA_STATUS_SUCCESS;
+         }, &callback);
+}
+
+uint64_t HsaAqlAgent::getMaxGridSize() {
+   if (rt == nullptr) return HsaAgent::getMaxGridSize();
+   uint32_t maxGridSize;
+   HsaUtils::apiCall([&] {
+      return hsa_agent_get_info(
+            rt->kernelAgent,
+            HSA_AGENT_INFO_GRID_MAX_SIZE,
+            &maxGridSize);
+   });
+   return maxGridSize;
+}
+
+uint32_t HsaAqlAgent::getMaxWorkgroupSize() {
+   if (rt == nullptr) return HsaAgent::getMaxWorkgroupSize();
+   uint32_t maxWorkgroupSize;
+   HsaUtils::apiCall([&] {
+      return hsa_agent_get_info(
+            rt->kernelAgent,
+            HSA_AGENT_INFO_WORKGROUP_MAX_SIZE,
+            &maxWorkgroupSize);
+   });
+   return std::min<uint32_t>(maxWorkgroupSize, HsaAgent::getMaxWorkgroupSize());
+}
+
+HsaAgent::Properties HsaAqlAgent::getProperties() {
+   if (rt == nullptr) {
+      throw HsaException("The agent is not bound to an HSA runtime.");
+   }
+   Properties properties;
+
+   // The number of compute units is not part of the HSA 1.0 core API. It is
+   // queried via the AMD extension attribute HSA_AMD_AGENT_INFO_COMPUTE_UNIT_COUNT,
+   // if the runtime does not support it, a single compute unit is assumed.
+   const hsa_agent_info_t computeUnitCountAttribute = static_cast<hsa_agent_info_t>(0xA002);
+   if (hsa_agent_get_info(rt->kernelAgent, computeUnitCountAttribute, &properties.numComputeUnits) != HSA_STATUS_SUCCESS
+         || properties.numComputeUnits == 0) {
+      properties.numComputeUnits = 1;
+   }
+
+   HsaUtils::apiCall([&] {
+      return hsa_agent_get_info(
+            rt->kernelAgent,
+            HSA_AGENT_INFO_WAVEFRONT_SIZE,
+            &properties.wavefrontSize);
+   });
+   HsaUtils::apiCall([&] {
+      return hsa_isa_get_info(
+            rt->kernelAgentIsa,
+            HSA_ISA_INFO_CALL_CONVENTION_INFO_WAVEFRONTS_PER_COMPUTE_UNIT,
+            0,
+            &properties.maxWavefrontsPerComputeUnit);
+   });
+   properties.maxWorkgroupsPerComputeUnit = 0;
+   properties.maxWorkgroupSize = getMaxWorkgroupSize();
+
+   // The size of the group segment region.
+   properties.groupSegmentSize = 0;
+   HsaUtils::apiCall([&] {
+      return hsa_agent_iterate_regions(rt->kernelAgent, [](hsa_region_t region, void* data) {
+         hsa_region_segment_t segment;
+         hsa_region_get_info(region, HSA_REGION_INFO_SEGMENT, &segment);
+         if (segment == HSA_REGION_SEGMENT_GROUP) {
+            size_t size;
+            hsa_region_get_info(region, HSA_REGION_INFO_SIZE, &size);
+            *reinterpret_cast<uint32_t*>(data) = static_cast<uint32_t>(size);
+         }
+         return HSA_STATUS_SUCCESS;
+      }, &properties.groupSegmentSize);
+   });
+
+   // The private memory of a compute unit cannot be queried.
+   properties.privateSegmentSize = 0;
+   return properties;
+}
+
+void* HsaAqlAgent::allocateArgumentMemory(const std::size_t size) {
+   if (rt == nullptr) {
+      throw HsaException("The agent is not bound to an HSA runtime.");
+   }
+   // The allocation granule of the kernel argument region is (at least) a
+   // page.
+   void* ptr = nullptr;
+   const hsa_region_t kernelArgumentRegion = HsaUtils::determineKernelArgumentRegion(rt->kernelAgent);
+   HsaUtils::apiCall([&] {
+      return hsa_memory_allocate(kernelArgumentRegion, size, &ptr);
+   });
+   return ptr;
+}
+
+void HsaAqlAgent::freeArgumentMemory(void* ptr) {
+   if (ptr == nullptr || HsaUtils::isInitialized() == false) return;
+   HsaUtils::apiCall([&] {
+      return hsa_memory_free(ptr);
+   });
+}
+
+hsa_executable_symbol_t HsaAqlAgent::getExecutableSymbol(const hsa_executable_t executable,
+      const std::string& kernelSymbolName) {
+   hsa_executable_symbol_t executableSymbol;
+   const char* moduleName = nullptr; // not yet supported
+   HsaUtils::apiCall([&] {
+      return hsa_executable_get_symbol(
+            executable,
+            moduleName,
+            kernelSymbolName.c_str(),
+            rt->kernelAgent,
+            HSA_EXT_FINALIZER_CALL_CONVENTION_AUTO,
+            &executableSymbol);
+   });
+   return executableSymbol;
+}
+
+HsaAgent::KernelDescriptor HsaAqlAgent::getKernelObject(const char* kernelSymbolName) {
+   return kernels.load(std::memory_order_acquire)->get(kernelSymbolName);
+}
+
+const char* HsaAqlAgent::getKernelSymbolName(const uint64_t kernelObject) {
+   return kernels.load(std::memory_order_acquire)->findSymbolName(kernelObject);
+}
+
+std::string HsaAqlAgent::getIsaName() {
+   if (rt == nullptr) {
+      throw HsaException("The agent is not bound to an HSA runtime.");
+   }
+   uint32_t length;
+   HsaUtils::apiCall([&] {
+      return hsa_isa_get_info(
+            rt->kernelAgentIsa,
+            HSA_ISA_INFO_NAME_LENGTH,
+            0,
+            &length);
+   });
+   std::string isaName(length, '\0');
+   HsaUtils::apiCall([&] {
+      return hsa_isa_get_info(
+            rt->kernelAgentIsa,
+            HSA_ISA_INFO_NAME,
+            0,
+            &isaName[0]);
+   });
+   // The name may include the terminating null character.
+   isaName.resize(std::strlen(isaName.c_str()));
+   return isaName;
+}
+
+HsaAgent::KernelDescriptor HsaAqlAgent::queryKernelObject(const hsa_executable_t executable,
+      const std::string& kernelSymbolName) {
+   const hsa_executable_symbol_t executableSymbol = getExecutableSymbol(executable, kernelSymbolName);
+
+   KernelDescriptor kernel;
+
+   HsaUtils::apiCall([&] {
+      return hsa_executable_symbol_get_info(
+            executableSymbol,
+            HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_OBJECT,
+            &kernel.kernelObject);
+   });
+
+   // Extract dispatch information such as group segment size etc.
+   HsaUtils::apiCall([&] {
+      return hsa_executable_symbol_get_info(
+            executableSymbol,
+            HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_KERNARG_SEGMENT_SIZE,
+            &kernel.argumentSegmentSize);
+   });
+   HsaUtils::apiCall([&] {
+      return hsa_executable_symbol_get_info(
+            executableSymbol,
+            HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_GROUP_SEGMENT_SIZE,
+            &kernel.groupSegmentSize);
+   });
+   HsaUtils::apiCall([&] {
+      return hsa_executable_symbol_get_info(
+            executableSymbol,
+            HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_PRIVATE_SEGMENT_SIZE,
+            &kernel.privateSegmentSize);
+   });
+
+   return kernel;
+}
+
+hsa_signal_t HsaAqlAgent::createSignal(const hsa_signal_value_t initialValue) {
+   hsa_signal_t signal;
+   HsaUtils::apiCall([&] {
+      return hsa_signal_create(initialValue, 0, NULL, &signal);
+   });
+   return signal;
+}
+
+void HsaAqlAgent::destroySignal(const hsa_signal_t signal) {
+   HsaUtils::apiCall([&] {
+      return hsa_signal_destroy(signal);
+   });
+}
+
+} // namespace hsa
+} // namespace rts
@@ -0,0 +1,327 @@
+#pragma once
+
+#include <rts/hsa/HsaAgent.hpp>
+#include <rts/hsa/HsaExecutableRegistry.hpp>
+#include <rts/hsa/HsaKernargSlab.hpp>
+#include <rts/hsa/HsaKernelTable.hpp>
+#include <rts/hsa/HsaRuntime.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstring> // memset
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <hsa.h>
+#include <hsa_ext_finalize.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+/// The HSA kernel agent (typically the GPU). Kernels are finalized from BRIG
+/// modules and dispatched via an AQL queue of the HSA runtime.
+///
+/// Modules can be added after a finalization: the next finalization only
+/// finalizes the new modules and loads them into an executable of their own.
+/// A finalization may run concurrently with the dispatches (and with the
+/// addition of modules); the kernels become visible once it has completed.
+/// If the finalizer or the runtime fails, the modules remain pending and the
+/// next finalization retries them. Modules whose kernels cannot be published
+/// (a kernel has been finalized before, or its arguments exceed the argument
+/// buffers of the queue) are dropped.
+/// The executables are shared with the other agents that finalize the same
+/// modules (see HsaExecutableRegistry).
+class HsaAqlAgent : public HsaAgent {
+public:
+   /// C'tor, requires an initialized HSA runtime object.
+   explicit HsaAqlAgent(HsaRuntime& rt);
+
+   /// D'tor
+   virtual ~HsaAqlAgent();
+
+   void addModule(const char* brigModulePtr) override; // TODO use uint8_t instead
+
+   void finalize() override;
+
+   bool hasUnfinalizedModules() override;
+
+   void setCodeObjectCache(HsaCodeObjectCache* cache) override {
+      codeObjectCache = cache;
+   }
+
+   using HsaAgent::createQueue;
+
+   void createQueue(const uint32_t queueSize) override;
+
+   using HsaAgent::getKernelObject;
+
+   KernelDescriptor getKernelObject(const char* kernelSymbolName) override;
+
+   const char* getKernelSymbolName(const uint64_t kernelObject) override;
+
+   std::string getIsaName() override;
+
+   inline uint64_t requestPacketId() override {
+      // Atomically request a new packet ID.
+      uint64_t packetId = queueAddWriteIndex(1);
+      // Wait until the queue is not full before writing the packet
+      if (packetId - queueLoadReadIndex() >= queue->size) {
+         waitForQueueSpace(packetId);
+      }
+      return packetId;
+   }
+
+   inline uint64_t requestPacketIds(const uint32_t count) override {
+      const uint64_t packetId = queueAddWriteIndex(count);
+      // Wait until all packets fit into the queue
+      if (packetId + count - queueLoadReadIndex() > queue->size) {
+         waitForQueueSpace(packetId + count - 1);
+      }
+      return packetId;
+   }
+
+   inline bool tryRequestPacketId(uint64_t& packetId) override {
+      uint64_t writeIndex = queueLoadWriteIndex();
+      while (writeIndex - queueLoadReadIndex() < queue->size) {
+         const uint64_t observed = queueCasWriteIndex(writeIndex, writeIndex + 1);
+         if (observed == writeIndex) {
+            packetId = writeIndex;
+            return true;
+         }
+         writeIndex = observed;
+      }
+      return false;
+   }
+
+   inline uint32_t getQueueSize() override {
+      return queue->size;
+   }
+
+   uint64_t getMaxGridSize() override;
+
+   uint32_t getMaxWorkgroupSize() override;
+
+   Properties getProperties() override;
+
+   void* allocateArgumentMemory(const std::size_t size) override;
+
+   void freeArgumentMemory(void* ptr) override;
+
+   bool requiresMemoryRegistration() override {
+      return true;
+   }
+
+   inline void* getArgBufferPtr(const uint64_t packetId, const KernelDescriptor& kernel) override {
+      return kernargs.getBuffer(packetId, kernel.argumentSegmentSize);
+   }
+
+   inline void publishPacket(const uint64_t packetId, const KernelDescriptor& kernel,
+         const KernelLaunchParameters n, const hsa_signal_t completionSignal) override {
+      hsa_kernel_dispatch_packet_t *packetPtr = queueGetKernelDispatchPacketPtr(packetId);
+      uint64_t* packetWords = reinterpret_cast<uint64_t*>(packetPtr);
+      uint64_t* shadowWords = &packetShadow[(packetId & (queue->size - 1)) * numPacketWords];
+
+      // The packet as 64-bit words (little endian). The reserved fields are
+      // bound to the queue slot (see initializePackets), the kernel argument
+      // address only changes if the kernel uses the overflow arena.
+      const uint32_t workgroupSize = n.workgroupSize == 0 ? defaultWorkgroupSize : n.workgroupSize;
+      const uint64_t workgroupSizeX = std::min<uint64_t>(n.numElements, workgroupSize);
+      uint64_t words[numPacketWords];
+      // header, setup (written below), workgroup_size_x, workgroup_size_y
+      words[0] = (workgroupSizeX << 32) | (uint64_t(1) << 48);
+      // workgroup_size_z, reserved0, grid_size_x
+      words[1] = uint64_t(1) | (uint64_t(n.numElements) << 32);
+      // grid_size_y, grid_size_z
+      words[2] = uint64_t(1) | (uint64_t(1) << 32);
+      // private_segment_size, group_segment_size
+      words[3] = uint64_t(kernel.privateSegmentSize) | (uint64_t(kernel.groupSegmentSize) << 32);
+      // kernel_object (= pointer to the finalized kernel)
+      words[4] = kernel.kernelObject;
+      // kernarg_address
+      words[5] = reinterpret_cast<uint64_t>(kernargs.getBuffer(packetId, kernel.argumentSegmentSize));
+      words[7] = completionSignal.handle;
+
+      // A barrier packet has overwritten the fields that are bound to the slot.
+      if (shadowWords[6] != 0) {
+         restoreDispatchPacket(packetId);
+      }
+
+      // Only write the fields that differ from the previous packet in this
+      // slot. Dispatching the same kernel with the same grid again only
+      // touches the completion signal.
+      if ((shadowWords[0] >> 32) != (words[0] >> 32)) {
+         reinterpret_cast<uint32_t*>(packetPtr)[1] = static_cast<uint32_t>(words[0] >> 32);
+         shadowWords[0] = words[0];
+      }
+      for (uint32_t i = 1; i <= 5; i++) {
+         if (shadowWords[i] != words[i]) {
+            packetWords[i] = words[i];
+            shadowWords[i] = words[i];
+         }
+      }
+      if (shadowWords[7] != words[7]) {
+         packetWords[7] = words[7];
+         shadowWords[7] = words[7];
+      }
+
+      // Atomically set header and setup fields (as described in the specs)
+      __atomic_store_n(reinterpret_cast<uint32_t *>(packetPtr), dispatchPacketHeader, __ATOMIC_RELEASE);
+   }
+
+   void publishBarrierPacket(const uint64_t packetId, const HsaBarrierType type,
+         const hsa_signal_t* dependencies, const uint32_t numDependencies, const hsa_signal_t completionSignal) override;
+
+   inline void ringDoorbell(const uint64_t packetId) override {
+      // Notify the runtime that a new packet is enqueued.
+      queueStoreDoorbell(packetId);
+   }
+
+   hsa_signal_t createSignal(const hsa_signal_value_t initialValue) override;
+
+   void destroySignal(const hsa_signal_t signal) override;
+
+   inline hsa_signal_value_t loadSignal(const hsa_signal_t signal) override {
+      return hsa_signal_load_acquire(signal);
+   }
+
+   inline void storeSignal(const hsa_signal_t signal, const hsa_signal_value_t value) override {
+      hsa_signal_store_release(signal, value);
+   }
+
+   inline void addSignal(const hsa_signal_t signal, const hsa_signal_value_t value) override {
+      hsa_signal_add_relaxed(signal, value);
+   }
+
+   inline hsa_signal_value_t waitSignal(const hsa_signal_t signal,
+         const hsa_signal_condition_t condition, const hsa_signal_value_t compareValue,
+         const uint64_t timeoutHint, const hsa_wait_state_t waitStateHint) override {
+      return hsa_signal_wait_acquire(signal, condition, compareValue, timeoutHint, waitStateHint);
+   }
+
+protected:
+   /// C'tor for agents that process the queue without the HSA runtime (see
+   /// HsaSoftAqlAgent). The derived class sets up the queue and the argument
+   /// memory and releases them on destruction.
+   HsaAqlAgent();
+
+   /// The queue primitives. Virtual, so that the queue can be processed in
+   /// software.
+   virtual uint64_t queueAddWriteIndex(const uint64_t value) {
+      return hsa_queue_add_write_index_release(queue, value);
+   }
+
+   virtual uint64_t queueLoadWriteIndex() {
+      return hsa_queue_load_write_index_relaxed(queue);
+   }
+
+   /// Returns the observed value of the write index.
+   virtual uint64_t queueCasWriteIndex(const uint64_t expected, const uint64_t value) {
+      return hsa_queue_cas_write_index_acq_rel(queue, expected, value);
+   }
+
+   uint64_t queueLoadReadIndex() override {
+      return hsa_queue_load_read_index_acquire(queue);
+   }
+
+   virtual void queueStoreDoorbell(const uint64_t packetId) {
+      hsa_signal_store_release(queue->doorbell_signal, packetId);
+   }
+
+   /// Initializes all packets of the queue (except the headers) and binds the
+   /// regular argument buffers of the slab to them.
+   void initializePackets();
+
+   /// Rewrites the kernel argument address and the reserved field of a slot
+   /// that held a barrier packet.
+   void restoreDispatchPacket(const uint64_t packetId);
+
+   void iterateKernelCodeSymbols(const hsa_code_object_t codeObject, std::function<void(std::string&)> callback);
+
+   hsa_executable_symbol_t
+   getExecutableSymbol(const hsa_executable_t executable, const std::string &kernelSymbolName);
+
+   /// Queries the kernel object and segment sizes from the executable.
+   KernelDescriptor queryKernelObject(const hsa_executable_t executable, const std::string& kernelSymbolName);
+
+   inline hsa_kernel_dispatch_packet_t*
+   queueGetKernelDispatchPacketPtr(const uint64_t packetId) {
+      const uint32_t queueMask = queue->size - 1;
+      hsa_kernel_dispatch_packet_t* packetPtr =
+            reinterpret_cast<hsa_kernel_dispatch_packet_t *>(queue->base_address) + (packetId & queueMask);
+      return packetPtr;
+   }
+
+   /// A packet consists of eight 64-bit words.
+   static constexpr uint32_t numPacketWords = sizeof(hsa_kernel_dispatch_packet_t) / sizeof(uint64_t);
+
+   // We support only 1-dimensional kernels.
+   static constexpr uint32_t numDimensions = 1;
+   static constexpr uint32_t barrierPacketHeader =
+         0 | (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_ACQUIRE_FENCE_SCOPE) |
+               (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_RELEASE_FENCE_SCOPE);
+   static constexpr uint32_t dispatchPacketHeader =
+         0 | (HSA_PACKET_TYPE_KERNEL_DISPATCH << HSA_PACKET_HEADER_TYPE) |
+               (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_ACQUIRE_FENCE_SCOPE) |
+               (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_RELEASE_FENCE_SCOPE) |
+               ((numDimensions << HSA_KERNEL_DISPATCH_PACKET_SETUP_DIMENSIONS) << 16);
+
+   hsa_queue_t *queue;
+
+   /// Points to the pre-allocated kernel argument memory-segment (see
+   /// HsaKernargSlab).
+   void *argumentMemoryPtr;
+
+   /// The layout of the kernel argument memory.
+   HsaKernargSlab kernargs;
+
+   /// A copy of the (non-header) packet contents of each queue slot, so that
+   /// publishPacket only writes the fields that have changed and never reads
+   /// from the queue memory. The reserved word 6, which is zero in the queue,
+   /// marks slots that hold a barrier packet.
+   std::unique_ptr<uint64_t[]> packetShadow;
+
+private:
+   /// Not set, if the queue is processed in software.
+   HsaRuntime *rt;
+
+   /// Guards the modules that have not been finalized yet, as well as the
+   /// publication of the kernels.
+   std::mutex moduleMutex;
+
+   /// Serializes the finalizations.
+   std::mutex finalizeMutex;
+
+   /// The modules that have been added since the previous finalization.
+   std::vector<const char*> modules;
+
+   /// Whether a finalization is in progress (its modules have been taken
+   /// from `modules` already).
+   bool finalizing;
+
+   /// Not owned, may be null (see setCodeObjectCache).
+   HsaCodeObjectCache* codeObjectCache;
+
+   /// The executables of all finalizations (shared with other agents).
+   std::vector<std::shared_ptr<const HsaExecutableRegistry::Executable>> executables;
+
+   /// The kernels of all executables (populated by finalize). Each
+   /// finalization publishes a new table, the previous ones are retained,
+   /// thus lookups do not lock.
+   std::vector<std::pair<std::string, KernelDescriptor>> descriptors;
+   std::vector<std::unique_ptr<HsaKernelTable>> tables;
+   std::atomic<const HsaKernelTable*> kernels;
+
+   /// Finalizes the given modules (or loads the code object from the cache)
+   /// and loads the code object into an executable (see
+   /// HsaExecutableRegistry::acquire).
+   void loadExecutable(const std::vector<const char*>& finalizedModules, HsaExecutableRegistry::Executable& e);
+
+   /// Finalizes the given program (or loads the code object from the cache).
+   hsa_code_object_t finalizeModules(const hsa_ext_program_t finalizedProgram,
+         const std::vector<const char*>& finalizedModules, std::string& serializedCodeObject);
+};
+
+}
+}
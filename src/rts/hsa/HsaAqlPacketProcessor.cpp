@@ -0,0 +1,255 @@
+#include <rts/hsa/HsaAqlPacketProcessor.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <utils/Utils.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace rts {
+namespace hsa {
+
+/// The doorbell value that is stored to wake up the workers on shut down.
+static constexpr hsa_signal_value_t shutDownDoorbellValue = INT64_MIN;
+
+HsaAqlPacketProcessor::HsaAqlPacketProcessor(const uint32_t queueSize, const uint32_t numThreads,
+      const ErrorCallback& errorCallback) :
+      numThreads(numThreads == 0 ? Utils::numProcessors() : numThreads), errorCallback(errorCallback),
+            packets(nullptr), queueMask(queueSize - 1),
+            writeIndex(0), readIndex(0), numLaunched(0), numSleepers(0), shutDown(false),
+            status(HSA_STATUS_SUCCESS) {
+
+   if (queueSize == 0 || (queueSize & queueMask) != 0) {
+      throw HsaException("The queue size must be a power of two.");
+   }
+
+   void* ptr;
+   if (posix_memalign(&ptr, 64, sizeof(hsa_kernel_dispatch_packet_t) * queueSize) != 0) {
+      throw std::bad_alloc();
+   }
+   packets = reinterpret_cast<hsa_kernel_dispatch_packet_t*>(ptr);
+   std::memset(packets, 0, sizeof(hsa_kernel_dispatch_packet_t) * queueSize);
+   for (uint32_t i = 0; i < queueSize; i++) {
+      packets[i].header = HSA_PACKET_TYPE_INVALID << HSA_PACKET_HEADER_TYPE;
+   }
+
+   std::memset(&queue, 0, sizeof(hsa_queue_t));
+   queue.type = HSA_QUEUE_TYPE_MULTI;
+   queue.features = HSA_QUEUE_FEATURE_KERNEL_DISPATCH;
+   queue.base_address = packets;
+   queue.doorbell_signal = HsaHostSignal::create(-1);
+   queue.size = queueSize;
+   queue.id = reinterpret_cast<uint64_t>(this);
+
+   // The packet with ID 0 has not been launched yet.
+   launch.work = static_cast<uint64_t>(UINT32_MAX) << 32;
+   launch.numGroups = 0;
+   launch.numGroupsDone = 0;
+   launch.kernel = nullptr;
+   launch.kernargAddress = nullptr;
+   launch.completionSignal = {0};
+   launch.barrierType = HsaBarrierType::And;
+   for (uint32_t i = 0; i < HsaAgent::maxBarrierDependencies; i++) {
+      launch.dependencies[i] = {0};
+   }
+
+   for (uint32_t i = 0; i < this->numThreads; i++) {
+      workers.emplace_back(&HsaAqlPacketProcessor::work, this, i);
+   }
+}
+
+HsaAqlPacketProcessor::~HsaAqlPacketProcessor() {
+   shutDown = true;
+   HsaHostSignal::store(queue.doorbell_signal, shutDownDoorbellValue);
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      wakeUp.notify_all();
+   }
+   for (std::thread& worker : workers) {
+      worker.join();
+   }
+   HsaHostSignal::destroy(queue.doorbell_signal);
+   free(packets);
+}
+
+void* HsaAqlPacketProcessor::operator new(const std::size_t size) {
+   void* ptr;
+   if (posix_memalign(&ptr, alignof(HsaAqlPacketProcessor), size) != 0) {
+      throw std::bad_alloc();
+   }
+   return ptr;
+}
+
+void HsaAqlPacketProcessor::operator delete(void* ptr) {
+   free(ptr);
+}
+
+void HsaAqlPacketProcessor::work(const uint32_t threadId) {
+   Utils::setAffinity(threadId);
+   uint32_t idleRounds = 0;
+   while (!shutDown && status.load(std::memory_order_relaxed) == HSA_STATUS_SUCCESS) {
+      const uint64_t packetId = readIndex.load(std::memory_order_acquire);
+      uint64_t w = launch.work.load(std::memory_order_acquire);
+      if ((w >> 32) == static_cast<uint32_t>(packetId)) {
+         // The packet has been launched.
+         if ((w & 0xffffffffu) < launch.numGroups.load(std::memory_order_relaxed)) {
+            // Claim the next work-group.
+            if (launch.work.compare_exchange_weak(w, w + 1, std::memory_order_acq_rel)) {
+               execute(packetId, w & 0xffffffffu);
+               idleRounds = 0;
+            }
+         }
+         else {
+            idle(packetId, idleRounds);
+         }
+         continue;
+      }
+
+      // Load the doorbell before the header, otherwise a doorbell ring might get lost.
+      const hsa_signal_value_t doorbell = HsaHostSignal::load(queue.doorbell_signal);
+      const hsa_kernel_dispatch_packet_t& packet = packets[packetId & queueMask];
+      const uint16_t header = __atomic_load_n(&packet.header, __ATOMIC_ACQUIRE);
+      if (getField(header, HSA_PACKET_HEADER_TYPE, HSA_PACKET_HEADER_WIDTH_TYPE) == HSA_PACKET_TYPE_INVALID) {
+         // Wait for the producer.
+         if (doorbell != shutDownDoorbellValue && readIndex.load(std::memory_order_acquire) == packetId) {
+            HsaHostSignal::wait(queue.doorbell_signal, HSA_SIGNAL_CONDITION_NE, doorbell,
+                  UINT64_MAX, HSA_WAIT_STATE_BLOCKED);
+         }
+         continue;
+      }
+      // The packet is published. Exactly one worker launches it, the others
+      // retry until the work-groups are available.
+      uint64_t expected = packetId;
+      if (numLaunched.compare_exchange_strong(expected, packetId + 1, std::memory_order_acq_rel)) {
+         launchPacket(packetId, packet, header);
+      }
+   }
+}
+
+void HsaAqlPacketProcessor::launchPacket(const uint64_t packetId, const hsa_kernel_dispatch_packet_t& packet,
+      const uint16_t header) {
+   const uint32_t type = getField(header, HSA_PACKET_HEADER_TYPE, HSA_PACKET_HEADER_WIDTH_TYPE);
+   const bool isBarrier = type == HSA_PACKET_TYPE_BARRIER_AND || type == HSA_PACKET_TYPE_BARRIER_OR;
+   if ((type != HSA_PACKET_TYPE_KERNEL_DISPATCH && !isBarrier)
+         || (!isBarrier && (packet.grid_size_y > 1 || packet.grid_size_z > 1))) {
+      fail(HSA_STATUS_ERROR_INVALID_PACKET_FORMAT);
+      return;
+   }
+   if (getField(header, HSA_PACKET_HEADER_ACQUIRE_FENCE_SCOPE, HSA_PACKET_HEADER_WIDTH_ACQUIRE_FENCE_SCOPE)
+         != HSA_FENCE_SCOPE_NONE) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+   }
+
+   launch.header = header;
+   launch.completionSignal = packet.completion_signal;
+   if (isBarrier) {
+      // Both barrier packets have the same layout. A single worker waits for
+      // the dependencies.
+      const hsa_barrier_and_packet_t& barrier = reinterpret_cast<const hsa_barrier_and_packet_t&>(packet);
+      launch.kernel = nullptr;
+      launch.kernargAddress = nullptr;
+      launch.gridSize = 1;
+      launch.workgroupSize = 1;
+      launch.barrierType = type == HSA_PACKET_TYPE_BARRIER_AND ? HsaBarrierType::And : HsaBarrierType::Or;
+      for (uint32_t i = 0; i < HsaAgent::maxBarrierDependencies; i++) {
+         launch.dependencies[i] = barrier.dep_signal[i];
+      }
+   }
+   else {
+      launch.kernel = HsaHostKernelRegistry::getKernel(packet.kernel_object);
+      launch.kernargAddress = packet.kernarg_address;
+      launch.gridSize = packet.grid_size_x;
+      launch.workgroupSize = packet.workgroup_size_x;
+   }
+   const uint64_t numGroups = launch.workgroupSize == 0 ? 0
+         : (launch.gridSize + launch.workgroupSize - 1) / launch.workgroupSize;
+   launch.numGroups.store(numGroups, std::memory_order_relaxed);
+   launch.numGroupsDone.store(0, std::memory_order_relaxed);
+   // Publish the work-groups.
+   launch.work.store(static_cast<uint64_t>(static_cast<uint32_t>(packetId)) << 32, std::memory_order_release);
+
+   if (numGroups == 0) {
+      // An empty grid.
+      complete(packetId);
+   }
+}
+
+void HsaAqlPacketProcessor::execute(const uint64_t packetId, const uint64_t groupId) {
+   if (launch.kernel == nullptr) {
+      // A barrier packet. On shut down, the packet is abandoned.
+      if (!HsaHostSignal::waitBarrier(launch.barrierType, launch.dependencies,
+            HsaAgent::maxBarrierDependencies, shutDown)) {
+         return;
+      }
+      complete(packetId);
+      return;
+   }
+
+   HsaWorkGroup group;
+   group.groupId = groupId;
+   group.workgroupSize = launch.workgroupSize;
+   group.gridSize = launch.gridSize;
+   group.begin = groupId * launch.workgroupSize;
+   group.end = std::min(group.begin + launch.workgroupSize, launch.gridSize);
+   launch.kernel->function(group, launch.kernargAddress);
+
+   const uint64_t numGroups = launch.numGroups.load(std::memory_order_relaxed);
+   if (launch.numGroupsDone.fetch_add(1, std::memory_order_acq_rel) + 1 == numGroups) {
+      complete(packetId);
+   }
+}
+
+void HsaAqlPacketProcessor::complete(const uint64_t packetId) {
+   const hsa_signal_t completionSignal = launch.completionSignal;
+   if (getField(launch.header, HSA_PACKET_HEADER_RELEASE_FENCE_SCOPE, HSA_PACKET_HEADER_WIDTH_RELEASE_FENCE_SCOPE)
+         != HSA_FENCE_SCOPE_NONE) {
+      std::atomic_thread_fence(std::memory_order_release);
+   }
+   // Release the queue entry. The header must not be mistaken as published
+   // once the entry is recycled.
+   __atomic_store_n(&packets[packetId & queueMask].header,
+         static_cast<uint16_t>(HSA_PACKET_TYPE_INVALID << HSA_PACKET_HEADER_TYPE), __ATOMIC_RELEASE);
+   readIndex.store(packetId + 1, std::memory_order_seq_cst);
+   if (completionSignal.handle != 0) {
+      HsaHostSignal::subtract(completionSignal, 1);
+   }
+   notifyWorkers();
+}
+
+void HsaAqlPacketProcessor::fail(const hsa_status_t error) {
+   status = error;
+   // Wake up all workers.
+   HsaHostSignal::store(queue.doorbell_signal, shutDownDoorbellValue);
+   notifyWorkers();
+   if (errorCallback) {
+      errorCallback(error);
+   }
+}
+
+void HsaAqlPacketProcessor::idle(const uint64_t packetId, uint32_t& idleRounds) {
+   constexpr uint32_t maxSpinRounds = 1 << 12;
+   if (idleRounds < maxSpinRounds) {
+      idleRounds++;
+      Utils::pause();
+      return;
+   }
+   std::unique_lock<std::mutex> lock(mutex);
+   numSleepers.fetch_add(1, std::memory_order_seq_cst);
+   wakeUp.wait(lock, [&] {
+      return shutDown
+            || status.load(std::memory_order_seq_cst) != HSA_STATUS_SUCCESS
+            || readIndex.load(std::memory_order_seq_cst) != packetId;
+   });
+   numSleepers.fetch_sub(1, std::memory_order_relaxed);
+   idleRounds = 0;
+}
+
+void HsaAqlPacketProcessor::notifyWorkers() {
+   if (numSleepers.load(std::memory_order_seq_cst) != 0) {
+      std::lock_guard<std::mutex> lock(mutex);
+      wakeUp.notify_all();
+   }
+}
+
+}
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaHostSignal.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <hsa.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+/// Processes an AQL queue in software. A pool of worker threads consumes the
+/// kernel dispatch packets of the queue, executes the referenced host kernels
+/// (the kernel object is the address of a HsaHostKernel, see
+/// HsaHostKernelRegistry) and decrements the completion signals, which have to
+/// be host signals (see HsaHostSignal).
+///
+/// The processor follows the queue protocol of the HSA specification:
+///  - A packet is consumed once its header type is no longer INVALID. The
+///    header is loaded with acquire semantics.
+///  - The acquire and release fences requested by the header are executed
+///    before and after the kernel.
+///  - After the packet has been processed, its header type is reset to
+///    INVALID, then the read index is advanced and the completion signal is
+///    decremented.
+///  - The doorbell signal is a host signal. Idle workers block on it.
+///
+/// Packets are processed one after another (the work-groups of a packet are
+/// distributed dynamically among all workers), thus the barrier bit is always
+/// honored. The read index is advanced after the packet has completed, so that
+/// the producer does not overwrite the kernel arguments of a running kernel.
+///
+/// A barrier-AND/OR packet is processed like a single work-group: one worker
+/// waits until its dependency signals satisfy the condition, then the packet
+/// completes. Subsequent packets are not launched before.
+///
+/// Only one-dimensional kernel dispatch packets and barrier packets are
+/// supported. Any other packet is a queue error: the error callback is invoked
+/// with HSA_STATUS_ERROR_INVALID_PACKET_FORMAT and the queue is no longer
+/// processed.
+class HsaAqlPacketProcessor {
+public:
+   typedef std::function<void(hsa_status_t)> ErrorCallback;
+
+   /// C'tor, creates the queue and starts the workers. If `numThreads` is 0,
+   /// one worker per processor is started. The queue size must be a power of two.
+   HsaAqlPacketProcessor(const uint32_t queueSize, const uint32_t numThreads = 0,
+         const ErrorCallback& errorCallback = nullptr);
+
+   /// D'tor, stops the workers. Packets that have not been processed yet are
+   /// discarded.
+   ~HsaAqlPacketProcessor();
+
+   /// The processor is cache-line aligned (C++11 does not support over-aligned new).
+   static void* operator new(const std::size_t size);
+
+   static void operator delete(void* ptr);
+
+   /// The queue. The packets are located at its base address. The queue ID
+   /// is the address of the processor.
+   hsa_queue_t* getQueue() {
+      return &queue;
+   }
+
+   static inline HsaAqlPacketProcessor* fromQueue(const hsa_queue_t* queue) {
+      return reinterpret_cast<HsaAqlPacketProcessor*>(queue->id);
+   }
+
+   uint32_t getNumThreads() const {
+      return numThreads;
+   }
+
+   inline uint64_t loadWriteIndex() const {
+      return writeIndex.load(std::memory_order_acquire);
+   }
+
+   inline void storeWriteIndex(const uint64_t value) {
+      writeIndex.store(value, std::memory_order_release);
+   }
+
+   inline uint64_t addWriteIndex(const uint64_t value) {
+      return writeIndex.fetch_add(value, std::memory_order_acq_rel);
+   }
+
+   /// Returns the observed value (like hsa_queue_cas_write_index).
+   inline uint64_t casWriteIndex(uint64_t expected, const uint64_t value) {
+      writeIndex.compare_exchange_strong(expected, value, std::memory_order_acq_rel);
+      return expected;
+   }
+
+   inline uint64_t loadReadIndex() const {
+      return readIndex.load(std::memory_order_acquire);
+   }
+
+   inline void ringDoorbell(const uint64_t packetId) {
+      HsaHostSignal::store(queue.doorbell_signal, packetId);
+   }
+
+   /// HSA_STATUS_SUCCESS, unless a queue error occurred.
+   hsa_status_t getStatus() const {
+      return status.load();
+   }
+
+private:
+   /// The state of the packet that is currently processed. The `work` word
+   /// contains the (lower 32 bits of the) packet ID in the upper half and the ID
+   /// of the next unclaimed work-group in the lower half. Workers claim
+   /// work-groups with a CAS, which fails once the next packet has been launched.
+   struct alignas(64) Launch {
+      std::atomic<uint64_t> work;
+      std::atomic<uint64_t> numGroups;
+      std::atomic<uint64_t> numGroupsDone;
+      /// Null for barrier packets.
+      const HsaHostKernel* kernel;
+      const void* kernargAddress;
+      uint64_t gridSize;
+      uint32_t workgroupSize;
+      uint16_t header;
+      hsa_signal_t completionSignal;
+      HsaBarrierType barrierType;
+      hsa_signal_t dependencies[HsaAgent::maxBarrierDependencies];
+   };
+
+   const uint32_t numThreads;
+   const ErrorCallback errorCallback;
+
+   hsa_queue_t queue;
+   hsa_kernel_dispatch_packet_t* packets;
+   uint64_t queueMask;
+
+   Launch launch;
+
+   alignas(64) std::atomic<uint64_t> writeIndex;
+   alignas(64) std::atomic<uint64_t> readIndex;
+   /// The number of packets that have been launched (or are being launched).
+   alignas(64) std::atomic<uint64_t> numLaunched;
+
+   /// Workers that wait for the current packet to complete block on the
+   /// condition variable.
+   std::atomic<uint32_t> numSleepers;
+   std::mutex mutex;
+   std::condition_variable wakeUp;
+   std::atomic<bool> shutDown;
+   std::atomic<hsa_status_t> status;
+
+   std::vector<std::thread> workers;
+
+   /// The main loop of a worker thread.
+   void work(const uint32_t threadId);
+
+   /// Reads the packet and makes its work-groups available to the workers.
+   void launchPacket(const uint64_t packetId, const hsa_kernel_dispatch_packet_t& packet, const uint16_t header);
+
+   /// Executes a single work-group (or waits for the dependencies of a
+   /// barrier packet) and completes the packet if it was the last one.
+   void execute(const uint64_t packetId, const uint64_t groupId);
+
+   void complete(const uint64_t packetId);
+
+   /// Stops the processing of the queue.
+   void fail(const hsa_status_t error);
+
+   /// Waits (spins, then blocks) until the current packet has completed.
+   void idle(const uint64_t packetId, uint32_t& idleRounds);
+
+   void notifyWorkers();
+
+   static inline uint32_t getField(const uint16_t header, const uint32_t offset, const uint32_t width) {
+      return (header >> offset) & ((1u << width) - 1);
+   }
+};
+
+}
+}
@@ -0,0 +1,163 @@
+#include <rts/hsa/HsaAutotuner.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+namespace rts {
+namespace hsa {
+
+using namespace std;
+
+HsaAutotuner::HsaAutotuner(const std::string& profilePath) :
+      profilePath(profilePath), workgroupSizeCandidates( { 64, 128, 256, 512, 1024 }), numRepetitions(3), generation(0) {
+   if (!profilePath.empty()) {
+      load();
+   }
+}
+
+void HsaAutotuner::setWorkgroupSizeCandidates(const std::vector<uint16_t>& workgroupSizes) {
+   if (workgroupSizes.empty() || std::find(workgroupSizes.begin(), workgroupSizes.end(), 0) != workgroupSizes.end()) {
+      throw HsaException("Invalid work-group size candidates.");
+   }
+   std::lock_guard<std::mutex> lock(mutex);
+   workgroupSizeCandidates = workgroupSizes;
+   std::sort(workgroupSizeCandidates.begin(), workgroupSizeCandidates.end());
+}
+
+std::vector<uint16_t> HsaAutotuner::getWorkgroupSizeCandidates() const {
+   std::lock_guard<std::mutex> lock(mutex);
+   return workgroupSizeCandidates;
+}
+
+void HsaAutotuner::setNumRepetitions(const uint32_t numRepetitions) {
+   std::lock_guard<std::mutex> lock(mutex);
+   this->numRepetitions = std::max(1u, numRepetitions);
+}
+
+uint32_t HsaAutotuner::getSizeClass(const uint64_t numElements) {
+   uint32_t sizeClass = 0;
+   while (sizeClass < 63 && (numElements >> (sizeClass + 1)) != 0) sizeClass++;
+   return sizeClass;
+}
+
+bool HsaAutotuner::find(const std::string& isaName, const std::string& kernelSymbolName,
+      const uint32_t sizeClass, KernelLaunchParameters& result) const {
+   std::lock_guard<std::mutex> lock(mutex);
+   const auto entry = profile.find(Key(isaName, kernelSymbolName, sizeClass));
+   if (entry == profile.end()) return false;
+   result = entry->second;
+   return true;
+}
+
+HsaAutotuner::KernelLaunchParameters HsaAutotuner::tune(const std::string& isaName,
+      const std::string& kernelSymbolName, const uint32_t sizeClass,
+      const std::vector<KernelLaunchParameters>& candidates, const Trial& trial) {
+   KernelLaunchParameters best = { 0, 0 };
+   if (find(isaName, kernelSymbolName, sizeClass, best)) return best;
+   if (candidates.empty()) {
+      throw HsaException("No candidates to tune kernel " + kernelSymbolName);
+   }
+
+   // The mutex is not held while the kernel runs. If two threads tune the
+   // same kernel concurrently, the result of the last one is kept.
+   uint32_t repetitions;
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      repetitions = numRepetitions;
+   }
+   auto bestTime = chrono::nanoseconds::max();
+   for (const KernelLaunchParameters& candidate : candidates) {
+      for (uint32_t i = 0; i < repetitions; i++) {
+         const auto start = chrono::steady_clock::now();
+         trial(candidate);
+         const auto time = chrono::steady_clock::now() - start;
+         if (time < bestTime) {
+            bestTime = time;
+            best = candidate;
+         }
+      }
+   }
+
+   std::lock_guard<std::mutex> lock(mutex);
+   profile[Key(isaName, kernelSymbolName, sizeClass)] = best;
+   generation.fetch_add(1, std::memory_order_release);
+   if (!profilePath.empty()) {
+      saveProfile();
+   }
+   return best;
+}
+
+std::size_t HsaAutotuner::size() const {
+   std::lock_guard<std::mutex> lock(mutex);
+   return profile.size();
+}
+
+void HsaAutotuner::load() {
+   ifstream in(profilePath);
+   if (!in) return;
+
+   // One entry per line (tab separated): ISA, kernel symbol, size class,
+   // grid size and work-group size.
+   std::map<Key, KernelLaunchParameters> loaded;
+   string line;
+   uint64_t lineNumber = 0;
+   while (getline(in, line)) {
+      lineNumber++;
+      if (line.empty()) continue;
+      istringstream fields(line);
+      string isaName;
+      string kernelSymbolName;
+      uint32_t sizeClass;
+      KernelLaunchParameters n;
+      if (!getline(fields, isaName, '\t') || !getline(fields, kernelSymbolName, '\t')
+            || !(fields >> sizeClass >> n.numElements >> n.workgroupSize)) {
+         throw HsaException("Malformed autotuner profile " + profilePath + " (line "
+               + to_string(lineNumber) + ")");
+      }
+      loaded[Key(isaName, kernelSymbolName, sizeClass)] = n;
+   }
+
+   std::lock_guard<std::mutex> lock(mutex);
+   profile.swap(loaded);
+   generation.fetch_add(1, std::memory_order_release);
+}
+
+void HsaAutotuner::save() const {
+   if (profilePath.empty()) {
+      throw HsaException("The autotuner has no profile path.");
+   }
+   std::lock_guard<std::mutex> lock(mutex);
+   saveProfile();
+}
+
+void HsaAutotuner::saveProfile() const {
+   // Write a temporary file and rename it, thus readers never see a
+   // partially written profile. The name of the temporary file is unique per
+   // write, as several processes (or autotuners) may write the same profile
+   // concurrently.
+   static atomic<uint64_t> numTmpFiles(0);
+   const string tmpPath = profilePath + ".tmp" + to_string(getpid()) + "." + to_string(numTmpFiles++);
+   {
+      ofstream out(tmpPath, ios::trunc);
+      for (const auto& entry : profile) {
+         out << get<0>(entry.first) << '\t' << get<1>(entry.first) << '\t' << get<2>(entry.first)
+               << '\t' << entry.second.numElements << '\t' << entry.second.workgroupSize << '\n';
+      }
+      if (!out) {
+         std::remove(tmpPath.c_str());
+         throw HsaException("Failed to write autotuner profile " + tmpPath);
+      }
+   }
+   if (std::rename(tmpPath.c_str(), profilePath.c_str()) != 0) {
+      std::remove(tmpPath.c_str());
+      throw HsaException("Failed to write autotuner profile " + profilePath);
+   }
+}
+
+}
+}
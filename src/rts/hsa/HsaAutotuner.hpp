@@ -0,0 +1,99 @@
+#pragma once
+
+#include <rts/hsa/HsaAgent.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+/// Empirically determines the launch parameters of a kernel. When a kernel
+/// is tuned for a size class on an agent, each candidate configuration is
+/// timed and the fastest one is kept. The results are keyed
+/// by the ISA of the agent, the kernel symbol and the size class, and are
+/// (optionally) persisted in a profile, thus later runs of the program do not
+/// tune again.
+///
+/// HsaContext uses the tuned work-group size for dispatches that do not
+/// specify one (see HsaContext::setAutotuner and HsaContext::tune). An
+/// autotuner can be shared by several contexts.
+class HsaAutotuner {
+public:
+   typedef HsaAgent::KernelLaunchParameters KernelLaunchParameters;
+
+   /// Runs the kernel with the given configuration and waits for it.
+   typedef std::function<void(const KernelLaunchParameters&)> Trial;
+
+   /// C'tor. If a profile path is given, the profile is loaded (if it exists)
+   /// and rewritten after each tuning run.
+   explicit HsaAutotuner(const std::string& profilePath = "");
+
+   /// The work-group sizes that are tried by HsaContext (default: 64 to 1024).
+   void setWorkgroupSizeCandidates(const std::vector<uint16_t>& workgroupSizes);
+
+   std::vector<uint16_t> getWorkgroupSizeCandidates() const;
+
+   /// The number of runs per candidate, the fastest run counts (default: 3).
+   void setNumRepetitions(const uint32_t numRepetitions);
+
+   /// Grids of the same size class share the tuned parameters. The size
+   /// class is the position of the most significant bit.
+   static uint32_t getSizeClass(const uint64_t numElements);
+
+   /// Returns false if the kernel has not been tuned for the size class.
+   bool find(const std::string& isaName, const std::string& kernelSymbolName,
+         const uint32_t sizeClass, KernelLaunchParameters& result) const;
+
+   /// Returns the tuned parameters of the kernel for the size class. If
+   /// there are none, each candidate is run (see setNumRepetitions) and the
+   /// fastest one is stored. Note that the trial is executed several times,
+   /// thus it should run the kernel on scratch data (or restore its input).
+   KernelLaunchParameters tune(const std::string& isaName, const std::string& kernelSymbolName,
+         const uint32_t sizeClass, const std::vector<KernelLaunchParameters>& candidates, const Trial& trial);
+
+   /// The number of tuned (kernel, size class) combinations.
+   std::size_t size() const;
+
+   /// Incremented whenever tuned parameters are stored or loaded, thus users
+   /// that cache the parameters (e.g., HsaContext) can tell that their cache
+   /// is outdated.
+   uint64_t getGeneration() const {
+      return generation.load(std::memory_order_acquire);
+   }
+
+   /// Reads the profile (replaces the tuned parameters). A missing profile
+   /// is not an error, a malformed one is.
+   void load();
+
+   /// Writes the profile (throws if it cannot be written).
+   void save() const;
+
+private:
+   typedef std::tuple<std::string, std::string, uint32_t> Key;
+
+   const std::string profilePath;
+
+   mutable std::mutex mutex;
+
+   std::vector<uint16_t> workgroupSizeCandidates;
+
+   uint32_t numRepetitions;
+
+   std::map<Key, KernelLaunchParameters> profile;
+
+   /// See getGeneration (modified with the mutex held).
+   std::atomic<uint64_t> generation;
+
+   /// Requires the mutex.
+   void saveProfile() const;
+};
+
+}
+}
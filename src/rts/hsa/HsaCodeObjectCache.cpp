@@ -0,0 +1,159 @@
+#include <rts/hsa/HsaCodeObjectCache.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+
+namespace rts {
+namespace hsa {
+
+using namespace std;
+
+namespace {
+
+/// Identifies the format of the cache entries, entries written in a different
+/// format are treated as misses.
+constexpr char entryMagic[8] = { 'H', 'S', 'A', 'C', 'O', 'C', '0', '1' };
+
+/// The offset of the byteCount field in the BRIG module header.
+constexpr size_t brigByteCountOffset = 16;
+
+/// An entry consists of the header, followed by the serialized code object.
+struct EntryHeader {
+   char magic[8];
+   char key[16];
+   uint64_t size;
+   uint64_t checksum;
+};
+
+/// FNV-1a (64 bit).
+constexpr uint64_t fnvOffsetBasis = 14695981039346656037ull;
+constexpr uint64_t fnvPrime = 1099511628211ull;
+
+inline uint64_t fnv1a(uint64_t hash, const void* data, const size_t size) {
+   const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+   for (size_t i = 0; i < size; i++) {
+      hash = (hash ^ bytes[i]) * fnvPrime;
+   }
+   return hash;
+}
+
+/// Hashes the size first, thus the boundaries of the inputs are part of the
+/// hash.
+inline uint64_t fnv1aSized(uint64_t hash, const void* data, const uint64_t size) {
+   hash = fnv1a(hash, &size, sizeof(size));
+   return fnv1a(hash, data, size);
+}
+
+}
+
+HsaCodeObjectCache::HsaCodeObjectCache(const std::string& directory) :
+      directory(directory), numHits(0), numMisses(0), numStores(0) {
+   if (directory.empty()) {
+      throw HsaException("The code object cache requires a directory.");
+   }
+}
+
+uint64_t HsaCodeObjectCache::getModuleSize(const char* brigModule) {
+   uint64_t byteCount;
+   std::memcpy(&byteCount, brigModule + brigByteCountOffset, sizeof(byteCount));
+   return byteCount;
+}
+
+std::string HsaCodeObjectCache::getKey(const std::vector<const char*>& brigModules, const std::string& isaName,
+      const std::string& options) {
+   uint64_t hash = fnv1aSized(fnvOffsetBasis, entryMagic, sizeof(entryMagic));
+   for (const char* brigModule : brigModules) {
+      hash = fnv1aSized(hash, brigModule, getModuleSize(brigModule));
+   }
+   hash = fnv1aSized(hash, isaName.data(), isaName.size());
+   hash = fnv1aSized(hash, options.data(), options.size());
+
+   ostringstream key;
+   key << hex << setw(16) << setfill('0') << hash;
+   return key.str();
+}
+
+std::string HsaCodeObjectCache::getPath(const std::string& key) const {
+   return directory + "/" + key + ".hsaco";
+}
+
+bool HsaCodeObjectCache::load(const std::string& key, std::string& serializedCodeObject) {
+   ifstream in(getPath(key), ios::binary);
+   if (!in) {
+      numMisses++;
+      return false;
+   }
+   // An invalid entry would be rejected on every load, thus it is removed.
+   EntryHeader header;
+   if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+         || std::memcmp(header.magic, entryMagic, sizeof(entryMagic)) != 0
+         || key.size() != sizeof(header.key) || key.compare(0, key.size(), header.key, sizeof(header.key)) != 0) {
+      numMisses++;
+      remove(key);
+      return false;
+   }
+   // The size is checked before the buffer is allocated, thus a corrupted
+   // header does not result in a huge allocation.
+   const streamoff dataOffset = in.tellg();
+   in.seekg(0, ios::end);
+   if (!in || static_cast<uint64_t>(in.tellg() - dataOffset) != header.size) {
+      numMisses++;
+      remove(key);
+      return false;
+   }
+   in.seekg(dataOffset);
+   string data(header.size, '\0');
+   if (!in.read(&data[0], header.size) || fnv1a(fnvOffsetBasis, data.data(), data.size()) != header.checksum) {
+      // A truncated or corrupted entry.
+      numMisses++;
+      remove(key);
+      return false;
+   }
+   serializedCodeObject.swap(data);
+   numHits++;
+   return true;
+}
+
+void HsaCodeObjectCache::store(const std::string& key, const void* serializedCodeObject, const std::size_t size) {
+   if (key.size() != sizeof(EntryHeader::key)) {
+      throw HsaException("Invalid code object cache key " + key);
+   }
+   EntryHeader header;
+   std::memcpy(header.magic, entryMagic, sizeof(entryMagic));
+   std::memcpy(header.key, key.data(), sizeof(header.key));
+   header.size = size;
+   header.checksum = fnv1a(fnvOffsetBasis, serializedCodeObject, size);
+
+   // Write a temporary file and rename it, thus readers never see a
+   // partially written entry. The name of the temporary file is unique per
+   // store, as several processes (or threads) may store the same entry
+   // concurrently.
+   static atomic<uint64_t> numTmpFiles(0);
+   const string path = getPath(key);
+   const string tmpPath = path + ".tmp" + to_string(getpid()) + "." + to_string(numTmpFiles++);
+   {
+      ofstream out(tmpPath, ios::binary | ios::trunc);
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      out.write(reinterpret_cast<const char*>(serializedCodeObject), size);
+      if (!out) {
+         std::remove(tmpPath.c_str());
+         throw HsaException("Failed to write code object cache entry " + tmpPath);
+      }
+   }
+   if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+      std::remove(tmpPath.c_str());
+      throw HsaException("Failed to write code object cache entry " + path);
+   }
+   numStores++;
+}
+
+void HsaCodeObjectCache::remove(const std::string& key) {
+   std::remove(getPath(key).c_str());
+}
+
+}
+}
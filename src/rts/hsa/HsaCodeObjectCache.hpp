@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+/// An on-disk cache of serialized code objects, so that warm starts skip the
+/// finalization of the BRIG modules (see HsaAqlAgent::finalize).
+///
+/// An entry is keyed by a hash of everything the finalization depends on:
+/// the contents of the BRIG modules (in the order they were added), the ISA
+/// of the kernel agent and the finalizer options. If any of them changes, the
+/// key changes as well, thus stale entries are never loaded. Entries are
+/// written to a temporary file, which is then renamed, so that concurrent
+/// processes never read a partially written entry. Entries that fail to load
+/// are removed.
+///
+/// The cache is thread-safe and may be shared by several agents.
+class HsaCodeObjectCache {
+public:
+   struct Stats {
+      uint64_t numHits;
+      uint64_t numMisses;
+      uint64_t numStores;
+   };
+
+   /// C'tor, the directory must exist.
+   explicit HsaCodeObjectCache(const std::string& directory);
+
+   /// The key of the code object that is finalized from the given BRIG
+   /// modules for the given ISA with the given finalizer options.
+   static std::string getKey(const std::vector<const char*>& brigModules, const std::string& isaName,
+         const std::string& options);
+
+   /// The size of a BRIG module (as stated in its header).
+   static uint64_t getModuleSize(const char* brigModule);
+
+   /// Reads the serialized code object. Returns false if there is no (valid)
+   /// entry; an invalid entry is removed.
+   bool load(const std::string& key, std::string& serializedCodeObject);
+
+   /// Atomically writes (or replaces) an entry.
+   void store(const std::string& key, const void* serializedCodeObject, const std::size_t size);
+
+   /// Removes an entry, e.g., if the code object cannot be deserialized.
+   void remove(const std::string& key);
+
+   const std::string& getDirectory() const {
+      return directory;
+   }
+
+   std::string getPath(const std::string& key) const;
+
+   Stats getStats() const {
+      return Stats { numHits.load(), numMisses.load(), numStores.load() };
+   }
+
+private:
+   const std::string directory;
+
+   std::atomic<uint64_t> numHits;
+   std::atomic<uint64_t> numMisses;
+   std::atomic<uint64_t> numStores;
+};
+
+}
+}
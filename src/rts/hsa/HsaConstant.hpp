@@ -0,0 +1,64 @@
+#pragma once
+
+#include <type_traits>
+
+namespace rts {
+namespace hsa {
+
+/// A kernel argument that is passed by value, but does not fit into the
+/// kernel argument segment, e.g., a lookup table, a predicate descriptor or
+/// the parameters of a hash function. In the argument segment it occupies a
+/// pointer, the kernel declares the parameter as a (constant) pointer to T.
+///
+/// The dispatch copies the value into the constant arena of the context (see
+/// HsaConstantArena) and passes the address of the copy. Thus the value may
+/// be modified (or destroyed) as soon as the dispatch returns. Arrays are
+/// passed as std::array or as a struct. The size of T must not exceed the
+/// capacity of the arena.
+template<typename T>
+class HsaConstant {
+public:
+   static_assert(std::is_trivially_copyable<T>::value, "A by-value kernel argument must be trivially copyable.");
+
+   /// C'tor, references no value (host kernels read their arguments into
+   /// default constructed ones).
+   HsaConstant() :
+         ptr(nullptr) {
+   }
+
+   /// C'tor, references the value (which is not copied before the dispatch).
+   explicit HsaConstant(const T& value) :
+         ptr(&value) {
+   }
+
+   const T* get() const {
+      return ptr;
+   }
+
+   const T& operator*() const {
+      return *ptr;
+   }
+
+   const T* operator->() const {
+      return ptr;
+   }
+
+private:
+   const T* ptr;
+};
+
+/// Whether any of the types Ts is a HsaConstant.
+template<typename ... Ts>
+struct HsaHasConstant : std::false_type {
+};
+
+template<typename T, typename ... Ts>
+struct HsaHasConstant<T, Ts...> : HsaHasConstant<Ts...> {
+};
+
+template<typename T, typename ... Ts>
+struct HsaHasConstant<HsaConstant<T>, Ts...> : std::true_type {
+};
+
+}
+}
@@ -0,0 +1,88 @@
+#include <rts/hsa/HsaConstantArena.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <string>
+#include <thread>
+
+namespace rts {
+namespace hsa {
+
+constexpr uint32_t HsaConstantArena::alignment;
+constexpr std::size_t HsaConstantArena::defaultCapacity;
+
+HsaConstantArena::HsaConstantArena(HsaAgent& agent, const std::size_t capacity) :
+      agent(agent), capacity((capacity + alignment - 1) & ~std::size_t(alignment - 1)), memory(nullptr),
+            head(0), tail(0), regions(agent.getQueueSize()), firstRegion(0), numRegions(0), numWaits(0) {
+   if (this->capacity == 0) {
+      throw HsaException("The capacity of the constant arena must not be zero.");
+   }
+   memory = reinterpret_cast<uint8_t*>(agent.allocateArgumentMemory(this->capacity));
+}
+
+HsaConstantArena::~HsaConstantArena() {
+   agent.freeArgumentMemory(memory);
+}
+
+void* HsaConstantArena::tryAllocate(const uint64_t packetId, const Completion& completion,
+      const std::size_t size) {
+   const uint64_t alignedSize = (size + alignment - 1) & ~uint64_t(alignment - 1);
+   if (alignedSize > capacity) {
+      throw HsaException("A by-value kernel argument of " + std::to_string(size)
+            + " bytes exceeds the capacity of the constant arena.");
+   }
+   if (!fits(alignedSize)) {
+      reclaim(packetId);
+      if (!fits(alignedSize)) return nullptr;
+   }
+
+   const bool extends = numRegions != 0 && regions[(firstRegion + numRegions - 1) % regions.size()].packetId == packetId;
+   if (!extends && numRegions == regions.size()) {
+      reclaim(packetId);
+      if (numRegions == regions.size()) return nullptr;
+   }
+
+   head += getGap(alignedSize);
+   void* ptr = memory + head % capacity;
+   head += alignedSize;
+   if (extends) {
+      regions[(firstRegion + numRegions - 1) % regions.size()].end = head;
+   } else {
+      regions[(firstRegion + numRegions) % regions.size()] = Region { packetId, head, completion };
+      if (completion.signalPool != nullptr) {
+         completion.signalPool->retain(completion.slot);
+      }
+      numRegions++;
+   }
+   return ptr;
+}
+
+void* HsaConstantArena::allocate(const uint64_t packetId, const Completion& completion,
+      const std::size_t size) {
+   void* ptr = tryAllocate(packetId, completion, size);
+   if (ptr != nullptr) return ptr;
+   numWaits++;
+   while ((ptr = tryAllocate(packetId, completion, size)) == nullptr) {
+      std::this_thread::yield();
+   }
+   return ptr;
+}
+
+void HsaConstantArena::reclaim(const uint64_t packetId) {
+   while (numRegions != 0 && regions[firstRegion].packetId != packetId
+         && agent.loadSignal(regions[firstRegion].completion.signal) == 0) {
+      const Completion& completion = regions[firstRegion].completion;
+      if (completion.signalPool != nullptr) {
+         completion.signalPool->release(completion.slot);
+      }
+      tail = regions[firstRegion].end;
+      firstRegion = (firstRegion + 1) % regions.size();
+      numRegions--;
+   }
+   if (numRegions == 0) {
+      // The ring is empty, the next allocation starts at its beginning.
+      head = (head + capacity - 1) / capacity * capacity;
+      tail = head;
+   }
+}
+
+}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <rts/hsa/HsaAgent.hpp>
+#include <rts/hsa/HsaSignalPool.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+/// A ring buffer of kernel argument memory that holds the by-value arguments
+/// of the packets in flight (see HsaConstant). The memory is allocated once,
+/// thus a dispatch with by-value arguments does not allocate (or free) any
+/// memory.
+///
+/// An allocation belongs to a packet and is reclaimed once the completion
+/// signal of the packet is zero, i.e., once the kernel has completed. The read
+/// index of the queue does not suffice, as an agent may advance it as soon as
+/// it has fetched the packet. A completion signal of a pool is retained until
+/// the memory is reclaimed, as the pool resets the signals it gets back.
+/// Allocations are made in packet order. Like the queue, the arena is not
+/// thread-safe.
+class HsaConstantArena {
+public:
+   /// Allocations start at a cache line and are a multiple of it.
+   static constexpr uint32_t alignment = 64;
+
+   static constexpr std::size_t defaultCapacity = 1 << 20;
+
+   /// How a packet signals its completion. The signal may be shared with
+   /// other packets (e.g., the chunks of a dispatch).
+   struct Completion {
+      hsa_signal_t signal;
+      /// The pool of the signal (nullptr if it does not stem from a pool).
+      HsaSignalPool* signalPool;
+      HsaSignalPool::Slot slot;
+   };
+
+   /// C'tor, allocates `capacity` bytes of kernel argument memory. The queue
+   /// of the agent must have been created.
+   HsaConstantArena(HsaAgent& agent, const std::size_t capacity = defaultCapacity);
+
+   /// D'tor
+   ~HsaConstantArena();
+
+   HsaConstantArena(const HsaConstantArena&) = delete;
+   HsaConstantArena& operator=(const HsaConstantArena&) = delete;
+
+   /// Allocates `size` bytes for the given packet. Returns nullptr if the
+   /// memory is held by packets that have not completed yet. Throws if the
+   /// size exceeds the capacity.
+   void* tryAllocate(const uint64_t packetId, const Completion& completion, const std::size_t size);
+
+   /// Like tryAllocate, but waits (yields) until the packets that hold the
+   /// memory have completed. They must have been submitted.
+   void* allocate(const uint64_t packetId, const Completion& completion, const std::size_t size);
+
+   std::size_t getCapacity() const {
+      return capacity;
+   }
+
+   /// The number of bytes held by packets in flight (as of the last
+   /// allocation).
+   std::size_t getNumBytesInUse() const {
+      return static_cast<std::size_t>(head - tail);
+   }
+
+   /// The number of allocations that had to wait.
+   uint64_t getNumWaits() const {
+      return numWaits;
+   }
+
+private:
+   /// The memory of a packet ends at `end` (as a position of the ring).
+   struct Region {
+      uint64_t packetId;
+      uint64_t end;
+      Completion completion;
+   };
+
+   HsaAgent& agent;
+   const std::size_t capacity;
+   uint8_t* memory;
+
+   /// The positions of the next and the oldest allocated byte. They are never
+   /// wrapped around, the offset is the position modulo the capacity.
+   uint64_t head;
+   uint64_t tail;
+
+   /// The regions of the packets in flight (a ring buffer), at most one per
+   /// packet. If all are in use, allocations wait for the oldest packet.
+   std::vector<Region> regions;
+   std::size_t firstRegion;
+   std::size_t numRegions;
+
+   uint64_t numWaits;
+
+   /// Releases the regions of the completed packets (except the one of the
+   /// given packet, whose signal may not count it yet).
+   void reclaim(const uint64_t packetId);
+
+   /// An allocation does not wrap around, the rest of the ring is skipped
+   /// instead (and belongs to the allocation).
+   inline uint64_t getGap(const uint64_t alignedSize) const {
+      const uint64_t offset = head % capacity;
+      return offset + alignedSize > capacity ? capacity - offset : 0;
+   }
+
+   inline bool fits(const uint64_t alignedSize) const {
+      return head + getGap(alignedSize) + alignedSize - tail <= capacity;
+   }
+};
+
+}
+}
@@ -1,12 +1,8 @@
 #include <rts/hsa/HsaContext.hpp>
-#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaAqlAgent.hpp>
 #include <rts/hsa/HsaRuntime.hpp>
-#include <rts/hsa/HsaUtils.hpp>
-#include <hsa.h>
-#include <hsa_ext_finalize.h>
-#include <functional>
-#include <memory>
-#include <iostream> // TODO remove
+#include <cstdlib>
+#include <new>
 
 namespace rts {
 namespace hsa {
@@ -14,305 +10,168 @@ namespace hsa {
 using namespace std;
 
 HsaContext::HsaContext(HsaRuntime& rt) :
-      rt(rt), program({0}), codeObject({0}), executable({0}),
-            queue(nullptr), argumentMemoryPtr(nullptr), argumentSize(0) {
+      ownedAgent(new HsaAqlAgent(rt)), agent(*ownedAgent), signalPool(agent),
+            batchCoalescingMaxPackets(1), batchCoalescingMaxDelay(std::chrono::nanoseconds::max()),
+            numPendingBatchPackets(0), lastPendingBatchPacketId(0), maxGridSize(agent.getMaxGridSize()),
+            autotuner(nullptr), autotunerGeneration(0), spillContext(nullptr), numSpilledDispatches(0) {
 
-   if (HsaUtils::isInitialized() == false) {
-      throw HsaException("HSA runtime not initialized.");
-   }
+   // Create batch-completion signal.
+   batchCompletionSignal = agent.createSignal(0);
+}
 
-   HsaUtils::apiCall([&] {
-      return hsa_ext_program_create(
-            HSA_MACHINE_MODEL_LARGE,
-            HSA_PROFILE_FULL,
-            HSA_DEFAULT_FLOAT_ROUNDING_MODE_DEFAULT,
-            nullptr, /* no options */
-            &program);
-   });
+HsaContext::HsaContext(HsaAgent& agent) :
+      agent(agent), signalPool(agent),
+            batchCoalescingMaxPackets(1), batchCoalescingMaxDelay(std::chrono::nanoseconds::max()),
+            numPendingBatchPackets(0), lastPendingBatchPacketId(0), maxGridSize(agent.getMaxGridSize()),
+            autotuner(nullptr), autotunerGeneration(0), spillContext(nullptr), numSpilledDispatches(0) {
 
    // Create batch-completion signal.
-   HsaUtils::apiCall([&] {
-      return hsa_signal_create(0, 0, NULL, &batchCompletionSignal);
-   });
+   batchCompletionSignal = agent.createSignal(0);
 }
 
 HsaContext::~HsaContext() {
-   if (HsaUtils::isInitialized() == false) return;
-
-   // Free argument memory-segment.
-   if (argumentMemoryPtr != nullptr) {
-      HsaUtils::apiCall([&] {
-         return hsa_memory_free(argumentMemoryPtr);
-      });
+   // The background finalization uses the agent.
+   if (finalization.valid()) {
+      finalization.wait();
    }
+   releaseBatchBuffers();
+   if (ownedAgent != nullptr && HsaUtils::isInitialized() == false) return;
 
-   // Destroy queue. // TODO explicitly destroy signals
-   if (queue != nullptr) {
-      HsaUtils::apiCall([&] {
-         return hsa_queue_destroy(queue);
-      });
-   }
+   signalPool.destroySignals();
+   agent.destroySignal(batchCompletionSignal);
+}
 
-   // Destroy executable.
-   if (executable.handle != 0) {
-      HsaUtils::apiCall([&] {
-         return hsa_executable_destroy(executable);
-      });
+void* HsaContext::operator new(const std::size_t size) {
+   void* ptr;
+   if (posix_memalign(&ptr, alignof(HsaContext), size) != 0) {
+      throw std::bad_alloc();
    }
+   return ptr;
+}
 
-   // Destroy code object.
-   if (codeObject.handle != 0) {
-      HsaUtils::apiCall([&] {
-         return hsa_code_object_destroy(codeObject);
-      });
-   }
+void HsaContext::operator delete(void* ptr) {
+   free(ptr);
+}
 
-   // Destroy program.
-   if (program.handle != 0) {
-      HsaUtils::apiCall([&] {
-         return hsa_ext_program_destroy(program);
-      });
+void HsaContext::releaseBatchBuffers() {
+   for (const Future::Registration& buffer : batchBuffers) {
+      HsaRegistrationCache::getInstance().release(buffer.first, buffer.second);
    }
-   cout << "HSA context destructed." << endl;
+   batchBuffers.clear();
 }
 
-void HsaContext::addModule(const char* brigModulePtr) {
-   HsaUtils::apiCall([&] {
-      return hsa_ext_program_add_module(program, (hsa_ext_module_t)brigModulePtr);
+void HsaContext::finalizeAsync() {
+   waitForFinalization();
+   HsaAgent* agent = &this->agent;
+   finalization = std::async(std::launch::async, [agent] {
+      agent->finalize();
    });
 }
 
-void HsaContext::finalize() {
-   // Finalize HSA modules (results in a ``code object'')
-   HsaUtils::apiCall([&] {
-      hsa_ext_control_directives_t finalizerControlDirectives;
-      finalizerControlDirectives.control_directives_mask = 0;
-      return hsa_ext_program_finalize(
-            program,
-            rt.kernelAgentIsa,
-            HSA_EXT_FINALIZER_CALL_CONVENTION_AUTO,
-            finalizerControlDirectives,
-            nullptr, /* no options */
-            HSA_CODE_OBJECT_TYPE_PROGRAM,
-            &codeObject);
-   });
-
-   // Destroy the HSA program as it is no longer needed.
-   HsaUtils::apiCall([&] {
-      return hsa_ext_program_destroy(program);
-   });
-   program = {0};
-
-   // Create an executable.
-   // Note, that the lifetime of the code object must exceed that of the executable.
-   HsaUtils::apiCall([&] {
-      return hsa_executable_create(
-            HSA_PROFILE_FULL,
-            HSA_EXECUTABLE_STATE_UNFROZEN,
-            nullptr, /* no options */
-            &executable);
-   });
-
-   HsaUtils::apiCall([&] {
-      return hsa_executable_load_code_object(
-            executable,
-            rt.kernelAgent,
-            codeObject,
-            nullptr);
-   });
-
-   HsaUtils::apiCall([&] {
-      return hsa_executable_freeze(
-            executable,
-            nullptr);
-   });
+void HsaContext::waitForFinalization() {
+   if (finalization.valid()) {
+      // Rethrows the exception of the finalization (and invalidates the
+      // future).
+      finalization.get();
+   }
 }
 
-void HsaContext::createQueue() {
-   // Determine the sizes of memory segments.
-   uint32_t maxKernelArgSegmentSize = 0;
-   uint32_t maxKernelGroupSegmentSize = 0;
-   uint32_t maxKernelPrivateSegmentSize = 0;
-
-   iterateKernelCodeSymbols([&](std::string& kernelSymbolName) {
-      std::cout << kernelSymbolName << std::endl;
-      hsa_executable_symbol_t executableSymbol;
-      const char* moduleName = nullptr; // not yet supported
-         HsaUtils::apiCall([&] {
-                  return hsa_executable_get_symbol(
-                        executable,
-                        moduleName,
-                        kernelSymbolName.c_str(),
-                        rt.kernelAgent,
-                        HSA_EXT_FINALIZER_CALL_CONVENTION_AUTO,
-                        &executableSymbol);
-               });
-         uint32_t kernelArgSegmentSize;
-         HsaUtils::apiCall([&] {
-                  return hsa_executable_symbol_get_info(
-                        executableSymbol,
-                        HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_KERNARG_SEGMENT_SIZE,
-                        &kernelArgSegmentSize);
-               });
-         maxKernelArgSegmentSize = std::max(maxKernelArgSegmentSize, kernelArgSegmentSize);
-
-         uint32_t kernelGroupSegmentSize;
-         HsaUtils::apiCall([&] {
-                  return hsa_executable_symbol_get_info(
-                        executableSymbol,
-                        HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_GROUP_SEGMENT_SIZE,
-                        &kernelGroupSegmentSize);
-               });
-         maxKernelGroupSegmentSize = std::max(maxKernelGroupSegmentSize, kernelGroupSegmentSize);
-
-         uint32_t kernelPrivateSegmentSize;
-         HsaUtils::apiCall([&] {
-                  return hsa_executable_symbol_get_info(
-                        executableSymbol,
-                        HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_PRIVATE_SEGMENT_SIZE,
-                        &kernelPrivateSegmentSize);
-               });
-         maxKernelPrivateSegmentSize = std::max(maxKernelPrivateSegmentSize, kernelPrivateSegmentSize);
-      });
-
-   // Determine the queue size.
-   uint32_t minQueueSize;
-   HsaUtils::apiCall([&] {
-      return hsa_agent_get_info(
-            rt.kernelAgent,
-            HSA_AGENT_INFO_QUEUE_MIN_SIZE,
-            &minQueueSize);
-   });
-   uint32_t maxQueueSize;
-   HsaUtils::apiCall([&] {
-      return hsa_agent_get_info(
-            rt.kernelAgent,
-            HSA_AGENT_INFO_QUEUE_MAX_SIZE,
-            &maxQueueSize);
-   });
-   const uint32_t preferredQueueSize = 1 << 4; // must be a power of two
-   const uint32_t queueSize = std::min(std::max(preferredQueueSize, minQueueSize), maxQueueSize);
-   std::cout << "queueSize=" << queueSize << " (min=" << minQueueSize << ", max=" << maxQueueSize << ")" << std::endl;
-
-   // Create the actual queue.
-   HsaUtils::apiCall([&] {
-      return hsa_queue_create(
-            rt.kernelAgent,
-            queueSize,
-            HSA_QUEUE_TYPE_SINGLE, /* not thread-safe! */
-            nullptr,
-            nullptr,
-            maxKernelPrivateSegmentSize,
-            maxKernelGroupSegmentSize,
-            &queue);
-   });
-
-   // (Pre-)Allocate memory for kernel arguments.
-   const hsa_region_t kernelArgumentRegion = HsaUtils::determineKernelArgumentRegion(rt.kernelAgent);
-   constexpr uint32_t argAlign = 8;
-   argumentSize = ((maxKernelArgSegmentSize / argAlign) * argAlign) + argAlign * (maxKernelArgSegmentSize % argAlign);
-   std::cout << "argSize=" << maxKernelArgSegmentSize << ", paddedSize=" << argumentSize << std::endl;
-   const uint32_t totalArgSegmentSize = argumentSize * queueSize;
-   HsaUtils::apiCall([&] {
-      return hsa_memory_allocate(kernelArgumentRegion, totalArgSegmentSize, &argumentMemoryPtr);
-   });
-
-   // Initialize argument buffer
-   std::memset(argumentMemoryPtr, 0, queueSize * argumentSize);
-
-   // Initialize packets
-   for (size_t i = 0; i < queueSize; i++) {
-      hsa_kernel_dispatch_packet_t* packetPtr = queueGetKernelDispatchPacketPtr(i);
-      std::memset(((uint8_t*) packetPtr) + 4, 0, sizeof(hsa_kernel_dispatch_packet_t) - 4);
-      packetPtr->workgroup_size_x = 128; // TODO: make hardware dependent parameter configurable
-      packetPtr->workgroup_size_y = 1;
-      packetPtr->workgroup_size_z = 1;
-      packetPtr->grid_size_x = 1;
-      packetPtr->grid_size_y = 1;
-      packetPtr->grid_size_z = 1;
-      void* argPtr = getArgBufferPtr(i);
-      packetPtr->kernarg_address = argPtr;
+HsaAgent::KernelDescriptor HsaContext::getUnfinalizedKernelObject(const char* kernelSymbolName) {
+   waitForFinalization();
+   if (agent.hasUnfinalizedModules()) {
+      agent.finalize();
    }
-
-   // TODO bind arg buffers to queue entries
-   // TODO init queue entries (signals etc.)
+   return agent.getKernelObject(kernelSymbolName);
 }
 
-void HsaContext::iterateKernelCodeSymbols(std::function<void(std::string&)> callback) {
-   hsa_code_object_iterate_symbols(codeObject,
-         [] (hsa_code_object_t /* code */, hsa_code_symbol_t symbol, void* data) -> hsa_status_t {
-            hsa_symbol_kind_t kind;
-            hsa_code_symbol_get_info(symbol, HSA_CODE_SYMBOL_INFO_TYPE, &kind);
-            if (kind != HSA_SYMBOL_KIND_KERNEL) {
-               /* continue iteration */
-               return HSA_STATUS_SUCCESS;
-            }
-            uint32_t length;
-            hsa_code_symbol_get_info(symbol, HSA_CODE_SYMBOL_INFO_NAME_LENGTH, &length);
-            std::string symbolName(length, '_');
-            hsa_code_symbol_get_info(symbol, HSA_CODE_SYMBOL_INFO_NAME, &symbolName[0]);
-            std::function<void(std::string&)> callback = *reinterpret_cast<std::function<void(std::string&)>*>(data);
-            callback(symbolName);
-            return HSA_STATUS_SUCCESS;
-         }, &callback);
+void HsaContext::setSpillContext(HsaContext* spillContext) {
+   if (spillContext == this) {
+      throw HsaException("A context cannot spill to itself.");
+   }
+   this->spillContext = spillContext;
+   spillKernels.clear();
 }
 
-void* HsaContext::getArgBufferPtr(const uint64_t packetId) {
-   const uint32_t queueMask = queue->size - 1;
-   const uint64_t pos = packetId & queueMask;
-   void* argPtr = reinterpret_cast<uint8_t*>(argumentMemoryPtr) + (pos * argumentSize);
-   return argPtr;
+uint16_t HsaContext::tuneWithTrial(const KernelDescriptor& kernel, const uint64_t numElements,
+      const HsaAutotuner::Trial& trial) {
+   if (autotuner == nullptr) {
+      throw HsaException("The context has no autotuner.");
+   }
+   const char* kernelSymbolName = agent.getKernelSymbolName(kernel.kernelObject);
+   if (kernelSymbolName == nullptr) {
+      throw HsaException("Unknown kernel object.");
+   }
+   // Work-groups larger than the grid are truncated to the grid size, thus
+   // larger candidates would not make a difference.
+   const uint32_t maxWorkgroupSize = agent.getMaxWorkgroupSize();
+   std::vector<KernelLaunchParameters> candidates;
+   for (const uint16_t candidate : autotuner->getWorkgroupSizeCandidates()) {
+      if (candidate > maxWorkgroupSize) break;
+      candidates.push_back( { numElements, candidate });
+      if (candidate >= numElements) break;
+   }
+   const KernelLaunchParameters best = autotuner->tune(agent.getIsaName(), kernelSymbolName,
+         HsaAutotuner::getSizeClass(numElements), candidates, trial);
+   return best.workgroupSize;
 }
 
-// TODO remove from public API
-hsa_executable_symbol_t HsaContext::getExecutableSymbol(const std::string& kernelSymbolName) {
-   hsa_executable_symbol_t executableSymbol;
-   const char* moduleName = nullptr; // not yet supported
-   HsaUtils::apiCall([&] {
-      return hsa_executable_get_symbol(
-            executable,
-            moduleName,
-            kernelSymbolName.c_str(),
-            rt.kernelAgent,
-            HSA_EXT_FINALIZER_CALL_CONVENTION_AUTO,
-            &executableSymbol);
-   });
-   return executableSymbol;
+void HsaContext::createConstantArena(const std::size_t capacity) {
+   if (constantArena != nullptr) {
+      throw HsaException("The constant arena has been created already.");
+   }
+   constantArena.reset(new HsaConstantArena(agent, capacity));
 }
 
-HsaContext::KernelDescriptor HsaContext::getKernelObject(const std::string& kernelSymbolName) {
-   const hsa_executable_symbol_t executableSymbol = getExecutableSymbol(kernelSymbolName);
-
-   KernelDescriptor kernel;
-
-   HsaUtils::apiCall([&] {
-      return hsa_executable_symbol_get_info(
-            executableSymbol,
-            HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_OBJECT,
-            &kernel.kernelObject);
-   });
+HsaAgent::KernelDescriptor HsaContext::getSpillKernel(const KernelDescriptor& kernel) {
+   const auto cached = spillKernels.find(kernel.kernelObject);
+   if (cached != spillKernels.end()) return cached->second;
+   const char* kernelSymbolName = agent.getKernelSymbolName(kernel.kernelObject);
+   if (kernelSymbolName == nullptr) {
+      throw HsaException("Unknown kernel object, the dispatch cannot spill.");
+   }
+   const KernelDescriptor spillKernel = spillContext->getKernelObject(kernelSymbolName);
+   spillKernels[kernel.kernelObject] = spillKernel;
+   return spillKernel;
+}
 
-   // Extract dispatch information such as group segment size etc.
-   HsaUtils::apiCall([&] {
-      return hsa_executable_symbol_get_info(
-            executableSymbol,
-            HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_KERNARG_SEGMENT_SIZE,
-            &kernel.argumentSegmentSize);
-   });
-   HsaUtils::apiCall([&] {
-      return hsa_executable_symbol_get_info(
-            executableSymbol,
-            HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_GROUP_SEGMENT_SIZE,
-            &kernel.groupSegmentSize);
-   });
-   HsaUtils::apiCall([&] {
-      return hsa_executable_symbol_get_info(
-            executableSymbol,
-            HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_PRIVATE_SEGMENT_SIZE,
-            &kernel.privateSegmentSize);
-   });
+bool HsaContext::enqueueBarrierPackets(const HsaBarrierType type, const Dependencies& dependencies) {
+   uint32_t numPending = 0;
+   for (const Future& dependency : dependencies) {
+      if (dependency.valid()) {
+         numPending++;
+      }
+      else if (type == HsaBarrierType::Or) {
+         // A dependency has completed already.
+         return false;
+      }
+   }
+   if (numPending == 0) return false;
+   if (type == HsaBarrierType::Or && numPending > HsaAgent::maxBarrierDependencies) {
+      throw HsaException("A dispatch can wait for at most " + to_string(HsaAgent::maxBarrierDependencies)
+            + " alternative dependencies.");
+   }
 
-   return kernel;
+   // Pending batch packets have to be submitted first, otherwise the
+   // reservations might wait for them forever.
+   flushBatch();
+
+   // Successive barrier-AND packets wait for all of their dependencies. The
+   // doorbell is rung for each of them, as there may be more barrier packets
+   // than the queue holds.
+   hsa_signal_t signals[HsaAgent::maxBarrierDependencies];
+   uint32_t numSignals = 0;
+   for (const Future& dependency : dependencies) {
+      if (!dependency.valid()) continue;
+      signals[numSignals++] = dependency.getCompletionSignal();
+      numPending--;
+      if (numSignals == HsaAgent::maxBarrierDependencies || numPending == 0) {
+         const uint64_t packetId = agent.requestPacketId();
+         agent.publishBarrierPacket(packetId, type, signals, numSignals, hsa_signal_t{0});
+         agent.ringDoorbell(packetId);
+         numSignals = 0;
+      }
+   }
+   return true;
 }
 
 } // namespace hsa
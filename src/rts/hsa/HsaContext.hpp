@@ -4,134 +4,384 @@
 // (c) Harald Lang 2016
 //---------------------------------------------------------------------------
 #include <algorithm>
-#include <cstring> // memset
+#include <chrono>
+#include <rts/hsa/HsaAgent.hpp>
+#include <rts/hsa/HsaAutotuner.hpp>
+#include <rts/hsa/HsaCodeObjectCache.hpp>
+#include <rts/hsa/HsaConstant.hpp>
+#include <rts/hsa/HsaConstantArena.hpp>
 #include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaFuture.hpp>
+#include <rts/hsa/HsaHostBuffer.hpp>
+#include <rts/hsa/HsaKernelSignature.hpp>
+#include <rts/hsa/HsaModuleSource.hpp>
+#include <rts/hsa/HsaOccupancy.hpp>
+#include <rts/hsa/HsaRegistrationCache.hpp>
 #include <rts/hsa/HsaRuntime.hpp>
+#include <rts/hsa/HsaSignalPool.hpp>
 #include <rts/hsa/HsaUtils.hpp>
+#include <cstddef>
+#include <cstring>
 #include <functional>
+#include <future>
 #include <hsa.h>
-#include <hsa_ext_finalize.h>
-#include <iostream> // TODO remove
+#include <map>
 #include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 namespace rts {
 namespace hsa {
 
 class HsaContext {
 public:
-   struct KernelDescriptor {
-      uint64_t kernelObject;
-      uint32_t argumentSegmentSize;
-      uint32_t groupSegmentSize;
-      uint32_t privateSegmentSize;
-   };
-
-   struct KernelLaunchParameters {
-      uint32_t numElements;
-      uint16_t workgroupSize;
-   };
-
-   struct Future {
-      hsa_signal_t completionSignal;
-
-      Future() :
-            completionSignal({0}) {
-      }
+   typedef HsaAgent::KernelDescriptor KernelDescriptor;
 
-      Future(hsa_signal_t completionSignal) :
-            completionSignal(completionSignal) {
-      }
+   typedef HsaAgent::KernelLaunchParameters KernelLaunchParameters;
 
-      void wait() {
-         // Wait for the task to finish, which is the same as waiting for the value
-         // of the completion signal to become zero
-         while (hsa_signal_wait_acquire(completionSignal, HSA_SIGNAL_CONDITION_EQ,
-               0, UINT64_MAX,
-               HSA_WAIT_STATE_BLOCKED) != 0) {};
-         // Done! The kernel has completed. Time to cleanup resources and leave
-         HsaUtils::apiCall([&] {return hsa_signal_destroy(completionSignal);});
-      }
-   };
+   typedef HsaFuture Future;
 
-   /// C'tor, requires an initialized HSA runtime object.
+   /// The tasks a dispatch waits for (see dispatchAfter).
+   typedef std::vector<std::reference_wrapper<const Future>> Dependencies;
+
+   /// C'tor, requires an initialized HSA runtime object. Kernels are
+   /// dispatched to the kernel agent of the runtime (see HsaAqlAgent).
    explicit HsaContext(HsaRuntime &rt);
 
+   /// C'tor, dispatches kernels through the given agent (e.g., a HsaNativeAgent).
+   explicit HsaContext(HsaAgent &agent);
+
    /// D'tor
    ~HsaContext();
 
+   /// The context is cache-line aligned (its signal pool is, C++11 does not
+   /// support over-aligned new).
+   static void* operator new(const std::size_t size);
+
+   static void operator delete(void* ptr);
+
    ///
-   void addModule(const char *brigModulePtr); // TODO use uint8_t instead
+   void addModule(const char *brigModulePtr) { // TODO use uint8_t instead
+      agent.addModule(brigModulePtr);
+   }
+
+   /// Adds an embedded or a mapped module, which has been validated already.
+   void addModule(const HsaModuleSource& module) {
+      agent.addModule(module.getData());
+   }
 
-   void finalize();
+   /// Finalizes the modules that have been added since the previous
+   /// finalization. Modules can be added after a finalization; the kernels
+   /// of the previous ones remain valid.
+   void finalize() {
+      waitForFinalization();
+      agent.finalize();
+   }
+
+   /// Starts to finalize the added modules on a background thread, e.g., to
+   /// overlap the finalization with loading the data. Kernel lookups only
+   /// wait for the finalization if the kernel is not known yet.
+   void finalizeAsync();
+
+   /// Waits for the background finalization (if any) and rethrows its
+   /// exception.
+   void waitForFinalization();
+
+   /// Loads the finalized code object from the given cache, if possible, and
+   /// stores it there otherwise (see HsaCodeObjectCache). Must be set before
+   /// finalize(). The cache is not owned by the context.
+   void setCodeObjectCache(HsaCodeObjectCache* cache) {
+      agent.setCodeObjectCache(cache);
+   }
 
-   void createQueue();
+   /// Creates the queue of the agent with (at least) `queueSize` packets.
+   /// Dispatches wait while the queue is full (see setQueueFullPolicy) or
+   /// spill to another queue (see setSpillContext).
+   void createQueue(const uint32_t queueSize = HsaAgent::defaultQueueSize) {
+      agent.createQueue(queueSize);
+      maxGridSize = std::min(maxGridSize, agent.getMaxGridSize());
+   }
 
-   KernelDescriptor getKernelObject(const std::string &kernelSymbolName);
+   void setQueueFullPolicy(const HsaQueueFullPolicy policy) {
+      agent.setQueueFullPolicy(policy);
+   }
 
+   HsaAgent::QueueStats getQueueStats() const {
+      return agent.getQueueStats();
+   }
+
+   /// Single-packet dispatches (dispatch, dispatchAsync) that find the queue
+   /// full are enqueued to the spill context instead of waiting, e.g., to a
+   /// second queue of the same agent. The spill context must provide the same
+   /// kernels (which are looked up by symbol name). Spilled packets are not
+   /// ordered with respect to the packets of this queue, thus packets that
+   /// rely on the order (barriers, batches, chunks, spans) always wait. The
+   /// spill context is not owned; nullptr disables spilling.
+   void setSpillContext(HsaContext* spillContext);
+
+   /// The number of dispatches that have been spilled.
+   uint64_t getNumSpilledDispatches() const {
+      return numSpilledDispatches;
+   }
+
+   /// Creates the arena that holds the by-value arguments of the packets in
+   /// flight (see HsaConstant) with the given capacity. Otherwise, the first
+   /// dispatch with by-value arguments creates an arena of the default
+   /// capacity. Requires the queue; throws if the arena exists already.
+   void createConstantArena(const std::size_t capacity);
+
+   /// The arena of the by-value arguments (created on first use).
+   HsaConstantArena& getConstantArena() {
+      if (constantArena == nullptr) {
+         createConstantArena(HsaConstantArena::defaultCapacity);
+      }
+      return *constantArena;
+   }
+
+   /// Limits the grid size of a single packet (in addition to the limit of
+   /// the agent). Larger grids are split by dispatch and dispatchAsync.
+   void setMaxGridSize(const uint64_t maxGridSize) {
+      this->maxGridSize = std::min(maxGridSize, agent.getMaxGridSize());
+   }
+
+   uint64_t getMaxGridSize() const {
+      return maxGridSize;
+   }
+
+   /// Dispatches without a work-group size (i.e., zero) use the work-group
+   /// size the autotuner has determined for the kernel and the size class of
+   /// the grid (see tune). Kernels that have not been tuned use the work-group
+   /// size the occupancy model recommends. Dispatches never tune implicitly.
+   /// The autotuner is not owned by the context; nullptr disables the lookup.
+   void setAutotuner(HsaAutotuner* autotuner) {
+      this->autotuner = autotuner;
+      autotunerGeneration = autotuner != nullptr ? autotuner->getGeneration() : 0;
+      workgroupSizes.clear();
+   }
+
+   /// Tunes the work-group size of the kernel for the size class of the grid
+   /// (see HsaAutotuner::tune) and returns the fastest one. The kernel is run
+   /// with the given arguments once per candidate and repetition, thus they
+   /// should be scratch buffers if the kernel is not idempotent. A kernel that
+   /// has been tuned for the size class already is not run. Throws if the
+   /// context has no autotuner.
    template<typename ... Args>
-   inline void dispatch(const std::string &kernelSymbolName, const KernelLaunchParameters n, const Args &... args) {
+   uint16_t tune(const KernelDescriptor &kernel, const uint64_t numElements, const Args &... args) {
+      return tuneWithTrial(kernel, numElements, [&](const KernelLaunchParameters &candidate) {
+         dispatch<Args...>(kernel, candidate, args...);
+      });
+   }
+
+   template<typename ... Args>
+   uint16_t tune(const char *kernelSymbolName, const uint64_t numElements, const Args &... args) {
+      return tune<Args...>(getKernelObject(kernelSymbolName), numElements, args...);
+   }
+
+   template<typename ... Args>
+   uint16_t tune(const HsaKernel<Args...> &kernel, const uint64_t numElements,
+         const typename HsaKernel<Args...>::template Arg<Args>::type &... args) {
+      return tune<Args...>(kernel.getDescriptor(), numElements, args...);
+   }
+
+   /// Like tune, but each candidate is run by the given trial, which
+   /// dispatches the kernel with the given launch parameters and waits for it
+   /// (e.g., after resetting its output).
+   uint16_t tuneWithTrial(const KernelDescriptor &kernel, const uint64_t numElements,
+         const HsaAutotuner::Trial &trial);
+
+   /// The occupancy model of the agent. The agent properties are queried on
+   /// first use.
+   const HsaOccupancy& getOccupancy() {
+      if (occupancy == nullptr) {
+         occupancy.reset(new HsaOccupancy(agent.getProperties()));
+      }
+      return *occupancy;
+   }
+
+   /// Looks up a kernel in the symbol table of the agent (see finalize). If
+   /// the kernel is unknown, the modules that have not been finalized yet
+   /// are finalized first, i.e., kernels are finalized on first use.
+   KernelDescriptor getKernelObject(const char *kernelSymbolName) {
+      try {
+         return agent.getKernelObject(kernelSymbolName);
+      }
+      catch (const HsaException&) {
+         return getUnfinalizedKernelObject(kernelSymbolName);
+      }
+   }
+
+   KernelDescriptor getKernelObject(const std::string &kernelSymbolName) {
+      return getKernelObject(kernelSymbolName.c_str());
+   }
+
+   /// Looks up a kernel and binds it to the signature Args. Throws if the
+   /// argument segment of the kernel does not match the signature.
+   template<typename ... Args>
+   HsaKernel<Args...> getKernel(const std::string &kernelSymbolName) {
+      return HsaKernel<Args...>(getKernelObject(kernelSymbolName));
+   }
+
+   HsaAgent& getAgent() {
+      return agent;
+   }
+
+   /// The pool of the completion signals that are used by dispatchAsync.
+   HsaSignalPool& getSignalPool() {
+      return signalPool;
+   }
+
+   template<typename ... Args>
+   inline void dispatch(const char *kernelSymbolName, const KernelLaunchParameters n, const Args &... args) {
       const KernelDescriptor kernel = getKernelObject(kernelSymbolName);
       dispatch<Args...>(kernel, n, args...);
    }
 
+   template<typename ... Args>
+   inline void dispatch(const std::string &kernelSymbolName, const KernelLaunchParameters n, const Args &... args) {
+      dispatch<Args...>(kernelSymbolName.c_str(), n, args...);
+   }
+
    template<typename ... Args>
    inline void dispatch(const KernelDescriptor &kernel, const KernelLaunchParameters n, const Args &... args) {
       Future task = dispatchAsync<Args...>(kernel, n, args...);
       task.wait();
    }
 
+   template<typename ... Args>
+   inline void dispatch(const HsaKernel<Args...> &kernel, const KernelLaunchParameters n,
+         const typename HsaKernel<Args...>::template Arg<Args>::type &... args) {
+      dispatch<Args...>(kernel.getDescriptor(), n, args...);
+   }
+
+   template<typename ... Args>
+   inline Future dispatchAsync(const HsaKernel<Args...> &kernel, const KernelLaunchParameters n,
+         const typename HsaKernel<Args...>::template Arg<Args>::type &... args) {
+      return dispatchAsync<Args...>(kernel.getDescriptor(), n, args...);
+   }
+
+   /// Grids that exceed the maximum grid size of a packet are split into
+   /// several packets (chunks), which share the completion signal. Each chunk
+   /// is a multiple of the work-group size and gets its first global ID as
+   /// global offset, thus the kernel sees continuous global IDs. The doorbell
+   /// is rung for each chunk, so that a chunk runs while the next one is
+   /// enqueued. Note that get_global_size() returns the size of the chunk.
    template<typename ... Args>
    inline Future dispatchAsync(const KernelDescriptor &kernel, const KernelLaunchParameters n, const Args &... args) {
-      // Request and populate an AQL packet.
-      const uint64_t packetId = queueRequestPacketId();
-      hsa_kernel_dispatch_packet_t *packetPtr = queueGetKernelDispatchPacketPtr(packetId);
-      void *argPtr = getArgBufferPtr(packetId);
-
-      // Reserved fields, private and group memory, and completion signal are all set to 0.
-      // Note: The header (first 4 bytes) will be written atomically later on.
-      std::memset(((uint8_t *) packetPtr) + 4, 0, sizeof(hsa_kernel_dispatch_packet_t) - 4);
-      const uint32_t workgroupSize = n.workgroupSize == 0 ? 128 : n.workgroupSize;
-      packetPtr->workgroup_size_x = std::min(n.numElements, workgroupSize);
-      packetPtr->workgroup_size_y = 1;
-      packetPtr->workgroup_size_z = 1;
-      packetPtr->grid_size_x = n.numElements;
-      packetPtr->grid_size_y = 1;
-      packetPtr->grid_size_z = 1;
-
-      // Indicate which executable code to run. (= pointer to the finalized kernel)
-      packetPtr->kernel_object = kernel.kernelObject;
-      packetPtr->kernarg_address = argPtr;
-      packetPtr->private_segment_size = kernel.privateSegmentSize;
-      packetPtr->group_segment_size = kernel.groupSegmentSize;
+      if (n.workgroupSize == 0) {
+         const KernelLaunchParameters resolved = { n.numElements, getWorkgroupSize(kernel, n.numElements) };
+         return dispatchAsync<Args...>(kernel, resolved, args...);
+      }
+      if (n.numElements > maxGridSize) {
+         return dispatchChunked<Args...>(kernel, n, args...);
+      }
 
-      // Copy arguments.
-      //   Note: OpenCL kernels compiled with CLOC have 6 additional leading
-      //   parameters which can all be set to NULL.
-      constexpr size_t numLeadingParameters = 6;
-      void** writer = reinterpret_cast<void**>(argPtr);
-      for (size_t i = 0; i < numLeadingParameters; i++) {
-         //*writer = queue;
-         writer++;
+      // Request an AQL packet. If the queue is full, the dispatch either
+      // waits or spills.
+      uint64_t packetId;
+      if (spillContext == nullptr) {
+         packetId = agent.requestPacketId();
+      } else if (!agent.tryRequestPacketId(packetId)) {
+         numSpilledDispatches++;
+         return spillContext->dispatchAsync<Args...>(getSpillKernel(kernel), n, args...);
       }
-//      void **fooo = reinterpret_cast<void **>(argPtr);
-//      fooo[4] = queue;
-//      fooo[5] = packetPtr;
-      writeArgs(writer, args...);
+      return dispatchPacket<Args...>(packetId, kernel, n, args...);
+   }
 
-      // Create a signal with an initial value of one to monitor the task
-      // completion
-      HsaUtils::apiCall([&] {
-         return hsa_signal_create(1, 0, NULL, &packetPtr->completion_signal);
-      });
+   /// Dispatches the kernel once for each of the `count` argument tuples.
+   /// The packets are reserved with a single update of the write index and
+   /// the doorbell is rung once (per queue-sized chunk). The future completes
+   /// when all dispatches have completed.
+   template<typename ... Args>
+   inline Future dispatchSpan(const KernelDescriptor &kernel, const KernelLaunchParameters n,
+         const std::tuple<Args...> *args, const std::size_t count) {
+      static_assert(!HsaHasConstant<Args...>::value, "dispatchSpan does not support by-value arguments.");
+      static_assert(!HsaHasHostBuffer<Args...>::value, "dispatchSpan does not support host buffers.");
+      if (count == 0) return Future();
+      checkGridSize(n);
+      const KernelLaunchParameters launch = { n.numElements,
+            n.workgroupSize != 0 ? n.workgroupSize : getWorkgroupSize(kernel, n.numElements) };
+
+      // Pending batch packets have to be submitted first, otherwise the
+      // reservation might wait for them forever.
+      flushBatch();
+
+      // All dispatches share one completion signal.
+      const HsaSignalPool::Slot signalSlot = signalPool.acquire();
+      const hsa_signal_t completionSignal = signalPool.getSignal(signalSlot);
+      agent.storeSignal(completionSignal, count);
+
+      const std::size_t maxChunkSize = agent.getQueueSize();
+      for (std::size_t begin = 0; begin < count; begin += maxChunkSize) {
+         const uint32_t chunkSize = static_cast<uint32_t>(std::min(count - begin, maxChunkSize));
+         const uint64_t firstPacketId = agent.requestPacketIds(chunkSize);
+         // Publish the packets in order.
+         for (uint32_t i = 0; i < chunkSize; i++) {
+            void* argPtr = agent.getArgBufferPtr(firstPacketId + i, kernel);
+            writeGlobalOffset(argPtr, 0);
+            HsaKernelSignature<Args...>::writeTuple(argPtr, args[begin + i]);
+            agent.publishPacket(firstPacketId + i, kernel, launch, completionSignal);
+         }
+         agent.ringDoorbell(firstPacketId + chunkSize - 1);
+      }
+      return Future(&agent, &signalPool, signalSlot);
+   }
+
+   template<typename ... Args>
+   inline Future dispatchSpan(const HsaKernel<Args...> &kernel, const KernelLaunchParameters n,
+         const std::tuple<Args...> *args, const std::size_t count) {
+      return dispatchSpan<Args...>(kernel.getDescriptor(), n, args, count);
+   }
 
-      // Atomically set header and setup fields (as described in the specs)
-      __atomic_store_n(reinterpret_cast<uint32_t *>(packetPtr), dispatchPacketHeader, __ATOMIC_RELEASE);
+   /// Dispatches the kernel once all dependencies have completed. The
+   /// dependencies are resolved in the queue by barrier-AND packets (one per
+   /// HsaAgent::maxBarrierDependencies tasks) in front of the dispatch, thus
+   /// the agent starts the kernel without a host round trip. Subsequent
+   /// packets of the queue wait as well. The dependencies may stem from other
+   /// contexts, if their agents share the signal implementation.
+   ///
+   /// The completion signals of the dependencies are retained until the
+   /// kernel has completed, thus the dependencies can be waited for (and
+   /// destroyed) at any time. Dependencies that are no longer valid have
+   /// completed already.
+   template<typename ... Args>
+   inline Future dispatchAfter(const Dependencies &dependencies, const KernelDescriptor &kernel,
+         const KernelLaunchParameters n, const Args &... args) {
+      return dispatchAfter<Args...>(HsaBarrierType::And, dependencies, kernel, n, args...);
+   }
 
-      // Notify the runtime that a new packet is enqueued
-      hsa_signal_store_release(queue->doorbell_signal, packetId);
+   template<typename ... Args>
+   inline Future dispatchAfter(const Dependencies &dependencies, const HsaKernel<Args...> &kernel,
+         const KernelLaunchParameters n, const typename HsaKernel<Args...>::template Arg<Args>::type &... args) {
+      return dispatchAfter<Args...>(HsaBarrierType::And, dependencies, kernel.getDescriptor(), n, args...);
+   }
 
-      Future task{packetPtr->completion_signal};
-      return task;
+   /// Like dispatchAfter, but the kernel is started once any of the
+   /// dependencies has completed (a barrier-OR packet). At most
+   /// HsaAgent::maxBarrierDependencies dependencies.
+   template<typename ... Args>
+   inline Future dispatchAfterAny(const Dependencies &dependencies, const KernelDescriptor &kernel,
+         const KernelLaunchParameters n, const Args &... args) {
+      return dispatchAfter<Args...>(HsaBarrierType::Or, dependencies, kernel, n, args...);
+   }
+
+   template<typename ... Args>
+   inline Future dispatchAfterAny(const Dependencies &dependencies, const HsaKernel<Args...> &kernel,
+         const KernelLaunchParameters n, const typename HsaKernel<Args...>::template Arg<Args>::type &... args) {
+      return dispatchAfter<Args...>(HsaBarrierType::Or, dependencies, kernel.getDescriptor(), n, args...);
+   }
+
+   /// Enables doorbell coalescing for dispatchBatch: the doorbell is held
+   /// until `maxPackets` packets are pending or `maxDelay` has passed since the
+   /// first pending packet. The delay is only checked when the next packet is
+   /// enqueued; waitForBatchCompletion and flushBatch submit the pending
+   /// packets immediately. A `maxPackets` of one (the default) rings the
+   /// doorbell for every packet. Like the queue, the batch state is not
+   /// thread-safe.
+   void setBatchCoalescing(const uint32_t maxPackets,
+         const std::chrono::nanoseconds maxDelay = std::chrono::nanoseconds::max()) {
+      batchCoalescingMaxPackets = std::max(1u, maxPackets);
+      batchCoalescingMaxDelay = maxDelay;
    }
 
    template<typename ... Args>
@@ -140,129 +390,330 @@ public:
       // Enqueue AQL packet.
       const uint64_t packetId = enqueueForBatchProcessing<Args...>(kernelObject, n, args...);
 
-      // Notify the runtime that a new packet is enqueued.
-      ringDoorbell(packetId);
+      if (batchCoalescingMaxPackets == 1) {
+         // Notify the runtime that a new packet is enqueued.
+         ringDoorbell(packetId);
+         return;
+      }
+
+      const auto now = std::chrono::steady_clock::now();
+      if (numPendingBatchPackets == 0) {
+         firstPendingBatchPacketTime = now;
+      }
+      numPendingBatchPackets++;
+      lastPendingBatchPacketId = packetId;
+      // Pending packets must never fill the queue, as requestPacketId would
+      // wait for them forever.
+      if (numPendingBatchPackets >= std::min(batchCoalescingMaxPackets, agent.getQueueSize())
+            || now - firstPendingBatchPacketTime >= batchCoalescingMaxDelay) {
+         flushBatch();
+      }
+   }
+
+   /// Rings the doorbell for the pending batch packets (if any).
+   inline void flushBatch() {
+      if (numPendingBatchPackets == 0) return;
+      ringDoorbell(lastPendingBatchPacketId);
+      numPendingBatchPackets = 0;
    }
 
    template<typename ... Args>
    inline uint64_t enqueueForBatchProcessing(
          const KernelDescriptor& kernel, const KernelLaunchParameters n, const Args &... args) {
+      checkGridSize(n);
+      const KernelLaunchParameters launch = { n.numElements,
+            n.workgroupSize != 0 ? n.workgroupSize : getWorkgroupSize(kernel, n.numElements) };
 
-      // Request and populate an AQL packet.
-      const uint64_t packetId = queueRequestPacketId();
-      hsa_kernel_dispatch_packet_t *packetPtr = queueGetKernelDispatchPacketPtr(packetId);
-      void* argPtr = getArgBufferPtr(packetId);
-
-      // Reserved fields, private and group memory, and completion signal are all set to 0.
-      // Note: The header (first 4 bytes) will be written atomically later on.
-      std::memset(((uint8_t *) packetPtr) + 4, 0, sizeof(hsa_kernel_dispatch_packet_t) - 4);
-      const uint32_t workgroupSize = n.workgroupSize == 0 ? 128 : n.workgroupSize;
-      packetPtr->workgroup_size_x = std::min(n.numElements, workgroupSize);
-      packetPtr->workgroup_size_y = 1;
-      packetPtr->workgroup_size_z = 1;
-      packetPtr->grid_size_x = n.numElements;
-      packetPtr->grid_size_y = 1;
-      packetPtr->grid_size_z = 1;
-
-      // Indicate which executable code to run. (= pointer to the finalized kernel)
-      packetPtr->kernel_object = kernel.kernelObject;
-      packetPtr->private_segment_size = kernel.privateSegmentSize;
-      packetPtr->group_segment_size = kernel.groupSegmentSize;
+      // Request an AQL packet.
+      const uint64_t packetId = agent.requestPacketId();
 
-      // Use the batch completion signal. All packets that belong to a batch share the same signal.
-      packetPtr->completion_signal = batchCompletionSignal;
-
-      std::cout << "AQL written" << std::endl;
       // Copy arguments.
-      //   Note: OpenCL kernels compiled with CLOC have 6 additional leading
-      //   parameters which can all be set to NULL.
-      constexpr size_t numLeadingParameters = 6;
-      uintptr_t *writer = reinterpret_cast<uintptr_t *>(argPtr);
-      writeArgs(&writer[numLeadingParameters], args...);
-      std::cout << "Args written" << std::endl;
+      writeKernelArgs(agent.getArgBufferPtr(packetId, kernel), 0,
+            stageArg(packetId, { batchCompletionSignal, nullptr, 0 }, args)...);
 
       // Atomically increment the completion signal value
-      hsa_signal_add_relaxed(batchCompletionSignal, 1);
+      agent.addSignal(batchCompletionSignal, 1);
+
+      // Populate the packet and atomically set header and setup fields.
+      // Use the batch completion signal. All packets that belong to a batch share the same signal.
+      agent.publishPacket(packetId, kernel, launch, batchCompletionSignal);
 
-      // Atomically set header and setup fields (as described in the specs)
-      __atomic_store_n(
-            reinterpret_cast<uint32_t *>(packetPtr),
-            dispatchPacketHeader, __ATOMIC_RELEASE);
+      // The host buffers are released once the batch has completed.
+      if (!stagedBuffers.empty()) {
+         batchBuffers.insert(batchBuffers.end(), stagedBuffers.begin(), stagedBuffers.end());
+         stagedBuffers.clear();
+      }
 
       return packetId;
    }
 
    inline void ringDoorbell(const uint64_t packetId) {
       // Notify the runtime that a new packet is enqueued.
-      hsa_signal_store_release(queue->doorbell_signal, packetId);
+      agent.ringDoorbell(packetId);
    }
 
    inline void waitForBatchCompletion() {
-      while (hsa_signal_wait_acquire(batchCompletionSignal,
+      flushBatch();
+      while (agent.waitSignal(batchCompletionSignal,
             HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX,
             HSA_WAIT_STATE_BLOCKED) != 0) {
       };
+      releaseBatchBuffers();
    }
 
 protected:
-   void iterateKernelCodeSymbols(std::function<void(std::string&)> callback);
+   template<typename ... Args>
+   static void writeKernelArgs(void* argPtr, const uint64_t globalOffset, const Args &... args) {
+      // The argument offsets are compile-time constants (including the
+      // leading parameters of CLOC compiled kernels).
+      writeGlobalOffset(argPtr, globalOffset);
+      HsaKernelSignature<Args...>::write(argPtr, args...);
+   }
 
-   hsa_executable_symbol_t
-   getExecutableSymbol(const std::string &kernelSymbolName);
+   /// The first leading parameter (see HsaAgent::numLeadingParameters). It is
+   /// always written, as the argument buffer is reused by other dispatches.
+   static inline void writeGlobalOffset(void* argPtr, const uint64_t globalOffset) {
+      std::memcpy(argPtr, &globalOffset, sizeof(globalOffset));
+   }
 
-   inline uint64_t queueRequestPacketId() {
-      // Atomically request a new packet ID.
-      uint64_t packetId = hsa_queue_add_write_index_release(queue, 1);
-      // Wait until the queue is not full before writing the packet
-      while (packetId - hsa_queue_load_read_index_acquire(queue) >= queue->size);
-      return packetId;
+   /// Writes the staged arguments (see stageArg) to the argument buffer.
+   template<typename ... Args>
+   static void writeKernelArgTuple(void* argPtr, const uint64_t globalOffset, const std::tuple<Args...> &args) {
+      writeGlobalOffset(argPtr, globalOffset);
+      HsaKernelSignature<Args...>::writeTuple(argPtr, args);
+   }
+
+   /// The arguments as they are written to the argument buffer of the packet
+   /// (only by-value arguments and host buffers are replaced).
+   template<typename T>
+   inline const T& stageArg(const uint64_t /* packetId */, const HsaConstantArena::Completion& /* completion */,
+         const T& arg) {
+      return arg;
+   }
+
+   /// Copies a by-value argument into the constant arena. The copy belongs to
+   /// the packet and is reclaimed once the packet has completed. The chunks of
+   /// a dispatch share the copy.
+   template<typename T>
+   inline HsaConstant<T> stageArg(const uint64_t packetId, const HsaConstantArena::Completion& completion,
+         const HsaConstant<T>& arg) {
+      HsaConstantArena& arena = getConstantArena();
+      void* ptr = arena.tryAllocate(packetId, completion, sizeof(T));
+      if (ptr == nullptr) {
+         // The arena might be held by the pending batch packets.
+         flushBatch();
+         ptr = arena.allocate(packetId, completion, sizeof(T));
+      }
+      std::memcpy(ptr, arg.get(), sizeof(T));
+      return HsaConstant<T>(*reinterpret_cast<const T*>(ptr));
+   }
+
+   /// Registers a host buffer (see HsaRegistrationCache) and passes its
+   /// address. The buffer is released once the packet has completed (see
+   /// releaseOnCompletion).
+   template<typename T>
+   inline T* stageArg(const uint64_t /* packetId */, const HsaConstantArena::Completion& /* completion */,
+         const HsaHostBuffer<T>& arg) {
+      if (agent.requiresMemoryRegistration()) {
+         HsaRegistrationCache::getInstance().acquire(arg.get(), arg.getNumBytes());
+         stagedBuffers.emplace_back(arg.get(), arg.getNumBytes());
+      }
+      return arg.get();
    }
 
-   inline hsa_kernel_dispatch_packet_t*
-   queueGetKernelDispatchPacketPtr(const uint64_t packetId) {
-      const uint32_t queueMask = queue->size - 1;
-      hsa_kernel_dispatch_packet_t* packetPtr =
-            reinterpret_cast<hsa_kernel_dispatch_packet_t *>(queue->base_address) + (packetId & queueMask);
-      return packetPtr;
+   /// Hands the host buffers of the staged arguments over to the future of
+   /// their packet(s).
+   inline void releaseOnCompletion(Future &task) {
+      if (!stagedBuffers.empty()) {
+         task.releaseOnCompletion(std::move(stagedBuffers));
+      }
    }
 
-   void* getArgBufferPtr(const uint64_t packetId);
+   /// Releases the host buffers of the batch packets (once they have
+   /// completed).
+   void releaseBatchBuffers();
+
+   /// Writes the arguments to the reserved packet, publishes it and rings
+   /// the doorbell.
+   template<typename ... Args>
+   inline Future dispatchPacket(const uint64_t packetId, const KernelDescriptor &kernel,
+         const KernelLaunchParameters n, const Args &... args) {
+      // Take a signal with a value of one from the pool to monitor the task
+      // completion
+      const HsaSignalPool::Slot signalSlot = signalPool.acquire();
+      const hsa_signal_t completionSignal = signalPool.getSignal(signalSlot);
+
+      // Copy arguments.
+      writeKernelArgs(agent.getArgBufferPtr(packetId, kernel), 0,
+            stageArg(packetId, { completionSignal, &signalPool, signalSlot }, args)...);
+
+      // Populate the packet and atomically set header and setup fields
+      agent.publishPacket(packetId, kernel, n, completionSignal);
+
+      // Notify the runtime that a new packet is enqueued
+      agent.ringDoorbell(packetId);
 
-   static void writeArgs(void* /* writer */) {
+      Future task(&agent, &signalPool, signalSlot);
+      releaseOnCompletion(task);
+      return task;
    }
 
-   template<typename T, typename ... Ts>
-   static void writeArgs(void* writer, const T& arg, const Ts&... args) {
-      uintptr_t pointer = reinterpret_cast<uintptr_t>(writer);
-      uint8_t *writePosition = reinterpret_cast<uint8_t *>((pointer + alignof(T) - 1) & -alignof(T));
-      *reinterpret_cast<T *>(writePosition) = arg;
-      writeArgs(writePosition + sizeof(T), args...);
+   template<typename ... Args>
+   inline Future dispatchChunked(const KernelDescriptor &kernel, const KernelLaunchParameters n, const Args &... args) {
+      const uint64_t workgroupSize = n.workgroupSize == 0 ? HsaAgent::defaultWorkgroupSize : n.workgroupSize;
+      const uint64_t chunkSize = maxGridSize / workgroupSize * workgroupSize;
+      if (chunkSize == 0) {
+         throw HsaException("The work-group size exceeds the maximum grid size.");
+      }
+      const uint64_t numChunks = (n.numElements + chunkSize - 1) / chunkSize;
+
+      // All chunks share one completion signal.
+      const HsaSignalPool::Slot signalSlot = signalPool.acquire();
+      const hsa_signal_t completionSignal = signalPool.getSignal(signalSlot);
+      agent.storeSignal(completionSignal, numChunks);
+
+      // The arguments are staged once for all chunks.
+      uint64_t packetId = agent.requestPacketId();
+      const auto stagedArgs = std::make_tuple(stageArg(packetId, { completionSignal, &signalPool, signalSlot }, args)...);
+      for (uint64_t globalOffset = 0;;) {
+         writeKernelArgTuple(agent.getArgBufferPtr(packetId, kernel), globalOffset, stagedArgs);
+         const KernelLaunchParameters chunk = { std::min(chunkSize, n.numElements - globalOffset), n.workgroupSize };
+         agent.publishPacket(packetId, kernel, chunk, completionSignal);
+         agent.ringDoorbell(packetId);
+         globalOffset += chunkSize;
+         if (globalOffset >= n.numElements) break;
+         // Waits while the queue is full (see setQueueFullPolicy), i.e., until
+         // a previous chunk has been fetched.
+         packetId = agent.requestPacketId();
+      }
+      Future task(&agent, &signalPool, signalSlot);
+      releaseOnCompletion(task);
+      return task;
    }
 
-   // We support only 1-dimensional kernels.
-   static constexpr uint32_t numDimensions = 1;
-   static constexpr uint32_t dispatchPacketHeader =
-         0 | (HSA_PACKET_TYPE_KERNEL_DISPATCH << HSA_PACKET_HEADER_TYPE) |
-               (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_ACQUIRE_FENCE_SCOPE) |
-               (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_RELEASE_FENCE_SCOPE) |
-               ((numDimensions << HSA_KERNEL_DISPATCH_PACKET_SETUP_DIMENSIONS) << 16);
+   template<typename ... Args>
+   inline Future dispatchAfter(const HsaBarrierType type, const Dependencies &dependencies,
+         const KernelDescriptor &kernel, const KernelLaunchParameters n, const Args &... args) {
+      const KernelLaunchParameters launch = { n.numElements,
+            n.workgroupSize != 0 ? n.workgroupSize : getWorkgroupSize(kernel, n.numElements) };
+      const bool waits = enqueueBarrierPackets(type, dependencies);
+      // The dispatch must not spill, as it would bypass the barriers.
+      Future task = launch.numElements > maxGridSize
+            ? dispatchChunked<Args...>(kernel, launch, args...)
+            : dispatchPacket<Args...>(agent.requestPacketId(), kernel, launch, args...);
+      if (waits) {
+         for (const Future &dependency : dependencies) {
+            if (dependency.valid()) task.retainUntilCompletion(dependency);
+         }
+      }
+      return task;
+   }
+
+   /// Enqueues the barrier packets of dispatchAfter (after the pending batch
+   /// packets). Returns false if there is nothing to wait for.
+   bool enqueueBarrierPackets(const HsaBarrierType type, const Dependencies &dependencies);
+
+   /// The work-group size of a dispatch that does not specify one: the tuned
+   /// one (if the autotuner has tuned the kernel for the size class of the
+   /// grid), otherwise the one the occupancy model recommends. The result is
+   /// cached per kernel object and size class. The cache is dropped once the
+   /// autotuner has stored new parameters (by any context), as a kernel
+   /// might have been tuned meanwhile.
+   uint16_t getWorkgroupSize(const KernelDescriptor &kernel, const uint64_t numElements) {
+      if (autotuner != nullptr) {
+         const uint64_t generation = autotuner->getGeneration();
+         if (generation != autotunerGeneration) {
+            workgroupSizes.clear();
+            autotunerGeneration = generation;
+         }
+      }
+      const uint32_t sizeClass = HsaAutotuner::getSizeClass(numElements);
+      const std::pair<uint64_t, uint32_t> key(kernel.kernelObject, sizeClass);
+      const auto cached = workgroupSizes.find(key);
+      if (cached != workgroupSizes.end()) return cached->second;
+      uint16_t workgroupSize = 0;
+      if (autotuner != nullptr) {
+         const char* kernelSymbolName = agent.getKernelSymbolName(kernel.kernelObject);
+         KernelLaunchParameters tuned;
+         if (kernelSymbolName != nullptr && autotuner->find(agent.getIsaName(), kernelSymbolName, sizeClass, tuned)) {
+            workgroupSize = tuned.workgroupSize;
+         }
+      }
+      if (workgroupSize == 0) {
+         workgroupSize = getOccupancy().recommendWorkgroupSize(kernel, numElements);
+      }
+      workgroupSizes[key] = workgroupSize;
+      return workgroupSize;
+   }
+
+   /// The descriptor of the kernel in the spill context.
+   KernelDescriptor getSpillKernel(const KernelDescriptor &kernel);
+
+   inline void checkGridSize(const KernelLaunchParameters n) const {
+      if (n.numElements > maxGridSize) {
+         throw HsaException("The grid size exceeds the maximum grid size of a packet. "
+               "Only dispatch and dispatchAsync split large grids.");
+      }
+   }
 
 private:
-   HsaRuntime &rt;
-   hsa_ext_program_t program;
-   hsa_code_object_t codeObject;
-   hsa_executable_t executable;
-   hsa_queue_t *queue;
+   /// Only set if the context created the agent.
+   std::unique_ptr<HsaAgent> ownedAgent;
 
-   /// Points to the pre-allocated kernel argument memory-segment. It contains
-   /// ``queueSize'' entries, each of size ``argumentSize''.
-   void *argumentMemoryPtr;
+   HsaAgent &agent;
 
-   /// The the number of bytes required for kernel argument passing (including padding).
-   uint32_t argumentSize;
+   /// Completion signals for asynchronous dispatches.
+   HsaSignalPool signalPool;
 
    /// Completion signal for batch-dispatching.
    hsa_signal_t batchCompletionSignal;
+
+   /// Doorbell coalescing of dispatchBatch (see setBatchCoalescing).
+   uint32_t batchCoalescingMaxPackets;
+   std::chrono::nanoseconds batchCoalescingMaxDelay;
+   uint32_t numPendingBatchPackets;
+   uint64_t lastPendingBatchPacketId;
+   std::chrono::steady_clock::time_point firstPendingBatchPacketTime;
+
+   /// The largest grid of a single packet (see setMaxGridSize).
+   uint64_t maxGridSize;
+
+   /// Not owned, may be null (see setAutotuner).
+   HsaAutotuner* autotuner;
+   /// The generation of the autotuner the cached work-group sizes stem from.
+   uint64_t autotunerGeneration;
+
+   /// Not owned, may be null (see setSpillContext).
+   HsaContext* spillContext;
+   uint64_t numSpilledDispatches;
+   /// The descriptors of the kernels in the spill context, by kernel object.
+   std::map<uint64_t, KernelDescriptor> spillKernels;
+
+   /// Created on first use (see getConstantArena). Destroyed before the
+   /// agent.
+   std::unique_ptr<HsaConstantArena> constantArena;
+
+   /// The host buffers of the arguments that have been staged for the
+   /// current dispatch (see stageArg).
+   std::vector<Future::Registration> stagedBuffers;
+
+   /// The host buffers of the pending batch packets (see
+   /// waitForBatchCompletion).
+   std::vector<Future::Registration> batchBuffers;
+
+   /// Created on first use (see getOccupancy).
+   std::unique_ptr<HsaOccupancy> occupancy;
+
+   /// The work-group sizes of dispatches without one, by kernel object and
+   /// size class (see getWorkgroupSize).
+   std::map<std::pair<uint64_t, uint32_t>, uint16_t> workgroupSizes;
+
+   /// The background finalization (see finalizeAsync).
+   std::future<void> finalization;
+
+   /// The slow path of getKernelObject: waits for the background
+   /// finalization or finalizes the remaining modules.
+   KernelDescriptor getUnfinalizedKernelObject(const char *kernelSymbolName);
 };
 }
 }
@@ -0,0 +1,112 @@
+#include <rts/hsa/HsaExecutableRegistry.hpp>
+#include <rts/hsa/HsaCodeObjectCache.hpp>
+#include <rts/hsa/HsaUtils.hpp>
+#include <hsa.h>
+#include <sstream>
+
+namespace rts {
+namespace hsa {
+
+using namespace std;
+
+HsaExecutableRegistry::Executable::Executable() :
+      codeObject({0}), executable({0}) {
+}
+
+HsaExecutableRegistry::Executable::~Executable() {
+   if ((executable.handle == 0 && codeObject.handle == 0) || HsaUtils::isInitialized() == false) return;
+   // The lifetime of the code object must exceed that of the executable.
+   if (executable.handle != 0) {
+      HsaUtils::apiCall([&] {
+         return hsa_executable_destroy(executable);
+      });
+   }
+   if (codeObject.handle != 0) {
+      HsaUtils::apiCall([&] {
+         return hsa_code_object_destroy(codeObject);
+      });
+   }
+}
+
+HsaExecutableRegistry::HsaExecutableRegistry() :
+      numHits(0), numMisses(0) {
+}
+
+HsaExecutableRegistry& HsaExecutableRegistry::getInstance() {
+   static HsaExecutableRegistry registry;
+   return registry;
+}
+
+std::string HsaExecutableRegistry::getKey(const std::vector<const char*>& brigModules, const std::string& isaName,
+      const hsa_agent_t agent) {
+   // The code object only depends on the modules and the ISA, the executable
+   // is loaded onto a particular agent.
+   ostringstream key;
+   key << HsaCodeObjectCache::getKey(brigModules, isaName, "") << '@' << hex << agent.handle;
+   return key.str();
+}
+
+std::shared_ptr<const HsaExecutableRegistry::Executable> HsaExecutableRegistry::acquire(const std::string& key,
+      const Loader& loader) {
+   shared_ptr<Entry> entry;
+   {
+      lock_guard<std::mutex> lock(mutex);
+      prune();
+      shared_ptr<Entry>& e = entries[key];
+      if (!e) {
+         e = make_shared<Entry>();
+      }
+      entry = e;
+      if (shared_ptr<const Executable> executable = entry->executable.lock()) {
+         numHits++;
+         return executable;
+      }
+   }
+
+   // Load the executable outside of the registry lock, thus agents that
+   // acquire other executables do not wait.
+   lock_guard<std::mutex> loadLock(entry->loadMutex);
+   {
+      // Loaded by a concurrent acquisition meanwhile?
+      lock_guard<std::mutex> lock(mutex);
+      if (shared_ptr<const Executable> executable = entry->executable.lock()) {
+         numHits++;
+         return executable;
+      }
+   }
+   numMisses++;
+   shared_ptr<Executable> executable = make_shared<Executable>();
+   loader(*executable);
+   lock_guard<std::mutex> lock(mutex);
+   entry->executable = executable;
+   return executable;
+}
+
+std::size_t HsaExecutableRegistry::getNumEntries() {
+   lock_guard<std::mutex> lock(mutex);
+   return entries.size();
+}
+
+void HsaExecutableRegistry::prune() {
+   // The entries are only referenced under the mutex, thus an entry that is
+   // referenced by the map alone cannot be picked up concurrently.
+   for (auto entry = entries.begin(); entry != entries.end();) {
+      if (entry->second.use_count() == 1 && entry->second->executable.expired()) {
+         entry = entries.erase(entry);
+      } else {
+         entry++;
+      }
+   }
+}
+
+std::size_t HsaExecutableRegistry::size() {
+   lock_guard<std::mutex> lock(mutex);
+   size_t numExecutables = 0;
+   for (const auto& entry : entries) {
+      numExecutables += entry.second->executable.expired() ? 0 : 1;
+   }
+   return numExecutables;
+}
+
+}
+}
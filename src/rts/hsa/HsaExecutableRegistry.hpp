@@ -0,0 +1,114 @@
+#pragma once
+
+#include <rts/hsa/HsaAgent.hpp>
+#include <hsa.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+/// A process-wide registry of the executables that have been finalized from
+/// BRIG modules (see HsaAqlAgent::finalize). Contexts that add the same
+/// modules, e.g., one context per worker thread, share a single finalization
+/// and a single copy of the code object, thus each further context only
+/// costs its queue and its kernel argument memory.
+///
+/// An executable is keyed by the contents of its modules and the kernel agent
+/// it is loaded onto (see getKey). The executables are reference counted: an
+/// executable is destroyed along with the last agent that uses it, the
+/// registry does not keep it alive. The registry is thread-safe; if several
+/// agents acquire the same executable concurrently, one of them loads it
+/// while the others wait.
+class HsaExecutableRegistry {
+public:
+   typedef HsaAgent::KernelDescriptor KernelDescriptor;
+
+   /// A code object, loaded into a (frozen) executable, and its kernels.
+   struct Executable {
+      hsa_code_object_t codeObject;
+      hsa_executable_t executable;
+
+      /// The cached code object (see HsaCodeObjectCache), which must outlive
+      /// the deserialized code object.
+      std::string serializedCodeObject;
+
+      std::vector<std::pair<std::string, KernelDescriptor>> kernels;
+
+      Executable();
+
+      /// D'tor, destroys the executable and the code object.
+      ~Executable();
+
+      Executable(const Executable&) = delete;
+      Executable& operator=(const Executable&) = delete;
+   };
+
+   /// Loads an executable (e.g., finalizes the modules). A loader that throws
+   /// leaves the executable unregistered, the handles that it has set are
+   /// released.
+   typedef std::function<void(Executable&)> Loader;
+
+   struct Stats {
+      uint64_t numHits;
+      uint64_t numMisses;
+   };
+
+   /// The registry of the process.
+   static HsaExecutableRegistry& getInstance();
+
+   /// The key of the executable that is finalized from the given BRIG modules
+   /// for the given agent.
+   static std::string getKey(const std::vector<const char*>& brigModules, const std::string& isaName,
+         const hsa_agent_t agent);
+
+   /// Returns the registered executable or loads (and registers) it. Throws
+   /// whatever the loader throws; the next acquisition loads it again.
+   std::shared_ptr<const Executable> acquire(const std::string& key, const Loader& loader);
+
+   /// The number of executables that are in use.
+   std::size_t size();
+
+   /// The number of registered keys (of executables that are in use or being
+   /// loaded, plus the destroyed ones that have not been pruned yet).
+   std::size_t getNumEntries();
+
+   Stats getStats() const {
+      return Stats { numHits.load(), numMisses.load() };
+   }
+
+private:
+   struct Entry {
+      /// Held while the executable is loaded.
+      std::mutex loadMutex;
+
+      std::weak_ptr<const Executable> executable;
+   };
+
+   /// Guards the entries and their executables.
+   std::mutex mutex;
+
+   /// The entries of destroyed executables are pruned by the next
+   /// acquisition (see prune).
+   std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+
+   std::atomic<uint64_t> numHits;
+   std::atomic<uint64_t> numMisses;
+
+   HsaExecutableRegistry();
+
+   /// Erases the entries whose executable has been destroyed (or failed to
+   /// load) and that no acquisition refers to. Requires the mutex.
+   void prune();
+};
+
+}
+}
@@ -0,0 +1,132 @@
+#include <rts/hsa/HsaFuture.hpp>
+#include <utils/Utils.hpp>
+#include <algorithm>
+
+namespace rts {
+namespace hsa {
+
+constexpr uint32_t HsaFuture::numSpins;
+
+/// Timeout hints are given in units of the HSA system timestamp. Blocked waits
+/// with a deadline are split into short waits, so that the deadline is not
+/// exceeded by much if the timestamp frequency is not 1 GHz.
+static constexpr uint64_t maxBlockNanos = 1000 * 1000;
+
+/// A blocked waitAny can only block on one of the signals at a time.
+static constexpr uint64_t waitAnyBlockNanos = 100 * 1000;
+
+HsaFuture& HsaFuture::operator=(HsaFuture&& other) {
+   if (this != &other) {
+      if (valid()) wait();
+      agent = other.agent;
+      signalPool = other.signalPool;
+      signalSlot = other.signalSlot;
+      completionSignal = other.completionSignal;
+      dependencies = std::move(other.dependencies);
+      registrations = std::move(other.registrations);
+      other.agent = nullptr;
+   }
+   return *this;
+}
+
+void HsaFuture::wait(const HsaWaitStrategy strategy) {
+   if (!valid()) return;
+   if (strategy != HsaWaitStrategy::Blocked) {
+      for (uint32_t i = 0; strategy == HsaWaitStrategy::Spin || i < numSpins; i++) {
+         if (agent->loadSignal(completionSignal) == 0) {
+            release();
+            return;
+         }
+         Utils::pause();
+      }
+   }
+   // Wait for the task to finish, which is the same as waiting for the value
+   // of the completion signal to become zero
+   while (agent->waitSignal(completionSignal, HSA_SIGNAL_CONDITION_EQ,
+         0, UINT64_MAX,
+         HSA_WAIT_STATE_BLOCKED) != 0) {};
+   release();
+}
+
+bool HsaFuture::waitFor(const std::chrono::nanoseconds timeout, const HsaWaitStrategy strategy) {
+   if (!valid()) return true;
+   const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+   if (strategy != HsaWaitStrategy::Blocked) {
+      for (uint32_t i = 0; strategy == HsaWaitStrategy::Spin || i < numSpins; i++) {
+         if (agent->loadSignal(completionSignal) == 0) {
+            release();
+            return true;
+         }
+         // Reading the clock is more expensive than polling the signal.
+         if ((i & 63) == 63 && std::chrono::steady_clock::now() >= deadline) return false;
+         Utils::pause();
+      }
+   }
+
+   while (agent->loadSignal(completionSignal) != 0) {
+      const auto now = std::chrono::steady_clock::now();
+      if (now >= deadline) return false;
+      const uint64_t remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+      block(std::min(remaining, maxBlockNanos));
+   }
+   release();
+   return true;
+}
+
+void HsaFuture::waitAll(HsaFuture* futures, const std::size_t numFutures, const HsaWaitStrategy strategy) {
+   if (strategy != HsaWaitStrategy::Blocked) {
+      // Poll all signals in one loop, until all tasks have completed or the
+      // spin budget is exhausted.
+      for (uint32_t i = 0; strategy == HsaWaitStrategy::Spin || i < numSpins; i++) {
+         bool done = true;
+         for (std::size_t f = 0; f < numFutures; f++) {
+            HsaFuture& future = futures[f];
+            if (!future.valid()) continue;
+            if (future.agent->loadSignal(future.completionSignal) == 0) {
+               future.release();
+            }
+            else {
+               done = false;
+            }
+         }
+         if (done) return;
+         Utils::pause();
+      }
+   }
+   // We have to wait for all tasks anyway, so it does not matter on which
+   // signal we block first.
+   for (std::size_t f = 0; f < numFutures; f++) {
+      futures[f].wait(HsaWaitStrategy::Blocked);
+   }
+}
+
+std::size_t HsaFuture::waitAny(HsaFuture* futures, const std::size_t numFutures, const HsaWaitStrategy strategy) {
+   for (uint32_t i = 0; ; i++) {
+      std::size_t firstValid = numFutures;
+      for (std::size_t f = 0; f < numFutures; f++) {
+         HsaFuture& future = futures[f];
+         if (!future.valid()) continue;
+         if (future.agent->loadSignal(future.completionSignal) == 0) {
+            future.release();
+            return f;
+         }
+         if (firstValid == numFutures) firstValid = f;
+      }
+      if (firstValid == numFutures) return numFutures;
+
+      const bool spin = strategy == HsaWaitStrategy::Spin
+            || (strategy == HsaWaitStrategy::SpinThenBlock && i < numSpins);
+      if (spin) {
+         Utils::pause();
+      }
+      else {
+         // The HSA API cannot block on multiple signals. Block on one of
+         // them for a short while and poll the others afterwards.
+         futures[firstValid].block(waitAnyBlockNanos);
+      }
+   }
+}
+
+}
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <rts/hsa/HsaAgent.hpp>
+#include <rts/hsa/HsaRegistrationCache.hpp>
+#include <rts/hsa/HsaSignalPool.hpp>
+#include <chrono>
+#include <cstddef>
+#include <hsa.h>
+#include <utility>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+/// How a thread waits for the completion of a dispatch.
+enum class HsaWaitStrategy {
+   /// Polls the completion signal (lowest latency, occupies the CPU).
+   Spin,
+   /// Polls for a short while, then blocks. Short kernels do not pay the
+   /// wake-up latency of a blocked wait.
+   SpinThenBlock,
+   /// Blocks immediately.
+   Blocked
+};
+
+/// The result of an asynchronous dispatch (see HsaContext::dispatchAsync).
+/// The future owns the completion signal, which it returns to the signal pool
+/// once the kernel has completed. Thus, a future is move-only and its
+/// d'tor waits for the completion of the kernel (if nobody did before).
+class HsaFuture {
+public:
+   /// A host buffer that is acquired from the HsaRegistrationCache.
+   typedef std::pair<const void*, std::size_t> Registration;
+
+   /// The number of polls before a SpinThenBlock wait blocks.
+   static constexpr uint32_t numSpins = 4096;
+
+   /// C'tor, an invalid future.
+   HsaFuture() :
+         agent(nullptr), signalPool(nullptr), signalSlot(0), completionSignal({0}) {
+   }
+
+   HsaFuture(HsaAgent* agent, HsaSignalPool* signalPool, HsaSignalPool::Slot signalSlot) :
+         agent(agent), signalPool(signalPool), signalSlot(signalSlot),
+               completionSignal(signalPool->getSignal(signalSlot)) {
+   }
+
+   HsaFuture(HsaFuture&& other) :
+         agent(other.agent), signalPool(other.signalPool), signalSlot(other.signalSlot),
+               completionSignal(other.completionSignal), dependencies(std::move(other.dependencies)),
+               registrations(std::move(other.registrations)) {
+      other.agent = nullptr;
+   }
+
+   /// Waits for the current task (if any) before the other one is taken over.
+   HsaFuture& operator=(HsaFuture&& other);
+
+   HsaFuture(const HsaFuture&) = delete;
+   HsaFuture& operator=(const HsaFuture&) = delete;
+
+   /// D'tor, waits for the task to complete.
+   ~HsaFuture() {
+      if (valid()) wait();
+   }
+
+   /// False for default constructed futures and after the task has been
+   /// waited for.
+   bool valid() const {
+      return agent != nullptr;
+   }
+
+   /// Returns whether the task has completed (does not block). Invalid futures
+   /// are ready.
+   bool isReady() const {
+      return !valid() || agent->loadSignal(completionSignal) == 0;
+   }
+
+   /// The completion signal of the task (only meaningful while the future
+   /// is valid).
+   hsa_signal_t getCompletionSignal() const {
+      return completionSignal;
+   }
+
+   /// Keeps the completion signal of another (valid) task out of the pool
+   /// until this task has completed, even if the other future is waited for
+   /// before. Used for tasks that wait on the other one in the queue (see
+   /// HsaContext::dispatchAfter).
+   void retainUntilCompletion(const HsaFuture& dependency) {
+      dependency.signalPool->retain(dependency.signalSlot);
+      dependencies.emplace_back(dependency.signalPool, dependency.signalSlot);
+   }
+
+   /// Releases the given host buffers once this task has completed (see
+   /// HsaContext::stageArg). Must only be called for valid futures.
+   void releaseOnCompletion(std::vector<Registration>&& buffers) {
+      if (registrations.empty()) {
+         registrations = std::move(buffers);
+      } else {
+         registrations.insert(registrations.end(), buffers.begin(), buffers.end());
+      }
+      buffers.clear();
+   }
+
+   /// Waits for the task to complete. Afterwards, the future is invalid.
+   void wait(const HsaWaitStrategy strategy = HsaWaitStrategy::SpinThenBlock);
+
+   /// Waits for at most the given time. Returns true (and invalidates the
+   /// future) if the task has completed.
+   bool waitFor(const std::chrono::nanoseconds timeout,
+         const HsaWaitStrategy strategy = HsaWaitStrategy::SpinThenBlock);
+
+   /// Waits for all tasks. The signals are polled in a single loop.
+   static void waitAll(HsaFuture* futures, const std::size_t numFutures,
+         const HsaWaitStrategy strategy = HsaWaitStrategy::SpinThenBlock);
+
+   static void waitAll(std::vector<HsaFuture>& futures,
+         const HsaWaitStrategy strategy = HsaWaitStrategy::SpinThenBlock) {
+      waitAll(futures.data(), futures.size(), strategy);
+   }
+
+   /// Waits until one of the tasks has completed and returns its index (the
+   /// future is invalidated). Returns `numFutures` if no future is valid.
+   static std::size_t waitAny(HsaFuture* futures, const std::size_t numFutures,
+         const HsaWaitStrategy strategy = HsaWaitStrategy::SpinThenBlock);
+
+   static std::size_t waitAny(std::vector<HsaFuture>& futures,
+         const HsaWaitStrategy strategy = HsaWaitStrategy::SpinThenBlock) {
+      return waitAny(futures.data(), futures.size(), strategy);
+   }
+
+private:
+   HsaAgent* agent;
+   HsaSignalPool* signalPool;
+   HsaSignalPool::Slot signalSlot;
+   hsa_signal_t completionSignal;
+   /// The retained completion signals of other tasks.
+   std::vector<std::pair<HsaSignalPool*, HsaSignalPool::Slot>> dependencies;
+   /// The host buffers that are registered until the task has completed.
+   std::vector<Registration> registrations;
+
+   /// Returns the signal(s) to the pool, releases the host buffers and
+   /// invalidates the future.
+   void release() {
+      signalPool->release(signalSlot);
+      for (const auto& dependency : dependencies) {
+         dependency.first->release(dependency.second);
+      }
+      dependencies.clear();
+      for (const Registration& registration : registrations) {
+         HsaRegistrationCache::getInstance().release(registration.first, registration.second);
+      }
+      registrations.clear();
+      agent = nullptr;
+   }
+
+   /// Blocks until the signal is zero or the timeout hint has expired.
+   void block(const uint64_t timeoutHint) const {
+      agent->waitSignal(completionSignal, HSA_SIGNAL_CONDITION_EQ, 0, timeoutHint, HSA_WAIT_STATE_BLOCKED);
+   }
+};
+
+}
+}
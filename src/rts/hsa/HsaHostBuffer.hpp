@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+namespace rts {
+namespace hsa {
+
+/// A kernel argument that points to host memory, e.g., a column that is
+/// scanned by the kernel. In the argument segment it occupies a pointer, the
+/// kernel declares the parameter as a pointer to T.
+///
+/// The dispatch registers the buffer with the runtime (if the agent requires
+/// it) and keeps it registered until the kernel has completed. The
+/// registrations are cached, thus a buffer that is passed over and over again
+/// is registered only once (see HsaRegistrationCache). The buffer is passed to
+/// the untyped dispatches (by kernel descriptor or symbol name), the
+/// signature of a HsaKernel declares the pointer.
+template<typename T>
+class HsaHostBuffer {
+public:
+   /// C'tor, the buffer of `count` elements at ptr.
+   HsaHostBuffer(T* ptr, const std::size_t count) :
+         ptr(ptr), count(count) {
+   }
+
+   T* get() const {
+      return ptr;
+   }
+
+   std::size_t size() const {
+      return count;
+   }
+
+   /// The size of the buffer in bytes.
+   std::size_t getNumBytes() const {
+      return count * sizeof(T);
+   }
+
+private:
+   T* ptr;
+   std::size_t count;
+};
+
+/// Whether any of the types Ts is a HsaHostBuffer.
+template<typename ... Ts>
+struct HsaHasHostBuffer : std::false_type {
+};
+
+template<typename T, typename ... Ts>
+struct HsaHasHostBuffer<T, Ts...> : HsaHasHostBuffer<Ts...> {
+};
+
+template<typename T, typename ... Ts>
+struct HsaHasHostBuffer<HsaHostBuffer<T>, Ts...> : std::true_type {
+};
+
+}
+}
@@ -0,0 +1,31 @@
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaException.hpp>
+
+namespace rts {
+namespace hsa {
+
+HsaAgent::KernelDescriptor HsaHostKernelRegistry::registerKernel(const HsaHostKernel& kernel) {
+   if (table.find(kernel.symbolName) != nullptr) {
+      throw HsaException("Kernel already registered: " + kernel.symbolName);
+   }
+   kernels.push_back(kernel);
+   HsaAgent::KernelDescriptor descriptor;
+   descriptor.kernelObject = reinterpret_cast<uint64_t>(&kernels.back());
+   descriptor.argumentSegmentSize = kernel.argumentSegmentSize;
+   descriptor.groupSegmentSize = kernel.groupSegmentSize;
+   descriptor.privateSegmentSize = 0;
+   descriptors.emplace_back(kernel.symbolName, descriptor);
+   table = HsaKernelTable(descriptors);
+   return descriptor;
+}
+
+uint32_t HsaHostKernelRegistry::getMaxArgumentSegmentSize() const {
+   return table.getMaxArgumentSegmentSize();
+}
+
+std::vector<uint32_t> HsaHostKernelRegistry::getArgumentSegmentSizes() const {
+   return table.getArgumentSegmentSizes();
+}
+
+}
+}
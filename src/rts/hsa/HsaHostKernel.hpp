@@ -0,0 +1,168 @@
+#pragma once
+
+#include <rts/hsa/HsaAgent.hpp>
+#include <rts/hsa/HsaKernelSignature.hpp>
+#include <rts/hsa/HsaKernelTable.hpp>
+#include <cstdint>
+#include <cstring> // memcpy
+#include <deque>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+/// The part of the grid that is processed by a single host kernel invocation.
+struct HsaWorkGroup {
+   /// The work-group ID.
+   uint64_t groupId;
+   /// The work-group size (as specified in the dispatch packet).
+   uint32_t workgroupSize;
+   /// The total number of work-items (of the packet).
+   uint64_t gridSize;
+   /// The global IDs of the work-items in this group: [begin, end), including
+   /// the global offset of the packet (see HsaContext::dispatchAsync). Note
+   /// that the last work-group of a grid can be partial.
+   uint64_t begin;
+   uint64_t end;
+};
+
+/// A kernel that is implemented in C++ and executed by host threads. The
+/// function is invoked once per work-group and receives a pointer to the
+/// kernel argument segment, which has the same layout as the one of a CLOC
+/// compiled OpenCL kernel (including the leading parameters).
+struct HsaHostKernel {
+private:
+   /// Prevents template argument deduction.
+   template<typename T>
+   struct Identity {
+      typedef T type;
+   };
+
+   template<typename T>
+   static constexpr uintptr_t align(const uintptr_t offset) {
+      return (offset + alignof(T) - 1) & -alignof(T);
+   }
+
+   template<typename ... Ts>
+   struct ArgReader;
+
+   template<typename ... Args>
+   struct WorkItemLoop {
+      std::function<void(uint64_t, Args...)> fn;
+
+      void operator()(const HsaWorkGroup& group, Args... args) const {
+         for (uint64_t gid = group.begin; gid < group.end; gid++) {
+            fn(gid, args...);
+         }
+      }
+   };
+
+public:
+   typedef std::function<void(const HsaWorkGroup&, const void*)> Function;
+
+   std::string symbolName;
+   Function function;
+   /// The size of the kernel argument segment.
+   uint32_t argumentSegmentSize;
+   /// The amount of group memory the kernel allocates (informational only).
+   uint32_t groupSegmentSize;
+
+   /// Creates a host kernel from a function which is called once per
+   /// work-item, e.g.,
+   ///   HsaHostKernel::forEachWorkItem<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel",
+   ///      [](uint64_t gid, size_t* output, size_t n) { if (gid < n) output[gid] = gid; });
+   template<typename ... Args>
+   static HsaHostKernel forEachWorkItem(const std::string& symbolName,
+         const typename Identity<std::function<void(uint64_t, Args...)>>::type& fn) {
+      return forEachWorkGroup<Args...>(symbolName, WorkItemLoop<Args...>{fn});
+   }
+
+   /// Creates a host kernel from a function which is called once per
+   /// work-group with the unpacked kernel arguments.
+   template<typename ... Args>
+   static HsaHostKernel forEachWorkGroup(const std::string& symbolName,
+         const typename Identity<std::function<void(const HsaWorkGroup&, Args...)>>::type& fn) {
+      HsaHostKernel kernel;
+      kernel.symbolName = symbolName;
+      kernel.function = [fn](const HsaWorkGroup& group, const void* kernargs) {
+         // The first leading parameter is the global offset.
+         uint64_t globalOffset;
+         std::memcpy(&globalOffset, kernargs, sizeof(globalOffset));
+         const uint8_t* reader = reinterpret_cast<const uint8_t*>(kernargs)
+               + HsaAgent::numLeadingParameters * sizeof(uintptr_t);
+         if (globalOffset == 0) {
+            ArgReader<Args...>::apply(fn, reader, group);
+         }
+         else {
+            HsaWorkGroup shifted = group;
+            shifted.begin += globalOffset;
+            shifted.end += globalOffset;
+            ArgReader<Args...>::apply(fn, reader, shifted);
+         }
+      };
+      kernel.argumentSegmentSize = HsaKernelSignature<Args...>::argumentSegmentSize;
+      kernel.groupSegmentSize = 0;
+      return kernel;
+   }
+};
+
+/// Reads the arguments in the same way HsaKernelSignature::write has written them
+/// and finally invokes the kernel function.
+template<>
+struct HsaHostKernel::ArgReader<> {
+   template<typename Fn, typename ... Done>
+   static void apply(const Fn& fn, const uint8_t* /* reader */, const HsaWorkGroup& group, const Done&... done) {
+      fn(group, done...);
+   }
+};
+
+template<typename T, typename ... Ts>
+struct HsaHostKernel::ArgReader<T, Ts...> {
+   template<typename Fn, typename ... Done>
+   static void apply(const Fn& fn, const uint8_t* reader, const HsaWorkGroup& group, const Done&... done) {
+      const uint8_t* readPosition = reinterpret_cast<const uint8_t*>(align<T>(reinterpret_cast<uintptr_t>(reader)));
+      T arg;
+      std::memcpy(&arg, readPosition, sizeof(T));
+      ArgReader<Ts...>::apply(fn, readPosition + sizeof(T), group, done..., arg);
+   }
+};
+
+/// The host kernels known to an agent. The kernel object of a registered
+/// kernel is the address of its HsaHostKernel.
+class HsaHostKernelRegistry {
+public:
+   HsaAgent::KernelDescriptor registerKernel(const HsaHostKernel& kernel);
+
+   /// Looks up a kernel by its symbol name (throws if unknown).
+   HsaAgent::KernelDescriptor getKernelObject(const char* kernelSymbolName) const {
+      return table.get(kernelSymbolName);
+   }
+
+   /// Returns nullptr if the kernel object is unknown.
+   const char* getKernelSymbolName(const uint64_t kernelObject) const {
+      return table.findSymbolName(kernelObject);
+   }
+
+   /// The size of the largest kernel argument segment.
+   uint32_t getMaxArgumentSegmentSize() const;
+
+   /// The argument segment sizes of all kernels.
+   std::vector<uint32_t> getArgumentSegmentSizes() const;
+
+   static inline const HsaHostKernel* getKernel(const uint64_t kernelObject) {
+      return reinterpret_cast<const HsaHostKernel*>(kernelObject);
+   }
+
+private:
+   /// A deque, because the kernel objects point to its elements.
+   std::deque<HsaHostKernel> kernels;
+   std::vector<std::pair<std::string, HsaAgent::KernelDescriptor>> descriptors;
+   /// Rebuilt on every registration (kernels are registered up front).
+   HsaKernelTable table;
+};
+
+}
+}
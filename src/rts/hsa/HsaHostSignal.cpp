@@ -0,0 +1,106 @@
+#include <rts/hsa/HsaHostSignal.hpp>
+#include <utils/Utils.hpp>
+#include <chrono>
+#include <thread>
+
+namespace rts {
+namespace hsa {
+
+hsa_signal_t HsaHostSignal::create(const hsa_signal_value_t initialValue) {
+   HsaHostSignal* s = new HsaHostSignal(initialValue);
+   return hsa_signal_t{reinterpret_cast<uint64_t>(s)};
+}
+
+void HsaHostSignal::destroy(const hsa_signal_t signal) {
+   delete get(signal);
+}
+
+/// A blocked barrier wait checks the abort flag at least this often.
+static constexpr uint64_t barrierBlockNanos = 100 * 1000;
+
+/// Returns the first non-null signal that is not zero (a null signal if there is none).
+static inline hsa_signal_t findPendingSignal(const hsa_signal_t* signals, const uint32_t numSignals) {
+   for (uint32_t i = 0; i < numSignals; i++) {
+      if (signals[i].handle != 0 && HsaHostSignal::load(signals[i]) != 0) return signals[i];
+   }
+   return hsa_signal_t{0};
+}
+
+static inline bool isBarrierSatisfied(const HsaBarrierType type, const hsa_signal_t* signals,
+      const uint32_t numSignals) {
+   if (type == HsaBarrierType::And) {
+      return findPendingSignal(signals, numSignals).handle == 0;
+   }
+   // A barrier-OR without (non-null) signals is satisfied.
+   bool pending = false;
+   for (uint32_t i = 0; i < numSignals; i++) {
+      if (signals[i].handle == 0) continue;
+      if (HsaHostSignal::load(signals[i]) == 0) return true;
+      pending = true;
+   }
+   return !pending;
+}
+
+bool HsaHostSignal::waitBarrier(const HsaBarrierType type, const hsa_signal_t* signals, const uint32_t numSignals,
+      const std::atomic<bool>& abort) {
+   while (!isBarrierSatisfied(type, signals, numSignals)) {
+      if (abort.load(std::memory_order_relaxed)) return false;
+      // A thread can only block on a single signal. Block on the first pending
+      // one for a while, then check all of them again.
+      const hsa_signal_t pending = findPendingSignal(signals, numSignals);
+      if (pending.handle != 0) {
+         wait(pending, HSA_SIGNAL_CONDITION_EQ, 0, barrierBlockNanos, HSA_WAIT_STATE_BLOCKED);
+      }
+   }
+   return true;
+}
+
+hsa_signal_value_t HsaHostSignal::wait(const hsa_signal_t signal,
+      const hsa_signal_condition_t condition, const hsa_signal_value_t compareValue,
+      const uint64_t timeoutNanos, const hsa_wait_state_t waitStateHint) {
+   HsaHostSignal* s = get(signal);
+
+   // Short kernels complete within a few microseconds. Thus we spin for a
+   // while before we give up the CPU.
+   constexpr uint32_t numSpins = 1024;
+   hsa_signal_value_t v = s->value.load(std::memory_order_acquire);
+   for (uint32_t i = 0; i < numSpins; i++) {
+      if (satisfies(v, condition, compareValue)) return v;
+      Utils::pause();
+      v = s->value.load(std::memory_order_acquire);
+   }
+   if (satisfies(v, condition, compareValue) || timeoutNanos == 0) return v;
+
+   // Timeouts beyond a year are treated as infinite.
+   const bool infinite = timeoutNanos >= 365ull * 24 * 3600 * 1000 * 1000 * 1000;
+   const auto deadline = infinite
+         ? std::chrono::steady_clock::time_point::max()
+         : std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeoutNanos);
+
+   if (waitStateHint == HSA_WAIT_STATE_ACTIVE) {
+      while (!satisfies(v, condition, compareValue)) {
+         if (std::chrono::steady_clock::now() >= deadline) break;
+         std::this_thread::yield();
+         v = s->value.load(std::memory_order_acquire);
+      }
+      return v;
+   }
+
+   // Blocked wait.
+   std::unique_lock<std::mutex> lock(s->mutex);
+   s->numWaiters.fetch_add(1, std::memory_order_seq_cst);
+   while (!satisfies(v = s->value.load(std::memory_order_seq_cst), condition, compareValue)) {
+      if (infinite) {
+         s->condition.wait(lock);
+      }
+      else if (s->condition.wait_until(lock, deadline) == std::cv_status::timeout) {
+         v = s->value.load(std::memory_order_acquire);
+         break;
+      }
+   }
+   s->numWaiters.fetch_sub(1, std::memory_order_relaxed);
+   return v;
+}
+
+}
+}
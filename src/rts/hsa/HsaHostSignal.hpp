@@ -0,0 +1,95 @@
+#pragma once
+
+#include <rts/hsa/HsaAgent.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <hsa.h>
+#include <mutex>
+
+namespace rts {
+namespace hsa {
+
+/// Signals for agents that are implemented by host threads. The semantics
+/// follow the HSA signal API, but no HSA runtime is required. The handle of a
+/// host signal points to the (heap allocated) signal object.
+///
+/// Note: Timeouts are given in nanoseconds.
+class HsaHostSignal {
+public:
+
+   static hsa_signal_t create(const hsa_signal_value_t initialValue);
+
+   static void destroy(const hsa_signal_t signal);
+
+   static inline hsa_signal_value_t load(const hsa_signal_t signal) {
+      return get(signal)->value.load(std::memory_order_acquire);
+   }
+
+   static inline void store(const hsa_signal_t signal, const hsa_signal_value_t value) {
+      HsaHostSignal* s = get(signal);
+      s->value.store(value, std::memory_order_seq_cst);
+      s->notify();
+   }
+
+   static inline void add(const hsa_signal_t signal, const hsa_signal_value_t value) {
+      HsaHostSignal* s = get(signal);
+      s->value.fetch_add(value, std::memory_order_seq_cst);
+      s->notify();
+   }
+
+   static inline void subtract(const hsa_signal_t signal, const hsa_signal_value_t value) {
+      HsaHostSignal* s = get(signal);
+      s->value.fetch_sub(value, std::memory_order_seq_cst);
+      s->notify();
+   }
+
+   /// Waits until the condition is satisfied or the timeout expired and
+   /// returns the observed signal value.
+   static hsa_signal_value_t wait(const hsa_signal_t signal,
+         const hsa_signal_condition_t condition, const hsa_signal_value_t compareValue,
+         const uint64_t timeoutNanos, const hsa_wait_state_t waitStateHint);
+
+   /// Waits until all (AND) or any (OR) of the signals are zero, like the
+   /// packet processor does for a barrier packet. Null signals are ignored.
+   /// Returns false, if `abort` has been set before (it is checked
+   /// periodically while the signals are pending).
+   static bool waitBarrier(const HsaBarrierType type, const hsa_signal_t* signals, const uint32_t numSignals,
+         const std::atomic<bool>& abort);
+
+   static inline bool satisfies(const hsa_signal_value_t value,
+         const hsa_signal_condition_t condition, const hsa_signal_value_t compareValue) {
+      switch (condition) {
+         case HSA_SIGNAL_CONDITION_EQ:  return value == compareValue;
+         case HSA_SIGNAL_CONDITION_NE:  return value != compareValue;
+         case HSA_SIGNAL_CONDITION_LT:  return value < compareValue;
+         case HSA_SIGNAL_CONDITION_GTE: return value >= compareValue;
+      }
+      return false;
+   }
+
+private:
+   std::atomic<hsa_signal_value_t> value;
+   /// The number of threads that are blocked in wait().
+   std::atomic<uint32_t> numWaiters;
+   std::mutex mutex;
+   std::condition_variable condition;
+
+   explicit HsaHostSignal(const hsa_signal_value_t initialValue) :
+         value(initialValue), numWaiters(0) {
+   }
+
+   static inline HsaHostSignal* get(const hsa_signal_t signal) {
+      return reinterpret_cast<HsaHostSignal*>(signal.handle);
+   }
+
+   /// Wakes up blocked waiters (if any).
+   inline void notify() {
+      if (numWaiters.load(std::memory_order_seq_cst) != 0) {
+         std::lock_guard<std::mutex> lock(mutex);
+         condition.notify_all();
+      }
+   }
+};
+
+}
+}
@@ -0,0 +1,44 @@
+#include <rts/hsa/HsaKernargSlab.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace rts {
+namespace hsa {
+
+constexpr uint32_t HsaKernargSlab::alignment;
+constexpr uint32_t HsaKernargSlab::maxSlotSize;
+
+HsaKernargSlab::HsaKernargSlab() :
+      queueMask(0), slotSize(0), overflowSlotSize(0), slots(nullptr), overflowSlots(nullptr) {
+}
+
+HsaKernargSlab::HsaKernargSlab(const std::vector<uint32_t>& argumentSegmentSizes, const uint32_t queueSize) :
+      queueMask(queueSize - 1), slotSize(alignment), overflowSlotSize(0), slots(nullptr), overflowSlots(nullptr) {
+   if (queueSize == 0 || (queueSize & (queueSize - 1)) != 0) {
+      throw HsaException("The queue size must be a power of two: " + std::to_string(queueSize));
+   }
+   uint32_t maxSize = 0;
+   for (const uint32_t size : argumentSegmentSizes) {
+      if (size <= maxSlotSize) {
+         slotSize = std::max(slotSize, roundUp(size));
+      }
+      maxSize = std::max(maxSize, size);
+   }
+   if (maxSize > slotSize) {
+      overflowSlotSize = roundUp(maxSize);
+   }
+}
+
+void HsaKernargSlab::bind(void* memory) {
+   if (reinterpret_cast<uintptr_t>(memory) % alignment != 0) {
+      throw HsaException("The kernel argument memory is not aligned to a cache line.");
+   }
+   std::memset(memory, 0, getSize());
+   slots = reinterpret_cast<uint8_t*>(memory);
+   overflowSlots = overflowSlotSize == 0 ? nullptr : slots + static_cast<std::size_t>(slotSize) * (queueMask + 1);
+}
+
+}
+}
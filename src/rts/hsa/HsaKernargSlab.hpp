@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+/// The layout of the pre-allocated kernel argument memory of a queue. Every
+/// queue slot owns an argument buffer (slot) that starts at a cache line
+/// boundary, thus the host writes the arguments of a packet without touching
+/// the cache lines of the packets in flight.
+///
+/// The slots are sized for the largest argument segment of the kernels that
+/// does not exceed maxSlotSize. Kernels with a larger argument segment use a
+/// separate overflow arena (again one buffer per queue slot), so that a single
+/// kernel with a large signature does not inflate every slot.
+///
+/// The slab does not own the memory; the agent allocates getSize() bytes from
+/// its kernel argument region and binds them.
+class HsaKernargSlab {
+public:
+   /// The alignment and granularity of the argument buffers (a cache line).
+   static constexpr uint32_t alignment = 64;
+
+   /// Larger argument segments are placed in the overflow arena.
+   static constexpr uint32_t maxSlotSize = 256;
+
+   /// C'tor, an empty layout.
+   HsaKernargSlab();
+
+   /// C'tor, lays out the buffers for the given argument segment sizes (one
+   /// per kernel) and queue size (a power of two).
+   HsaKernargSlab(const std::vector<uint32_t>& argumentSegmentSizes, const uint32_t queueSize);
+
+   /// The number of bytes to allocate, including the overflow arena.
+   std::size_t getSize() const {
+      return static_cast<std::size_t>(slotSize + overflowSlotSize) * (queueMask + 1);
+   }
+
+   uint32_t getSlotSize() const {
+      return slotSize;
+   }
+
+   /// Zero if there is no overflow arena.
+   uint32_t getOverflowSlotSize() const {
+      return overflowSlotSize;
+   }
+
+   /// The largest argument segment the buffers can hold.
+   uint32_t getMaxArgumentSegmentSize() const {
+      return overflowSlotSize != 0 ? overflowSlotSize : slotSize;
+   }
+
+   /// Binds the memory (of getSize() bytes, aligned to a cache line) and
+   /// clears it.
+   void bind(void* memory);
+
+   /// Returns the argument buffer of a packet of a kernel with the given
+   /// argument segment size.
+   inline void* getBuffer(const uint64_t packetId, const uint32_t argumentSegmentSize) const {
+      const uint64_t pos = packetId & queueMask;
+      if (argumentSegmentSize <= slotSize) {
+         return slots + pos * slotSize;
+      }
+      return overflowSlots + pos * overflowSlotSize;
+   }
+
+   /// Returns the regular argument buffer of a packet.
+   inline void* getSlot(const uint64_t packetId) const {
+      return slots + (packetId & queueMask) * slotSize;
+   }
+
+private:
+   uint64_t queueMask;
+   uint32_t slotSize;
+   uint32_t overflowSlotSize;
+
+   uint8_t* slots;
+   uint8_t* overflowSlots;
+
+   static inline uint32_t roundUp(const uint32_t size) {
+      return (size + alignment - 1) & ~(alignment - 1);
+   }
+};
+
+}
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <rts/hsa/HsaAgent.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstring> // memcpy
+#include <string>
+#include <tuple>
+
+namespace rts {
+namespace hsa {
+
+/// The layout of the arguments Ts, placed one after another (with the
+/// natural alignment of each type) starting at the given byte offset, i.e.,
+/// the layout of
+///
+///   struct args_struct {
+///      Arg1 arg1;
+///      Arg2 arg2;
+///      ...
+///   }
+///
+/// All offsets are compile-time constants.
+template<uint32_t Offset, typename ... Ts>
+struct HsaKernelArgLayout;
+
+template<uint32_t Offset>
+struct HsaKernelArgLayout<Offset> {
+   /// The end of the last argument (unpadded).
+   static constexpr uint32_t end = Offset;
+
+   /// The offset of the i-th argument.
+   static constexpr uint32_t offset(const std::size_t /* i */) {
+      return end;
+   }
+
+   static inline void write(uint8_t* /* base */) {
+   }
+
+   template<std::size_t I, typename Tuple>
+   static inline void writeTuple(uint8_t* /* base */, const Tuple& /* args */) {
+   }
+};
+
+template<uint32_t Offset, typename T, typename ... Ts>
+struct HsaKernelArgLayout<Offset, T, Ts...> {
+   static constexpr uint32_t begin = static_cast<uint32_t>((Offset + alignof(T) - 1) & -alignof(T));
+
+   typedef HsaKernelArgLayout<begin + sizeof(T), Ts...> Next;
+
+   static constexpr uint32_t end = Next::end;
+
+   static constexpr uint32_t offset(const std::size_t i) {
+      return i == 0 ? begin : Next::offset(i - 1);
+   }
+
+   /// Stores the arguments at their offsets relative to base.
+   static inline void write(uint8_t* base, const T& arg, const Ts&... args) {
+      std::memcpy(base + begin, &arg, sizeof(T));
+      Next::write(base, args...);
+   }
+
+   /// Stores the tuple elements I, I+1, ... at their offsets relative to base.
+   template<std::size_t I, typename Tuple>
+   static inline void writeTuple(uint8_t* base, const Tuple& args) {
+      std::memcpy(base + begin, &std::get<I>(args), sizeof(T));
+      Next::template writeTuple<I + 1>(base, args);
+   }
+};
+
+/// The kernel argument segment of a CLOC compiled OpenCL kernel with the
+/// parameters Args: the (hidden) leading parameters followed by the actual
+/// arguments.
+template<typename ... Args>
+struct HsaKernelSignature {
+   typedef HsaKernelArgLayout<HsaAgent::numLeadingParameters * sizeof(uintptr_t), Args...> Layout;
+
+   static constexpr std::size_t numArgs = sizeof...(Args);
+
+   /// The size of the argument segment (unpadded).
+   static constexpr uint32_t argumentSegmentSize = Layout::end;
+
+   /// The byte offset of the i-th (non-hidden) argument.
+   static constexpr uint32_t offset(const std::size_t i) {
+      return Layout::offset(i);
+   }
+
+   /// Writes the arguments to the argument buffer. The leading parameters
+   /// are not touched.
+   static inline void write(void* argPtr, const Args&... args) {
+      Layout::write(reinterpret_cast<uint8_t*>(argPtr), args...);
+   }
+
+   static inline void writeTuple(void* argPtr, const std::tuple<Args...>& args) {
+      Layout::template writeTuple<0>(reinterpret_cast<uint8_t*>(argPtr), args);
+   }
+
+   /// Throws if the argument segment of the kernel does not match the
+   /// signature. The finalizer may pad the segment to a multiple of 16 bytes.
+   static void check(const HsaAgent::KernelDescriptor& kernel) {
+      const uint32_t padded = (argumentSegmentSize + 15) & ~15u;
+      if (kernel.argumentSegmentSize < argumentSegmentSize || kernel.argumentSegmentSize > padded) {
+         throw HsaException("Kernel argument segment size mismatch: the kernel expects "
+               + std::to_string(kernel.argumentSegmentSize) + " bytes, the signature has "
+               + std::to_string(argumentSegmentSize) + " bytes.");
+      }
+   }
+};
+
+template<typename ... Args>
+constexpr uint32_t HsaKernelSignature<Args...>::argumentSegmentSize;
+
+/// A kernel whose argument layout has been checked against the signature
+/// Args (see HsaContext::getKernel).
+template<typename ... Args>
+class HsaKernel {
+public:
+   typedef HsaKernelSignature<Args...> Signature;
+
+   /// Prevents template argument deduction, so that dispatch arguments are
+   /// converted to the parameter types of the kernel.
+   template<typename T>
+   struct Arg {
+      typedef T type;
+   };
+
+   /// C'tor, an unbound kernel.
+   HsaKernel() :
+         descriptor( { 0, 0, 0, 0 }) {
+   }
+
+   /// C'tor, throws if the kernel does not match the signature.
+   explicit HsaKernel(const HsaAgent::KernelDescriptor& descriptor) :
+         descriptor(descriptor) {
+      Signature::check(descriptor);
+   }
+
+   const HsaAgent::KernelDescriptor& getDescriptor() const {
+      return descriptor;
+   }
+
+private:
+   HsaAgent::KernelDescriptor descriptor;
+};
+
+}
+}
@@ -0,0 +1,97 @@
+#include <rts/hsa/HsaKernelTable.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace rts {
+namespace hsa {
+
+HsaKernelTable::HsaKernelTable() :
+      slots(1, 0), slotMask(0) {
+}
+
+HsaKernelTable::HsaKernelTable(const std::vector<std::pair<std::string, KernelDescriptor>>& kernels) {
+   std::size_t numSlots = 2;
+   while (numSlots < 2 * kernels.size()) numSlots <<= 1;
+   slots.assign(numSlots, 0);
+   slotMask = numSlots - 1;
+
+   entries.reserve(kernels.size());
+   for (const auto& kernel : kernels) {
+      if (find(kernel.first) != nullptr) {
+         throw HsaException("Duplicate kernel symbol: " + kernel.first);
+      }
+      std::size_t length;
+      const uint64_t h = hash(kernel.first.c_str(), length);
+      uint64_t slot = h & slotMask;
+      while (slots[slot] != 0) slot = (slot + 1) & slotMask;
+      entries.push_back(Entry { kernel.first, h, kernel.second });
+      slots[slot] = static_cast<uint32_t>(entries.size());
+   }
+}
+
+const HsaKernelTable::KernelDescriptor* HsaKernelTable::find(const char* kernelSymbolName) const {
+   std::size_t length;
+   const uint64_t h = hash(kernelSymbolName, length);
+   for (uint64_t slot = h & slotMask; slots[slot] != 0; slot = (slot + 1) & slotMask) {
+      const Entry& entry = entries[slots[slot] - 1];
+      if (entry.hash == h && entry.name.size() == length
+            && std::memcmp(entry.name.data(), kernelSymbolName, length) == 0) {
+         return &entry.kernel;
+      }
+   }
+   return nullptr;
+}
+
+const HsaKernelTable::KernelDescriptor& HsaKernelTable::get(const char* kernelSymbolName) const {
+   const KernelDescriptor* kernel = find(kernelSymbolName);
+   if (kernel == nullptr) {
+      throw HsaException(std::string("Unknown kernel: ") + kernelSymbolName);
+   }
+   return *kernel;
+}
+
+const char* HsaKernelTable::findSymbolName(const uint64_t kernelObject) const {
+   for (const Entry& entry : entries) {
+      if (entry.kernel.kernelObject == kernelObject) {
+         return entry.name.c_str();
+      }
+   }
+   return nullptr;
+}
+
+uint32_t HsaKernelTable::getMaxArgumentSegmentSize() const {
+   uint32_t maxSize = 0;
+   for (const Entry& entry : entries) {
+      maxSize = std::max(maxSize, entry.kernel.argumentSegmentSize);
+   }
+   return maxSize;
+}
+
+uint32_t HsaKernelTable::getMaxGroupSegmentSize() const {
+   uint32_t maxSize = 0;
+   for (const Entry& entry : entries) {
+      maxSize = std::max(maxSize, entry.kernel.groupSegmentSize);
+   }
+   return maxSize;
+}
+
+uint32_t HsaKernelTable::getMaxPrivateSegmentSize() const {
+   uint32_t maxSize = 0;
+   for (const Entry& entry : entries) {
+      maxSize = std::max(maxSize, entry.kernel.privateSegmentSize);
+   }
+   return maxSize;
+}
+
+std::vector<uint32_t> HsaKernelTable::getArgumentSegmentSizes() const {
+   std::vector<uint32_t> sizes;
+   sizes.reserve(entries.size());
+   for (const Entry& entry : entries) {
+      sizes.push_back(entry.kernel.argumentSegmentSize);
+   }
+   return sizes;
+}
+
+}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <rts/hsa/HsaAgent.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+/// An immutable hash table that maps kernel symbol names to kernel
+/// descriptors. Lookups take a plain C string, thus name-based dispatches do
+/// not construct std::string temporaries. Collisions are resolved by linear
+/// probing; the table is at most half full.
+class HsaKernelTable {
+public:
+   typedef HsaAgent::KernelDescriptor KernelDescriptor;
+
+   /// C'tor, an empty table.
+   HsaKernelTable();
+
+   /// C'tor, throws if a symbol name occurs more than once.
+   explicit HsaKernelTable(const std::vector<std::pair<std::string, KernelDescriptor>>& kernels);
+
+   /// Returns nullptr if the kernel is unknown.
+   const KernelDescriptor* find(const char* kernelSymbolName) const;
+
+   const KernelDescriptor* find(const std::string& kernelSymbolName) const {
+      return find(kernelSymbolName.c_str());
+   }
+
+   /// Looks up a kernel by its symbol name (throws if unknown).
+   const KernelDescriptor& get(const char* kernelSymbolName) const;
+
+   /// Looks up the symbol name of a kernel object (linear search). Returns
+   /// nullptr if the kernel object is unknown.
+   const char* findSymbolName(const uint64_t kernelObject) const;
+
+   std::size_t size() const {
+      return entries.size();
+   }
+
+   /// The largest argument, group and private segment sizes of all kernels.
+   uint32_t getMaxArgumentSegmentSize() const;
+
+   uint32_t getMaxGroupSegmentSize() const;
+
+   uint32_t getMaxPrivateSegmentSize() const;
+
+   /// The argument segment sizes of all kernels (see HsaKernargSlab).
+   std::vector<uint32_t> getArgumentSegmentSizes() const;
+
+private:
+   struct Entry {
+      std::string name;
+      uint64_t hash;
+      KernelDescriptor kernel;
+   };
+
+   std::vector<Entry> entries;
+
+   /// Entry index + 1, zero marks an empty slot.
+   std::vector<uint32_t> slots;
+
+   uint64_t slotMask;
+
+   /// FNV-1a, also determines the length of the name.
+   static inline uint64_t hash(const char* name, std::size_t& length) {
+      uint64_t h = 14695981039346656037ull;
+      length = 0;
+      for (; name[length] != '\0'; length++) {
+         h = (h ^ static_cast<uint8_t>(name[length])) * 1099511628211ull;
+      }
+      return h;
+   }
+};
+
+}
+}
@@ -0,0 +1,38 @@
+#include <rts/hsa/HsaMemoryAllocator.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaUtils.hpp>
+#include <string>
+
+namespace rts {
+namespace hsa {
+
+HsaMemoryAllocator::HsaMemoryAllocator(hsa_agent_t agent) :
+      regions(HsaUtils::determineGlobalRegions(agent)) {
+   for (const HsaRegion& region : regions) {
+      pools.emplace_back(region.allocAllowed ? new HsaMemoryPool(region) : nullptr);
+   }
+}
+
+HsaMemoryPool& HsaMemoryAllocator::getFineGrainedPool() {
+   return getPool(&HsaRegion::fineGrained, "fine-grained");
+}
+
+HsaMemoryPool& HsaMemoryAllocator::getCoarseGrainedPool() {
+   return getPool(&HsaRegion::coarseGrained, "coarse-grained");
+}
+
+HsaMemoryPool& HsaMemoryAllocator::getKernargPool() {
+   return getPool(&HsaRegion::kernarg, "kernarg");
+}
+
+HsaMemoryPool& HsaMemoryAllocator::getPool(bool HsaRegion::*property, const char* name) {
+   for (std::size_t i = 0; i < regions.size(); i++) {
+      if (regions[i].*property && pools[i]) {
+         return *pools[i];
+      }
+   }
+   throw HsaException(std::string("The agent has no ") + name + " region.");
+}
+
+}
+}
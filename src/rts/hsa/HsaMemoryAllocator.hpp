@@ -0,0 +1,48 @@
+#pragma once
+
+#include <rts/hsa/HsaMemoryPool.hpp>
+#include <rts/hsa/HsaRegion.hpp>
+#include <hsa.h>
+#include <memory>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+/// The memory of an agent: its global regions and a memory pool per region
+/// in which the runtime may allocate (see HsaMemoryPool).
+///
+/// The pools must be destroyed before the HSA runtime is shut down.
+class HsaMemoryAllocator {
+public:
+   /// C'tor, enumerates the global regions of the agent (e.g.,
+   /// HsaUtils::determineKernelAgent()).
+   explicit HsaMemoryAllocator(hsa_agent_t agent);
+
+   HsaMemoryAllocator(const HsaMemoryAllocator&) = delete;
+   HsaMemoryAllocator& operator=(const HsaMemoryAllocator&) = delete;
+
+   const std::vector<HsaRegion>& getRegions() const {
+      return regions;
+   }
+
+   /// The pool of the first region with the respective property. Throws if
+   /// the agent has no such region (in which the runtime may allocate).
+   HsaMemoryPool& getFineGrainedPool();
+
+   HsaMemoryPool& getCoarseGrainedPool();
+
+   HsaMemoryPool& getKernargPool();
+
+private:
+   std::vector<HsaRegion> regions;
+
+   /// The pool of each region, null if the runtime must not allocate in the
+   /// region.
+   std::vector<std::unique_ptr<HsaMemoryPool>> pools;
+
+   HsaMemoryPool& getPool(bool HsaRegion::*property, const char* name);
+};
+
+}
+}
@@ -0,0 +1,206 @@
+#include <rts/hsa/HsaMemoryPool.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaUtils.hpp>
+#include <hsa.h>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <sys/mman.h>
+
+namespace rts {
+namespace hsa {
+
+using namespace std;
+
+constexpr std::size_t HsaMemoryPool::minBlockSize;
+constexpr std::size_t HsaMemoryPool::maxBlockSize;
+constexpr std::size_t HsaMemoryPool::slabSize;
+constexpr uint32_t HsaMemoryPool::numSizeClasses;
+
+namespace {
+
+/// 4 GiB
+constexpr std::size_t defaultMaxCachedBytes = std::size_t(4) << 30;
+
+inline std::size_t roundUp(const std::size_t size, const std::size_t granule) {
+   return (size + granule - 1) / granule * granule;
+}
+
+}
+
+HsaMemoryPool::HsaMemoryPool() :
+      region({0}), hostMemory(true), maxCachedBytes(defaultMaxCachedBytes), stats() {
+}
+
+HsaMemoryPool::HsaMemoryPool(const HsaRegion& region) :
+      region(region.region), hostMemory(false), maxCachedBytes(defaultMaxCachedBytes), stats() {
+   if (!region.allocAllowed) {
+      throw HsaException("The runtime must not allocate memory in the region.");
+   }
+}
+
+HsaMemoryPool::~HsaMemoryPool() {
+   for (void* slab : slabs) {
+      freeChunk(slab, slabSize);
+   }
+   for (const auto& block : largeBlocks) {
+      freeChunk(block.first, block.second);
+   }
+   for (const auto& block : cachedBlocks) {
+      freeChunk(block.second, block.first);
+   }
+}
+
+uint32_t HsaMemoryPool::getSizeClass(const std::size_t size) {
+   if (size > maxBlockSize) {
+      return numSizeClasses;
+   }
+   uint32_t sizeClass = 0;
+   while ((minBlockSize << sizeClass) < size) {
+      sizeClass++;
+   }
+   return sizeClass;
+}
+
+void* HsaMemoryPool::allocate(const std::size_t size) {
+   const uint32_t sizeClass = getSizeClass(size);
+   lock_guard<std::mutex> lock(mutex);
+   stats.numAllocations++;
+
+   if (sizeClass == numSizeClasses) {
+      const std::size_t blockSize = roundUp(size, slabSize);
+      // Reuse a cached block of (about) the same size, which wastes at most
+      // an eighth of it.
+      auto cached = cachedBlocks.lower_bound(blockSize);
+      if (cached != cachedBlocks.end() && cached->first <= blockSize + blockSize / 8) {
+         void* ptr = cached->second;
+         largeBlocks.emplace(ptr, cached->first);
+         stats.numReuses++;
+         stats.cachedBytes -= cached->first;
+         stats.inUseBytes += cached->first;
+         cachedBlocks.erase(cached);
+         return ptr;
+      }
+      void* ptr = allocateChunk(blockSize);
+      largeBlocks.emplace(ptr, blockSize);
+      stats.numLargeBlocks++;
+      stats.reservedBytes += blockSize;
+      stats.inUseBytes += blockSize;
+      return ptr;
+   }
+
+   const std::size_t blockSize = minBlockSize << sizeClass;
+   vector<void*>& blocks = freeBlocks[sizeClass];
+   if (!blocks.empty()) {
+      stats.numReuses++;
+   }
+   else {
+      // Carve a new slab into blocks of this size class.
+      char* slab = reinterpret_cast<char*>(allocateChunk(slabSize));
+      slabs.push_back(slab);
+      stats.numSlabs++;
+      stats.reservedBytes += slabSize;
+      for (std::size_t offset = slabSize; offset > 0; offset -= blockSize) {
+         blocks.push_back(slab + offset - blockSize);
+      }
+   }
+   void* ptr = blocks.back();
+   blocks.pop_back();
+   stats.inUseBytes += blockSize;
+   return ptr;
+}
+
+void HsaMemoryPool::deallocate(void* ptr, const std::size_t size) {
+   if (ptr == nullptr) return;
+   const uint32_t sizeClass = getSizeClass(size);
+   lock_guard<std::mutex> lock(mutex);
+
+   if (sizeClass == numSizeClasses) {
+      auto block = largeBlocks.find(ptr);
+      if (block == largeBlocks.end()) {
+         throw HsaException("The block has not been allocated by the pool.");
+      }
+      const std::size_t blockSize = block->second;
+      largeBlocks.erase(block);
+      stats.inUseBytes -= blockSize;
+      if (blockSize > maxCachedBytes) {
+         freeChunk(ptr, blockSize);
+         stats.reservedBytes -= blockSize;
+         return;
+      }
+      evictCachedBlocks(maxCachedBytes - blockSize);
+      cachedBlocks.emplace(blockSize, ptr);
+      stats.cachedBytes += blockSize;
+      return;
+   }
+
+   freeBlocks[sizeClass].push_back(ptr);
+   stats.inUseBytes -= minBlockSize << sizeClass;
+}
+
+void HsaMemoryPool::trim() {
+   lock_guard<std::mutex> lock(mutex);
+   evictCachedBlocks(0);
+}
+
+void HsaMemoryPool::setMaxCachedBytes(const std::size_t bytes) {
+   lock_guard<std::mutex> lock(mutex);
+   maxCachedBytes = bytes;
+   evictCachedBlocks(bytes);
+}
+
+HsaMemoryPool::Stats HsaMemoryPool::getStats() {
+   lock_guard<std::mutex> lock(mutex);
+   return stats;
+}
+
+void HsaMemoryPool::evictCachedBlocks(const std::size_t bytes) {
+   while (stats.cachedBytes > bytes) {
+      auto largest = std::prev(cachedBlocks.end());
+      freeChunk(largest->second, largest->first);
+      stats.cachedBytes -= largest->first;
+      stats.reservedBytes -= largest->first;
+      cachedBlocks.erase(largest);
+   }
+}
+
+void* HsaMemoryPool::allocateChunk(const std::size_t size) {
+   if (!hostMemory) {
+      void* ptr;
+      HsaUtils::apiCall([&] {
+         return hsa_memory_allocate(region, size, &ptr);
+      });
+      return ptr;
+   }
+
+   // Map an additional huge page, so that the chunk can be aligned to a huge
+   // page, and unmap the remainder.
+   const std::size_t mappedSize = size + slabSize;
+   void* mapped = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (mapped == MAP_FAILED) {
+      throw HsaException("Failed to map " + to_string(size) + " bytes of host memory.");
+   }
+   const uintptr_t begin = reinterpret_cast<uintptr_t>(mapped);
+   const uintptr_t aligned = roundUp(begin, slabSize);
+   if (aligned > begin) {
+      munmap(mapped, aligned - begin);
+   }
+   if (begin + mappedSize > aligned + size) {
+      munmap(reinterpret_cast<void*>(aligned + size), begin + mappedSize - (aligned + size));
+   }
+   void* ptr = reinterpret_cast<void*>(aligned);
+   madvise(ptr, size, MADV_HUGEPAGE);
+   return ptr;
+}
+
+void HsaMemoryPool::freeChunk(void* ptr, const std::size_t size) {
+   if (hostMemory) {
+      munmap(ptr, size);
+   }
+   else if (HsaUtils::isInitialized()) {
+      hsa_memory_free(ptr);
+   }
+}
+
+}
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <rts/hsa/HsaRegion.hpp>
+#include <hsa.h>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+/// A memory pool that recycles the buffers that are passed to kernels,
+/// instead of mapping (and faulting in) fresh memory for each of them. The
+/// memory either comes from a global region of an agent (see
+/// HsaMemoryAllocator) or is host memory, which a full-profile kernel agent
+/// accesses directly.
+///
+/// Small allocations (up to maxBlockSize) are served from size classes of
+/// power-of-two blocks, which are carved from slabs of the size of a huge
+/// page. Thus, a block is aligned to its size (at most to the alignment of
+/// the region). Larger allocations are rounded up to a multiple of the slab
+/// size and are allocated individually; freed large blocks are cached (up to
+/// getMaxCachedBytes() bytes) and are reused for allocations of (about) the
+/// same size. Host memory is mapped in huge-page-aligned chunks and backed by
+/// transparent huge pages.
+///
+/// The pool is thread-safe. All allocations must be returned before the pool
+/// is destroyed, the d'tor releases the memory of the pool.
+class HsaMemoryPool {
+public:
+   struct Stats {
+      /// The number of allocations and how many of them were served without
+      /// allocating from the region (from a free block or a cached block).
+      uint64_t numAllocations;
+      uint64_t numReuses;
+      /// The number of slabs and large blocks allocated from the region.
+      uint64_t numSlabs;
+      uint64_t numLargeBlocks;
+      /// The memory allocated from the region (including the cached blocks
+      /// and the free blocks of the slabs).
+      std::size_t reservedBytes;
+      /// The memory of the allocations (rounded up to their block size).
+      std::size_t inUseBytes;
+      /// The memory of the cached large blocks.
+      std::size_t cachedBytes;
+   };
+
+   /// The smallest block (a cache line) and the largest block that is
+   /// served from a size class.
+   static constexpr std::size_t minBlockSize = 64;
+   static constexpr std::size_t maxBlockSize = 1 << 20;
+
+   /// The size of a slab (a huge page). Large blocks are rounded up to a
+   /// multiple of it.
+   static constexpr std::size_t slabSize = 2 << 20;
+
+   /// The size classes are the powers of two from minBlockSize to
+   /// maxBlockSize.
+   static constexpr uint32_t numSizeClasses = 15;
+
+   /// C'tor, a pool of host memory.
+   HsaMemoryPool();
+
+   /// C'tor, a pool of the given region. Throws if the runtime must not
+   /// allocate in the region.
+   explicit HsaMemoryPool(const HsaRegion& region);
+
+   /// D'tor, releases the slabs and the large blocks.
+   ~HsaMemoryPool();
+
+   HsaMemoryPool(const HsaMemoryPool&) = delete;
+   HsaMemoryPool& operator=(const HsaMemoryPool&) = delete;
+
+   /// Allocates (at least) `size` bytes. Throws if the region is exhausted.
+   void* allocate(const std::size_t size);
+
+   /// Returns an allocation of `size` bytes (as requested) to the pool.
+   void deallocate(void* ptr, const std::size_t size);
+
+   /// Releases the cached large blocks.
+   void trim();
+
+   /// Bounds the memory of the cached large blocks (4 GiB by default). The
+   /// largest blocks are released first.
+   void setMaxCachedBytes(const std::size_t bytes);
+
+   std::size_t getMaxCachedBytes() const {
+      return maxCachedBytes;
+   }
+
+   /// Whether the pool allocates host memory (instead of region memory).
+   bool isHostMemory() const {
+      return hostMemory;
+   }
+
+   Stats getStats();
+
+   /// The size class of an allocation, numSizeClasses for large blocks.
+   static uint32_t getSizeClass(const std::size_t size);
+
+private:
+   hsa_region_t region;
+   bool hostMemory;
+
+   /// Guards the members below.
+   std::mutex mutex;
+
+   /// The free blocks of each size class.
+   std::vector<void*> freeBlocks[numSizeClasses];
+
+   /// The slabs, which are released on destruction.
+   std::vector<void*> slabs;
+
+   /// The large blocks that are in use and their (rounded) size, and the
+   /// cached ones by size.
+   std::unordered_map<void*, std::size_t> largeBlocks;
+   std::multimap<std::size_t, void*> cachedBlocks;
+
+   std::size_t maxCachedBytes;
+
+   Stats stats;
+
+   /// Allocates (releases) a slab or a large block.
+   void* allocateChunk(const std::size_t size);
+   void freeChunk(void* ptr, const std::size_t size);
+
+   /// Releases the largest cached blocks until at most `bytes` remain.
+   void evictCachedBlocks(const std::size_t bytes);
+};
+
+/// A std::allocator-compatible adaptor of a memory pool, e.g., for a
+/// std::vector whose buffer is passed to a kernel.
+template<typename T>
+class HsaPoolAllocator {
+public:
+   typedef T value_type;
+
+   template<typename U>
+   struct rebind {
+      typedef HsaPoolAllocator<U> other;
+   };
+
+   explicit HsaPoolAllocator(HsaMemoryPool& pool) :
+         pool(&pool) {
+   }
+
+   template<typename U>
+   HsaPoolAllocator(const HsaPoolAllocator<U>& other) :
+         pool(other.getPool()) {
+   }
+
+   T* allocate(const std::size_t n) {
+      if (n > SIZE_MAX / sizeof(T)) {
+         throw std::bad_alloc();
+      }
+      return static_cast<T*>(pool->allocate(n * sizeof(T)));
+   }
+
+   void deallocate(T* ptr, const std::size_t n) {
+      pool->deallocate(ptr, n * sizeof(T));
+   }
+
+   HsaMemoryPool* getPool() const {
+      return pool;
+   }
+
+private:
+   HsaMemoryPool* pool;
+};
+
+template<typename T, typename U>
+inline bool operator==(const HsaPoolAllocator<T>& a, const HsaPoolAllocator<U>& b) {
+   return a.getPool() == b.getPool();
+}
+
+template<typename T, typename U>
+inline bool operator!=(const HsaPoolAllocator<T>& a, const HsaPoolAllocator<U>& b) {
+   return !(a == b);
+}
+
+}
+}
@@ -0,0 +1,107 @@
+#include <rts/hsa/HsaModuleSource.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rts {
+namespace hsa {
+
+constexpr std::size_t HsaModuleSource::alignment;
+constexpr std::size_t HsaModuleSource::headerSize;
+
+namespace {
+
+constexpr char brigMagic[8] = { 'H', 'S', 'A', ' ', 'B', 'R', 'I', 'G' };
+
+/// The offset of the byteCount field in the BRIG module header.
+constexpr std::size_t byteCountOffset = 16;
+
+}
+
+HsaModuleSource::HsaModuleSource() :
+      data(nullptr), size(0), mappedSize(0) {
+}
+
+HsaModuleSource::HsaModuleSource(const void* brig, const std::size_t size) :
+      data(reinterpret_cast<const char*>(brig)), size(0), mappedSize(0) {
+   if (brig == nullptr) {
+      throw HsaException("The BRIG module is null.");
+   }
+   validate(size, "embedded module");
+}
+
+HsaModuleSource HsaModuleSource::map(const std::string& path) {
+   const int fd = open(path.c_str(), O_RDONLY);
+   if (fd < 0) {
+      throw HsaException("Failed to open BRIG module " + path);
+   }
+   struct stat status;
+   if (fstat(fd, &status) != 0 || status.st_size == 0) {
+      close(fd);
+      throw HsaException("Failed to map BRIG module " + path);
+   }
+   const std::size_t fileSize = static_cast<std::size_t>(status.st_size);
+   void* ptr = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+   // The mapping remains valid after the file has been closed.
+   close(fd);
+   if (ptr == MAP_FAILED) {
+      throw HsaException("Failed to map BRIG module " + path);
+   }
+
+   HsaModuleSource source;
+   source.data = reinterpret_cast<const char*>(ptr);
+   source.mappedSize = fileSize;
+   source.validate(fileSize, path);
+   return source;
+}
+
+HsaModuleSource::~HsaModuleSource() {
+   unmap();
+}
+
+HsaModuleSource::HsaModuleSource(HsaModuleSource&& other) :
+      data(other.data), size(other.size), mappedSize(other.mappedSize) {
+   other.data = nullptr;
+   other.size = 0;
+   other.mappedSize = 0;
+}
+
+HsaModuleSource& HsaModuleSource::operator=(HsaModuleSource&& other) {
+   if (this != &other) {
+      unmap();
+      data = other.data;
+      size = other.size;
+      mappedSize = other.mappedSize;
+      other.data = nullptr;
+      other.size = 0;
+      other.mappedSize = 0;
+   }
+   return *this;
+}
+
+void HsaModuleSource::validate(const std::size_t availableSize, const std::string& origin) {
+   if (availableSize < headerSize || std::memcmp(data, brigMagic, sizeof(brigMagic)) != 0) {
+      unmap();
+      throw HsaException("Invalid magic number of BRIG module " + origin);
+   }
+   uint64_t byteCount;
+   std::memcpy(&byteCount, data + byteCountOffset, sizeof(byteCount));
+   if (byteCount < headerSize || byteCount > availableSize) {
+      unmap();
+      throw HsaException("Truncated BRIG module " + origin);
+   }
+   size = static_cast<std::size_t>(byteCount);
+}
+
+void HsaModuleSource::unmap() {
+   if (mappedSize != 0) {
+      munmap(const_cast<char*>(data), mappedSize);
+      mappedSize = 0;
+   }
+}
+
+}
+}
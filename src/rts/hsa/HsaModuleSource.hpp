@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace rts {
+namespace hsa {
+
+/// A BRIG module that can be added to a context (see HsaContext::addModule),
+/// without copying it: either a module that is embedded into the binary
+/// (see scripts/hsa/embed_brig.sh) or a module file that is mapped into
+/// memory. The header of the module is validated once, on construction.
+///
+/// The module must outlive the finalization of the context.
+class HsaModuleSource {
+public:
+   /// The alignment of embedded modules.
+   static constexpr std::size_t alignment = 16;
+
+   /// The size of the BRIG module header.
+   static constexpr std::size_t headerSize = 104;
+
+   /// C'tor, refers to a module in memory (e.g., an embedded module) of
+   /// `size` bytes. Throws if it is not a valid BRIG module.
+   HsaModuleSource(const void* brig, const std::size_t size);
+
+   /// Maps the given module file (read-only). Throws if the file cannot be
+   /// mapped or is not a valid BRIG module.
+   static HsaModuleSource map(const std::string& path);
+
+   /// D'tor, unmaps a mapped module.
+   ~HsaModuleSource();
+
+   HsaModuleSource(HsaModuleSource&& other);
+   HsaModuleSource& operator=(HsaModuleSource&& other);
+
+   HsaModuleSource(const HsaModuleSource&) = delete;
+   HsaModuleSource& operator=(const HsaModuleSource&) = delete;
+
+   const char* getData() const {
+      return data;
+   }
+
+   /// The size of the module (as stated in its header).
+   std::size_t getSize() const {
+      return size;
+   }
+
+   bool isMapped() const {
+      return mappedSize != 0;
+   }
+
+private:
+   const char* data;
+   std::size_t size;
+
+   /// The size of the mapping, zero if the module is not mapped.
+   std::size_t mappedSize;
+
+   HsaModuleSource();
+
+   /// Validates the header and determines the size of the module.
+   void validate(const std::size_t availableSize, const std::string& origin);
+
+   void unmap();
+};
+
+}
+}
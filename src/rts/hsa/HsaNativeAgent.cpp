@@ -0,0 +1,286 @@
+#include <rts/hsa/HsaNativeAgent.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <utils/Utils.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+namespace rts {
+namespace hsa {
+
+HsaNativeAgent::HsaNativeAgent(const uint32_t numThreads) :
+      numThreads(numThreads == 0 ? Utils::numProcessors() : numThreads),
+            packets(nullptr), queueMask(0), argumentMemory(nullptr),
+            writeIndex(0), readIndex(0), doorbellIndex(0), numSleepers(0), shutDown(false) {
+}
+
+HsaNativeAgent::~HsaNativeAgent() {
+   shutDown = true;
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      wakeUp.notify_all();
+   }
+   for (std::thread& worker : workers) {
+      worker.join();
+   }
+   free(packets);
+   free(argumentMemory);
+}
+
+void* HsaNativeAgent::operator new(const std::size_t size) {
+   void* ptr;
+   if (posix_memalign(&ptr, alignof(HsaNativeAgent), size) != 0) {
+      throw std::bad_alloc();
+   }
+   return ptr;
+}
+
+void HsaNativeAgent::operator delete(void* ptr) {
+   free(ptr);
+}
+
+HsaAgent::KernelDescriptor HsaNativeAgent::registerKernel(const HsaHostKernel& kernel) {
+   if (packets != nullptr) {
+      throw HsaException("Kernels have to be registered before the queue is created.");
+   }
+   return kernels.registerKernel(kernel);
+}
+
+void HsaNativeAgent::addModule(const char* /* brigModulePtr */) {
+   throw HsaException("The native agent does not support BRIG modules. Use registerKernel() instead.");
+}
+
+void HsaNativeAgent::finalize() {
+   // Nothing to do. Host kernels are ready to run.
+}
+
+void HsaNativeAgent::createQueue(const uint32_t preferredQueueSize) {
+   if (packets != nullptr) {
+      throw HsaException("Queue already created.");
+   }
+
+   const uint32_t queueSize = roundQueueSize(preferredQueueSize);
+   queueMask = queueSize - 1;
+
+   // Each argument buffer occupies its own cache line(s).
+   kernargs = HsaKernargSlab(kernels.getArgumentSegmentSizes(), queueSize);
+
+   void* ptr;
+   if (posix_memalign(&ptr, 64, sizeof(Packet) * queueSize) != 0) {
+      throw std::bad_alloc();
+   }
+   packets = reinterpret_cast<Packet*>(ptr);
+   for (uint32_t i = 0; i < queueSize; i++) {
+      Packet* p = new (&packets[i]) Packet();
+      // The entry must not be mistaken as published.
+      p->work = static_cast<uint64_t>(static_cast<uint32_t>(i - 1)) << 32;
+      p->numGroups = 0;
+      p->numGroupsDone = 0;
+      p->kernel = nullptr;
+      p->kernargs = nullptr;
+      p->completionSignal = {0};
+      p->barrierType = HsaBarrierType::And;
+   }
+   if (posix_memalign(&argumentMemory, HsaKernargSlab::alignment, kernargs.getSize()) != 0) {
+      throw std::bad_alloc();
+   }
+   kernargs.bind(argumentMemory);
+
+   for (uint32_t i = 0; i < numThreads; i++) {
+      workers.emplace_back(&HsaNativeAgent::work, this, i);
+   }
+}
+
+HsaAgent::KernelDescriptor HsaNativeAgent::getKernelObject(const char* kernelSymbolName) {
+   return kernels.getKernelObject(kernelSymbolName);
+}
+
+const char* HsaNativeAgent::getKernelSymbolName(const uint64_t kernelObject) {
+   return kernels.getKernelSymbolName(kernelObject);
+}
+
+std::string HsaNativeAgent::getIsaName() {
+   // The host kernels are native code. Their performance depends on the
+   // number of workers.
+   return "native:" + std::to_string(numThreads);
+}
+
+HsaAgent::Properties HsaNativeAgent::getProperties() {
+   // A worker executes one work-group at a time, work-item by work-item.
+   Properties properties;
+   properties.numComputeUnits = numThreads;
+   properties.wavefrontSize = 1;
+   properties.maxWavefrontsPerComputeUnit = getMaxWorkgroupSize();
+   properties.maxWorkgroupsPerComputeUnit = 1;
+   properties.maxWorkgroupSize = getMaxWorkgroupSize();
+   properties.groupSegmentSize = 0;
+   properties.privateSegmentSize = 0;
+   return properties;
+}
+
+void* HsaNativeAgent::allocateArgumentMemory(const std::size_t size) {
+   void* ptr;
+   if (posix_memalign(&ptr, 64, size) != 0) {
+      throw std::bad_alloc();
+   }
+   return ptr;
+}
+
+void HsaNativeAgent::freeArgumentMemory(void* ptr) {
+   free(ptr);
+}
+
+uint64_t HsaNativeAgent::requestPacketId() {
+   // Atomically request a new packet ID.
+   const uint64_t packetId = writeIndex.fetch_add(1);
+   // Wait until the queue is not full before writing the packet
+   if (packetId - readIndex.load(std::memory_order_acquire) > queueMask) {
+      waitForQueueSpace(packetId);
+   }
+   return packetId;
+}
+
+uint64_t HsaNativeAgent::requestPacketIds(const uint32_t count) {
+   const uint64_t packetId = writeIndex.fetch_add(count);
+   // Wait until all packets fit into the queue
+   if (packetId + count - 1 - readIndex.load(std::memory_order_acquire) > queueMask) {
+      waitForQueueSpace(packetId + count - 1);
+   }
+   return packetId;
+}
+
+bool HsaNativeAgent::tryRequestPacketId(uint64_t& packetId) {
+   uint64_t id = writeIndex.load(std::memory_order_relaxed);
+   while (id - readIndex.load(std::memory_order_acquire) <= queueMask) {
+      if (writeIndex.compare_exchange_weak(id, id + 1)) {
+         packetId = id;
+         return true;
+      }
+   }
+   return false;
+}
+
+void HsaNativeAgent::publishPacket(const uint64_t packetId, const KernelDescriptor& kernel,
+      const KernelLaunchParameters n, const hsa_signal_t completionSignal) {
+   Packet& p = packets[packetId & queueMask];
+   const uint32_t workgroupSize = n.workgroupSize == 0 ? defaultWorkgroupSize : n.workgroupSize;
+   p.kernel = HsaHostKernelRegistry::getKernel(kernel.kernelObject);
+   p.kernargs = kernargs.getBuffer(packetId, kernel.argumentSegmentSize);
+   p.gridSize = n.numElements;
+   p.workgroupSize = workgroupSize;
+   p.completionSignal = completionSignal;
+   // An empty grid is executed as a single empty work-group.
+   p.numGroups.store(std::max<uint64_t>(1, (n.numElements + workgroupSize - 1) / workgroupSize),
+         std::memory_order_relaxed);
+   p.numGroupsDone.store(0, std::memory_order_relaxed);
+   // Publish.
+   p.work.store(static_cast<uint64_t>(static_cast<uint32_t>(packetId)) << 32, std::memory_order_release);
+}
+
+void HsaNativeAgent::publishBarrierPacket(const uint64_t packetId, const HsaBarrierType type,
+      const hsa_signal_t* dependencies, const uint32_t numDependencies, const hsa_signal_t completionSignal) {
+   if (numDependencies > maxBarrierDependencies) {
+      throw HsaException("A barrier packet has at most " + std::to_string(maxBarrierDependencies) + " dependencies.");
+   }
+   Packet& p = packets[packetId & queueMask];
+   p.kernel = nullptr;
+   p.kernargs = nullptr;
+   p.gridSize = 0;
+   p.workgroupSize = 1;
+   p.completionSignal = completionSignal;
+   p.barrierType = type;
+   for (uint32_t i = 0; i < maxBarrierDependencies; i++) {
+      p.dependencies[i] = i < numDependencies ? dependencies[i] : hsa_signal_t{0};
+   }
+   p.numGroups.store(1, std::memory_order_relaxed);
+   p.numGroupsDone.store(0, std::memory_order_relaxed);
+   // Publish.
+   p.work.store(static_cast<uint64_t>(static_cast<uint32_t>(packetId)) << 32, std::memory_order_release);
+}
+
+void HsaNativeAgent::ringDoorbell(const uint64_t packetId) {
+   uint64_t current = doorbellIndex.load();
+   while (current < packetId + 1 && !doorbellIndex.compare_exchange_weak(current, packetId + 1)) {
+   }
+   notifyWorkers();
+}
+
+void HsaNativeAgent::work(const uint32_t threadId) {
+   Utils::setAffinity(threadId);
+   uint32_t idleRounds = 0;
+   while (true) {
+      const uint64_t packetId = readIndex.load(std::memory_order_acquire);
+      Packet& p = packets[packetId & queueMask];
+      uint64_t w = p.work.load(std::memory_order_acquire);
+      const bool published = (w >> 32) == static_cast<uint32_t>(packetId);
+      if (published && (w & 0xffffffffu) < p.numGroups.load(std::memory_order_relaxed)) {
+         // Claim the next work-group.
+         if (p.work.compare_exchange_weak(w, w + 1, std::memory_order_acq_rel)) {
+            execute(p, packetId, w & 0xffffffffu);
+            idleRounds = 0;
+         }
+         continue;
+      }
+      if (shutDown) return;
+      idle(packetId, published, idleRounds);
+   }
+}
+
+void HsaNativeAgent::execute(Packet& p, const uint64_t packetId, const uint64_t groupId) {
+   if (p.kernel == nullptr) {
+      // A barrier packet. On shut down, the packet is abandoned.
+      if (!HsaHostSignal::waitBarrier(p.barrierType, p.dependencies, maxBarrierDependencies, shutDown)) return;
+   }
+   else {
+      HsaWorkGroup group;
+      group.groupId = groupId;
+      group.workgroupSize = p.workgroupSize;
+      group.gridSize = p.gridSize;
+      group.begin = std::min(groupId * p.workgroupSize, p.gridSize);
+      group.end = std::min(group.begin + p.workgroupSize, p.gridSize);
+      p.kernel->function(group, p.kernargs);
+   }
+
+   const uint64_t numGroups = p.numGroups.load(std::memory_order_relaxed);
+   if (p.numGroupsDone.fetch_add(1, std::memory_order_acq_rel) + 1 == numGroups) {
+      // This was the last work-group. Complete the packet and release the queue entry.
+      const hsa_signal_t completionSignal = p.completionSignal;
+      readIndex.store(packetId + 1, std::memory_order_seq_cst);
+      if (completionSignal.handle != 0) {
+         HsaHostSignal::subtract(completionSignal, 1);
+      }
+      notifyWorkers();
+   }
+}
+
+void HsaNativeAgent::idle(const uint64_t packetId, const bool published, uint32_t& idleRounds) {
+   constexpr uint32_t maxSpinRounds = 1 << 12;
+   if (idleRounds < maxSpinRounds) {
+      idleRounds++;
+      Utils::pause();
+      return;
+   }
+   std::unique_lock<std::mutex> lock(mutex);
+   numSleepers.fetch_add(1, std::memory_order_seq_cst);
+   // Wait for the packet to complete (all work-groups have been claimed) or
+   // to be enqueued.
+   wakeUp.wait(lock, [&] {
+      return shutDown
+            || readIndex.load(std::memory_order_seq_cst) != packetId
+            || (!published && doorbellIndex.load(std::memory_order_seq_cst) > packetId);
+   });
+   numSleepers.fetch_sub(1, std::memory_order_relaxed);
+   idleRounds = 0;
+}
+
+void HsaNativeAgent::notifyWorkers() {
+   if (numSleepers.load(std::memory_order_seq_cst) != 0) {
+      std::lock_guard<std::mutex> lock(mutex);
+      wakeUp.notify_all();
+   }
+}
+
+}
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <rts/hsa/HsaAgent.hpp>
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaHostSignal.hpp>
+#include <rts/hsa/HsaKernargSlab.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <hsa.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+/// An agent that executes host kernels (C++ functions) on a pool of pinned
+/// worker threads. It does not depend on the HSA runtime and therefore runs on
+/// systems without a kernel agent.
+///
+/// The dispatch queue mimics an AQL queue: packets are processed in order and
+/// the work-groups of a packet are distributed dynamically among all workers.
+/// The completion signal of a packet is decremented after its last work-group
+/// has finished. A barrier packet is executed like a single work-group, which
+/// waits for the dependency signals.
+class HsaNativeAgent : public HsaAgent {
+public:
+   /// C'tor. If `numThreads` is 0, one worker per processor is started.
+   explicit HsaNativeAgent(const uint32_t numThreads = 0);
+
+   /// D'tor
+   virtual ~HsaNativeAgent();
+
+   /// The agent is cache-line aligned (C++11 does not support over-aligned new).
+   static void* operator new(const std::size_t size);
+
+   static void operator delete(void* ptr);
+
+   /// Registers a host kernel. Kernels have to be registered before the
+   /// queue is created.
+   KernelDescriptor registerKernel(const HsaHostKernel& kernel);
+
+   /// Returns the number of worker threads.
+   uint32_t getNumThreads() const {
+      return numThreads;
+   }
+
+   /// BRIG modules are not supported (throws).
+   void addModule(const char* brigModulePtr) override;
+
+   void finalize() override;
+
+   using HsaAgent::createQueue;
+
+   void createQueue(const uint32_t queueSize) override;
+
+   using HsaAgent::getKernelObject;
+
+   KernelDescriptor getKernelObject(const char* kernelSymbolName) override;
+
+   const char* getKernelSymbolName(const uint64_t kernelObject) override;
+
+   std::string getIsaName() override;
+
+   Properties getProperties() override;
+
+   void* allocateArgumentMemory(const std::size_t size) override;
+
+   void freeArgumentMemory(void* ptr) override;
+
+   uint64_t requestPacketId() override;
+
+   uint64_t requestPacketIds(const uint32_t count) override;
+
+   bool tryRequestPacketId(uint64_t& packetId) override;
+
+   inline uint32_t getQueueSize() override {
+      return queueMask + 1;
+   }
+
+   inline void* getArgBufferPtr(const uint64_t packetId, const KernelDescriptor& kernel) override {
+      return kernargs.getBuffer(packetId, kernel.argumentSegmentSize);
+   }
+
+   void publishPacket(const uint64_t packetId, const KernelDescriptor& kernel,
+         const KernelLaunchParameters n, const hsa_signal_t completionSignal) override;
+
+   void publishBarrierPacket(const uint64_t packetId, const HsaBarrierType type,
+         const hsa_signal_t* dependencies, const uint32_t numDependencies, const hsa_signal_t completionSignal) override;
+
+   void ringDoorbell(const uint64_t packetId) override;
+
+   inline hsa_signal_t createSignal(const hsa_signal_value_t initialValue) override {
+      return HsaHostSignal::create(initialValue);
+   }
+
+   inline void destroySignal(const hsa_signal_t signal) override {
+      HsaHostSignal::destroy(signal);
+   }
+
+   inline hsa_signal_value_t loadSignal(const hsa_signal_t signal) override {
+      return HsaHostSignal::load(signal);
+   }
+
+   inline void storeSignal(const hsa_signal_t signal, const hsa_signal_value_t value) override {
+      HsaHostSignal::store(signal, value);
+   }
+
+   inline void addSignal(const hsa_signal_t signal, const hsa_signal_value_t value) override {
+      HsaHostSignal::add(signal, value);
+   }
+
+   inline hsa_signal_value_t waitSignal(const hsa_signal_t signal,
+         const hsa_signal_condition_t condition, const hsa_signal_value_t compareValue,
+         const uint64_t timeoutHint, const hsa_wait_state_t waitStateHint) override {
+      return HsaHostSignal::wait(signal, condition, compareValue, timeoutHint, waitStateHint);
+   }
+
+protected:
+   inline uint64_t queueLoadReadIndex() override {
+      return readIndex.load(std::memory_order_acquire);
+   }
+
+private:
+   /// A queue entry. The `work` word contains the (lower 32 bits of the)
+   /// packet ID in the upper half and the ID of the next unclaimed work-group
+   /// in the lower half. Workers claim work-groups with a CAS, which fails if
+   /// the entry has been recycled in the meantime.
+   struct alignas(64) Packet {
+      std::atomic<uint64_t> work;
+      std::atomic<uint64_t> numGroups;
+      std::atomic<uint64_t> numGroupsDone;
+      /// Null for barrier packets.
+      const HsaHostKernel* kernel;
+      /// The argument buffer of the kernel (see getArgBufferPtr).
+      void* kernargs;
+      uint64_t gridSize;
+      uint32_t workgroupSize;
+      hsa_signal_t completionSignal;
+      HsaBarrierType barrierType;
+      hsa_signal_t dependencies[maxBarrierDependencies];
+   };
+
+   const uint32_t numThreads;
+
+   HsaHostKernelRegistry kernels;
+
+   Packet* packets;
+   uint64_t queueMask;
+
+   /// The kernel argument buffers (see HsaKernargSlab).
+   void* argumentMemory;
+   HsaKernargSlab kernargs;
+
+   alignas(64) std::atomic<uint64_t> writeIndex;
+   alignas(64) std::atomic<uint64_t> readIndex;
+   /// One past the ID of the last packet the doorbell was rung for.
+   alignas(64) std::atomic<uint64_t> doorbellIndex;
+
+   /// Idle workers block on the condition variable.
+   std::atomic<uint32_t> numSleepers;
+   std::mutex mutex;
+   std::condition_variable wakeUp;
+   std::atomic<bool> shutDown;
+
+   std::vector<std::thread> workers;
+
+   /// The main loop of a worker thread.
+   void work(const uint32_t threadId);
+
+   /// Executes a single work-group (or waits for the dependencies of a
+   /// barrier packet) and completes the packet if it was the last one.
+   void execute(Packet& packet, const uint64_t packetId, const uint64_t groupId);
+
+   /// Waits (spins, then blocks) until the state of the queue changes.
+   void idle(const uint64_t packetId, const bool published, uint32_t& idleRounds);
+
+   void notifyWorkers();
+};
+
+}
+}
@@ -0,0 +1,72 @@
+#include <rts/hsa/HsaOccupancy.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <algorithm>
+
+namespace rts {
+namespace hsa {
+
+HsaOccupancy::HsaOccupancy(const AgentProperties& agent) :
+      agent(agent) {
+   if (agent.numComputeUnits == 0 || agent.wavefrontSize == 0 || agent.maxWavefrontsPerComputeUnit == 0
+         || agent.maxWorkgroupSize == 0) {
+      throw HsaException("Invalid agent properties.");
+   }
+}
+
+uint32_t HsaOccupancy::getNumResidentWorkgroups(const KernelDescriptor& kernel, const uint32_t workgroupSize) const {
+   if (workgroupSize == 0 || workgroupSize > agent.maxWorkgroupSize) return 0;
+
+   // Wavefront slots.
+   uint64_t numWorkgroups = agent.maxWavefrontsPerComputeUnit / getNumWavefronts(workgroupSize);
+   // Work-group slots.
+   if (agent.maxWorkgroupsPerComputeUnit != 0) {
+      numWorkgroups = std::min<uint64_t>(numWorkgroups, agent.maxWorkgroupsPerComputeUnit);
+   }
+   // Group memory, which is allocated per work-group.
+   if (agent.groupSegmentSize != 0 && kernel.groupSegmentSize != 0) {
+      numWorkgroups = std::min<uint64_t>(numWorkgroups, agent.groupSegmentSize / kernel.groupSegmentSize);
+   }
+   // Private memory, which is allocated per work-item.
+   if (agent.privateSegmentSize != 0 && kernel.privateSegmentSize != 0) {
+      numWorkgroups = std::min<uint64_t>(numWorkgroups,
+            agent.privateSegmentSize / (uint64_t(kernel.privateSegmentSize) * workgroupSize));
+   }
+   return static_cast<uint32_t>(numWorkgroups);
+}
+
+double HsaOccupancy::getOccupancy(const KernelDescriptor& kernel, const uint32_t workgroupSize) const {
+   const uint64_t numWavefronts = uint64_t(getNumResidentWorkgroups(kernel, workgroupSize)) * getNumWavefronts(workgroupSize);
+   return double(numWavefronts) / agent.maxWavefrontsPerComputeUnit;
+}
+
+uint16_t HsaOccupancy::recommendWorkgroupSize(const KernelDescriptor& kernel, const uint64_t numElements) const {
+   const uint32_t maxWorkgroupSize = std::min<uint32_t>(agent.maxWorkgroupSize, UINT16_MAX);
+   const uint32_t minWorkgroupSize = std::min(agent.wavefrontSize, maxWorkgroupSize);
+   // An empty grid does not occupy anything.
+   if (numElements == 0) return static_cast<uint16_t>(minWorkgroupSize);
+
+   uint32_t best = minWorkgroupSize;
+   uint64_t bestNumWavefronts = 0;
+   for (uint64_t workgroupSize = minWorkgroupSize; workgroupSize <= maxWorkgroupSize; workgroupSize <<= 1) {
+      const uint32_t numResident = getNumResidentWorkgroups(kernel, workgroupSize);
+      // Too few work-groups to occupy all compute units. Larger work-groups
+      // would only leave more compute units idle.
+      const uint64_t numWorkgroups = (numElements - 1) / workgroupSize + 1;
+      if (workgroupSize > minWorkgroupSize && numWorkgroups < uint64_t(numResident) * agent.numComputeUnits) break;
+
+      const uint64_t numWavefronts = uint64_t(numResident) * getNumWavefronts(workgroupSize);
+      if (numWavefronts >= bestNumWavefronts && numResident != 0) {
+         best = workgroupSize;
+         bestNumWavefronts = numWavefronts;
+      }
+   }
+   return static_cast<uint16_t>(best);
+}
+
+uint64_t HsaOccupancy::recommendGridSize(const KernelDescriptor& kernel, const uint32_t workgroupSize) const {
+   const uint64_t numResident = std::max(1u, getNumResidentWorkgroups(kernel, workgroupSize));
+   return numResident * agent.numComputeUnits * workgroupSize;
+}
+
+}
+}
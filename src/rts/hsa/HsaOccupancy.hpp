@@ -0,0 +1,58 @@
+#pragma once
+
+#include <rts/hsa/HsaAgent.hpp>
+#include <cstdint>
+
+namespace rts {
+namespace hsa {
+
+/// An analytic occupancy model. The number of work-groups a compute unit runs
+/// concurrently is limited by its wavefront slots, its work-group slots, its
+/// group memory and its private memory. The model derives launch parameters
+/// that keep all compute units busy, without running the kernel (see
+/// HsaAutotuner for the empirical alternative).
+///
+/// The agent properties are plain values, thus the model can be evaluated
+/// for synthetic agents.
+class HsaOccupancy {
+public:
+   typedef HsaAgent::KernelDescriptor KernelDescriptor;
+
+   typedef HsaAgent::Properties AgentProperties;
+
+   /// C'tor, throws if the properties are inconsistent (e.g., no compute units).
+   explicit HsaOccupancy(const AgentProperties& agent);
+
+   const AgentProperties& getAgentProperties() const {
+      return agent;
+   }
+
+   /// The number of work-groups of the given size a compute unit runs
+   /// concurrently. Zero if a single work-group does not fit.
+   uint32_t getNumResidentWorkgroups(const KernelDescriptor& kernel, const uint32_t workgroupSize) const;
+
+   /// The fraction of the wavefront slots of a compute unit that are occupied.
+   double getOccupancy(const KernelDescriptor& kernel, const uint32_t workgroupSize) const;
+
+   /// The largest work-group size that achieves the maximum occupancy. The
+   /// candidates are power-of-two multiples of the wavefront size. If the
+   /// grid size is given, candidates that yield less than one work-group per
+   /// resident slot on every compute unit are skipped (as long as there are
+   /// smaller candidates). An empty grid yields the smallest candidate.
+   uint16_t recommendWorkgroupSize(const KernelDescriptor& kernel, const uint64_t numElements = UINT64_MAX) const;
+
+   /// The total number of work-items of a grid-stride loop kernel (e.g.,
+   /// sumLoop), such that every resident work-group slot of every compute
+   /// unit is occupied.
+   uint64_t recommendGridSize(const KernelDescriptor& kernel, const uint32_t workgroupSize) const;
+
+private:
+   const AgentProperties agent;
+
+   inline uint32_t getNumWavefronts(const uint32_t workgroupSize) const {
+      return (workgroupSize + agent.wavefrontSize - 1) / agent.wavefrontSize;
+   }
+};
+
+}
+}
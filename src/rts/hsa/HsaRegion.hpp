@@ -0,0 +1,33 @@
+#pragma once
+
+#include <hsa.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace rts {
+namespace hsa {
+
+/// A global memory region of an agent and its properties (see
+/// HsaUtils::determineGlobalRegions).
+struct HsaRegion {
+   hsa_region_t region;
+
+   /// Fine-grained memory is coherent between the agents at any time,
+   /// coarse-grained memory only at dispatch boundaries. The kernel
+   /// arguments are passed in a kernarg region.
+   bool fineGrained;
+   bool coarseGrained;
+   bool kernarg;
+
+   /// The total size of the region.
+   std::size_t size;
+
+   /// Whether hsa_memory_allocate may allocate in the region, and its limits.
+   bool allocAllowed;
+   std::size_t allocMaxSize;
+   std::size_t allocGranule;
+   std::size_t allocAlignment;
+};
+
+}
+}
@@ -0,0 +1,150 @@
+#include <rts/hsa/HsaRegistrationCache.hpp>
+#include <rts/hsa/HsaUtils.hpp>
+#include <utils/Utils.hpp>
+#include <hsa.h>
+#include <algorithm>
+#include <iterator>
+
+namespace rts {
+namespace hsa {
+
+namespace {
+
+/// 16 GiB
+constexpr std::size_t defaultMaxRegisteredBytes = std::size_t(16) << 30;
+
+void invalidateFreedMemory(void* ptr, size_t size) {
+   HsaRegistrationCache::getInstance().invalidate(ptr, size);
+}
+
+}
+
+HsaRegistrationCache::HsaRegistrationCache() :
+      maxRegisteredBytes(defaultMaxRegisteredBytes), stats() {
+   Utils::freeHugeHook().store(&invalidateFreedMemory);
+}
+
+HsaRegistrationCache& HsaRegistrationCache::getInstance() {
+   static HsaRegistrationCache cache;
+   return cache;
+}
+
+void HsaRegistrationCache::acquire(const void* ptr, const std::size_t size) {
+   if (size == 0) return;
+   uintptr_t begin = reinterpret_cast<uintptr_t>(ptr);
+   uintptr_t end = begin + size;
+   std::lock_guard<std::mutex> lock(mutex);
+
+   // The range that begins at or before `begin` (if any) may cover it.
+   auto range = ranges.upper_bound(begin);
+   if (range != ranges.begin()) {
+      auto previous = std::prev(range);
+      if (previous->second.end >= end) {
+         previous->second.numUsers++;
+         lru.splice(lru.begin(), lru, previous->second.lru);
+         stats.numHits++;
+         return;
+      }
+      if (previous->second.end > begin) {
+         range = previous;
+      }
+   }
+   stats.numMisses++;
+
+   // Merge the overlapping ranges into a single registration, which takes
+   // over their users.
+   const auto first = range;
+   std::size_t numUsers = 1;
+   for (; range != ranges.end() && range->first < end; range++) {
+      begin = std::min(begin, range->first);
+      end = std::max(end, range->second.end);
+      numUsers += range->second.numUsers;
+   }
+   // The merged range is registered before the overlapping ones are
+   // unregistered, as kernels in flight may access them.
+   HsaUtils::apiCall([&] {
+      return hsa_memory_register(reinterpret_cast<void*>(begin), end - begin);
+   });
+   for (auto overlapping = first; overlapping != range;) {
+      overlapping = unregister(overlapping);
+   }
+   lru.push_front(begin);
+   ranges.emplace(begin, Range { end, numUsers, lru.begin() });
+   stats.numRanges++;
+   stats.registeredBytes += end - begin;
+   evict();
+}
+
+void HsaRegistrationCache::release(const void* ptr, const std::size_t size) {
+   if (size == 0) return;
+   const uintptr_t begin = reinterpret_cast<uintptr_t>(ptr);
+   std::lock_guard<std::mutex> lock(mutex);
+   auto range = ranges.upper_bound(begin);
+   if (range == ranges.begin()) return;
+   range--;
+   // The range is gone if the memory has been invalidated in the meantime.
+   if (range->second.end < begin + size || range->second.numUsers == 0) return;
+   if (--range->second.numUsers == 0) {
+      evict();
+   }
+}
+
+void HsaRegistrationCache::invalidate(const void* ptr, const std::size_t size) {
+   const uintptr_t begin = reinterpret_cast<uintptr_t>(ptr);
+   const uintptr_t end = begin + size;
+   std::lock_guard<std::mutex> lock(mutex);
+   auto range = ranges.upper_bound(begin);
+   if (range != ranges.begin() && std::prev(range)->second.end > begin) {
+      range--;
+   }
+   while (range != ranges.end() && range->first < end) {
+      range = unregister(range);
+   }
+}
+
+void HsaRegistrationCache::clear() {
+   std::lock_guard<std::mutex> lock(mutex);
+   auto range = ranges.begin();
+   while (range != ranges.end()) {
+      range = unregister(range);
+   }
+}
+
+void HsaRegistrationCache::setMaxRegisteredBytes(const std::size_t bytes) {
+   std::lock_guard<std::mutex> lock(mutex);
+   maxRegisteredBytes = bytes;
+   evict();
+}
+
+HsaRegistrationCache::Stats HsaRegistrationCache::getStats() {
+   std::lock_guard<std::mutex> lock(mutex);
+   return stats;
+}
+
+std::map<uintptr_t, HsaRegistrationCache::Range>::iterator HsaRegistrationCache::unregister(
+      std::map<uintptr_t, Range>::iterator range) {
+   // The registrations are gone along with the runtime.
+   if (HsaUtils::isInitialized()) {
+      hsa_memory_deregister(reinterpret_cast<void*>(range->first), range->second.end - range->first);
+   }
+   stats.numRanges--;
+   stats.registeredBytes -= range->second.end - range->first;
+   lru.erase(range->second.lru);
+   return ranges.erase(range);
+}
+
+void HsaRegistrationCache::evict() {
+   auto position = lru.end();
+   while (stats.registeredBytes > maxRegisteredBytes && position != lru.begin()) {
+      const auto range = ranges.find(*std::prev(position));
+      if (range->second.numUsers != 0) {
+         position--;
+         continue;
+      }
+      unregister(range);
+      stats.numEvictions++;
+   }
+}
+
+}
+}
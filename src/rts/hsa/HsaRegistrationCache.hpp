@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+
+namespace rts {
+namespace hsa {
+
+/// Caches the registrations of host memory with the HSA runtime
+/// (hsa_memory_register), so that a buffer that is passed to kernels over and
+/// over again (e.g., a column) is registered only once. HsaContext acquires
+/// the buffers that are passed as HsaHostBuffer and releases them once the
+/// kernel has completed.
+///
+/// The registered ranges are keyed by their address. A range that overlaps
+/// registered ranges is merged with them into a single registration; ranges
+/// that merely touch remain separate. The registered bytes are bounded: the
+/// least recently used ranges are unregistered first. Ranges that are in use
+/// (acquired, but not released yet) are never unregistered to stay within the
+/// bound, thus the bound is exceeded while they do not fit. The registration
+/// of memory that is freed via Utils::freeHuge is undone automatically; memory
+/// that is freed otherwise must be invalidated explicitly.
+///
+/// The registrations are process-wide, thus there is a single cache. It is
+/// thread-safe and cleared when an HsaRuntime is shut down.
+class HsaRegistrationCache {
+public:
+   struct Stats {
+      uint64_t numHits;
+      uint64_t numMisses;
+      /// The number of ranges that were unregistered to stay within the bound.
+      uint64_t numEvictions;
+      std::size_t numRanges;
+      std::size_t registeredBytes;
+   };
+
+   /// The cache of the process.
+   static HsaRegistrationCache& getInstance();
+
+   HsaRegistrationCache(const HsaRegistrationCache&) = delete;
+   HsaRegistrationCache& operator=(const HsaRegistrationCache&) = delete;
+
+   /// Registers [ptr, ptr + size), unless a registered range covers it, and
+   /// marks it in use until it is released. Throws if the runtime fails to
+   /// register the memory.
+   void acquire(const void* ptr, const std::size_t size);
+
+   /// Releases a range that has been acquired, e.g., once the kernel that
+   /// accesses it has completed.
+   void release(const void* ptr, const std::size_t size);
+
+   /// Unregisters all ranges that overlap [ptr, ptr + size), e.g., because
+   /// the memory is about to be freed (even if they are in use).
+   void invalidate(const void* ptr, const std::size_t size);
+
+   /// Unregisters all ranges.
+   void clear();
+
+   /// Bounds the registered bytes (16 GiB by default).
+   void setMaxRegisteredBytes(const std::size_t bytes);
+
+   Stats getStats();
+
+private:
+   struct Range {
+      uintptr_t end;
+      /// The number of acquisitions that have not been released yet.
+      std::size_t numUsers;
+      /// The position in the LRU list.
+      std::list<uintptr_t>::iterator lru;
+   };
+
+   std::mutex mutex;
+
+   /// The registered ranges by their begin address.
+   std::map<uintptr_t, Range> ranges;
+
+   /// The begin addresses of the ranges, the most recently used first.
+   std::list<uintptr_t> lru;
+
+   std::size_t maxRegisteredBytes;
+
+   Stats stats;
+
+   HsaRegistrationCache();
+
+   /// Unregisters a range and returns the iterator to the next one.
+   std::map<uintptr_t, Range>::iterator unregister(std::map<uintptr_t, Range>::iterator range);
+
+   /// Unregisters the least recently used ranges that are not in use until
+   /// the bound is met.
+   void evict();
+};
+
+}
+}
@@ -6,6 +6,7 @@
  */
 
 #include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaRegistrationCache.hpp>
 #include <rts/hsa/HsaRuntime.hpp>
 #include <rts/hsa/HsaUtils.hpp>
 #include <hsa.h>
@@ -46,6 +47,8 @@ void HsaRuntime::initialize() {
 }
 
 void HsaRuntime::shutDown() {
+   // Undo the registrations of host memory while the runtime is alive.
+   HsaRegistrationCache::getInstance().clear();
    hsa_status_t status;
    status = hsa_shut_down();
    HsaUtils::checkStatus(status);
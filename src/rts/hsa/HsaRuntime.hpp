@@ -5,10 +5,10 @@
 namespace rts {
 namespace hsa {
 
-class HsaContext;
+class HsaAqlAgent;
 
 class HsaRuntime {
-   friend HsaContext;
+   friend HsaAqlAgent;
 
 private:
    /// The dispatch agent (typically the CPU)
@@ -0,0 +1,133 @@
+#include <rts/hsa/HsaSignalPool.hpp>
+#include <rts/hsa/HsaException.hpp>
+
+namespace rts {
+namespace hsa {
+
+constexpr uint32_t HsaSignalPool::maxChunks;
+
+static inline uint32_t log2Ceil(const uint32_t value) {
+   uint32_t log = 0;
+   while ((1u << log) < value) log++;
+   return log;
+}
+
+HsaSignalPool::HsaSignalPool(HsaAgent& agent, const uint32_t chunkSize) :
+      agent(agent), chunkShift(log2Ceil(chunkSize == 0 ? 1 : chunkSize)), chunkMask((1u << chunkShift) - 1),
+            head(0), numChunks(0), numInUse(0), peakInUse(0) {
+   for (uint32_t i = 0; i < maxChunks; i++) {
+      chunks[i].store(nullptr, std::memory_order_relaxed);
+   }
+   // Pre-allocate the first chunk.
+   push(grow());
+}
+
+HsaSignalPool::~HsaSignalPool() {
+   const uint32_t n = numChunks.load();
+   for (uint32_t i = 0; i < n; i++) {
+      delete[] chunks[i].load();
+   }
+}
+
+HsaSignalPool::Slot HsaSignalPool::acquire() {
+   Slot slot;
+   if (!pop(slot)) {
+      slot = grow();
+   }
+   getNode(slot).refCount.store(1, std::memory_order_relaxed);
+   recordAcquire();
+   return slot;
+}
+
+void HsaSignalPool::release(const Slot slot) {
+   if (getNode(slot).refCount.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+   agent.storeSignal(getSignal(slot), 1);
+   numInUse.fetch_sub(1, std::memory_order_relaxed);
+   push(slot);
+}
+
+HsaSignalPool::Stats HsaSignalPool::getStats() const {
+   Stats stats;
+   stats.numGrowths = numChunks.load() - 1;
+   stats.capacity = numChunks.load() << chunkShift;
+   stats.numInUse = numInUse.load();
+   stats.peakInUse = peakInUse.load();
+   return stats;
+}
+
+void HsaSignalPool::destroySignals() {
+   const uint32_t n = numChunks.load();
+   for (uint32_t i = 0; i < n; i++) {
+      Node* chunk = chunks[i].load();
+      for (uint32_t j = 0; j <= chunkMask; j++) {
+         agent.destroySignal(chunk[j].signal);
+      }
+   }
+}
+
+bool HsaSignalPool::pop(Slot& slot) {
+   uint64_t h = head.load(std::memory_order_acquire);
+   while (true) {
+      const uint32_t top = static_cast<uint32_t>(h);
+      if (top == 0) return false;
+      // The node might be popped (and pushed) concurrently, in which case the
+      // tag has changed and the CAS fails.
+      const uint32_t next = getNode(top - 1).next.load(std::memory_order_relaxed);
+      const uint64_t tag = (h >> 32) + 1;
+      if (head.compare_exchange_weak(h, (tag << 32) | next, std::memory_order_acq_rel)) {
+         slot = top - 1;
+         return true;
+      }
+   }
+}
+
+void HsaSignalPool::push(const Slot slot) {
+   Node& node = getNode(slot);
+   uint64_t h = head.load(std::memory_order_relaxed);
+   while (true) {
+      node.next.store(static_cast<uint32_t>(h), std::memory_order_relaxed);
+      const uint64_t tag = (h >> 32) + 1;
+      if (head.compare_exchange_weak(h, (tag << 32) | (slot + 1), std::memory_order_acq_rel)) {
+         return;
+      }
+   }
+}
+
+HsaSignalPool::Slot HsaSignalPool::grow() {
+   std::lock_guard<std::mutex> lock(growMutex);
+   // Another thread might have grown the pool in the meantime.
+   Slot slot;
+   if (numChunks.load() != 0 && pop(slot)) {
+      return slot;
+   }
+   const uint32_t chunkId = numChunks.load();
+   if (chunkId == maxChunks || (static_cast<uint64_t>(chunkId + 1) << chunkShift) > UINT32_MAX) {
+      throw HsaException("Signal pool exhausted.");
+   }
+   const uint32_t chunkSize = chunkMask + 1;
+   Node* chunk = new Node[chunkSize];
+   for (uint32_t i = 0; i < chunkSize; i++) {
+      chunk[i].signal = agent.createSignal(1);
+      chunk[i].next.store(0, std::memory_order_relaxed);
+      chunk[i].refCount.store(0, std::memory_order_relaxed);
+   }
+   chunks[chunkId].store(chunk, std::memory_order_release);
+   numChunks.store(chunkId + 1);
+
+   // Keep the first signal, make the others available.
+   const Slot first = chunkId << chunkShift;
+   for (uint32_t i = chunkSize - 1; i > 0; i--) {
+      push(first + i);
+   }
+   return first;
+}
+
+void HsaSignalPool::recordAcquire() {
+   const uint32_t inUse = numInUse.fetch_add(1, std::memory_order_relaxed) + 1;
+   uint32_t peak = peakInUse.load(std::memory_order_relaxed);
+   while (inUse > peak && !peakInUse.compare_exchange_weak(peak, inUse, std::memory_order_relaxed)) {
+   }
+}
+
+}
+}
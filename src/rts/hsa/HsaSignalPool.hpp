@@ -0,0 +1,114 @@
+#pragma once
+
+#include <rts/hsa/HsaAgent.hpp>
+#include <atomic>
+#include <cstdint>
+#include <hsa.h>
+#include <mutex>
+
+namespace rts {
+namespace hsa {
+
+/// A pool of completion signals, which avoids creating and destroying a
+/// signal per dispatch. Signals are handed out with a value of one and are
+/// reset to one when they are released. A signal that is referenced by a
+/// pending barrier packet is retained, so that it is not reused before the
+/// barrier has completed.
+///
+/// The free signals form a lock-free stack (the head is tagged to prevent
+/// ABA). The signals are allocated in chunks, which are never freed while the
+/// pool exists. Thus, the stack nodes can be read without synchronization.
+/// If the stack is empty, the pool grows by one chunk (the only operation
+/// that takes a lock).
+class HsaSignalPool {
+public:
+   /// Identifies a signal of the pool.
+   typedef uint32_t Slot;
+
+   struct Stats {
+      /// The number of signals created.
+      uint32_t capacity;
+      /// The number of signals that are currently acquired.
+      uint32_t numInUse;
+      /// The maximum number of signals that were acquired at the same time.
+      uint32_t peakInUse;
+      /// The number of times the pool has grown.
+      uint32_t numGrowths;
+   };
+
+   /// C'tor, creates `chunkSize` signals. The pool grows by the same amount
+   /// (rounded up to a power of two).
+   explicit HsaSignalPool(HsaAgent& agent, const uint32_t chunkSize = 64);
+
+   /// D'tor, does not destroy the signals (see destroySignals).
+   ~HsaSignalPool();
+
+   HsaSignalPool(const HsaSignalPool&) = delete;
+   HsaSignalPool& operator=(const HsaSignalPool&) = delete;
+
+   /// Returns a signal with a value of one.
+   Slot acquire();
+
+   /// Adds a reference to an acquired signal. The signal returns to the pool
+   /// once it has been released as often as it has been acquired and retained.
+   inline void retain(const Slot slot) {
+      getNode(slot).refCount.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   /// Drops a reference. The last one resets the signal to one and returns it
+   /// to the pool.
+   void release(const Slot slot);
+
+   inline hsa_signal_t getSignal(const Slot slot) const {
+      return getNode(slot).signal;
+   }
+
+   Stats getStats() const;
+
+   /// Destroys all signals. Must be called before the agent (or the HSA
+   /// runtime) is shut down. The pool must not be used afterwards.
+   void destroySignals();
+
+private:
+   struct Node {
+      hsa_signal_t signal;
+      /// The next free slot plus one (zero terminates the stack).
+      std::atomic<uint32_t> next;
+      /// The number of references of an acquired signal.
+      std::atomic<uint32_t> refCount;
+   };
+
+   static constexpr uint32_t maxChunks = 1024;
+
+   HsaAgent& agent;
+   const uint32_t chunkShift;
+   const uint32_t chunkMask;
+
+   /// The lower 32 bits contain the top slot plus one, the upper 32 bits a
+   /// tag that is incremented by each update.
+   alignas(64) std::atomic<uint64_t> head;
+
+   alignas(64) std::atomic<Node*> chunks[maxChunks];
+   std::atomic<uint32_t> numChunks;
+   std::mutex growMutex;
+
+   std::atomic<uint32_t> numInUse;
+   std::atomic<uint32_t> peakInUse;
+
+   inline Node& getNode(const Slot slot) const {
+      return chunks[slot >> chunkShift].load(std::memory_order_acquire)[slot & chunkMask];
+   }
+
+   /// Pops a slot, returns false if the stack is empty.
+   bool pop(Slot& slot);
+
+   void push(const Slot slot);
+
+   /// Adds a chunk and returns one of its slots (the others are pushed).
+   Slot grow();
+
+   void recordAcquire();
+};
+
+}
+}
@@ -0,0 +1,97 @@
+#include <rts/hsa/HsaSoftAqlAgent.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <utils/Utils.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+namespace rts {
+namespace hsa {
+
+HsaSoftAqlAgent::HsaSoftAqlAgent(const uint32_t numThreads) :
+      numThreads(numThreads == 0 ? Utils::numProcessors() : numThreads) {
+}
+
+HsaSoftAqlAgent::~HsaSoftAqlAgent() {
+   // Stop the workers before the argument memory is released.
+   processor.reset();
+   queue = nullptr;
+   free(argumentMemoryPtr);
+   argumentMemoryPtr = nullptr;
+}
+
+HsaAgent::KernelDescriptor HsaSoftAqlAgent::registerKernel(const HsaHostKernel& kernel) {
+   if (processor != nullptr) {
+      throw HsaException("Kernels have to be registered before the queue is created.");
+   }
+   return kernels.registerKernel(kernel);
+}
+
+void HsaSoftAqlAgent::addModule(const char* /* brigModulePtr */) {
+   throw HsaException("The software AQL agent does not support BRIG modules. Use registerKernel() instead.");
+}
+
+void HsaSoftAqlAgent::finalize() {
+   // Nothing to do. Host kernels are ready to run.
+}
+
+void HsaSoftAqlAgent::createQueue(const uint32_t preferredQueueSize) {
+   if (processor != nullptr) {
+      throw HsaException("Queue already created.");
+   }
+
+   const uint32_t queueSize = roundQueueSize(preferredQueueSize);
+   processor.reset(new HsaAqlPacketProcessor(queueSize, numThreads));
+   queue = processor->getQueue();
+
+   // (Pre-)Allocate memory for kernel arguments.
+   kernargs = HsaKernargSlab(kernels.getArgumentSegmentSizes(), queueSize);
+   if (posix_memalign(&argumentMemoryPtr, HsaKernargSlab::alignment, kernargs.getSize()) != 0) {
+      throw std::bad_alloc();
+   }
+   kernargs.bind(argumentMemoryPtr);
+
+   initializePackets();
+}
+
+HsaAgent::KernelDescriptor HsaSoftAqlAgent::getKernelObject(const char* kernelSymbolName) {
+   return kernels.getKernelObject(kernelSymbolName);
+}
+
+const char* HsaSoftAqlAgent::getKernelSymbolName(const uint64_t kernelObject) {
+   return kernels.getKernelSymbolName(kernelObject);
+}
+
+std::string HsaSoftAqlAgent::getIsaName() {
+   return "soft-aql:" + std::to_string(numThreads);
+}
+
+HsaAgent::Properties HsaSoftAqlAgent::getProperties() {
+   // Like the native agent, a worker executes one work-group at a time.
+   Properties properties;
+   properties.numComputeUnits = numThreads;
+   properties.wavefrontSize = 1;
+   properties.maxWavefrontsPerComputeUnit = getMaxWorkgroupSize();
+   properties.maxWorkgroupsPerComputeUnit = 1;
+   properties.maxWorkgroupSize = getMaxWorkgroupSize();
+   properties.groupSegmentSize = 0;
+   properties.privateSegmentSize = 0;
+   return properties;
+}
+
+void* HsaSoftAqlAgent::allocateArgumentMemory(const std::size_t size) {
+   void* ptr;
+   if (posix_memalign(&ptr, 64, size) != 0) {
+      throw std::bad_alloc();
+   }
+   return ptr;
+}
+
+void HsaSoftAqlAgent::freeArgumentMemory(void* ptr) {
+   free(ptr);
+}
+
+}
+}
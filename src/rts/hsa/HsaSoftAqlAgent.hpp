@@ -0,0 +1,120 @@
+#pragma once
+
+#include <rts/hsa/HsaAqlAgent.hpp>
+#include <rts/hsa/HsaAqlPacketProcessor.hpp>
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaHostSignal.hpp>
+#include <hsa.h>
+#include <memory>
+#include <string>
+
+namespace rts {
+namespace hsa {
+
+/// An AQL agent that does not require a kernel agent. Packets and kernel
+/// arguments are written exactly like for the HsaAqlAgent, but the queue is
+/// processed in software (see HsaAqlPacketProcessor) and the kernels are host
+/// kernels. Thus the complete dispatch path (argument writes, packet writes,
+/// header publication and doorbell) runs, and can be profiled, on systems
+/// without a GPU.
+class HsaSoftAqlAgent : public HsaAqlAgent {
+public:
+   /// C'tor. If `numThreads` is 0, one worker per processor is started.
+   explicit HsaSoftAqlAgent(const uint32_t numThreads = 0);
+
+   /// D'tor
+   virtual ~HsaSoftAqlAgent();
+
+   /// Registers a host kernel. Kernels have to be registered before the
+   /// queue is created.
+   KernelDescriptor registerKernel(const HsaHostKernel& kernel);
+
+   uint32_t getNumThreads() const {
+      return numThreads;
+   }
+
+   /// BRIG modules are not supported (throws).
+   void addModule(const char* brigModulePtr) override;
+
+   void finalize() override;
+
+   using HsaAgent::createQueue;
+
+   void createQueue(const uint32_t queueSize) override;
+
+   using HsaAgent::getKernelObject;
+
+   KernelDescriptor getKernelObject(const char* kernelSymbolName) override;
+
+   const char* getKernelSymbolName(const uint64_t kernelObject) override;
+
+   std::string getIsaName() override;
+
+   Properties getProperties() override;
+
+   void* allocateArgumentMemory(const std::size_t size) override;
+
+   void freeArgumentMemory(void* ptr) override;
+
+   /// The host kernels access any memory.
+   bool requiresMemoryRegistration() override {
+      return false;
+   }
+
+   inline hsa_signal_t createSignal(const hsa_signal_value_t initialValue) override {
+      return HsaHostSignal::create(initialValue);
+   }
+
+   inline void destroySignal(const hsa_signal_t signal) override {
+      HsaHostSignal::destroy(signal);
+   }
+
+   inline hsa_signal_value_t loadSignal(const hsa_signal_t signal) override {
+      return HsaHostSignal::load(signal);
+   }
+
+   inline void storeSignal(const hsa_signal_t signal, const hsa_signal_value_t value) override {
+      HsaHostSignal::store(signal, value);
+   }
+
+   inline void addSignal(const hsa_signal_t signal, const hsa_signal_value_t value) override {
+      HsaHostSignal::add(signal, value);
+   }
+
+   inline hsa_signal_value_t waitSignal(const hsa_signal_t signal,
+         const hsa_signal_condition_t condition, const hsa_signal_value_t compareValue,
+         const uint64_t timeoutHint, const hsa_wait_state_t waitStateHint) override {
+      return HsaHostSignal::wait(signal, condition, compareValue, timeoutHint, waitStateHint);
+   }
+
+protected:
+   inline uint64_t queueAddWriteIndex(const uint64_t value) override {
+      return processor->addWriteIndex(value);
+   }
+
+   inline uint64_t queueLoadWriteIndex() override {
+      return processor->loadWriteIndex();
+   }
+
+   inline uint64_t queueCasWriteIndex(const uint64_t expected, const uint64_t value) override {
+      return processor->casWriteIndex(expected, value);
+   }
+
+   inline uint64_t queueLoadReadIndex() override {
+      return processor->loadReadIndex();
+   }
+
+   inline void queueStoreDoorbell(const uint64_t packetId) override {
+      processor->ringDoorbell(packetId);
+   }
+
+private:
+   const uint32_t numThreads;
+
+   HsaHostKernelRegistry kernels;
+
+   std::unique_ptr<HsaAqlPacketProcessor> processor;
+};
+
+}
+}
@@ -0,0 +1,119 @@
+#include <rts/hsa/HsaTaskGraph.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <algorithm>
+
+namespace rts {
+namespace hsa {
+
+void HsaTaskGraph::addDependency(const NodeId node, const NodeId dependency) {
+   if (node >= nodes.size() || dependency >= nodes.size()) {
+      throw HsaException("Unknown task graph node.");
+   }
+   if (node == dependency) {
+      throw HsaException("A task graph node cannot depend on itself.");
+   }
+   auto& dependencies = nodes[node].dependencies;
+   if (std::find(dependencies.begin(), dependencies.end(), dependency) == dependencies.end()) {
+      dependencies.push_back(dependency);
+   }
+}
+
+std::vector<HsaTaskGraph::NodeId> HsaTaskGraph::getTopologicalOrder() const {
+   // Kahn's algorithm, independent nodes keep the order they were added in.
+   std::vector<uint32_t> numPending(nodes.size());
+   std::vector<std::vector<NodeId>> successors(nodes.size());
+   for (NodeId id = 0; id < nodes.size(); id++) {
+      numPending[id] = static_cast<uint32_t>(nodes[id].dependencies.size());
+      for (const NodeId dependency : nodes[id].dependencies) {
+         successors[dependency].push_back(id);
+      }
+   }
+   std::vector<NodeId> order;
+   order.reserve(nodes.size());
+   for (NodeId id = 0; id < nodes.size(); id++) {
+      if (numPending[id] == 0) order.push_back(id);
+   }
+   for (std::size_t i = 0; i < order.size(); i++) {
+      for (const NodeId successor : successors[order[i]]) {
+         if (--numPending[successor] == 0) order.push_back(successor);
+      }
+   }
+   if (order.size() != nodes.size()) {
+      throw HsaException("The task graph has a cycle.");
+   }
+   return order;
+}
+
+HsaTaskGraphExecutor::HsaTaskGraphExecutor(const HsaTaskGraph& graph, const std::vector<HsaContext*>& contexts,
+      const EdgeMode mode) :
+      graph(graph), contexts(contexts), mode(mode), order(graph.getTopologicalOrder()), queueIndexes(graph.size()),
+      successors(graph.size()), futures(graph.size()), dependencies(graph.size()), numPending(graph.size()),
+      timings(graph.size()), duration(0) {
+   if (contexts.empty()) {
+      throw HsaException("A task graph executor requires at least one context.");
+   }
+
+   // The depth of a node is the length of the longest path from a node
+   // without dependencies. Nodes of the same depth are independent of each
+   // other, thus they are spread across the queues.
+   std::vector<uint32_t> depths(graph.size(), 0);
+   std::vector<uint32_t> numNodesPerDepth;
+   for (const NodeId id : order) {
+      for (const NodeId dependency : graph.getNode(id).dependencies) {
+         depths[id] = std::max(depths[id], depths[dependency] + 1);
+         successors[dependency].push_back(id);
+      }
+      if (depths[id] >= numNodesPerDepth.size()) numNodesPerDepth.resize(depths[id] + 1, 0);
+      queueIndexes[id] = numNodesPerDepth[depths[id]]++ % contexts.size();
+   }
+
+   kernels.reserve(graph.size());
+   for (NodeId id = 0; id < graph.size(); id++) {
+      kernels.push_back(contexts[queueIndexes[id]]->getKernelObject(graph.getNode(id).kernelSymbolName));
+      if (mode == EdgeMode::BarrierPackets) {
+         // The futures are reassigned by every run, but never reallocated.
+         for (const NodeId dependency : graph.getNode(id).dependencies) {
+            dependencies[id].push_back(std::cref(futures[dependency]));
+         }
+      }
+   }
+}
+
+void HsaTaskGraphExecutor::run() {
+   static const HsaContext::Dependencies none;
+   start = std::chrono::steady_clock::now();
+
+   std::size_t numCompleted = 0;
+   if (mode == EdgeMode::BarrierPackets) {
+      for (const NodeId id : order) {
+         submit(id, dependencies[id]);
+      }
+   } else {
+      for (NodeId id = 0; id < graph.size(); id++) {
+         numPending[id] = static_cast<uint32_t>(graph.getNode(id).dependencies.size());
+      }
+      for (const NodeId id : order) {
+         if (numPending[id] == 0) submit(id, none);
+      }
+   }
+
+   while (numCompleted < graph.size()) {
+      const std::size_t id = HsaFuture::waitAny(futures);
+      timings[id].completed = elapsed();
+      numCompleted++;
+      if (mode == EdgeMode::HostTracking) {
+         for (const NodeId successor : successors[id]) {
+            if (--numPending[successor] == 0) submit(successor, none);
+         }
+      }
+   }
+   duration = elapsed();
+}
+
+void HsaTaskGraphExecutor::submit(const NodeId id, const HsaContext::Dependencies& nodeDependencies) {
+   futures[id] = graph.getNode(id).launch(*contexts[queueIndexes[id]], kernels[id], nodeDependencies);
+   timings[id].submitted = elapsed();
+}
+
+}
+}
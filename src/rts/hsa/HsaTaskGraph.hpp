@@ -0,0 +1,164 @@
+#pragma once
+
+#include <rts/hsa/HsaAgent.hpp>
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaFuture.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+
+/// A pipeline of kernel dispatches (nodes) and their dependencies (edges). The
+/// graph is built once and executed many times (see HsaTaskGraphExecutor).
+///
+/// Kernels are referenced by their symbol names, which are resolved by the
+/// executor. Thus the same graph runs on any agent that provides the kernels,
+/// e.g., on the host kernels of a HsaNativeAgent instead of the GPU.
+class HsaTaskGraph {
+public:
+   typedef uint32_t NodeId;
+
+   typedef HsaAgent::KernelDescriptor KernelDescriptor;
+
+   typedef HsaAgent::KernelLaunchParameters KernelLaunchParameters;
+
+   /// Dispatches the kernel of a node after the given dependencies (see
+   /// HsaContext::dispatchAfter).
+   typedef std::function<HsaFuture(HsaContext&, const KernelDescriptor&, const HsaContext::Dependencies&)> Launcher;
+
+   struct Node {
+      std::string name;
+      std::string kernelSymbolName;
+      Launcher launch;
+      /// The nodes that have to complete before this one starts.
+      std::vector<NodeId> dependencies;
+   };
+
+   /// Adds a dispatch of the kernel with the given arguments (which are
+   /// copied). A zero work-group size is resolved by the occupancy model.
+   template<typename ... Args>
+   NodeId addNode(const std::string& name, const std::string& kernelSymbolName, const KernelLaunchParameters n,
+         const Args&... args) {
+      Node node;
+      node.name = name;
+      node.kernelSymbolName = kernelSymbolName;
+      node.launch = [n, args...](HsaContext& ctx, const KernelDescriptor& kernel,
+            const HsaContext::Dependencies& dependencies) {
+         return ctx.dispatchAfter<Args...>(dependencies, kernel, n, args...);
+      };
+      nodes.push_back(std::move(node));
+      return static_cast<NodeId>(nodes.size() - 1);
+   }
+
+   /// The node does not start before the dependency has completed.
+   void addDependency(const NodeId node, const NodeId dependency);
+
+   std::size_t size() const {
+      return nodes.size();
+   }
+
+   const Node& getNode(const NodeId id) const {
+      return nodes.at(id);
+   }
+
+   /// The nodes ordered such that every node follows its dependencies. Throws
+   /// if the graph has a cycle.
+   std::vector<NodeId> getTopologicalOrder() const;
+
+private:
+   std::vector<Node> nodes;
+};
+
+/// Executes a task graph on one or more contexts (i.e., queues). The nodes of
+/// the same depth in the graph are distributed round-robin among the
+/// contexts, thus independent nodes run concurrently. All of them have to
+/// provide the kernels of the graph. The kernels are looked up once, when the
+/// executor is created.
+///
+/// The edges are either resolved in the queues (barrier packets), in which
+/// case all nodes are submitted up front, or by the host, which submits a node
+/// once all of its dependencies have completed.
+class HsaTaskGraphExecutor {
+public:
+   typedef HsaTaskGraph::NodeId NodeId;
+
+   enum class EdgeMode {
+      /// Every node is dispatched after barrier-AND packets that wait for its
+      /// dependencies (see HsaContext::dispatchAfter).
+      BarrierPackets,
+      /// The host tracks the completion of the nodes.
+      HostTracking
+   };
+
+   /// The times of a node, relative to the start of the run. Completions are
+   /// observed by the host, thus the times are upper bounds.
+   struct NodeTiming {
+      std::chrono::nanoseconds submitted;
+      std::chrono::nanoseconds completed;
+   };
+
+   /// C'tor, the graph and the contexts must outlive the executor.
+   HsaTaskGraphExecutor(const HsaTaskGraph& graph, const std::vector<HsaContext*>& contexts,
+         const EdgeMode mode = EdgeMode::BarrierPackets);
+
+   HsaTaskGraphExecutor(const HsaTaskGraphExecutor&) = delete;
+   HsaTaskGraphExecutor& operator=(const HsaTaskGraphExecutor&) = delete;
+
+   /// Executes all nodes and waits for their completion.
+   void run();
+
+   EdgeMode getEdgeMode() const {
+      return mode;
+   }
+
+   /// The index of the context a node is dispatched to.
+   uint32_t getQueueIndex(const NodeId id) const {
+      return queueIndexes.at(id);
+   }
+
+   /// The timings of the last run, by node.
+   const std::vector<NodeTiming>& getTimings() const {
+      return timings;
+   }
+
+   /// The duration of the last run.
+   std::chrono::nanoseconds getDuration() const {
+      return duration;
+   }
+
+private:
+   const HsaTaskGraph& graph;
+   const std::vector<HsaContext*> contexts;
+   const EdgeMode mode;
+
+   std::vector<NodeId> order;
+   std::vector<uint32_t> queueIndexes;
+   std::vector<HsaAgent::KernelDescriptor> kernels;
+   std::vector<std::vector<NodeId>> successors;
+
+   /// The futures of the current run, by node.
+   std::vector<HsaFuture> futures;
+   /// The futures of the dependencies, by node (only for barrier packets).
+   std::vector<HsaContext::Dependencies> dependencies;
+   /// The number of dependencies that have not completed yet, by node (only
+   /// for host tracking).
+   std::vector<uint32_t> numPending;
+
+   std::vector<NodeTiming> timings;
+   std::chrono::nanoseconds duration;
+
+   std::chrono::steady_clock::time_point start;
+
+   void submit(const NodeId id, const HsaContext::Dependencies& nodeDependencies);
+
+   inline std::chrono::nanoseconds elapsed() const {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+   }
+};
+
+}
+}
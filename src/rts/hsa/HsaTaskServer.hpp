@@ -0,0 +1,248 @@
+#pragma once
+
+#include <rts/hsa/HsaAgent.hpp>
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+namespace rts {
+namespace hsa {
+
+/// The shared-memory mailbox of a persistent worker (see HsaTaskServer): a
+/// ring of task slots. The host writes a task to the next free slot and marks
+/// it as submitted; the worker processes the slots in order, writes the result
+/// and marks the slot as completed; the host reads the result and frees the
+/// slot.
+///
+/// Device code implements the same protocol on the same layout, thus Task and
+/// Result have to be plain old data (see kernel/TaskServer.cl).
+template<typename Task, typename Result>
+struct HsaTaskMailbox {
+   static_assert(std::is_pod<Task>::value && std::is_pod<Result>::value,
+         "Tasks and results are shared with device code.");
+
+   /// The states of a slot.
+   static constexpr uint32_t Free = 0;
+   static constexpr uint32_t Submitted = 1;
+   static constexpr uint32_t Completed = 2;
+
+   struct alignas(64) Slot {
+      std::atomic<uint32_t> state;
+      Task task;
+      Result result;
+   };
+
+   /// Set by the worker, once it polls the ring.
+   std::atomic<uint32_t> running;
+
+   /// Set by the host. The worker returns as soon as there are no more
+   /// submitted tasks.
+   std::atomic<uint32_t> stop;
+
+   /// The number of slots minus one (the number of slots is a power of two).
+   uint64_t mask;
+
+   Slot* slots;
+
+   /// The main loop of a worker that runs on the host (a host kernel or a
+   /// host thread). It returns after the stop flag has been set.
+   template<typename Fn>
+   void serve(const Fn& fn) {
+      running.store(1, std::memory_order_release);
+      for (uint64_t readIndex = 0;; readIndex++) {
+         Slot& slot = slots[readIndex & mask];
+         uint32_t numPolls = 0;
+         while (slot.state.load(std::memory_order_acquire) != Submitted) {
+            // Tasks are submitted before the stop flag is set, thus the slot
+            // has to be checked again after the flag.
+            if (stop.load(std::memory_order_acquire) != 0
+                  && slot.state.load(std::memory_order_acquire) != Submitted) {
+               return;
+            }
+            backoff(numPolls);
+         }
+         slot.result = fn(slot.task);
+         slot.state.store(Completed, std::memory_order_release);
+      }
+   }
+
+   /// Spins for a while, then yields (the host worker may share the
+   /// processor with the submitting thread).
+   static inline void backoff(uint32_t& numPolls) {
+      if (++numPolls > 64) std::this_thread::yield();
+   }
+};
+
+template<typename Task, typename Result>
+constexpr uint32_t HsaTaskMailbox<Task, Result>::Free;
+
+template<typename Task, typename Result>
+constexpr uint32_t HsaTaskMailbox<Task, Result>::Submitted;
+
+template<typename Task, typename Result>
+constexpr uint32_t HsaTaskMailbox<Task, Result>::Completed;
+
+/// Executes tasks on a persistent worker. Submitting a task only writes a slot
+/// of the mailbox in shared memory, neither an AQL packet nor a signal is
+/// involved, thus the round trip is much shorter than that of a dispatch
+/// (see HsaPerformance.DispatchTaskServer). The worker is either
+///   - a persistent kernel, which is dispatched once with the mailbox as its
+///     only argument and serves the tasks until it is shut down, or
+///   - a host thread, which stands in for the kernel agent (e.g., in tests).
+///
+/// Tasks complete in submission order. The result of each task has to be
+/// collected (poll, wait) exactly once, as its slot is not reused before.
+/// Like the queue, the server is not thread-safe.
+template<typename Task, typename Result>
+class HsaTaskServer {
+public:
+   typedef HsaTaskMailbox<Task, Result> Mailbox;
+
+   typedef typename Mailbox::Slot Slot;
+
+   /// Identifies a submitted task.
+   typedef uint64_t Ticket;
+
+   /// C'tor, dispatches the persistent kernel (a single work-item). The kernel
+   /// has the signature `kernel(Mailbox*)` and implements the protocol of
+   /// HsaTaskMailbox. The number of slots is rounded up to a power of two.
+   HsaTaskServer(HsaContext& ctx, const HsaAgent::KernelDescriptor& kernel, const uint32_t capacity = 64) :
+         HsaTaskServer(capacity) {
+      kernelTask = ctx.dispatchAsync<Mailbox*>(kernel, { 1, 1 }, mailbox.get());
+   }
+
+   /// C'tor, serves the tasks with a host thread that invokes `fn`.
+   explicit HsaTaskServer(const std::function<Result(const Task&)>& fn, const uint32_t capacity = 64) :
+         HsaTaskServer(capacity) {
+      Mailbox* m = mailbox.get();
+      hostWorker = std::thread([m, fn] {
+         m->serve(fn);
+      });
+   }
+
+   HsaTaskServer(const HsaTaskServer&) = delete;
+   HsaTaskServer& operator=(const HsaTaskServer&) = delete;
+
+   /// D'tor, shuts the worker down.
+   ~HsaTaskServer() {
+      shutDown();
+      std::free(mailbox->slots);
+   }
+
+   /// Waits until the worker polls the mailbox (e.g., to exclude the launch
+   /// of the persistent kernel from measurements).
+   void waitUntilRunning() const {
+      uint32_t numPolls = 0;
+      while (mailbox->running.load(std::memory_order_acquire) == 0) {
+         Mailbox::backoff(numPolls);
+      }
+   }
+
+   /// Submits a task. Blocks while the slot is still occupied, i.e., while
+   /// the result of the task that has been submitted `capacity` tasks before
+   /// has not been collected.
+   Ticket submit(const Task& task) {
+      if (stopped) {
+         throw HsaException("The task server has been shut down.");
+      }
+      Slot& slot = getSlot(writeIndex);
+      uint32_t numPolls = 0;
+      while (slot.state.load(std::memory_order_acquire) != Mailbox::Free) {
+         Mailbox::backoff(numPolls);
+      }
+      slot.task = task;
+      slot.state.store(Mailbox::Submitted, std::memory_order_release);
+      return writeIndex++;
+   }
+
+   /// Collects the result of the task, if it has completed.
+   bool poll(const Ticket ticket, Result& result) {
+      Slot& slot = getSlot(ticket);
+      if (slot.state.load(std::memory_order_acquire) != Mailbox::Completed) return false;
+      result = slot.result;
+      slot.state.store(Mailbox::Free, std::memory_order_release);
+      return true;
+   }
+
+   /// Waits for the task and collects its result.
+   Result wait(const Ticket ticket) {
+      Result result;
+      uint32_t numPolls = 0;
+      while (!poll(ticket, result)) {
+         Mailbox::backoff(numPolls);
+      }
+      return result;
+   }
+
+   /// Submits a task and waits for its result.
+   Result call(const Task& task) {
+      return wait(submit(task));
+   }
+
+   uint32_t getCapacity() const {
+      return static_cast<uint32_t>(mailbox->mask + 1);
+   }
+
+   /// Lets the worker finish the submitted tasks, then stops it and waits
+   /// until it has returned (i.e., the persistent kernel has completed).
+   /// Results that have not been collected yet can still be polled.
+   void shutDown() {
+      if (stopped) return;
+      stopped = true;
+      mailbox->stop.store(1, std::memory_order_release);
+      if (hostWorker.joinable()) {
+         hostWorker.join();
+      }
+      if (kernelTask.valid()) {
+         kernelTask.wait();
+      }
+   }
+
+private:
+   std::unique_ptr<Mailbox> mailbox;
+
+   uint64_t writeIndex;
+
+   bool stopped;
+
+   /// The persistent kernel (if any).
+   HsaFuture kernelTask;
+
+   /// The host thread (if any).
+   std::thread hostWorker;
+
+   /// Allocates the mailbox. The kernel agent accesses it directly, which
+   /// requires a full profile agent (like all kernel arguments that point to
+   /// host memory).
+   explicit HsaTaskServer(const uint32_t capacity) :
+         mailbox(new Mailbox), writeIndex(0), stopped(false) {
+      uint64_t numSlots = 1;
+      while (numSlots < capacity) numSlots <<= 1;
+      void* slots;
+      if (posix_memalign(&slots, alignof(Slot), numSlots * sizeof(Slot)) != 0) {
+         throw std::bad_alloc();
+      }
+      mailbox->running.store(0);
+      mailbox->stop.store(0);
+      mailbox->mask = numSlots - 1;
+      mailbox->slots = static_cast<Slot*>(slots);
+      for (uint64_t i = 0; i < numSlots; i++) {
+         new (&mailbox->slots[i]) Slot();
+         mailbox->slots[i].state.store(Mailbox::Free);
+      }
+   }
+
+   inline Slot& getSlot(const Ticket ticket) {
+      return mailbox->slots[ticket & mailbox->mask];
+   }
+};
+
+}
+}
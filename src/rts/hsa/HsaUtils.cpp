@@ -3,6 +3,7 @@
 #include <hsa.h>
 #include <iostream>
 #include <limits>
+#include <vector>
 
 namespace rts {
 namespace hsa {
@@ -101,5 +102,38 @@ hsa_region_t HsaUtils::determineKernelArgumentRegion(hsa_agent_t kernelAgent) {
    return region;
 }
 
+std::vector<HsaRegion> HsaUtils::determineGlobalRegions(hsa_agent_t agent) {
+   auto getGlobalRegionsCallback = [](hsa_region_t region, void* data) -> hsa_status_t {
+      hsa_region_segment_t segment;
+      hsa_region_get_info(region, HSA_REGION_INFO_SEGMENT, &segment);
+      if (segment != HSA_REGION_SEGMENT_GLOBAL) {
+         return HSA_STATUS_SUCCESS;
+      }
+      HsaRegion r;
+      r.region = region;
+      uint32_t flags;
+      hsa_region_get_info(region, HSA_REGION_INFO_GLOBAL_FLAGS, &flags);
+      r.fineGrained = (flags & HSA_REGION_GLOBAL_FLAG_FINE_GRAINED) != 0;
+      r.coarseGrained = (flags & HSA_REGION_GLOBAL_FLAG_COARSE_GRAINED) != 0;
+      r.kernarg = (flags & HSA_REGION_GLOBAL_FLAG_KERNARG) != 0;
+      hsa_region_get_info(region, HSA_REGION_INFO_SIZE, &r.size);
+      hsa_region_get_info(region, HSA_REGION_INFO_RUNTIME_ALLOC_ALLOWED, &r.allocAllowed);
+      r.allocMaxSize = 0;
+      r.allocGranule = 0;
+      r.allocAlignment = 0;
+      if (r.allocAllowed) {
+         hsa_region_get_info(region, HSA_REGION_INFO_ALLOC_MAX_SIZE, &r.allocMaxSize);
+         hsa_region_get_info(region, HSA_REGION_INFO_RUNTIME_ALLOC_GRANULE, &r.allocGranule);
+         hsa_region_get_info(region, HSA_REGION_INFO_RUNTIME_ALLOC_ALIGNMENT, &r.allocAlignment);
+      }
+      reinterpret_cast<vector<HsaRegion>*>(data)->push_back(r);
+      return HSA_STATUS_SUCCESS;
+   };
+
+   vector<HsaRegion> regions;
+   checkStatus(hsa_agent_iterate_regions(agent, getGlobalRegionsCallback, &regions));
+   return regions;
+}
+
 }
 }
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaRegion.hpp>
 #include <hsa.h>
 #include <functional>
+#include <vector>
 
 namespace rts {
 namespace hsa {
@@ -20,6 +22,9 @@ public:
 
    static hsa_region_t determineKernelArgumentRegion(hsa_agent_t kernelAgent);
 
+   /// Enumerates the global memory regions of the agent.
+   static std::vector<HsaRegion> determineGlobalRegions(hsa_agent_t agent);
+
    static void apiCall(std::function<hsa_status_t()> hsaApiFunc) {
       const hsa_status_t status = hsaApiFunc();
       checkStatus(status);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <rts/hsa/HsaKernelSignature.hpp>
 #include <hsa.h>
 #include <iostream>
 
@@ -15,10 +16,18 @@ private:
    KernelArgs(void* ptr) :
          ptr(ptr) {
    }
-   ;
 
 public:
+   KernelArgs(KernelArgs&& other) :
+         ptr(other.ptr) {
+      other.ptr = nullptr;
+   }
+
+   KernelArgs(const KernelArgs&) = delete;
+   KernelArgs& operator=(const KernelArgs&) = delete;
+
    ~KernelArgs() {
+      if (ptr == nullptr) return;
       hsa_status_t status;
       status = hsa_memory_free(ptr);
       if (status != HSA_STATUS_SUCCESS) {
@@ -33,7 +42,7 @@ public:
    template<typename ... Args>
    static KernelArgs build(const hsa_region_t kernelArgumentRegion, const Args&... args) {
       // Determine the size of the kernel arguments
-      constexpr size_t argsSize = sizeOfArgs(args...);
+      constexpr size_t argsSize = sizeOfArgs<0, Args...>();
 
       // Allocate memory (Note: we have to use HSA functions to allocate memory in a region that is associated with the kernel agent)
       void* ptr = nullptr;
@@ -44,17 +53,17 @@ public:
       }
 
       // Copy the actual parameters to the newly allocated memory
-      writeArgs(ptr, args...);
+      HsaKernelArgLayout<0, Args...>::write(reinterpret_cast<uint8_t*>(ptr), args...);
       return KernelArgs{ptr};
    }
 
    template<typename ... Args>
    static KernelArgs buildOpenCL(const hsa_region_t kernelArgumentRegion, const Args&... args) {
       // OpenCL kernels compiled with CLOC have 6 additional leading parameters which can all be set to NULL.
-      constexpr size_t numLeadingParameters = 6;
+      constexpr size_t numLeadingParameters = HsaAgent::numLeadingParameters;
 
       // Determine the size of the kernel arguments
-      constexpr size_t argsSize = sizeOfArgs(args...) + numLeadingParameters * sizeof(uintptr_t);
+      constexpr size_t argsSize = sizeOfArgs<numLeadingParameters * sizeof(uintptr_t), Args...>();
 
       // Allocate memory (Note: we have to use HSA functions to allocate memory in a region that is associated with the kernel agent)
       void* ptr = nullptr;
@@ -70,44 +79,16 @@ public:
          *writer = 0;
          writer++;
       }
-      writeArgs(writer, args...);
+      HsaKernelSignature<Args...>::write(ptr, args...);
       return KernelArgs{ptr};
    }
 
 private:
-   static constexpr size_t sizeOfArgsRec(const size_t size) {
-      return size;
-   }
-
-   template<typename T, typename ... Ts>
-   static constexpr size_t sizeOfArgsRec(const size_t size, const T& /* arg */, const Ts&... args) {
-      return sizeOfArgsRec(((size + alignof(T) - 1) & -alignof(T)) + sizeof(T), args...);
-   }
-
-   template<typename ... Args>
-   static constexpr size_t sizeOfArgs(const Args&... args) {
-      // Calculates how much space the arguments will take as kernel arguments.
-      // Basically it returns sizeof(args_struct) padded to multiple of 16 with
-      //
-      // struct args_struct {
-      //     Arg1 arg1;
-      //     Arg2 arg2;
-      //     ...
-      // }
-      //
-      // while taking into account all needed padding between the arguments.
-      return (sizeOfArgsRec(0, args...) + 15) / 16 * 16;
-   }
-
-   static void writeArgs(void* /* writer */) {
-   }
-
-   template<typename T, typename ... Ts>
-   static void writeArgs(void* writer, const T& arg, const Ts&... args) {
-      uintptr_t pointer = reinterpret_cast<uintptr_t>(writer);
-      uint8_t* writePosition = reinterpret_cast<uint8_t*>((pointer + alignof(T) - 1) & -alignof(T));
-      *reinterpret_cast<T*>(writePosition) = arg;
-      writeArgs(writePosition + sizeof(T), args...);
+   template<uint32_t Offset, typename ... Args>
+   static constexpr size_t sizeOfArgs() {
+      // Calculates how much space the arguments will take as kernel arguments
+      // (starting at the given offset), padded to a multiple of 16.
+      return (HsaKernelArgLayout<Offset, Args...>::end + 15) / 16 * 16;
    }
 
 };
@@ -1,4 +1,27 @@
+include src/rts/hsa/mock/LocalMakefile.mk
+
 src_rts_hsa:= \
+	src/rts/hsa/HsaAgent.cpp \
+	src/rts/hsa/HsaAqlAgent.cpp \
+	src/rts/hsa/HsaAqlPacketProcessor.cpp \
+	src/rts/hsa/HsaAutotuner.cpp \
+	src/rts/hsa/HsaCodeObjectCache.cpp \
+	src/rts/hsa/HsaConstantArena.cpp \
 	src/rts/hsa/HsaContext.cpp \
+	src/rts/hsa/HsaExecutableRegistry.cpp \
+	src/rts/hsa/HsaFuture.cpp \
+	src/rts/hsa/HsaHostKernel.cpp \
+	src/rts/hsa/HsaHostSignal.cpp \
+	src/rts/hsa/HsaKernargSlab.cpp \
+	src/rts/hsa/HsaKernelTable.cpp \
+	src/rts/hsa/HsaMemoryAllocator.cpp \
+	src/rts/hsa/HsaMemoryPool.cpp \
+	src/rts/hsa/HsaModuleSource.cpp \
+	src/rts/hsa/HsaNativeAgent.cpp \
+	src/rts/hsa/HsaOccupancy.cpp \
+	src/rts/hsa/HsaRegistrationCache.cpp \
 	src/rts/hsa/HsaRuntime.cpp \
+	src/rts/hsa/HsaSignalPool.cpp \
+	src/rts/hsa/HsaSoftAqlAgent.cpp \
+	src/rts/hsa/HsaTaskGraph.cpp \
 	src/rts/hsa/HsaUtils.cpp
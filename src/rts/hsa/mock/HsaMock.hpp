@@ -0,0 +1,35 @@
+#pragma once
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <string>
+
+namespace rts {
+namespace hsa {
+namespace mock {
+
+/// The mock HSA runtime (libhsa-runtime64.so, built with HSA_MOCK=1) is a
+/// drop-in replacement of the HSA runtime for systems without a kernel agent.
+/// It executes host kernels on host threads: when a program is finalized,
+/// the kernels of its BRIG modules are bound to the host kernels that have
+/// been registered under the same symbol name.
+///
+/// If two modules define kernels with the same symbol name, the host kernels
+/// can be registered for a specific module. The module name is only known for
+/// the placeholder BRIG modules that are generated in mock mode (see
+/// scripts/hsa/mock_brig.sh). It is the name of the OpenCL source file
+/// without extension.
+void registerKernel(const HsaHostKernel& kernel, const std::string& moduleName = "");
+
+/// Registers a host kernel during static initialization.
+struct KernelRegistration {
+   KernelRegistration(const HsaHostKernel& kernel, const std::string& moduleName = "") {
+      registerKernel(kernel, moduleName);
+   }
+};
+
+}
+}
+}
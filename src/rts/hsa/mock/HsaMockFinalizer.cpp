@@ -0,0 +1,437 @@
+#include <rts/hsa/mock/HsaMockRuntime.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+using namespace rts::hsa;
+using namespace rts::hsa::mock;
+
+// The mock finalizer does not translate HSAIL. It extracts the kernel symbols
+// from the BRIG module and binds them to the registered host kernels.
+
+static constexpr char brigMagic[8] = {'H', 'S', 'A', ' ', 'B', 'R', 'I', 'G'};
+static constexpr size_t brigHeaderSize = 104;
+static constexpr size_t brigByteCountOffset = 16;
+static constexpr size_t brigSectionCountOffset = 92;
+static constexpr char kernelPrefix[] = "&__OpenCL_";
+static constexpr char kernelSuffix[] = "_kernel";
+static constexpr char codeObjectMagic[] = "HSA MOCK CODE OBJECT 1";
+
+static inline bool endsWith(const std::string& str, const std::string& suffix) {
+   return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/// Extracts the kernel names from a BRIG module. Returns false if the module is invalid.
+static bool parseModule(const void* brig, Module& module) {
+   if (brig == nullptr) return false;
+   const uint8_t* data = reinterpret_cast<const uint8_t*>(brig);
+   if (std::memcmp(data, brigMagic, sizeof(brigMagic)) != 0) return false;
+   uint64_t byteCount;
+   std::memcpy(&byteCount, data + brigByteCountOffset, sizeof(byteCount));
+   uint32_t sectionCount;
+   std::memcpy(&sectionCount, data + brigSectionCountOffset, sizeof(sectionCount));
+   if (byteCount < brigHeaderSize) return false;
+
+   module.brig = brig;
+   module.name.clear();
+   module.kernelNames.clear();
+
+   if (sectionCount == 0) {
+      // A placeholder module (see scripts/hsa/mock_brig.sh), which contains
+      // the module name and the kernel names (one per line).
+      std::istringstream body(std::string(reinterpret_cast<const char*>(data + brigHeaderSize),
+            byteCount - brigHeaderSize));
+      std::string line;
+      while (std::getline(body, line)) {
+         if (line.compare(0, 7, "module:") == 0) {
+            module.name = line.substr(7);
+         }
+         else if (!line.empty() && line[0] == '&') {
+            module.kernelNames.push_back(line);
+         }
+      }
+      return true;
+   }
+
+   // A module compiled by CLOC. Strings are stored in the data section with
+   // a leading 32-bit length.
+   std::set<std::string> kernelNames;
+   const size_t prefixLength = sizeof(kernelPrefix) - 1;
+   const uint8_t* end = data + byteCount;
+   for (const uint8_t* pos = data + brigHeaderSize + sizeof(uint32_t); pos + prefixLength <= end; pos++) {
+      if (std::memcmp(pos, kernelPrefix, prefixLength) != 0) continue;
+      uint32_t length;
+      std::memcpy(&length, pos - sizeof(uint32_t), sizeof(length));
+      if (length <= prefixLength || length > static_cast<size_t>(end - pos)) continue;
+      const std::string name(reinterpret_cast<const char*>(pos), length);
+      if (endsWith(name, kernelSuffix) && kernelNames.insert(name).second) {
+         module.kernelNames.push_back(name);
+      }
+   }
+   return true;
+}
+
+static inline bool isKernelAgent(const hsa_agent_t agent) {
+   return fromHandle<const Agent>(agent) == &HsaMockRuntime::get().kernelAgent;
+}
+
+static hsa_status_t getSymbolInfo(const Symbol& symbol, const uint32_t attribute, void* value) {
+   switch (attribute) {
+      case HSA_CODE_SYMBOL_INFO_TYPE: {
+         const hsa_symbol_kind_t kind = HSA_SYMBOL_KIND_KERNEL;
+         std::memcpy(value, &kind, sizeof(kind));
+         return HSA_STATUS_SUCCESS;
+      }
+      case HSA_CODE_SYMBOL_INFO_NAME_LENGTH: {
+         const uint32_t length = symbol.name.size();
+         std::memcpy(value, &length, sizeof(length));
+         return HSA_STATUS_SUCCESS;
+      }
+      case HSA_CODE_SYMBOL_INFO_NAME:
+         std::memcpy(value, symbol.name.c_str(), symbol.name.size());
+         return HSA_STATUS_SUCCESS;
+      case HSA_CODE_SYMBOL_INFO_MODULE_NAME_LENGTH: {
+         const uint32_t length = symbol.moduleName.size();
+         std::memcpy(value, &length, sizeof(length));
+         return HSA_STATUS_SUCCESS;
+      }
+      case HSA_CODE_SYMBOL_INFO_MODULE_NAME:
+         std::memcpy(value, symbol.moduleName.c_str(), symbol.moduleName.size());
+         return HSA_STATUS_SUCCESS;
+      case HSA_CODE_SYMBOL_INFO_LINKAGE: {
+         const hsa_symbol_linkage_t linkage = HSA_SYMBOL_LINKAGE_PROGRAM;
+         std::memcpy(value, &linkage, sizeof(linkage));
+         return HSA_STATUS_SUCCESS;
+      }
+      case HSA_CODE_SYMBOL_INFO_IS_DEFINITION:
+      case HSA_CODE_SYMBOL_INFO_KERNEL_DYNAMIC_CALLSTACK: {
+         const bool flag = attribute == HSA_CODE_SYMBOL_INFO_IS_DEFINITION;
+         std::memcpy(value, &flag, sizeof(flag));
+         return HSA_STATUS_SUCCESS;
+      }
+      case HSA_CODE_SYMBOL_INFO_KERNEL_KERNARG_SEGMENT_SIZE:
+      case HSA_CODE_SYMBOL_INFO_KERNEL_KERNARG_SEGMENT_ALIGNMENT:
+      case HSA_CODE_SYMBOL_INFO_KERNEL_GROUP_SEGMENT_SIZE:
+      case HSA_CODE_SYMBOL_INFO_KERNEL_PRIVATE_SEGMENT_SIZE: {
+         uint32_t size = 0;
+         if (attribute == HSA_CODE_SYMBOL_INFO_KERNEL_KERNARG_SEGMENT_SIZE) size = symbol.kernel->argumentSegmentSize;
+         if (attribute == HSA_CODE_SYMBOL_INFO_KERNEL_KERNARG_SEGMENT_ALIGNMENT) size = 16;
+         if (attribute == HSA_CODE_SYMBOL_INFO_KERNEL_GROUP_SEGMENT_SIZE) size = symbol.kernel->groupSegmentSize;
+         std::memcpy(value, &size, sizeof(size));
+         return HSA_STATUS_SUCCESS;
+      }
+   }
+   return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+}
+
+extern "C" {
+
+//===----------------------------------------------------------------------===//
+// Finalizer extension
+//===----------------------------------------------------------------------===//
+
+hsa_status_t hsa_ext_program_create(hsa_machine_model_t machine_model, hsa_profile_t profile,
+      hsa_default_float_rounding_mode_t default_float_rounding_mode, const char* /* options */,
+      hsa_ext_program_t* program) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (program == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   Program* p = new Program();
+   p->machineModel = machine_model;
+   p->profile = profile;
+   p->roundingMode = default_float_rounding_mode;
+   *program = toHandle<hsa_ext_program_t>(p);
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_ext_program_destroy(hsa_ext_program_t program) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (program.handle == 0) return static_cast<hsa_status_t>(HSA_EXT_STATUS_ERROR_INVALID_PROGRAM);
+   delete fromHandle<Program>(program);
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_ext_program_add_module(hsa_ext_program_t program, hsa_ext_module_t module) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (program.handle == 0) return static_cast<hsa_status_t>(HSA_EXT_STATUS_ERROR_INVALID_PROGRAM);
+   Program* p = fromHandle<Program>(program);
+   const void* brig = reinterpret_cast<const void*>(module);
+   for (const Module& m : p->modules) {
+      if (m.brig == brig) return static_cast<hsa_status_t>(HSA_EXT_STATUS_ERROR_MODULE_ALREADY_INCLUDED);
+   }
+   Module m;
+   if (!parseModule(brig, m)) return static_cast<hsa_status_t>(HSA_EXT_STATUS_ERROR_INVALID_MODULE);
+   p->modules.push_back(m);
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_ext_program_iterate_modules(hsa_ext_program_t program,
+      hsa_status_t (*callback)(hsa_ext_program_t program, hsa_ext_module_t module, void* data), void* data) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (program.handle == 0) return static_cast<hsa_status_t>(HSA_EXT_STATUS_ERROR_INVALID_PROGRAM);
+   if (callback == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   for (const Module& m : fromHandle<Program>(program)->modules) {
+      const hsa_status_t status = callback(program, (hsa_ext_module_t) m.brig, data);
+      if (status != HSA_STATUS_SUCCESS) return status;
+   }
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_ext_program_get_info(hsa_ext_program_t program, hsa_ext_program_info_t attribute, void* value) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (program.handle == 0) return static_cast<hsa_status_t>(HSA_EXT_STATUS_ERROR_INVALID_PROGRAM);
+   if (value == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   const Program* p = fromHandle<const Program>(program);
+   switch (attribute) {
+      case HSA_EXT_PROGRAM_INFO_MACHINE_MODEL: std::memcpy(value, &p->machineModel, sizeof(p->machineModel)); break;
+      case HSA_EXT_PROGRAM_INFO_PROFILE: std::memcpy(value, &p->profile, sizeof(p->profile)); break;
+      case HSA_EXT_PROGRAM_INFO_DEFAULT_FLOAT_ROUNDING_MODE: std::memcpy(value, &p->roundingMode, sizeof(p->roundingMode)); break;
+      default: return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   }
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_ext_program_finalize(hsa_ext_program_t program, hsa_isa_t isa, int32_t /* call_convention */,
+      hsa_ext_control_directives_t /* control_directives */, const char* /* options */,
+      hsa_code_object_type_t code_object_type, hsa_code_object_t* code_object) {
+   HsaMockRuntime& rt = HsaMockRuntime::get();
+   if (!rt.isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (program.handle == 0) return static_cast<hsa_status_t>(HSA_EXT_STATUS_ERROR_INVALID_PROGRAM);
+   if (fromHandle<const Isa>(isa) != &rt.isa) return HSA_STATUS_ERROR_INVALID_ISA;
+   if (code_object == nullptr || code_object_type != HSA_CODE_OBJECT_TYPE_PROGRAM) {
+      return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   }
+   const Program* p = fromHandle<const Program>(program);
+   CodeObject* codeObject = new CodeObject();
+   codeObject->machineModel = p->machineModel;
+   codeObject->profile = p->profile;
+   codeObject->roundingMode = p->roundingMode;
+   codeObject->isa = &rt.isa;
+   for (const Module& m : p->modules) {
+      for (const std::string& kernelName : m.kernelNames) {
+         const HsaHostKernel* kernel = rt.findKernel(m.name, kernelName);
+         if (kernel == nullptr) {
+            std::cerr << "HSA mock: no host implementation of kernel '" << kernelName << "'"
+                  << (m.name.empty() ? "" : " (module '" + m.name + "')") << std::endl;
+            delete codeObject;
+            return static_cast<hsa_status_t>(HSA_EXT_STATUS_ERROR_FINALIZATION_FAILED);
+         }
+         Symbol symbol;
+         symbol.name = kernelName;
+         symbol.moduleName = m.name;
+         symbol.kernel = kernel;
+         symbol.agent = {0};
+         codeObject->symbols.push_back(symbol);
+      }
+   }
+   *code_object = toHandle<hsa_code_object_t>(codeObject);
+   return HSA_STATUS_SUCCESS;
+}
+
+//===----------------------------------------------------------------------===//
+// Code objects
+//===----------------------------------------------------------------------===//
+
+hsa_status_t hsa_code_object_destroy(hsa_code_object_t code_object) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (code_object.handle == 0) return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+   delete fromHandle<CodeObject>(code_object);
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_code_object_serialize(hsa_code_object_t code_object,
+      hsa_status_t (*alloc_callback)(size_t size, hsa_callback_data_t data, void** address),
+      hsa_callback_data_t callback_data, const char* /* options */, void** serialized_code_object,
+      size_t* serialized_code_object_size) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (code_object.handle == 0) return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+   if (alloc_callback == nullptr || serialized_code_object == nullptr || serialized_code_object_size == nullptr) {
+      return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   }
+   // The symbols are serialized by name (one per line), the deserialization
+   // binds them to the registered host kernels again.
+   const CodeObject* c = fromHandle<const CodeObject>(code_object);
+   std::ostringstream out;
+   out << codeObjectMagic << '\n' << c->machineModel << ' ' << c->profile << ' ' << c->roundingMode << '\n';
+   for (const Symbol& s : c->symbols) {
+      out << s.moduleName << '\t' << s.name << '\n';
+   }
+   const std::string data = out.str();
+   void* address = nullptr;
+   const hsa_status_t status = alloc_callback(data.size(), callback_data, &address);
+   if (status != HSA_STATUS_SUCCESS) return status;
+   std::memcpy(address, data.data(), data.size());
+   *serialized_code_object = address;
+   *serialized_code_object_size = data.size();
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_code_object_deserialize(void* serialized_code_object, size_t serialized_code_object_size,
+      const char* /* options */, hsa_code_object_t* code_object) {
+   HsaMockRuntime& rt = HsaMockRuntime::get();
+   if (!rt.isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (serialized_code_object == nullptr || code_object == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   std::istringstream in(std::string(reinterpret_cast<const char*>(serialized_code_object),
+         serialized_code_object_size));
+   std::string magic;
+   int machineModel;
+   int profile;
+   int roundingMode;
+   if (!std::getline(in, magic) || magic != codeObjectMagic || !(in >> machineModel >> profile >> roundingMode)) {
+      return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+   }
+   in.ignore(1);
+   CodeObject* c = new CodeObject();
+   c->machineModel = static_cast<hsa_machine_model_t>(machineModel);
+   c->profile = static_cast<hsa_profile_t>(profile);
+   c->roundingMode = static_cast<hsa_default_float_rounding_mode_t>(roundingMode);
+   c->isa = &rt.isa;
+   std::string line;
+   while (std::getline(in, line)) {
+      const size_t tab = line.find('\t');
+      Symbol symbol;
+      symbol.moduleName = line.substr(0, tab);
+      symbol.name = tab == std::string::npos ? "" : line.substr(tab + 1);
+      symbol.kernel = rt.findKernel(symbol.moduleName, symbol.name);
+      symbol.agent = {0};
+      if (symbol.kernel == nullptr) {
+         // The host kernel is not registered (anymore).
+         delete c;
+         return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+      }
+      c->symbols.push_back(symbol);
+   }
+   *code_object = toHandle<hsa_code_object_t>(c);
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_code_object_get_symbol(hsa_code_object_t code_object, const char* symbol_name,
+      hsa_code_symbol_t* symbol) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (code_object.handle == 0) return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+   if (symbol_name == nullptr || symbol == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   for (const Symbol& s : fromHandle<const CodeObject>(code_object)->symbols) {
+      if (s.name == symbol_name) {
+         *symbol = toHandle<hsa_code_symbol_t>(&s);
+         return HSA_STATUS_SUCCESS;
+      }
+   }
+   return HSA_STATUS_ERROR_INVALID_SYMBOL_NAME;
+}
+
+hsa_status_t hsa_code_object_iterate_symbols(hsa_code_object_t code_object,
+      hsa_status_t (*callback)(hsa_code_object_t code_object, hsa_code_symbol_t symbol, void* data), void* data) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (code_object.handle == 0) return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+   if (callback == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   for (const Symbol& s : fromHandle<const CodeObject>(code_object)->symbols) {
+      const hsa_status_t status = callback(code_object, toHandle<hsa_code_symbol_t>(&s), data);
+      if (status != HSA_STATUS_SUCCESS) return status;
+   }
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_code_symbol_get_info(hsa_code_symbol_t code_symbol, hsa_code_symbol_info_t attribute, void* value) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (code_symbol.handle == 0 || value == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   return getSymbolInfo(*fromHandle<const Symbol>(code_symbol), attribute, value);
+}
+
+//===----------------------------------------------------------------------===//
+// Executables
+//===----------------------------------------------------------------------===//
+
+hsa_status_t hsa_executable_create(hsa_profile_t profile, hsa_executable_state_t executable_state,
+      const char* /* options */, hsa_executable_t* executable) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (executable == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   Executable* e = new Executable();
+   e->profile = profile;
+   e->state = executable_state;
+   *executable = toHandle<hsa_executable_t>(e);
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_executable_destroy(hsa_executable_t executable) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (executable.handle == 0) return HSA_STATUS_ERROR_INVALID_EXECUTABLE;
+   delete fromHandle<Executable>(executable);
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_executable_load_code_object(hsa_executable_t executable, hsa_agent_t agent,
+      hsa_code_object_t code_object, const char* /* options */) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (executable.handle == 0) return HSA_STATUS_ERROR_INVALID_EXECUTABLE;
+   if (!isKernelAgent(agent)) return HSA_STATUS_ERROR_INVALID_AGENT;
+   if (code_object.handle == 0) return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+   Executable* e = fromHandle<Executable>(executable);
+   if (e->state == HSA_EXECUTABLE_STATE_FROZEN) return HSA_STATUS_ERROR_FROZEN_EXECUTABLE;
+   const CodeObject* c = fromHandle<const CodeObject>(code_object);
+   if (c->profile != e->profile) return HSA_STATUS_ERROR_INCOMPATIBLE_ARGUMENTS;
+   for (Symbol symbol : c->symbols) {
+      symbol.agent = agent;
+      e->symbols.push_back(symbol);
+   }
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_executable_freeze(hsa_executable_t executable, const char* /* options */) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (executable.handle == 0) return HSA_STATUS_ERROR_INVALID_EXECUTABLE;
+   Executable* e = fromHandle<Executable>(executable);
+   if (e->state == HSA_EXECUTABLE_STATE_FROZEN) return HSA_STATUS_ERROR_FROZEN_EXECUTABLE;
+   e->state = HSA_EXECUTABLE_STATE_FROZEN;
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_executable_get_symbol(hsa_executable_t executable, const char* module_name,
+      const char* symbol_name, hsa_agent_t agent, int32_t /* call_convention */,
+      hsa_executable_symbol_t* symbol) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (executable.handle == 0) return HSA_STATUS_ERROR_INVALID_EXECUTABLE;
+   if (symbol_name == nullptr || symbol == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   for (const Symbol& s : fromHandle<const Executable>(executable)->symbols) {
+      if (s.name == symbol_name && s.agent.handle == agent.handle
+            && (module_name == nullptr || s.moduleName == module_name)) {
+         *symbol = toHandle<hsa_executable_symbol_t>(&s);
+         return HSA_STATUS_SUCCESS;
+      }
+   }
+   return HSA_STATUS_ERROR_INVALID_SYMBOL_NAME;
+}
+
+hsa_status_t hsa_executable_symbol_get_info(hsa_executable_symbol_t executable_symbol,
+      hsa_executable_symbol_info_t attribute, void* value) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (executable_symbol.handle == 0 || value == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   const Symbol& symbol = *fromHandle<const Symbol>(executable_symbol);
+   switch (attribute) {
+      case HSA_EXECUTABLE_SYMBOL_INFO_AGENT:
+         std::memcpy(value, &symbol.agent, sizeof(symbol.agent));
+         return HSA_STATUS_SUCCESS;
+      case HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_OBJECT: {
+         const uint64_t kernelObject = reinterpret_cast<uint64_t>(symbol.kernel);
+         std::memcpy(value, &kernelObject, sizeof(kernelObject));
+         return HSA_STATUS_SUCCESS;
+      }
+      default:
+         // The remaining attributes have the same values as the code symbol attributes.
+         return getSymbolInfo(symbol, attribute, value);
+   }
+}
+
+hsa_status_t hsa_executable_iterate_symbols(hsa_executable_t executable,
+      hsa_status_t (*callback)(hsa_executable_t exec, hsa_executable_symbol_t symbol, void* data), void* data) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (executable.handle == 0) return HSA_STATUS_ERROR_INVALID_EXECUTABLE;
+   if (callback == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   for (const Symbol& s : fromHandle<const Executable>(executable)->symbols) {
+      const hsa_status_t status = callback(executable, toHandle<hsa_executable_symbol_t>(&s), data);
+      if (status != HSA_STATUS_SUCCESS) return status;
+   }
+   return HSA_STATUS_SUCCESS;
+}
+
+} // extern "C"
@@ -0,0 +1,555 @@
+#include <rts/hsa/mock/HsaMock.hpp>
+#include <rts/hsa/mock/HsaMockRuntime.hpp>
+#include <rts/hsa/HsaAqlPacketProcessor.hpp>
+#include <rts/hsa/HsaHostSignal.hpp>
+#include <utils/Utils.hpp>
+#include <hsa.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <unistd.h>
+
+namespace rts {
+namespace hsa {
+namespace mock {
+
+HsaMockRuntime& HsaMockRuntime::get() {
+   static HsaMockRuntime runtime;
+   return runtime;
+}
+
+HsaMockRuntime::HsaMockRuntime() :
+      refCount(0) {
+   isa.name = "HSA-mock:host";
+
+   globalRegion.segment = HSA_REGION_SEGMENT_GLOBAL;
+   globalRegion.globalFlags = HSA_REGION_GLOBAL_FLAG_KERNARG | HSA_REGION_GLOBAL_FLAG_FINE_GRAINED;
+   globalRegion.size = static_cast<size_t>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGE_SIZE);
+   globalRegion.allocAllowed = true;
+
+   groupRegion.segment = HSA_REGION_SEGMENT_GROUP;
+   groupRegion.globalFlags = 0;
+   groupRegion.size = 64 * 1024;
+   groupRegion.allocAllowed = false;
+
+   cpuAgent.name = "HSA mock CPU";
+   cpuAgent.deviceType = HSA_DEVICE_TYPE_CPU;
+   cpuAgent.feature = HSA_AGENT_FEATURE_AGENT_DISPATCH;
+   cpuAgent.node = 0;
+   cpuAgent.isa = nullptr;
+   cpuAgent.regions.push_back(toHandle<hsa_region_t>(&globalRegion));
+
+   // The kernel agent claims to be a GPU, as this is what applications look for.
+   kernelAgent.name = "HSA mock kernel agent";
+   kernelAgent.deviceType = HSA_DEVICE_TYPE_GPU;
+   kernelAgent.feature = HSA_AGENT_FEATURE_KERNEL_DISPATCH;
+   kernelAgent.node = 1;
+   kernelAgent.isa = &isa;
+   kernelAgent.regions.push_back(toHandle<hsa_region_t>(&globalRegion));
+   kernelAgent.regions.push_back(toHandle<hsa_region_t>(&groupRegion));
+
+   const char* numThreads = std::getenv("HSA_MOCK_NUM_THREADS");
+   numThreadsPerQueue = numThreads != nullptr ? std::max(1, std::atoi(numThreads)) : static_cast<uint32_t>(Utils::numProcessors());
+}
+
+void HsaMockRuntime::registerKernel(const HsaHostKernel& kernel, const std::string& moduleName) {
+   std::lock_guard<std::mutex> lock(mutex);
+   kernels.push_back(kernel);
+   kernelsByName[std::make_pair(moduleName, kernel.symbolName)] = &kernels.back();
+}
+
+const HsaHostKernel* HsaMockRuntime::findKernel(const std::string& moduleName, const std::string& symbolName) {
+   std::lock_guard<std::mutex> lock(mutex);
+   auto it = kernelsByName.find(std::make_pair(moduleName, symbolName));
+   if (it == kernelsByName.end()) {
+      it = kernelsByName.find(std::make_pair(std::string(), symbolName));
+   }
+   return it == kernelsByName.end() ? nullptr : it->second;
+}
+
+void HsaMockRuntime::addQueue(HsaAqlPacketProcessor* processor) {
+   std::lock_guard<std::mutex> lock(mutex);
+   queues.insert(processor);
+}
+
+void HsaMockRuntime::removeQueue(HsaAqlPacketProcessor* processor) {
+   std::lock_guard<std::mutex> lock(mutex);
+   queues.erase(processor);
+}
+
+void HsaMockRuntime::destroyQueues() {
+   std::lock_guard<std::mutex> lock(mutex);
+   for (HsaAqlPacketProcessor* processor : queues) {
+      delete processor;
+   }
+   queues.clear();
+}
+
+void registerKernel(const HsaHostKernel& kernel, const std::string& moduleName) {
+   HsaMockRuntime::get().registerKernel(kernel, moduleName);
+}
+
+}
+}
+}
+
+using namespace rts::hsa;
+using namespace rts::hsa::mock;
+
+static inline bool isPowerOfTwo(const uint64_t value) {
+   return value != 0 && (value & (value - 1)) == 0;
+}
+
+/// Copies an info value of type T.
+template<typename T>
+static inline hsa_status_t setInfo(void* value, const T& info) {
+   std::memcpy(value, &info, sizeof(T));
+   return HSA_STATUS_SUCCESS;
+}
+
+static inline hsa_status_t setInfo(void* value, const std::string& info, const size_t size) {
+   std::memset(value, 0, size);
+   std::memcpy(value, info.c_str(), std::min(info.size(), size - 1));
+   return HSA_STATUS_SUCCESS;
+}
+
+static constexpr uint32_t minQueueSize = 4;
+static constexpr uint32_t maxQueueSize = 1 << 17;
+static constexpr size_t allocAlignment = 4096;
+
+extern "C" {
+
+//===----------------------------------------------------------------------===//
+// Initialization and shut down
+//===----------------------------------------------------------------------===//
+
+hsa_status_t hsa_status_string(hsa_status_t status, const char** status_string) {
+   if (status_string == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   switch (static_cast<uint32_t>(status)) {
+      case HSA_STATUS_SUCCESS: *status_string = "HSA_STATUS_SUCCESS: The function has been executed successfully."; break;
+      case HSA_STATUS_INFO_BREAK: *status_string = "HSA_STATUS_INFO_BREAK: A traversal over a list of elements has been interrupted by the application before completing."; break;
+      case HSA_STATUS_ERROR: *status_string = "HSA_STATUS_ERROR: A generic error has occurred."; break;
+      case HSA_STATUS_ERROR_INVALID_ARGUMENT: *status_string = "HSA_STATUS_ERROR_INVALID_ARGUMENT: One of the actual arguments does not meet a precondition stated in the documentation of the corresponding formal argument."; break;
+      case HSA_STATUS_ERROR_INVALID_QUEUE_CREATION: *status_string = "HSA_STATUS_ERROR_INVALID_QUEUE_CREATION: The requested queue creation is not valid."; break;
+      case HSA_STATUS_ERROR_INVALID_ALLOCATION: *status_string = "HSA_STATUS_ERROR_INVALID_ALLOCATION: The requested allocation is not valid."; break;
+      case HSA_STATUS_ERROR_INVALID_AGENT: *status_string = "HSA_STATUS_ERROR_INVALID_AGENT: The agent is invalid."; break;
+      case HSA_STATUS_ERROR_INVALID_REGION: *status_string = "HSA_STATUS_ERROR_INVALID_REGION: The memory region is invalid."; break;
+      case HSA_STATUS_ERROR_INVALID_SIGNAL: *status_string = "HSA_STATUS_ERROR_INVALID_SIGNAL: The signal is invalid."; break;
+      case HSA_STATUS_ERROR_INVALID_QUEUE: *status_string = "HSA_STATUS_ERROR_INVALID_QUEUE: The queue is invalid."; break;
+      case HSA_STATUS_ERROR_OUT_OF_RESOURCES: *status_string = "HSA_STATUS_ERROR_OUT_OF_RESOURCES: The runtime failed to allocate the necessary resources."; break;
+      case HSA_STATUS_ERROR_INVALID_PACKET_FORMAT: *status_string = "HSA_STATUS_ERROR_INVALID_PACKET_FORMAT: The AQL packet is malformed."; break;
+      case HSA_STATUS_ERROR_RESOURCE_FREE: *status_string = "HSA_STATUS_ERROR_RESOURCE_FREE: An error has been detected while releasing a resource."; break;
+      case HSA_STATUS_ERROR_NOT_INITIALIZED: *status_string = "HSA_STATUS_ERROR_NOT_INITIALIZED: An API other than hsa_init has been invoked while the reference count of the HSA runtime is zero."; break;
+      case HSA_STATUS_ERROR_REFCOUNT_OVERFLOW: *status_string = "HSA_STATUS_ERROR_REFCOUNT_OVERFLOW: The maximum reference count for the object has been reached."; break;
+      case HSA_STATUS_ERROR_INCOMPATIBLE_ARGUMENTS: *status_string = "HSA_STATUS_ERROR_INCOMPATIBLE_ARGUMENTS: The arguments passed to a functions are not compatible."; break;
+      case HSA_STATUS_ERROR_INVALID_INDEX: *status_string = "HSA_STATUS_ERROR_INVALID_INDEX: The index is invalid."; break;
+      case HSA_STATUS_ERROR_INVALID_ISA: *status_string = "HSA_STATUS_ERROR_INVALID_ISA: The instruction set architecture is invalid."; break;
+      case HSA_STATUS_ERROR_INVALID_ISA_NAME: *status_string = "HSA_STATUS_ERROR_INVALID_ISA_NAME: The instruction set architecture name is invalid."; break;
+      case HSA_STATUS_ERROR_INVALID_CODE_OBJECT: *status_string = "HSA_STATUS_ERROR_INVALID_CODE_OBJECT: The code object is invalid."; break;
+      case HSA_STATUS_ERROR_INVALID_EXECUTABLE: *status_string = "HSA_STATUS_ERROR_INVALID_EXECUTABLE: The executable is invalid."; break;
+      case HSA_STATUS_ERROR_FROZEN_EXECUTABLE: *status_string = "HSA_STATUS_ERROR_FROZEN_EXECUTABLE: The executable is frozen."; break;
+      case HSA_STATUS_ERROR_INVALID_SYMBOL_NAME: *status_string = "HSA_STATUS_ERROR_INVALID_SYMBOL_NAME: There is no symbol with the given name."; break;
+      case HSA_STATUS_ERROR_VARIABLE_ALREADY_DEFINED: *status_string = "HSA_STATUS_ERROR_VARIABLE_ALREADY_DEFINED: The variable is already defined."; break;
+      case HSA_STATUS_ERROR_VARIABLE_UNDEFINED: *status_string = "HSA_STATUS_ERROR_VARIABLE_UNDEFINED: The variable is undefined."; break;
+      case HSA_STATUS_ERROR_EXCEPTION: *status_string = "HSA_STATUS_ERROR_EXCEPTION: An HSAIL operation resulted in a hardware exception."; break;
+      case HSA_EXT_STATUS_ERROR_INVALID_PROGRAM: *status_string = "HSA_EXT_STATUS_ERROR_INVALID_PROGRAM: The HSAIL program is invalid."; break;
+      case HSA_EXT_STATUS_ERROR_INVALID_MODULE: *status_string = "HSA_EXT_STATUS_ERROR_INVALID_MODULE: The HSAIL module is invalid."; break;
+      case HSA_EXT_STATUS_ERROR_MODULE_ALREADY_INCLUDED: *status_string = "HSA_EXT_STATUS_ERROR_MODULE_ALREADY_INCLUDED: The HSAIL module is already a part of the HSAIL program."; break;
+      case HSA_EXT_STATUS_ERROR_FINALIZATION_FAILED: *status_string = "HSA_EXT_STATUS_ERROR_FINALIZATION_FAILED: Failed to finalize (no host implementation of a kernel)."; break;
+      default: *status_string = nullptr; return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   }
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_init() {
+   HsaMockRuntime::get().refCount++;
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_shut_down() {
+   HsaMockRuntime& rt = HsaMockRuntime::get();
+   uint32_t refCount = rt.refCount.load();
+   do {
+      if (refCount == 0) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   } while (!rt.refCount.compare_exchange_weak(refCount, refCount - 1));
+   if (refCount == 1) {
+      // Release the resources that are still in use.
+      rt.destroyQueues();
+   }
+   return HSA_STATUS_SUCCESS;
+}
+
+//===----------------------------------------------------------------------===//
+// System and agent information
+//===----------------------------------------------------------------------===//
+
+hsa_status_t hsa_system_get_info(hsa_system_info_t attribute, void* value) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (value == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   switch (attribute) {
+      case HSA_SYSTEM_INFO_VERSION_MAJOR: return setInfo<uint16_t>(value, 1);
+      case HSA_SYSTEM_INFO_VERSION_MINOR: return setInfo<uint16_t>(value, 0);
+      case HSA_SYSTEM_INFO_TIMESTAMP:
+         return setInfo<uint64_t>(value, std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count());
+      case HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY: return setInfo<uint64_t>(value, 1000000000);
+      case HSA_SYSTEM_INFO_SIGNAL_MAX_WAIT: return setInfo<uint64_t>(value, UINT64_MAX);
+      case HSA_SYSTEM_INFO_ENDIANNESS: return setInfo(value, HSA_ENDIANNESS_LITTLE);
+      case HSA_SYSTEM_INFO_MACHINE_MODEL: return setInfo(value, HSA_MACHINE_MODEL_LARGE);
+      case HSA_SYSTEM_INFO_EXTENSIONS: {
+         // Only the finalizer extension (bit 0) is supported.
+         uint8_t extensions[128] = {1};
+         std::memcpy(value, extensions, sizeof(extensions));
+         return HSA_STATUS_SUCCESS;
+      }
+   }
+   return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+}
+
+hsa_status_t hsa_iterate_agents(hsa_status_t (*callback)(hsa_agent_t agent, void* data), void* data) {
+   HsaMockRuntime& rt = HsaMockRuntime::get();
+   if (!rt.isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (callback == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   hsa_status_t status = callback(toHandle<hsa_agent_t>(&rt.cpuAgent), data);
+   if (status != HSA_STATUS_SUCCESS) return status;
+   return callback(toHandle<hsa_agent_t>(&rt.kernelAgent), data);
+}
+
+hsa_status_t hsa_agent_get_info(hsa_agent_t agent, hsa_agent_info_t attribute, void* value) {
+   HsaMockRuntime& rt = HsaMockRuntime::get();
+   if (!rt.isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   const Agent* a = fromHandle<const Agent>(agent);
+   if (a != &rt.cpuAgent && a != &rt.kernelAgent) return HSA_STATUS_ERROR_INVALID_AGENT;
+   if (value == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   const bool isKernelAgent = a->feature == HSA_AGENT_FEATURE_KERNEL_DISPATCH;
+   switch (attribute) {
+      case HSA_AGENT_INFO_NAME: return setInfo(value, a->name, 64);
+      case HSA_AGENT_INFO_VENDOR_NAME: return setInfo(value, std::string("SIM[DT] Lab"), 64);
+      case HSA_AGENT_INFO_FEATURE: return setInfo(value, static_cast<hsa_agent_feature_t>(a->feature));
+      case HSA_AGENT_INFO_MACHINE_MODEL: return setInfo(value, HSA_MACHINE_MODEL_LARGE);
+      case HSA_AGENT_INFO_PROFILE: return setInfo(value, HSA_PROFILE_FULL);
+      case HSA_AGENT_INFO_DEFAULT_FLOAT_ROUNDING_MODE: return setInfo(value, HSA_DEFAULT_FLOAT_ROUNDING_MODE_NEAR);
+      case HSA_AGENT_INFO_BASE_PROFILE_DEFAULT_FLOAT_ROUNDING_MODES:
+         return setInfo<uint32_t>(value, HSA_DEFAULT_FLOAT_ROUNDING_MODE_NEAR);
+      case HSA_AGENT_INFO_FAST_F16_OPERATION: return setInfo(value, false);
+      case HSA_AGENT_INFO_WAVEFRONT_SIZE: return setInfo<uint32_t>(value, isKernelAgent ? 64 : 0);
+      case HSA_AGENT_INFO_WORKGROUP_MAX_DIM: {
+         const uint16_t dims[3] = {1024, 1, 1};
+         std::memcpy(value, dims, sizeof(dims));
+         return HSA_STATUS_SUCCESS;
+      }
+      case HSA_AGENT_INFO_WORKGROUP_MAX_SIZE: return setInfo<uint32_t>(value, isKernelAgent ? 1024 : 0);
+      case HSA_AGENT_INFO_GRID_MAX_DIM: {
+         const hsa_dim3_t dims = {UINT32_MAX, 1, 1};
+         return setInfo(value, dims);
+      }
+      case HSA_AGENT_INFO_GRID_MAX_SIZE: return setInfo<uint32_t>(value, isKernelAgent ? UINT32_MAX : 0);
+      case HSA_AGENT_INFO_FBARRIER_MAX_SIZE: return setInfo<uint32_t>(value, 0);
+      case HSA_AGENT_INFO_QUEUES_MAX: return setInfo<uint32_t>(value, isKernelAgent ? 128 : 0);
+      case HSA_AGENT_INFO_QUEUE_MIN_SIZE: return setInfo<uint32_t>(value, isKernelAgent ? minQueueSize : 0);
+      case HSA_AGENT_INFO_QUEUE_MAX_SIZE: return setInfo<uint32_t>(value, isKernelAgent ? maxQueueSize : 0);
+      case HSA_AGENT_INFO_QUEUE_TYPE: return setInfo(value, HSA_QUEUE_TYPE_MULTI);
+      case HSA_AGENT_INFO_NODE: return setInfo<uint32_t>(value, a->node);
+      case HSA_AGENT_INFO_DEVICE: return setInfo(value, a->deviceType);
+      case HSA_AGENT_INFO_CACHE_SIZE: {
+         const uint32_t cacheSizes[4] = {0, 0, 0, 0};
+         std::memcpy(value, cacheSizes, sizeof(cacheSizes));
+         return HSA_STATUS_SUCCESS;
+      }
+      case HSA_AGENT_INFO_ISA: return setInfo(value, toHandle<hsa_isa_t>(a->isa));
+      case HSA_AGENT_INFO_EXTENSIONS: {
+         uint8_t extensions[128] = {static_cast<uint8_t>(isKernelAgent ? 1 : 0)};
+         std::memcpy(value, extensions, sizeof(extensions));
+         return HSA_STATUS_SUCCESS;
+      }
+      case HSA_AGENT_INFO_VERSION_MAJOR: return setInfo<uint16_t>(value, 1);
+      case HSA_AGENT_INFO_VERSION_MINOR: return setInfo<uint16_t>(value, 0);
+   }
+   return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+}
+
+hsa_status_t hsa_isa_get_info(hsa_isa_t isa, hsa_isa_info_t attribute, uint32_t index, void* value) {
+   HsaMockRuntime& rt = HsaMockRuntime::get();
+   if (!rt.isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (fromHandle<const Isa>(isa) != &rt.isa) return HSA_STATUS_ERROR_INVALID_ISA;
+   if (value == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   switch (attribute) {
+      case HSA_ISA_INFO_NAME_LENGTH: return setInfo<uint32_t>(value, rt.isa.name.size());
+      case HSA_ISA_INFO_NAME: std::memcpy(value, rt.isa.name.c_str(), rt.isa.name.size()); return HSA_STATUS_SUCCESS;
+      case HSA_ISA_INFO_CALL_CONVENTION_COUNT: return setInfo<uint32_t>(value, 1);
+      case HSA_ISA_INFO_CALL_CONVENTION_INFO_WAVEFRONT_SIZE:
+         return index == 0 ? setInfo<uint32_t>(value, 64) : HSA_STATUS_ERROR_INVALID_INDEX;
+      case HSA_ISA_INFO_CALL_CONVENTION_INFO_WAVEFRONTS_PER_COMPUTE_UNIT:
+         return index == 0 ? setInfo<uint32_t>(value, 1) : HSA_STATUS_ERROR_INVALID_INDEX;
+   }
+   return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+}
+
+//===----------------------------------------------------------------------===//
+// Memory
+//===----------------------------------------------------------------------===//
+
+hsa_status_t hsa_agent_iterate_regions(hsa_agent_t agent, hsa_status_t (*callback)(hsa_region_t region, void* data),
+      void* data) {
+   HsaMockRuntime& rt = HsaMockRuntime::get();
+   if (!rt.isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   const Agent* a = fromHandle<const Agent>(agent);
+   if (a != &rt.cpuAgent && a != &rt.kernelAgent) return HSA_STATUS_ERROR_INVALID_AGENT;
+   if (callback == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   for (const hsa_region_t region : a->regions) {
+      const hsa_status_t status = callback(region, data);
+      if (status != HSA_STATUS_SUCCESS) return status;
+   }
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_region_get_info(hsa_region_t region, hsa_region_info_t attribute, void* value) {
+   HsaMockRuntime& rt = HsaMockRuntime::get();
+   if (!rt.isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   const Region* r = fromHandle<const Region>(region);
+   if (r != &rt.globalRegion && r != &rt.groupRegion) return HSA_STATUS_ERROR_INVALID_REGION;
+   if (value == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   switch (attribute) {
+      case HSA_REGION_INFO_SEGMENT: return setInfo(value, r->segment);
+      case HSA_REGION_INFO_GLOBAL_FLAGS: return setInfo<uint32_t>(value, r->globalFlags);
+      case HSA_REGION_INFO_SIZE: return setInfo<size_t>(value, r->size);
+      case HSA_REGION_INFO_ALLOC_MAX_SIZE: return setInfo<size_t>(value, r->allocAllowed ? r->size : 0);
+      case HSA_REGION_INFO_RUNTIME_ALLOC_ALLOWED: return setInfo(value, r->allocAllowed);
+      case HSA_REGION_INFO_RUNTIME_ALLOC_GRANULE: return setInfo<size_t>(value, r->allocAllowed ? allocAlignment : 0);
+      case HSA_REGION_INFO_RUNTIME_ALLOC_ALIGNMENT: return setInfo<size_t>(value, r->allocAllowed ? allocAlignment : 0);
+   }
+   return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+}
+
+hsa_status_t hsa_memory_allocate(hsa_region_t region, size_t size, void** ptr) {
+   HsaMockRuntime& rt = HsaMockRuntime::get();
+   if (!rt.isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   const Region* r = fromHandle<const Region>(region);
+   if (r != &rt.globalRegion && r != &rt.groupRegion) return HSA_STATUS_ERROR_INVALID_REGION;
+   if (ptr == nullptr || size == 0) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   if (!r->allocAllowed || size > r->size) return HSA_STATUS_ERROR_INVALID_ALLOCATION;
+   if (posix_memalign(ptr, allocAlignment, size) != 0) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_memory_free(void* ptr) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   free(ptr);
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_memory_copy(void* dst, const void* src, size_t size) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (dst == nullptr || src == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   std::memmove(dst, src, size);
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_memory_assign_agent(void* ptr, hsa_agent_t /* agent */, int /* access */) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (ptr == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   return HSA_STATUS_SUCCESS;
+}
+
+// All host memory is accessible by the kernel agent. Thus, there is nothing to register.
+
+hsa_status_t hsa_memory_register(void* ptr, size_t size) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (ptr == nullptr && size != 0) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_memory_deregister(void* /* ptr */, size_t /* size */) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   return HSA_STATUS_SUCCESS;
+}
+
+//===----------------------------------------------------------------------===//
+// Signals (see HsaHostSignal)
+//===----------------------------------------------------------------------===//
+
+hsa_status_t hsa_signal_create(hsa_signal_value_t initial_value, uint32_t num_consumers,
+      const hsa_agent_t* consumers, hsa_signal_t* signal) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (signal == nullptr || (num_consumers != 0 && consumers == nullptr)) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   *signal = HsaHostSignal::create(initial_value);
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_signal_destroy(hsa_signal_t signal) {
+   if (!HsaMockRuntime::get().isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (signal.handle == 0) return HSA_STATUS_ERROR_INVALID_SIGNAL;
+   HsaHostSignal::destroy(signal);
+   return HSA_STATUS_SUCCESS;
+}
+
+// Host signals are sequentially consistent, which satisfies all memory orders.
+
+hsa_signal_value_t hsa_signal_load_acquire(hsa_signal_t signal) {
+   return HsaHostSignal::load(signal);
+}
+
+hsa_signal_value_t hsa_signal_load_relaxed(hsa_signal_t signal) {
+   return HsaHostSignal::load(signal);
+}
+
+void hsa_signal_store_relaxed(hsa_signal_t signal, hsa_signal_value_t value) {
+   HsaHostSignal::store(signal, value);
+}
+
+void hsa_signal_store_release(hsa_signal_t signal, hsa_signal_value_t value) {
+   HsaHostSignal::store(signal, value);
+}
+
+void hsa_signal_add_acq_rel(hsa_signal_t signal, hsa_signal_value_t value) {
+   HsaHostSignal::add(signal, value);
+}
+
+void hsa_signal_add_acquire(hsa_signal_t signal, hsa_signal_value_t value) {
+   HsaHostSignal::add(signal, value);
+}
+
+void hsa_signal_add_relaxed(hsa_signal_t signal, hsa_signal_value_t value) {
+   HsaHostSignal::add(signal, value);
+}
+
+void hsa_signal_add_release(hsa_signal_t signal, hsa_signal_value_t value) {
+   HsaHostSignal::add(signal, value);
+}
+
+void hsa_signal_subtract_acq_rel(hsa_signal_t signal, hsa_signal_value_t value) {
+   HsaHostSignal::subtract(signal, value);
+}
+
+void hsa_signal_subtract_acquire(hsa_signal_t signal, hsa_signal_value_t value) {
+   HsaHostSignal::subtract(signal, value);
+}
+
+void hsa_signal_subtract_relaxed(hsa_signal_t signal, hsa_signal_value_t value) {
+   HsaHostSignal::subtract(signal, value);
+}
+
+void hsa_signal_subtract_release(hsa_signal_t signal, hsa_signal_value_t value) {
+   HsaHostSignal::subtract(signal, value);
+}
+
+hsa_signal_value_t hsa_signal_wait_acquire(hsa_signal_t signal, hsa_signal_condition_t condition,
+      hsa_signal_value_t compare_value, uint64_t timeout_hint, hsa_wait_state_t wait_state_hint) {
+   return HsaHostSignal::wait(signal, condition, compare_value, timeout_hint, wait_state_hint);
+}
+
+hsa_signal_value_t hsa_signal_wait_relaxed(hsa_signal_t signal, hsa_signal_condition_t condition,
+      hsa_signal_value_t compare_value, uint64_t timeout_hint, hsa_wait_state_t wait_state_hint) {
+   return HsaHostSignal::wait(signal, condition, compare_value, timeout_hint, wait_state_hint);
+}
+
+//===----------------------------------------------------------------------===//
+// Queues (see HsaAqlPacketProcessor)
+//===----------------------------------------------------------------------===//
+
+hsa_status_t hsa_queue_create(hsa_agent_t agent, uint32_t size, hsa_queue_type_t type,
+      void (*callback)(hsa_status_t status, hsa_queue_t* source, void* data), void* data,
+      uint32_t /* private_segment_size */, uint32_t /* group_segment_size */, hsa_queue_t** queue) {
+   HsaMockRuntime& rt = HsaMockRuntime::get();
+   if (!rt.isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   const Agent* a = fromHandle<const Agent>(agent);
+   if (a != &rt.cpuAgent && a != &rt.kernelAgent) return HSA_STATUS_ERROR_INVALID_AGENT;
+   if (a != &rt.kernelAgent) return HSA_STATUS_ERROR_INVALID_QUEUE_CREATION;
+   if (queue == nullptr || !isPowerOfTwo(size) || size > maxQueueSize
+         || (type != HSA_QUEUE_TYPE_MULTI && type != HSA_QUEUE_TYPE_SINGLE)) {
+      return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+   }
+
+   // The callback needs the queue, which does not exist yet.
+   hsa_queue_t** source = new hsa_queue_t*(nullptr);
+   HsaAqlPacketProcessor::ErrorCallback errorCallback;
+   if (callback != nullptr) {
+      errorCallback = [callback, data, source](hsa_status_t status) {
+         callback(status, *source, data);
+      };
+   }
+   HsaAqlPacketProcessor* processor;
+   try {
+      processor = new HsaAqlPacketProcessor(std::max(size, minQueueSize), rt.numThreadsPerQueue, errorCallback);
+   }
+   catch (const std::bad_alloc&) {
+      delete source;
+      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+   }
+   *source = processor->getQueue();
+   processor->getQueue()->type = type;
+   rt.addQueue(processor);
+   *queue = processor->getQueue();
+   // The source pointer is never released, as it might be used by a worker until the queue is destroyed.
+   return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t hsa_queue_destroy(hsa_queue_t* queue) {
+   HsaMockRuntime& rt = HsaMockRuntime::get();
+   if (!rt.isInitialized()) return HSA_STATUS_ERROR_NOT_INITIALIZED;
+   if (queue == nullptr) return HSA_STATUS_ERROR_INVALID_QUEUE;
+   HsaAqlPacketProcessor* processor = HsaAqlPacketProcessor::fromQueue(queue);
+   rt.removeQueue(processor);
+   delete processor;
+   return HSA_STATUS_SUCCESS;
+}
+
+uint64_t hsa_queue_load_read_index_acquire(const hsa_queue_t* queue) {
+   return HsaAqlPacketProcessor::fromQueue(queue)->loadReadIndex();
+}
+
+uint64_t hsa_queue_load_read_index_relaxed(const hsa_queue_t* queue) {
+   return HsaAqlPacketProcessor::fromQueue(queue)->loadReadIndex();
+}
+
+uint64_t hsa_queue_load_write_index_acquire(const hsa_queue_t* queue) {
+   return HsaAqlPacketProcessor::fromQueue(queue)->loadWriteIndex();
+}
+
+uint64_t hsa_queue_load_write_index_relaxed(const hsa_queue_t* queue) {
+   return HsaAqlPacketProcessor::fromQueue(queue)->loadWriteIndex();
+}
+
+void hsa_queue_store_write_index_relaxed(const hsa_queue_t* queue, uint64_t value) {
+   HsaAqlPacketProcessor::fromQueue(queue)->storeWriteIndex(value);
+}
+
+void hsa_queue_store_write_index_release(const hsa_queue_t* queue, uint64_t value) {
+   HsaAqlPacketProcessor::fromQueue(queue)->storeWriteIndex(value);
+}
+
+uint64_t hsa_queue_cas_write_index_acq_rel(const hsa_queue_t* queue, uint64_t expected, uint64_t value) {
+   return HsaAqlPacketProcessor::fromQueue(queue)->casWriteIndex(expected, value);
+}
+
+uint64_t hsa_queue_cas_write_index_acquire(const hsa_queue_t* queue, uint64_t expected, uint64_t value) {
+   return HsaAqlPacketProcessor::fromQueue(queue)->casWriteIndex(expected, value);
+}
+
+uint64_t hsa_queue_cas_write_index_relaxed(const hsa_queue_t* queue, uint64_t expected, uint64_t value) {
+   return HsaAqlPacketProcessor::fromQueue(queue)->casWriteIndex(expected, value);
+}
+
+uint64_t hsa_queue_cas_write_index_release(const hsa_queue_t* queue, uint64_t expected, uint64_t value) {
+   return HsaAqlPacketProcessor::fromQueue(queue)->casWriteIndex(expected, value);
+}
+
+uint64_t hsa_queue_add_write_index_acq_rel(const hsa_queue_t* queue, uint64_t value) {
+   return HsaAqlPacketProcessor::fromQueue(queue)->addWriteIndex(value);
+}
+
+uint64_t hsa_queue_add_write_index_acquire(const hsa_queue_t* queue, uint64_t value) {
+   return HsaAqlPacketProcessor::fromQueue(queue)->addWriteIndex(value);
+}
+
+uint64_t hsa_queue_add_write_index_relaxed(const hsa_queue_t* queue, uint64_t value) {
+   return HsaAqlPacketProcessor::fromQueue(queue)->addWriteIndex(value);
+}
+
+uint64_t hsa_queue_add_write_index_release(const hsa_queue_t* queue, uint64_t value) {
+   return HsaAqlPacketProcessor::fromQueue(queue)->addWriteIndex(value);
+}
+
+} // extern "C"
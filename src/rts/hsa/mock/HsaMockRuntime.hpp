@@ -0,0 +1,143 @@
+#pragma once
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+#include <rts/hsa/HsaAqlPacketProcessor.hpp>
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <atomic>
+#include <deque>
+#include <hsa.h>
+#include <hsa_ext_finalize.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rts {
+namespace hsa {
+namespace mock {
+
+// The objects behind the handles of the mock runtime. A handle is the
+// address of the corresponding object.
+
+struct Isa {
+   std::string name;
+};
+
+struct Agent {
+   std::string name;
+   hsa_device_type_t deviceType;
+   uint32_t feature;
+   uint32_t node;
+   /// Not set for agents that do not support kernel dispatch.
+   const Isa* isa;
+   std::vector<hsa_region_t> regions;
+};
+
+struct Region {
+   hsa_region_segment_t segment;
+   uint32_t globalFlags;
+   size_t size;
+   bool allocAllowed;
+};
+
+/// A kernel symbol. The kernel object is the address of the host kernel.
+struct Symbol {
+   std::string name;
+   std::string moduleName;
+   const HsaHostKernel* kernel;
+   /// Only set for executable symbols.
+   hsa_agent_t agent;
+};
+
+/// The (relevant) contents of a BRIG module.
+struct Module {
+   const void* brig;
+   std::string name;
+   std::vector<std::string> kernelNames;
+};
+
+struct Program {
+   hsa_machine_model_t machineModel;
+   hsa_profile_t profile;
+   hsa_default_float_rounding_mode_t roundingMode;
+   std::vector<Module> modules;
+};
+
+struct CodeObject {
+   hsa_machine_model_t machineModel;
+   hsa_profile_t profile;
+   hsa_default_float_rounding_mode_t roundingMode;
+   const Isa* isa;
+   /// A deque, because the symbol handles point to its elements.
+   std::deque<Symbol> symbols;
+};
+
+struct Executable {
+   hsa_profile_t profile;
+   hsa_executable_state_t state;
+   std::deque<Symbol> symbols;
+};
+
+template<typename T, typename Handle>
+static inline T* fromHandle(const Handle handle) {
+   return reinterpret_cast<T*>(handle.handle);
+}
+
+template<typename Handle, typename T>
+static inline Handle toHandle(const T* object) {
+   Handle handle;
+   handle.handle = reinterpret_cast<uint64_t>(object);
+   return handle;
+}
+
+/// The global state of the mock runtime.
+class HsaMockRuntime {
+public:
+   static HsaMockRuntime& get();
+
+   bool isInitialized() const {
+      return refCount.load() != 0;
+   }
+
+   std::atomic<uint32_t> refCount;
+
+   Isa isa;
+   Region globalRegion;
+   Region groupRegion;
+   Agent cpuAgent;
+   Agent kernelAgent;
+
+   /// The number of worker threads per queue (HSA_MOCK_NUM_THREADS, defaults
+   /// to the number of processors).
+   uint32_t numThreadsPerQueue;
+
+   void registerKernel(const HsaHostKernel& kernel, const std::string& moduleName);
+
+   /// Returns the host implementation of a kernel (or nullptr). Kernels that
+   /// have been registered for the given module take precedence.
+   const HsaHostKernel* findKernel(const std::string& moduleName, const std::string& symbolName);
+
+   /// The queues are destroyed when the runtime is shut down.
+   void addQueue(HsaAqlPacketProcessor* processor);
+
+   void removeQueue(HsaAqlPacketProcessor* processor);
+
+   void destroyQueues();
+
+private:
+   HsaMockRuntime();
+
+   std::mutex mutex;
+   /// A deque, because the kernel objects point to its elements.
+   std::deque<HsaHostKernel> kernels;
+   std::map<std::pair<std::string, std::string>, const HsaHostKernel*> kernelsByName;
+   std::set<HsaAqlPacketProcessor*> queues;
+};
+
+}
+}
+}
@@ -0,0 +1,6 @@
+src_rts_hsa_mock:= \
+	src/rts/hsa/mock/HsaMockFinalizer.cpp \
+	src/rts/hsa/mock/HsaMockRuntime.cpp \
+	src/rts/hsa/HsaAgent.cpp \
+	src/rts/hsa/HsaAqlPacketProcessor.cpp \
+	src/rts/hsa/HsaHostSignal.cpp
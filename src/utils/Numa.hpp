@@ -0,0 +1,196 @@
+#pragma once
+//---------------------------------------------------------------------------
+#include <utils/Utils.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <new>
+#include <sched.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+/// NUMA topology (discovered from /sys), node-local huge page allocation and thread placement
+class Numa {
+public:
+
+   /// A NUMA node and its CPUs
+   struct Node {
+      uint32_t id;
+      vector<uint32_t> cpus;
+   };
+
+   /// The NUMA nodes (discovered once). Without NUMA support, there is a single node with all processors
+   static const vector<Node>& nodes() {
+      static const vector<Node> topology=discoverTopology();
+      return topology;
+   }
+
+   static inline uint32_t numNodes() {
+      return nodes().size();
+   }
+
+   /// The node of the given CPU
+   static uint32_t nodeOfCpu(const uint32_t cpu) {
+      for (const Node& node : nodes()) {
+         if (find(node.cpus.begin(),node.cpus.end(),cpu)!=node.cpus.end()) {
+            return node.id;
+         }
+      }
+      return nodes()[0].id;
+   }
+
+   /// The node that holds the (touched) page at the given address, -1 if unknown
+   static int nodeOfAddress(const void* p) {
+      int node=-1;
+      if (syscall(SYS_get_mempolicy,&node,nullptr,0,const_cast<void*>(p),MPOL_F_NODE|MPOL_F_ADDR)!=0) {
+         return -1;
+      }
+      return node;
+   }
+
+   /// Memory allocation (huge pages) on the given node. The pages are placed once they are touched (see firstTouch)
+   static void* mallocHugeOnNode(size_t size,const uint32_t node) {
+      void* p=Utils::mallocHuge(size);
+      const unsigned long mask=nodeMask(node);
+      bind(p,size,MPOL_BIND,&mask);
+      return p;
+   }
+
+   /// Memory allocation (huge pages) interleaved across all nodes
+   static void* mallocHugeInterleaved(size_t size) {
+      void* p=Utils::mallocHuge(size);
+      unsigned long mask=0;
+      for (const Node& node : nodes()) {
+         mask|=nodeMask(node.id);
+      }
+      bind(p,size,MPOL_INTERLEAVE,&mask);
+      return p;
+   }
+
+   /// Touches (zeroes) the memory with one thread per CPU of the given node, so that the page faults are
+   /// served in parallel and pages without a memory policy are placed on that node
+   static void firstTouch(void* p,size_t size,const uint32_t node) {
+      const vector<uint32_t>& cpus=nodeById(node).cpus;
+      const size_t chunkSize=(size/cpus.size()+pageSize-1)/pageSize*pageSize;
+      vector<thread> threads;
+      for (size_t i=0;i<cpus.size() && i*chunkSize<size;i++) {
+         threads.emplace_back([=] {
+            pinToCpus({cpus[i]});
+            memset(reinterpret_cast<char*>(p)+i*chunkSize,0,min(chunkSize,size-i*chunkSize));
+         });
+      }
+      for (thread& t : threads) {
+         t.join();
+      }
+   }
+
+   /// Thread affinitizer: pins the calling thread to a CPU of the given node (round robin)
+   static void setAffinity(const uint32_t threadId,const uint32_t node) {
+      const vector<uint32_t>& cpus=nodeById(node).cpus;
+      if (!pinToCpus({cpus[threadId%cpus.size()]})) {
+         cout<<"Failed to set CPU affinity."<<endl;
+      }
+   }
+
+   /// Pins the calling thread to all CPUs of the given node (the scheduler may move it within the node)
+   static void setNodeAffinity(const uint32_t node) {
+      if (!pinToCpus(nodeById(node).cpus)) {
+         cout<<"Failed to set CPU affinity."<<endl;
+      }
+   }
+
+private:
+
+   static const size_t pageSize=4096;
+
+   static const Node& nodeById(const uint32_t id) {
+      for (const Node& node : nodes()) {
+         if (node.id==id) {
+            return node;
+         }
+      }
+      return nodes()[0];
+   }
+
+   static inline unsigned long nodeMask(const uint32_t node) {
+      return node<sizeof(unsigned long)*8 ? 1ul<<node : 0;
+   }
+
+   /// Sets the memory policy of the range, the policy is ignored (the pages are placed by the kernel)
+   /// if NUMA is not supported
+   static void bind(void* p,size_t size,const int mode,const unsigned long* mask) {
+      if (numNodes()<2 || *mask==0) return;
+      if (syscall(SYS_mbind,p,size,mode,mask,sizeof(unsigned long)*8,0)!=0) {
+         cout<<"Failed to set the NUMA memory policy."<<endl;
+      }
+   }
+
+   static bool pinToCpus(const vector<uint32_t>& cpus) {
+      cpu_set_t mask;
+      CPU_ZERO(&mask);
+      for (const uint32_t cpu : cpus) {
+         CPU_SET(cpu,&mask);
+      }
+      return sched_setaffinity(0,sizeof(mask),&mask)==0;
+   }
+
+   /// Parses a list such as "0-3,8,10-11"
+   static vector<uint32_t> parseList(const string& list) {
+      vector<uint32_t> values;
+      size_t pos=0;
+      while (pos<list.size()) {
+         size_t end=list.find(',',pos);
+         if (end==string::npos) end=list.size();
+         const string range=list.substr(pos,end-pos);
+         const size_t dash=range.find('-');
+         try {
+            const uint32_t first=stoul(range.substr(0,dash));
+            const uint32_t last=dash==string::npos ? first : stoul(range.substr(dash+1));
+            for (uint32_t v=first;v<=last;v++) {
+               values.push_back(v);
+            }
+         } catch (...) {
+            // ignore malformed entries (e.g., an empty list)
+         }
+         pos=end+1;
+      }
+      return values;
+   }
+
+   static string readLine(const string& fileName) {
+      ifstream in(fileName.c_str());
+      string line;
+      getline(in,line);
+      return line;
+   }
+
+   static vector<Node> discoverTopology() {
+      vector<Node> topology;
+      for (const uint32_t id : parseList(readLine("/sys/devices/system/node/online"))) {
+         Node node;
+         node.id=id;
+         node.cpus=parseList(readLine("/sys/devices/system/node/node"+to_string(id)+"/cpulist"));
+         // memory-only nodes have no CPUs to place threads on
+         if (!node.cpus.empty()) {
+            topology.push_back(node);
+         }
+      }
+      if (topology.empty()) {
+         Node node;
+         node.id=0;
+         for (uint32_t cpu=0;cpu<Utils::numProcessors();cpu++) {
+            node.cpus.push_back(cpu);
+         }
+         topology.push_back(node);
+      }
+      return topology;
+   }
+};
+//---------------------------------------------------------------------------
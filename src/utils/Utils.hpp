@@ -1,8 +1,10 @@
 #pragma once
 //---------------------------------------------------------------------------
+#include <atomic>
 #include <chrono>
 #include <fstream>
 #include <iostream>
+#include <new>
 #include <sched.h>
 #include <stdio.h>
 #include <string.h>
@@ -18,19 +20,32 @@ public:
    /// Memory allocation (huge pages)
    static inline void* mallocHuge(size_t size) {
       void* p=mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+      if (p==MAP_FAILED) {
+         cout<<"Failed to allocate "<<size<<" bytes."<<endl;
+         throw bad_alloc();
+      }
       madvise(p,size,MADV_HUGEPAGE);
       return p;
    }
 
+   /// Called by freeHuge before the memory is unmapped (e.g., to undo the registration of the memory with the HSA runtime)
+   typedef void (*FreeHugeHook)(void* ptr,size_t size);
+   static inline atomic<FreeHugeHook>& freeHugeHook() {
+      static atomic<FreeHugeHook> hook(nullptr);
+      return hook;
+   }
+
    /// Free allocated huge pages
    static inline void freeHuge(void* ptr,size_t size) {
+      FreeHugeHook hook=freeHugeHook().load();
+      if (hook) {
+         hook(ptr,size);
+      }
       munmap(ptr,size);
    }
 
    static inline void* mallocHugeAndSet(size_t size) {
-      void* p=mmap(NULL,size,PROT_READ|PROT_WRITE,
-      MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
-      madvise(p,size,MADV_HUGEPAGE);
+      void* p=mallocHuge(size);
       memset(p,0,size);
       return p;
    }
@@ -52,6 +67,13 @@ public:
 #endif
    }
 
+   /// Spin-wait hint (reduces power consumption and the penalty when leaving the spin loop)
+   static inline void pause() {
+#if defined(__x86_64__) && defined(__GNUC__)
+      __builtin_ia32_pause();
+#endif
+   }
+
    /// Determine the number of processors
    static int64_t numProcessors() {
       int64_t n=sysconf(_SC_NPROCESSORS_ONLN);
@@ -62,11 +84,12 @@ public:
       return n;
    }
 
-   /// Thread affinitizer
+   /// Thread affinitizer (ignores the NUMA topology, see Numa::setAffinity)
    static void setAffinity(const uint32_t threadId) {
+      static const int64_t n=numProcessors();
       cpu_set_t mask;
       CPU_ZERO(&mask);
-      CPU_SET(threadId%numProcessors(),&mask);
+      CPU_SET(threadId%n,&mask);
       int result=sched_setaffinity(0,sizeof(mask),&mask);
       if (result!=0) {
          cout<<"Failed to set CPU affinity."<<endl;
@@ -3,5 +3,22 @@ include test/rts/hsa/kernel/LocalMakefile.mk
 src_test_rts_hsa:= \
 	$(src_test_rts_hsa_kernel) \
 	test/rts/hsa/TestHsa.cpp \
+	test/rts/hsa/TestHsaAutotuner.cpp \
+	test/rts/hsa/TestHsaCodeObjectCache.cpp \
+	test/rts/hsa/TestHsaConstantArena.cpp \
 	test/rts/hsa/TestHsaContext.cpp \
-	test/rts/hsa/TestHsaPerformance.cpp
\ No newline at end of file
+	test/rts/hsa/TestHsaExecutableRegistry.cpp \
+	test/rts/hsa/TestHsaFuture.cpp \
+	test/rts/hsa/TestHsaKernargSlab.cpp \
+	test/rts/hsa/TestHsaKernelSignature.cpp \
+	test/rts/hsa/TestHsaKernelTable.cpp \
+	test/rts/hsa/TestHsaMemoryPool.cpp \
+	test/rts/hsa/TestHsaModuleSource.cpp \
+	test/rts/hsa/TestHsaNativeAgent.cpp \
+	test/rts/hsa/TestHsaOccupancy.cpp \
+	test/rts/hsa/TestHsaPerformance.cpp \
+	test/rts/hsa/TestHsaRegistrationCache.cpp \
+	test/rts/hsa/TestHsaSignalPool.cpp \
+	test/rts/hsa/TestHsaSoftAqlAgent.cpp \
+	test/rts/hsa/TestHsaTaskGraph.cpp \
+	test/rts/hsa/TestHsaTaskServer.cpp
\ No newline at end of file
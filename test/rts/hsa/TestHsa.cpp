@@ -6,7 +6,7 @@
 #include <rts/hsa/HsaRuntime.hpp>
 #include <rts/hsa/HsaUtils.hpp>
 #include <rts/hsa/KernelArgs.hpp>
-#include <fstream>
+#include <test/rts/hsa/kernel/EmbeddedKernels.hpp>
 #include <memory>
 #include <atomic>
 #include <limits>
@@ -302,21 +302,9 @@ static void finalize() {
       ASSERT_HSA_STATUS(HSA_STATUS_SUCCESS, status);
 
       // Add the BRIG to the program (add module)
-//		auto module = reinterpret_cast<hsa_ext_module_t>(rts::hsa::kernel::StoreGlobalIdKernelBrig);
-//		status = hsa_ext_program_add_module(program, (hsa_ext_module_t)(rts::hsa::kernel::StoreGlobalIdKernelBrig));
-//		ASSERT_HSA_STATUS(HSA_STATUS_SUCCESS, status);
-
-      // TODO fix loading from file
-      const string filename = "bin/test/rts/hsa/kernel/StoreGlobalId.brig";
-      ifstream file(filename, ifstream::binary);
-      if (file.fail()) {
-         throw "couldn't open file: " + filename;
-      }
-      string contents((istreambuf_iterator<char>(file)), (istreambuf_iterator<char>()));
-      if (contents.substr(0, 8) != "HSA BRIG") {
-         throw "invalid magic number";
-      }
-      status = hsa_ext_program_add_module(program, (hsa_ext_module_t) contents.c_str());
+      const HsaModuleSource module(rts::hsa::kernel::StoreGlobalIdKernelBrig,
+            rts::hsa::kernel::StoreGlobalIdKernelBrigSize);
+      status = hsa_ext_program_add_module(program, (hsa_ext_module_t) module.getData());
       ASSERT_HSA_STATUS(HSA_STATUS_SUCCESS, status);
 
       hsa_agent_t kernelAgent = determineKernelAgent();
@@ -0,0 +1,160 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaAutotuner.hpp>
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaNativeAgent.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+typedef HsaAgent::KernelLaunchParameters KernelLaunchParameters;
+
+static string profilePath() {
+   return "/tmp/HsaAutotuner." + to_string(getpid()) + ".profile";
+}
+
+TEST(HsaAutotuner, SizeClass) {
+   ASSERT_EQ(0u, HsaAutotuner::getSizeClass(0));
+   ASSERT_EQ(0u, HsaAutotuner::getSizeClass(1));
+   ASSERT_EQ(1u, HsaAutotuner::getSizeClass(2));
+   ASSERT_EQ(1u, HsaAutotuner::getSizeClass(3));
+   ASSERT_EQ(10u, HsaAutotuner::getSizeClass(1024));
+   ASSERT_EQ(10u, HsaAutotuner::getSizeClass(2047));
+   ASSERT_EQ(63u, HsaAutotuner::getSizeClass(UINT64_MAX));
+}
+
+TEST(HsaAutotuner, Tune) {
+   HsaAutotuner autotuner;
+   autotuner.setNumRepetitions(2);
+
+   // The trial of a work-group size of 256 is the fastest one.
+   vector<KernelLaunchParameters> candidates;
+   for (uint16_t workgroupSize : { 64, 128, 256, 512 }) {
+      candidates.push_back( { 1 << 20, workgroupSize });
+   }
+   uint32_t numTrials = 0;
+   ASSERT_EQ(0u, autotuner.getGeneration());
+   auto trial = [&](const KernelLaunchParameters& n) {
+      numTrials++;
+      const uint32_t distance = n.workgroupSize > 256 ? n.workgroupSize - 256 : 256 - n.workgroupSize;
+      this_thread::sleep_for(chrono::microseconds(distance * 20));
+   };
+
+   KernelLaunchParameters best = autotuner.tune("isa", "&__OpenCL_a_kernel", 20, candidates, trial);
+   ASSERT_EQ(256u, best.workgroupSize);
+   ASSERT_EQ(1u << 20, best.numElements);
+   ASSERT_EQ(8u, numTrials);
+   ASSERT_EQ(1u, autotuner.getGeneration());
+
+   // Tuned kernels are not run again, nothing new is stored.
+   best = autotuner.tune("isa", "&__OpenCL_a_kernel", 20, candidates, trial);
+   ASSERT_EQ(256u, best.workgroupSize);
+   ASSERT_EQ(8u, numTrials);
+   ASSERT_EQ(1u, autotuner.getGeneration());
+
+   // Other size classes, ISAs and kernels are tuned separately.
+   ASSERT_TRUE(autotuner.find("isa", "&__OpenCL_a_kernel", 20, best));
+   ASSERT_FALSE(autotuner.find("isa", "&__OpenCL_a_kernel", 21, best));
+   ASSERT_FALSE(autotuner.find("other", "&__OpenCL_a_kernel", 20, best));
+   ASSERT_FALSE(autotuner.find("isa", "&__OpenCL_b_kernel", 20, best));
+   ASSERT_EQ(1u, autotuner.size());
+
+   ASSERT_THROW(autotuner.tune("isa", "&__OpenCL_b_kernel", 20, { }, trial), HsaException);
+   ASSERT_THROW(autotuner.save(), HsaException);
+}
+
+TEST(HsaAutotuner, Profile) {
+   const string path = profilePath();
+   remove(path.c_str());
+   {
+      HsaAutotuner autotuner(path);
+      ASSERT_EQ(0u, autotuner.size());
+      autotuner.setNumRepetitions(1);
+      autotuner.tune("HSA-mock:host", "&__OpenCL_a_kernel", 10, { { 1024, 64 } }, [](const KernelLaunchParameters&) {});
+      autotuner.tune("native:4", "&__OpenCL_a_kernel", 30, { { 1u << 30, 512 } }, [](const KernelLaunchParameters&) {});
+   }
+   {
+      // The profile has been written by tune.
+      HsaAutotuner autotuner(path);
+      ASSERT_EQ(2u, autotuner.size());
+      KernelLaunchParameters n;
+      ASSERT_TRUE(autotuner.find("HSA-mock:host", "&__OpenCL_a_kernel", 10, n));
+      ASSERT_EQ(1024u, n.numElements);
+      ASSERT_EQ(64u, n.workgroupSize);
+      ASSERT_TRUE(autotuner.find("native:4", "&__OpenCL_a_kernel", 30, n));
+      ASSERT_EQ(1u << 30, n.numElements);
+      ASSERT_EQ(512u, n.workgroupSize);
+   }
+   {
+      ofstream out(path, ios::trunc);
+      out << "native:4\t&__OpenCL_a_kernel\tten\t1024\t64\n";
+   }
+   ASSERT_THROW(HsaAutotuner autotuner(path), HsaException);
+   remove(path.c_str());
+}
+
+TEST(HsaAutotuner, Dispatch) {
+   HsaNativeAgent agent(2);
+   atomic<uint64_t> numInvocations(0);
+   // The kernel is not idempotent.
+   agent.registerKernel(HsaHostKernel::forEachWorkItem<uint64_t*>("&__OpenCL_increment_kernel",
+         [&](uint64_t gid, uint64_t* dst) {
+            dst[gid]++;
+            numInvocations++;
+         }));
+   HsaContext ctx(agent);
+   ctx.createQueue();
+   const uint64_t n = 1000;
+   vector<uint64_t> output(10 * n);
+   ASSERT_THROW(ctx.tune<uint64_t*>("&__OpenCL_increment_kernel", n, output.data()), HsaException);
+
+   HsaAutotuner autotuner;
+   autotuner.setNumRepetitions(1);
+   autotuner.setWorkgroupSizeCandidates( { 64, 32 });
+   ctx.setAutotuner(&autotuner);
+
+   // Dispatches do not tune, the kernel runs once.
+   ctx.dispatch<uint64_t*>("&__OpenCL_increment_kernel", { n, 0 }, output.data());
+   ASSERT_EQ(n, numInvocations);
+   ASSERT_EQ(0u, autotuner.size());
+
+   // Tuning runs the kernel once per candidate, on the scratch buffer.
+   vector<uint64_t> scratch(n);
+   const uint16_t workgroupSize = ctx.tune<uint64_t*>("&__OpenCL_increment_kernel", n, scratch.data());
+   ASSERT_TRUE(workgroupSize == 32 || workgroupSize == 64);
+   ASSERT_EQ(3 * n, numInvocations);
+   KernelLaunchParameters tuned;
+   ASSERT_TRUE(autotuner.find(agent.getIsaName(), "&__OpenCL_increment_kernel",
+         HsaAutotuner::getSizeClass(n), tuned));
+   ASSERT_EQ(workgroupSize, tuned.workgroupSize);
+
+   // A tuned kernel is not run again, grids of the same size class use the
+   // tuned work-group size.
+   ASSERT_EQ(workgroupSize, ctx.tune<uint64_t*>("&__OpenCL_increment_kernel", n, scratch.data()));
+   ctx.dispatch<uint64_t*>("&__OpenCL_increment_kernel", { n - 1, 0 }, output.data());
+   ASSERT_EQ(4 * n - 1, numInvocations);
+   for (uint64_t i = 0; i < n; i++) {
+      ASSERT_EQ(i < n - 1 ? 2u : 1u, output[i]);
+   }
+
+   // Explicit work-group sizes are not tuned.
+   ctx.dispatch<uint64_t*>("&__OpenCL_increment_kernel", { 10 * n, 128 }, output.data());
+   ASSERT_EQ(14 * n - 1, numInvocations);
+   ASSERT_EQ(1u, autotuner.size());
+}
+
+} // namespace
@@ -0,0 +1,183 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaAqlAgent.hpp>
+#include <rts/hsa/HsaCodeObjectCache.hpp>
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaRuntime.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+/// A fresh cache directory per test.
+class HsaCodeObjectCacheTest : public ::testing::Test {
+protected:
+   string directory;
+
+   void SetUp() override {
+      const ::testing::TestInfo* test = ::testing::UnitTest::GetInstance()->current_test_info();
+      directory = "/tmp/HsaCodeObjectCache." + to_string(getpid()) + "." + test->name();
+      mkdir(directory.c_str(), 0755);
+   }
+
+   void TearDown() override {
+      remove(directory.c_str());
+   }
+};
+
+/// A BRIG module header without sections, followed by the body.
+static string brigModule(const string& body) {
+   string module(104, '\0');
+   memcpy(&module[0], "HSA BRIG", 8);
+   const uint64_t byteCount = module.size() + body.size();
+   memcpy(&module[16], &byteCount, sizeof(byteCount));
+   return module + body;
+}
+
+static string loadFromFile(const string& filename) {
+   ifstream file(filename, ifstream::binary);
+   if (file.fail()) {
+      throw "couldn't open file: " + filename;
+   }
+   return string((istreambuf_iterator<char>(file)), (istreambuf_iterator<char>()));
+}
+
+TEST_F(HsaCodeObjectCacheTest, Key) {
+   // The trailing bytes are not part of the module.
+   const string a = brigModule("a");
+   const string b = brigModule("b");
+   const string a2 = brigModule("a") + "garbage";
+   const string key = HsaCodeObjectCache::getKey({ a.c_str(), b.c_str() }, "isa", "");
+   ASSERT_EQ(16u, key.size());
+   ASSERT_EQ(key, HsaCodeObjectCache::getKey({ a2.c_str(), b.c_str() }, "isa", ""));
+
+   // Any change of the inputs changes the key.
+   ASSERT_NE(key, HsaCodeObjectCache::getKey({ b.c_str(), a.c_str() }, "isa", ""));
+   ASSERT_NE(key, HsaCodeObjectCache::getKey({ a.c_str() }, "isa", ""));
+   ASSERT_NE(key, HsaCodeObjectCache::getKey({ a.c_str(), b.c_str() }, "other isa", ""));
+   ASSERT_NE(key, HsaCodeObjectCache::getKey({ a.c_str(), b.c_str() }, "isa", "-O0"));
+   ASSERT_NE(HsaCodeObjectCache::getKey({ a.c_str() }, "isa", "b"),
+         HsaCodeObjectCache::getKey({ a.c_str() }, "isab", ""));
+}
+
+TEST_F(HsaCodeObjectCacheTest, StoreAndLoad) {
+   HsaCodeObjectCache cache(directory);
+   const string module = brigModule("module");
+   const string key = HsaCodeObjectCache::getKey({ module.c_str() }, "isa", "");
+   string data;
+   ASSERT_FALSE(cache.load(key, data));
+
+   const string codeObject = "code object";
+   cache.store(key, codeObject.data(), codeObject.size());
+   ASSERT_TRUE(cache.load(key, data));
+   ASSERT_EQ(codeObject, data);
+
+   // Replace the entry.
+   cache.store(key, "other", 5);
+   ASSERT_TRUE(cache.load(key, data));
+   ASSERT_EQ("other", data);
+
+   const HsaCodeObjectCache::Stats stats = cache.getStats();
+   ASSERT_EQ(2u, stats.numHits);
+   ASSERT_EQ(1u, stats.numMisses);
+   ASSERT_EQ(2u, stats.numStores);
+
+   // An entry is found under its key only.
+   const string otherKey = HsaCodeObjectCache::getKey({ module.c_str() }, "isa", "-O0");
+   rename(cache.getPath(key).c_str(), cache.getPath(otherKey).c_str());
+   ASSERT_FALSE(cache.load(otherKey, data));
+   ASSERT_NE(0, access(cache.getPath(otherKey).c_str(), F_OK));
+}
+
+TEST_F(HsaCodeObjectCacheTest, CorruptedEntry) {
+   HsaCodeObjectCache cache(directory);
+   const string key = HsaCodeObjectCache::getKey({}, "isa", "");
+   const string codeObject(1000, 'x');
+   cache.store(key, codeObject.data(), codeObject.size());
+   const string entry = loadFromFile(cache.getPath(key));
+
+   string data;
+   {
+      // Truncated
+      ofstream out(cache.getPath(key), ios::binary | ios::trunc);
+      out.write(entry.data(), entry.size() - 1);
+   }
+   ASSERT_FALSE(cache.load(key, data));
+   // The invalid entry is removed.
+   ASSERT_NE(0, access(cache.getPath(key).c_str(), F_OK));
+   {
+      // Modified
+      string modified = entry;
+      modified[modified.size() - 1] = 'y';
+      ofstream out(cache.getPath(key), ios::binary | ios::trunc);
+      out.write(modified.data(), modified.size());
+   }
+   ASSERT_FALSE(cache.load(key, data));
+   ASSERT_NE(0, access(cache.getPath(key).c_str(), F_OK));
+   {
+      // Not an entry at all
+      ofstream out(cache.getPath(key), ios::binary | ios::trunc);
+      out << "garbage";
+   }
+   ASSERT_FALSE(cache.load(key, data));
+   ASSERT_NE(0, access(cache.getPath(key).c_str(), F_OK));
+   ASSERT_EQ(0u, cache.getStats().numHits);
+}
+
+/// Finalizes the module with the given cache and checks the kernel.
+static void finalizeAndDispatch(HsaRuntime& rt, HsaCodeObjectCache& cache, const HsaModuleSource& module) {
+   HsaContext ctx(rt);
+   ctx.setCodeObjectCache(&cache);
+   ctx.addModule(module);
+   ctx.finalize();
+   ctx.createQueue();
+
+   const size_t n = 1024;
+   vector<size_t> output(n);
+   ctx.dispatch<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel", { n, 128 }, output.data(), n);
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i, output[i]);
+   }
+}
+
+TEST_F(HsaCodeObjectCacheTest, WarmStart) {
+   HsaRuntime rt;
+   rt.initialize();
+   HsaCodeObjectCache cache(directory);
+   const HsaModuleSource module = HsaModuleSource::map("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
+
+   // The cold start finalizes the module and stores the code object, the
+   // warm start loads it.
+   finalizeAndDispatch(rt, cache, module);
+   ASSERT_EQ(0u, cache.getStats().numHits);
+   ASSERT_EQ(1u, cache.getStats().numStores);
+   finalizeAndDispatch(rt, cache, module);
+   ASSERT_EQ(1u, cache.getStats().numHits);
+   ASSERT_EQ(1u, cache.getStats().numStores);
+
+   // An entry that cannot be deserialized is replaced.
+   HsaAqlAgent agent(rt);
+   const string key = HsaCodeObjectCache::getKey({ module.getData() }, agent.getIsaName(), "");
+   cache.store(key, "garbage", 7);
+   finalizeAndDispatch(rt, cache, module);
+   ASSERT_EQ(2u, cache.getStats().numHits);
+   ASSERT_EQ(3u, cache.getStats().numStores);
+   finalizeAndDispatch(rt, cache, module);
+   ASSERT_EQ(3u, cache.getStats().numHits);
+
+   cache.remove(key);
+   rt.shutDown();
+}
+
+} // namespace
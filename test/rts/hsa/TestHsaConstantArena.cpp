@@ -0,0 +1,163 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaConstant.hpp>
+#include <rts/hsa/HsaConstantArena.hpp>
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaNativeAgent.hpp>
+#include <rts/hsa/HsaSignalPool.hpp>
+#include <rts/hsa/HsaSoftAqlAgent.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+typedef array<uint32_t, 256> LookupTable;
+
+/// Maps the input values through a lookup table.
+static HsaHostKernel lookupKernel() {
+   return HsaHostKernel::forEachWorkItem<uint32_t*, const uint8_t*, HsaConstant<LookupTable>, size_t>("&lookup",
+         [](uint64_t gid, uint32_t* output, const uint8_t* input, HsaConstant<LookupTable> table, size_t n) {
+            if (gid < n) output[gid] = (*table)[input[gid]];
+         });
+}
+
+TEST(HsaConstantArena, Reclaim) {
+   HsaNativeAgent agent(1);
+   agent.createQueue(4);
+   HsaConstantArena arena(agent, 250);
+   ASSERT_EQ(256u, arena.getCapacity());
+
+   const hsa_signal_t firstSignal = agent.createSignal(1);
+   const hsa_signal_t secondSignal = agent.createSignal(1);
+   const hsa_signal_t thirdSignal = agent.createSignal(1);
+   const HsaConstantArena::Completion firstCompletion = { firstSignal, nullptr, 0 };
+   const HsaConstantArena::Completion secondCompletion = { secondSignal, nullptr, 0 };
+   const HsaConstantArena::Completion thirdCompletion = { thirdSignal, nullptr, 0 };
+   const uint64_t first = agent.requestPacketId();
+   const uint64_t second = agent.requestPacketId();
+   uint8_t* base = reinterpret_cast<uint8_t*>(arena.tryAllocate(first, firstCompletion, 100));
+   ASSERT_NE(nullptr, base);
+   ASSERT_EQ(base + 128, arena.tryAllocate(first, firstCompletion, 1));
+   ASSERT_EQ(base + 192, arena.tryAllocate(second, secondCompletion, 64));
+   ASSERT_EQ(256u, arena.getNumBytesInUse());
+
+   // The arena is full until the first packet has completed. That the agent
+   // has processed (fetched) the packet does not suffice.
+   const uint64_t third = agent.requestPacketId();
+   ASSERT_EQ(nullptr, arena.tryAllocate(third, thirdCompletion, 64));
+   agent.publishBarrierPacket(first, HsaBarrierType::And, nullptr, 0, hsa_signal_t { 0 });
+   agent.ringDoorbell(first);
+   while (agent.loadReadIndex() <= first) {
+   }
+   ASSERT_EQ(nullptr, arena.tryAllocate(third, thirdCompletion, 64));
+   agent.storeSignal(firstSignal, 0);
+   ASSERT_EQ(base, arena.tryAllocate(third, thirdCompletion, 64));
+   ASSERT_EQ(128u, arena.getNumBytesInUse());
+
+   // The second packet still holds its memory. An allocation does not wrap
+   // around.
+   ASSERT_EQ(nullptr, arena.tryAllocate(third, thirdCompletion, 192));
+   ASSERT_THROW(arena.tryAllocate(third, thirdCompletion, 257), HsaException);
+
+   // Once the ring is empty, it starts over at its beginning.
+   for (const uint64_t packetId : { second, third }) {
+      agent.publishBarrierPacket(packetId, HsaBarrierType::And, nullptr, 0, hsa_signal_t { 0 });
+   }
+   agent.ringDoorbell(third);
+   agent.storeSignal(secondSignal, 0);
+   agent.storeSignal(thirdSignal, 0);
+   agent.storeSignal(firstSignal, 1);
+   ASSERT_EQ(base, arena.allocate(agent.requestPacketId(), firstCompletion, 256));
+   ASSERT_EQ(256u, arena.getNumBytesInUse());
+
+   // A signal of a pool is retained until the memory is reclaimed, as the
+   // pool resets the signals it gets back.
+   HsaSignalPool signalPool(agent, 1);
+   const HsaSignalPool::Slot slot = signalPool.acquire();
+   agent.storeSignal(firstSignal, 0);
+   const uint64_t fifth = agent.requestPacketId();
+   ASSERT_EQ(base, arena.tryAllocate(fifth, { signalPool.getSignal(slot), &signalPool, slot }, 256));
+   agent.storeSignal(signalPool.getSignal(slot), 0);
+   signalPool.release(slot);
+   ASSERT_EQ(1u, signalPool.getStats().numInUse);
+   ASSERT_EQ(0, agent.loadSignal(signalPool.getSignal(slot)));
+   ASSERT_EQ(base, arena.tryAllocate(fifth + 1, firstCompletion, 256));
+   ASSERT_EQ(0u, signalPool.getStats().numInUse);
+   signalPool.destroySignals();
+   for (const hsa_signal_t signal : { firstSignal, secondSignal, thirdSignal }) {
+      agent.destroySignal(signal);
+   }
+}
+
+/// The tables are modified right after each dispatch, thus the kernels must
+/// see the copies. The arena holds four tables only, thus it is reused.
+template<typename Agent>
+static void dispatchLookupTables() {
+   Agent agent(2);
+   agent.registerKernel(lookupKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue(16);
+   ctx.createConstantArena(4 * sizeof(LookupTable));
+   const auto lookup = ctx.getKernel<uint32_t*, const uint8_t*, HsaConstant<LookupTable>, size_t>("&lookup");
+
+   const size_t n = 1000;
+   const size_t numDispatches = 64;
+   vector<uint8_t> input(n);
+   for (size_t i = 0; i < n; i++) {
+      input[i] = static_cast<uint8_t>(i);
+   }
+   LookupTable table;
+   vector<vector<uint32_t>> outputs(numDispatches, vector<uint32_t>(n));
+   vector<HsaFuture> futures;
+   for (size_t d = 0; d < numDispatches; d++) {
+      for (uint32_t i = 0; i < table.size(); i++) {
+         table[i] = static_cast<uint32_t>(d * 1000 + i);
+      }
+      futures.push_back(ctx.dispatchAsync(lookup, { n, 64 }, outputs[d].data(), input.data(),
+            HsaConstant<LookupTable>(table), n));
+      table.fill(0);
+   }
+   HsaFuture::waitAll(futures);
+   for (size_t d = 0; d < numDispatches; d++) {
+      for (size_t i = 0; i < n; i++) {
+         ASSERT_EQ(d * 1000 + i % 256, outputs[d][i]);
+      }
+   }
+   ASSERT_LT(0u, ctx.getConstantArena().getNumWaits());
+
+   // Batches and chunks.
+   for (uint32_t i = 0; i < table.size(); i++) {
+      table[i] = 2 * i;
+   }
+   ctx.setBatchCoalescing(16);
+   for (size_t d = 0; d < numDispatches; d++) {
+      ctx.dispatchBatch(lookup.getDescriptor(), { n, 64 }, outputs[d].data(), input.data(),
+            HsaConstant<LookupTable>(table), n);
+   }
+   ctx.waitForBatchCompletion();
+   ctx.setMaxGridSize(128);
+   ctx.dispatch(lookup, { n, 64 }, outputs[0].data(), input.data(), HsaConstant<LookupTable>(table), n);
+   for (size_t d = 0; d < numDispatches; d++) {
+      for (size_t i = 0; i < n; i++) {
+         ASSERT_EQ(2 * (i % 256), outputs[d][i]);
+      }
+   }
+}
+
+TEST(HsaConstantArena, LookupTableNative) {
+   dispatchLookupTables<HsaNativeAgent>();
+}
+
+TEST(HsaConstantArena, LookupTableSoftAql) {
+   dispatchLookupTables<HsaSoftAqlAgent>();
+}
+
+} // namespace
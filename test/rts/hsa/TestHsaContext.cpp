@@ -5,9 +5,9 @@
 #include <rts/hsa/HsaRuntime.hpp>
 #include <rts/hsa/HsaUtils.hpp>
 #include <rts/hsa/KernelArgs.hpp>
-#include <fstream>
 #include <memory>
 #include <atomic>
+#include <vector>
 //---------------------------------------------------------------------------
 // SIM[DT] Lab
 // (c) Harald Lang 2015
@@ -44,26 +44,14 @@ TEST(HsaContext, HsaException) {
    rt.shutDown();
 }
 
-static string loadFromFile(const string& filename) {
-   ifstream file(filename, ifstream::binary);
-   if (file.fail()) {
-      throw "couldn't open file: " + filename;
-   }
-   string contents((istreambuf_iterator<char>(file)), (istreambuf_iterator<char>()));
-   if (contents.substr(0, 8) != "HSA BRIG") {
-      throw "invalid magic number";
-   }
-   return contents;
-}
-
 TEST(HsaContext, Dispatch) {
    HsaRuntime rt;
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
 
-   ctx.addModule(module1.c_str());
+   ctx.addModule(module1);
    ctx.finalize();
    ctx.createQueue();
 
@@ -82,14 +70,47 @@ TEST(HsaContext, Dispatch) {
    rt.shutDown();
 }
 
+TEST(HsaContext, DispatchRecommendedWorkgroupSize) {
+   HsaRuntime rt;
+   rt.initialize();
+   HsaContext ctx(rt);
+
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
+
+   ctx.addModule(module1);
+   ctx.finalize();
+   ctx.createQueue();
+
+   // The agent properties are queried from the runtime.
+   const HsaAgent::Properties& properties = ctx.getOccupancy().getAgentProperties();
+   ASSERT_LT(0u, properties.numComputeUnits);
+   ASSERT_LT(0u, properties.wavefrontSize);
+   ASSERT_LE(properties.wavefrontSize, properties.maxWorkgroupSize);
+
+   const size_t n = 1024 * 1024;
+   size_t* output = new size_t[n];
+   memset(output, 0, n * sizeof(size_t));
+
+   // Without a work-group size, the occupancy model recommends one.
+   const auto kernelObject = ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel");
+   ctx.dispatch<size_t*, size_t>(kernelObject, {n, 0}, output, n);
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i, output[i]);
+   }
+
+   delete[] output;
+   rt.shutDown();
+}
+
 TEST(HsaContext, MultipleDispatches) {
    HsaRuntime rt;
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
 
-   ctx.addModule(module1.c_str());
+   ctx.addModule(module1);
    ctx.finalize();
    ctx.createQueue();
 
@@ -114,9 +135,9 @@ TEST(HsaContext, DISABLED_DispatchBatch) {
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
 
-   ctx.addModule(module1.c_str());
+   ctx.addModule(module1);
    ctx.finalize();
    ctx.createQueue();
 
@@ -145,10 +166,10 @@ TEST(HsaContext, BundleModules) {
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
-   ctx.addModule(module1.c_str());
-   const string module2 = loadFromFile("bin/test/rts/hsa/kernel/Add.brig");
-   ctx.addModule(module2.c_str());
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
+   ctx.addModule(module1);
+   const HsaModuleSource module2 = HsaModuleSource::map("bin/test/rts/hsa/kernel/Add.brig");
+   ctx.addModule(module2);
 
    ctx.finalize();
    ctx.createQueue();
@@ -168,13 +189,115 @@ TEST(HsaContext, BundleModules) {
    rt.shutDown();
 }
 
+TEST(HsaContext, IncrementalModules) {
+   HsaRuntime rt;
+   rt.initialize();
+   HsaContext ctx(rt);
+
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
+   ctx.addModule(module1);
+   ctx.finalize();
+   const auto storeGlobalId = ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel");
+
+   // The second module is finalized into an executable of its own, the
+   // kernels of the first one remain valid.
+   const HsaModuleSource module2 = HsaModuleSource::map("bin/test/rts/hsa/kernel/Add.brig");
+   ctx.addModule(module2);
+   ctx.finalize();
+   ASSERT_EQ(storeGlobalId.kernelObject, ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel").kernelObject);
+   // The argument buffers of the queue are sized for the kernels finalized so
+   // far.
+   ctx.createQueue();
+
+   const size_t n = 1024;
+   vector<size_t> output(n);
+   ctx.dispatch<size_t*, size_t>(storeGlobalId, {n, 128}, output.data(), n);
+   ctx.dispatch<size_t*, size_t, size_t>("&__OpenCL_add_kernel", {n, 128}, output.data(), 42, n);
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i + 42, output[i]);
+   }
+
+   rt.shutDown();
+}
+
+TEST(HsaContext, DropFailedFinalization) {
+   HsaRuntime rt;
+   rt.initialize();
+   HsaContext ctx(rt);
+
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
+   ctx.addModule(module1);
+   ctx.finalize();
+   const auto storeGlobalId = ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel");
+
+   // A kernel must not be finalized twice. The modules of the failed
+   // finalization would fail again, thus they are dropped. The kernels
+   // remain unchanged.
+   const HsaModuleSource module2 = HsaModuleSource::map("bin/test/rts/hsa/kernel/Add.brig");
+   ctx.addModule(module2);
+   ctx.addModule(module1);
+   ASSERT_THROW(ctx.finalize(), HsaException);
+   ASSERT_FALSE(ctx.getAgent().hasUnfinalizedModules());
+   ASSERT_EQ(storeGlobalId.kernelObject, ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel").kernelObject);
+   ASSERT_THROW(ctx.getAgent().getKernelObject("&__OpenCL_add_kernel"), HsaException);
+
+   // A module that is added afterwards is finalized.
+   ctx.addModule(module2);
+   ctx.finalize();
+   ASSERT_FALSE(ctx.getAgent().hasUnfinalizedModules());
+   ctx.createQueue();
+   const size_t n = 1024;
+   vector<size_t> output(n);
+   ctx.dispatch<size_t*, size_t>(storeGlobalId, {n, 128}, output.data(), n);
+   ctx.dispatch<size_t*, size_t, size_t>("&__OpenCL_add_kernel", {n, 128}, output.data(), 42, n);
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i + 42, output[i]);
+   }
+
+   rt.shutDown();
+}
+
+TEST(HsaContext, FinalizeAsync) {
+   HsaRuntime rt;
+   rt.initialize();
+   HsaContext ctx(rt);
+
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
+   const HsaModuleSource module2 = HsaModuleSource::map("bin/test/rts/hsa/kernel/Add.brig");
+   ctx.addModule(module1);
+   ctx.finalizeAsync();
+   // Added while the first module is (possibly) being finalized.
+   ctx.addModule(module2);
+   // The queue reserves argument buffers for the kernels that are not known
+   // yet.
+   ctx.createQueue();
+
+   const size_t n = 1024;
+   vector<size_t> output(n);
+   // Waits for the finalization.
+   ctx.dispatch<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel", {n, 128}, output.data(), n);
+   // Finalizes the second module on first use.
+   ctx.dispatch<size_t*, size_t, size_t>("&__OpenCL_add_kernel", {n, 128}, output.data(), 42, n);
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i + 42, output[i]);
+   }
+   ASSERT_THROW(ctx.getKernelObject("&__OpenCL_unknown_kernel"), HsaException);
+
+   // The exception of a background finalization is rethrown.
+   ctx.addModule(module2);
+   ctx.finalizeAsync();
+   ASSERT_THROW(ctx.waitForFinalization(), HsaException);
+
+   rt.shutDown();
+}
+
 TEST(HsaContext, GroupLocalMemory) {
    HsaRuntime rt;
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/GroupLocalMemory.brig");
-   ctx.addModule(module1.c_str());
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/GroupLocalMemory.brig");
+   ctx.addModule(module1);
 
    ctx.finalize();
    ctx.createQueue();
@@ -198,9 +321,9 @@ TEST(HsaContext, DISABLED_DeviceEnqueue) {
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/DeviceSideEnqueue.brig");
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/DeviceSideEnqueue.brig");
 
-   ctx.addModule(module1.c_str());
+   ctx.addModule(module1);
    ctx.finalize();
    ctx.createQueue();
 
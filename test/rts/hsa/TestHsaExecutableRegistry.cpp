@@ -0,0 +1,144 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaExecutableRegistry.hpp>
+#include <rts/hsa/HsaModuleSource.hpp>
+#include <rts/hsa/HsaRuntime.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+typedef HsaExecutableRegistry::Executable Executable;
+
+/// A loader that only registers a kernel.
+static HsaExecutableRegistry::Loader kernelLoader(atomic<uint32_t>& numLoads) {
+   return [&numLoads](Executable& e) {
+      numLoads++;
+      e.kernels.emplace_back("&kernel", HsaAgent::KernelDescriptor { numLoads.load(), 8, 0, 0 });
+   };
+}
+
+TEST(HsaExecutableRegistry, Acquire) {
+   HsaExecutableRegistry& registry = HsaExecutableRegistry::getInstance();
+   const HsaExecutableRegistry::Stats stats = registry.getStats();
+   const size_t size = registry.size();
+   atomic<uint32_t> numLoads(0);
+   {
+      shared_ptr<const Executable> e1 = registry.acquire("HsaExecutableRegistry.Acquire", kernelLoader(numLoads));
+      shared_ptr<const Executable> e2 = registry.acquire("HsaExecutableRegistry.Acquire", kernelLoader(numLoads));
+      ASSERT_EQ(e1, e2);
+      ASSERT_EQ(1u, numLoads.load());
+      ASSERT_EQ(1u, e1->kernels.size());
+      ASSERT_EQ(size + 1, registry.size());
+      ASSERT_EQ(stats.numMisses + 1, registry.getStats().numMisses);
+      ASSERT_EQ(stats.numHits + 1, registry.getStats().numHits);
+   }
+
+   // The executable is destroyed along with its last user.
+   ASSERT_EQ(size, registry.size());
+   shared_ptr<const Executable> e = registry.acquire("HsaExecutableRegistry.Acquire", kernelLoader(numLoads));
+   ASSERT_EQ(2u, numLoads.load());
+   ASSERT_EQ(2u, e->kernels[0].second.kernelObject);
+}
+
+TEST(HsaExecutableRegistry, FailedLoad) {
+   HsaExecutableRegistry& registry = HsaExecutableRegistry::getInstance();
+   const size_t size = registry.size();
+   ASSERT_THROW(registry.acquire("HsaExecutableRegistry.FailedLoad", [](Executable&) {
+      throw HsaException("failed");
+   }), HsaException);
+   ASSERT_EQ(size, registry.size());
+
+   // The next acquisition loads it again.
+   atomic<uint32_t> numLoads(0);
+   shared_ptr<const Executable> e = registry.acquire("HsaExecutableRegistry.FailedLoad", kernelLoader(numLoads));
+   ASSERT_EQ(1u, numLoads.load());
+   ASSERT_EQ(size + 1, registry.size());
+}
+
+TEST(HsaExecutableRegistry, Prune) {
+   HsaExecutableRegistry& registry = HsaExecutableRegistry::getInstance();
+   const size_t numEntries = registry.getNumEntries();
+   atomic<uint32_t> numLoads(0);
+   for (uint32_t i = 0; i < 100; i++) {
+      registry.acquire("HsaExecutableRegistry.Prune." + to_string(i), kernelLoader(numLoads));
+   }
+   ASSERT_EQ(100u, numLoads.load());
+
+   // The entries of the destroyed executables do not accumulate.
+   shared_ptr<const Executable> e = registry.acquire("HsaExecutableRegistry.Prune", kernelLoader(numLoads));
+   ASSERT_LE(registry.getNumEntries(), numEntries + 1);
+}
+
+TEST(HsaExecutableRegistry, ConcurrentAcquire) {
+   HsaExecutableRegistry& registry = HsaExecutableRegistry::getInstance();
+   const size_t numThreads = 8;
+   atomic<uint32_t> numLoads(0);
+   const HsaExecutableRegistry::Loader loader = [&](Executable& e) {
+      // A slow finalization, the other threads wait for it.
+      this_thread::sleep_for(chrono::milliseconds(10));
+      kernelLoader(numLoads)(e);
+   };
+   vector<shared_ptr<const Executable>> executables(numThreads);
+   vector<thread> threads;
+   for (size_t i = 0; i < numThreads; i++) {
+      threads.emplace_back([&, i] {
+         executables[i] = registry.acquire("HsaExecutableRegistry.ConcurrentAcquire", loader);
+      });
+   }
+   for (thread& t : threads) {
+      t.join();
+   }
+   ASSERT_EQ(1u, numLoads.load());
+   for (size_t i = 0; i < numThreads; i++) {
+      ASSERT_EQ(executables[0], executables[i]);
+   }
+}
+
+TEST(HsaExecutableRegistry, SharedAcrossContexts) {
+   HsaRuntime rt;
+   rt.initialize();
+   HsaExecutableRegistry& registry = HsaExecutableRegistry::getInstance();
+   const HsaExecutableRegistry::Stats stats = registry.getStats();
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
+   {
+      // The second context neither finalizes nor loads the module.
+      HsaContext ctx1(rt);
+      ctx1.addModule(module1);
+      ctx1.finalize();
+      HsaContext ctx2(rt);
+      ctx2.addModule(module1);
+      ctx2.finalize();
+      ASSERT_EQ(stats.numMisses + 1, registry.getStats().numMisses);
+      ASSERT_EQ(stats.numHits + 1, registry.getStats().numHits);
+      ASSERT_EQ(ctx1.getKernelObject("&__OpenCL_storeGlobalId_kernel").kernelObject,
+            ctx2.getKernelObject("&__OpenCL_storeGlobalId_kernel").kernelObject);
+
+      // Each context dispatches via its own queue.
+      ctx1.createQueue();
+      ctx2.createQueue();
+      const size_t n = 1024;
+      vector<size_t> output1(n);
+      vector<size_t> output2(n);
+      ctx1.dispatch<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel", {n, 128}, output1.data(), n);
+      ctx2.dispatch<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel", {n, 128}, output2.data(), n);
+      for (size_t i = 0; i < n; i++) {
+         ASSERT_EQ(i, output1[i]);
+         ASSERT_EQ(i, output2[i]);
+      }
+   }
+   rt.shutDown();
+}
+
+} // namespace
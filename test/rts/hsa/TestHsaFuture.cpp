@@ -0,0 +1,158 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaFuture.hpp>
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaNativeAgent.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+/// Blocks until the flag is set.
+static HsaHostKernel waitForFlagKernel() {
+   return HsaHostKernel::forEachWorkGroup<atomic<bool>*>("&__OpenCL_waitForFlag_kernel",
+         [](const HsaWorkGroup& /* group */, atomic<bool>* flag) {
+            while (!flag->load()) {
+               this_thread::yield();
+            }
+         });
+}
+
+/// Host implementation of the StoreValue.cl kernel.
+static HsaHostKernel storeValueKernel() {
+   return HsaHostKernel::forEachWorkItem<size_t*, size_t>("&__OpenCL_storeValue_kernel",
+         [](uint64_t gid, size_t* dst, size_t value) {
+            if (gid == 0) dst[0] = value;
+         });
+}
+
+static const HsaWaitStrategy strategies[] = {
+      HsaWaitStrategy::Spin, HsaWaitStrategy::SpinThenBlock, HsaWaitStrategy::Blocked };
+
+TEST(HsaFuture, IsReadyAndWait) {
+   for (const HsaWaitStrategy strategy : strategies) {
+      HsaNativeAgent agent(2);
+      agent.registerKernel(waitForFlagKernel());
+      HsaContext ctx(agent);
+      ctx.createQueue();
+      const auto kernelObject = ctx.getKernelObject("&__OpenCL_waitForFlag_kernel");
+
+      atomic<bool> flag(false);
+      HsaContext::Future task = ctx.dispatchAsync<atomic<bool>*>(kernelObject, {1, 1}, &flag);
+      ASSERT_TRUE(task.valid());
+      ASSERT_FALSE(task.isReady());
+      flag = true;
+      task.wait(strategy);
+      ASSERT_FALSE(task.valid());
+      ASSERT_TRUE(task.isReady());
+      ASSERT_EQ(0u, ctx.getSignalPool().getStats().numInUse);
+   }
+}
+
+TEST(HsaFuture, WaitFor) {
+   for (const HsaWaitStrategy strategy : strategies) {
+      HsaNativeAgent agent(2);
+      agent.registerKernel(waitForFlagKernel());
+      HsaContext ctx(agent);
+      ctx.createQueue();
+      const auto kernelObject = ctx.getKernelObject("&__OpenCL_waitForFlag_kernel");
+
+      atomic<bool> flag(false);
+      HsaContext::Future task = ctx.dispatchAsync<atomic<bool>*>(kernelObject, {1, 1}, &flag);
+      const auto begin = chrono::steady_clock::now();
+      ASSERT_FALSE(task.waitFor(chrono::milliseconds(10), strategy));
+      ASSERT_GE(chrono::steady_clock::now() - begin, chrono::milliseconds(10));
+      ASSERT_TRUE(task.valid());
+
+      flag = true;
+      ASSERT_TRUE(task.waitFor(chrono::seconds(10), strategy));
+      ASSERT_FALSE(task.valid());
+   }
+}
+
+TEST(HsaFuture, Move) {
+   HsaNativeAgent agent(2);
+   agent.registerKernel(storeValueKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+   const auto kernelObject = ctx.getKernelObject("&__OpenCL_storeValue_kernel");
+
+   size_t output[2] = {0, 0};
+   {
+      HsaContext::Future task = ctx.dispatchAsync<size_t*, size_t>(kernelObject, {1, 1}, &output[0], 1);
+      HsaContext::Future other(std::move(task));
+      ASSERT_FALSE(task.valid());
+      ASSERT_TRUE(other.valid());
+
+      // The assignment waits for the task of `other`.
+      other = ctx.dispatchAsync<size_t*, size_t>(kernelObject, {1, 1}, &output[1], 2);
+      ASSERT_EQ(1u, output[0]);
+      ASSERT_TRUE(other.valid());
+      // The d'tor waits for the second task.
+   }
+   ASSERT_EQ(2u, output[1]);
+   ASSERT_EQ(0u, ctx.getSignalPool().getStats().numInUse);
+}
+
+TEST(HsaFuture, WaitAll) {
+   for (const HsaWaitStrategy strategy : strategies) {
+      HsaNativeAgent agent(2);
+      agent.registerKernel(storeValueKernel());
+      HsaContext ctx(agent);
+      ctx.createQueue();
+      const auto kernelObject = ctx.getKernelObject("&__OpenCL_storeValue_kernel");
+
+      constexpr size_t n = 64;
+      size_t output[n];
+      memset(output, 0, sizeof(output));
+      vector<HsaContext::Future> tasks;
+      for (size_t i = 0; i < n; i++) {
+         tasks.push_back(ctx.dispatchAsync<size_t*, size_t>(kernelObject, {1, 1}, &output[i], i + 1));
+      }
+      HsaContext::Future::waitAll(tasks, strategy);
+      for (size_t i = 0; i < n; i++) {
+         ASSERT_FALSE(tasks[i].valid());
+         ASSERT_EQ(i + 1, output[i]);
+      }
+      ASSERT_EQ(0u, ctx.getSignalPool().getStats().numInUse);
+   }
+}
+
+TEST(HsaFuture, WaitAny) {
+   for (const HsaWaitStrategy strategy : strategies) {
+      // Two workers, as the first task blocks one of them.
+      HsaNativeAgent agent(2);
+      agent.registerKernel(waitForFlagKernel());
+      HsaContext ctx(agent);
+      ctx.createQueue();
+      const auto kernelObject = ctx.getKernelObject("&__OpenCL_waitForFlag_kernel");
+
+      atomic<bool> flags[2];
+      flags[0] = false;
+      flags[1] = false;
+      HsaContext::Future tasks[2];
+      tasks[0] = ctx.dispatchAsync<atomic<bool>*>(kernelObject, {1, 1}, &flags[0]);
+      tasks[1] = ctx.dispatchAsync<atomic<bool>*>(kernelObject, {1, 1}, &flags[1]);
+
+      // Only the first task can complete.
+      flags[0] = true;
+      ASSERT_EQ(0u, HsaContext::Future::waitAny(tasks, 2, strategy));
+      ASSERT_FALSE(tasks[0].valid());
+      ASSERT_TRUE(tasks[1].valid());
+      flags[1] = true;
+      ASSERT_EQ(1u, HsaContext::Future::waitAny(tasks, 2, strategy));
+      ASSERT_EQ(2u, HsaContext::Future::waitAny(tasks, 2, strategy));
+   }
+}
+
+} // namespace
@@ -0,0 +1,110 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaKernargSlab.hpp>
+#include <rts/hsa/HsaNativeAgent.hpp>
+#include <rts/hsa/HsaSoftAqlAgent.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+/// A by-value argument that does not fit into a regular slot.
+struct Coefficients {
+   uint64_t values[40];
+};
+
+static HsaHostKernel storeGlobalIdKernel() {
+   return HsaHostKernel::forEachWorkItem<uint64_t*>("&__OpenCL_storeGlobalId_kernel",
+         [](uint64_t gid, uint64_t* output) {
+            output[gid] = gid;
+         });
+}
+
+static HsaHostKernel polynomialKernel() {
+   return HsaHostKernel::forEachWorkItem<uint64_t*, Coefficients>("&polynomial",
+         [](uint64_t gid, uint64_t* output, Coefficients coefficients) {
+            output[gid] = coefficients.values[gid % 40] * gid;
+         });
+}
+
+TEST(HsaKernargSlab, Layout) {
+   // The slots are sized for the largest regular argument segment.
+   HsaKernargSlab slab( { 48, 100, 72 }, 16);
+   ASSERT_EQ(128u, slab.getSlotSize());
+   ASSERT_EQ(0u, slab.getOverflowSlotSize());
+   ASSERT_EQ(16u * 128, slab.getSize());
+
+   // Large argument segments are placed in the overflow arena.
+   slab = HsaKernargSlab( { 48, 1000, 56 }, 4);
+   ASSERT_EQ(64u, slab.getSlotSize());
+   ASSERT_EQ(1024u, slab.getOverflowSlotSize());
+   ASSERT_EQ(4u * (64 + 1024), slab.getSize());
+
+   void* memory;
+   ASSERT_EQ(0, posix_memalign(&memory, HsaKernargSlab::alignment, slab.getSize()));
+   ASSERT_THROW(slab.bind(reinterpret_cast<uint8_t*>(memory) + 8), HsaException);
+   slab.bind(memory);
+   uint8_t* base = reinterpret_cast<uint8_t*>(memory);
+   ASSERT_EQ(base, slab.getBuffer(0, 48));
+   ASSERT_EQ(base + 3 * 64, slab.getBuffer(7, 56));
+   ASSERT_EQ(base + 4 * 64, slab.getBuffer(0, 1000));
+   ASSERT_EQ(base + 4 * 64 + 1024, slab.getBuffer(5, 1000));
+   ASSERT_EQ(base + 64, slab.getSlot(5));
+   for (uint64_t packetId = 0; packetId < 4; packetId++) {
+      ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(slab.getBuffer(packetId, 1000)) % HsaKernargSlab::alignment);
+   }
+   free(memory);
+
+   ASSERT_THROW(HsaKernargSlab( { 48 }, 12), HsaException);
+}
+
+/// Alternates dispatches of a kernel with a large and a kernel with a small
+/// argument segment.
+template<typename Agent>
+static void dispatchLargeSignature() {
+   Agent agent(2);
+   agent.registerKernel(storeGlobalIdKernel());
+   agent.registerKernel(polynomialKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue(4);
+
+   const size_t n = 1000;
+   Coefficients coefficients;
+   for (uint64_t i = 0; i < 40; i++) {
+      coefficients.values[i] = i + 1;
+   }
+   vector<uint64_t> ids(n);
+   vector<uint64_t> values(n);
+   const auto storeGlobalId = ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel");
+   const auto polynomial = ctx.getKernelObject("&polynomial");
+   vector<HsaFuture> futures;
+   for (size_t i = 0; i < 16; i++) {
+      futures.push_back(ctx.dispatchAsync<uint64_t*>(storeGlobalId, { n, 64 }, ids.data()));
+      futures.push_back(ctx.dispatchAsync<uint64_t*, Coefficients>(polynomial, { n, 64 }, values.data(), coefficients));
+   }
+   HsaFuture::waitAll(futures);
+   for (uint64_t i = 0; i < n; i++) {
+      ASSERT_EQ(i, ids[i]);
+      ASSERT_EQ((i % 40 + 1) * i, values[i]);
+   }
+}
+
+TEST(HsaKernargSlab, LargeSignatureNative) {
+   dispatchLargeSignature<HsaNativeAgent>();
+}
+
+TEST(HsaKernargSlab, LargeSignatureSoftAql) {
+   dispatchLargeSignature<HsaSoftAqlAgent>();
+}
+
+} // namespace
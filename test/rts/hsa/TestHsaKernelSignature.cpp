@@ -0,0 +1,79 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaKernelSignature.hpp>
+#include <rts/hsa/HsaNativeAgent.hpp>
+#include <cstring>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+constexpr uint32_t leading = HsaAgent::numLeadingParameters * sizeof(uintptr_t);
+
+// The layout is computed at compile time.
+typedef HsaKernelSignature<size_t*, uint8_t, uint32_t, uint8_t, uint64_t> Signature;
+static_assert(Signature::offset(0) == leading, "");
+static_assert(Signature::offset(1) == leading + 8, "");
+static_assert(Signature::offset(2) == leading + 12, "");
+static_assert(Signature::offset(3) == leading + 16, "");
+static_assert(Signature::offset(4) == leading + 24, "");
+static_assert(Signature::argumentSegmentSize == leading + 32, "");
+static_assert(HsaKernelSignature<>::argumentSegmentSize == leading, "");
+
+TEST(HsaKernelSignature, Write) {
+   struct Args {
+      size_t* a;
+      uint8_t b;
+      uint32_t c;
+      uint8_t d;
+      uint64_t e;
+   };
+   alignas(16) uint8_t buffer[Signature::argumentSegmentSize];
+   memset(buffer, 0, sizeof(buffer));
+   size_t value = 0;
+   Signature::write(buffer, &value, 1, 2, 3, 4);
+
+   // Same layout as the struct.
+   Args args;
+   memcpy(&args, buffer + leading, sizeof(Args));
+   ASSERT_EQ(&value, args.a);
+   ASSERT_EQ(1u, args.b);
+   ASSERT_EQ(2u, args.c);
+   ASSERT_EQ(3u, args.d);
+   ASSERT_EQ(4u, args.e);
+   // The leading parameters are not touched.
+   for (uint32_t i = 0; i < leading; i++) {
+      ASSERT_EQ(0u, buffer[i]);
+   }
+}
+
+TEST(HsaKernelSignature, Check) {
+   HsaNativeAgent agent(1);
+   agent.registerKernel(HsaHostKernel::forEachWorkItem<size_t*, size_t>("&__OpenCL_storeValue_kernel",
+         [](uint64_t gid, size_t* dst, size_t value) {
+            if (gid == 0) dst[0] = value;
+         }));
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   ASSERT_NO_THROW((ctx.getKernel<size_t*, size_t>("&__OpenCL_storeValue_kernel")));
+   // Trailing padding up to a multiple of 16 bytes is tolerated (thus, a
+   // missing trailing argument is not always detected).
+   ASSERT_NO_THROW((ctx.getKernel<size_t*, uint32_t>("&__OpenCL_storeValue_kernel")));
+   ASSERT_THROW(ctx.getKernel<>("&__OpenCL_storeValue_kernel"), HsaException);
+   ASSERT_THROW((ctx.getKernel<size_t*, size_t, size_t*>("&__OpenCL_storeValue_kernel")), HsaException);
+
+   // Arguments are converted to the parameter types.
+   const HsaKernel<size_t*, size_t> kernel = ctx.getKernel<size_t*, size_t>("&__OpenCL_storeValue_kernel");
+   size_t output = 0;
+   ctx.dispatch(kernel, {1, 1}, &output, 42);
+   ASSERT_EQ(42u, output);
+}
+
+} // namespace
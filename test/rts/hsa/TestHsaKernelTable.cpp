@@ -0,0 +1,53 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaKernelTable.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+static HsaAgent::KernelDescriptor descriptor(const uint64_t kernelObject, const uint32_t argumentSegmentSize) {
+   return HsaAgent::KernelDescriptor { kernelObject, argumentSegmentSize, 0, 0 };
+}
+
+TEST(HsaKernelTable, Lookup) {
+   vector<pair<string, HsaAgent::KernelDescriptor>> kernels;
+   for (uint32_t i = 0; i < 100; i++) {
+      kernels.emplace_back("&__OpenCL_kernel" + to_string(i) + "_kernel", descriptor(i + 1, 48 + i));
+   }
+   const HsaKernelTable table(kernels);
+   ASSERT_EQ(100u, table.size());
+   for (uint32_t i = 0; i < 100; i++) {
+      const HsaAgent::KernelDescriptor* kernel = table.find(kernels[i].first);
+      ASSERT_NE(nullptr, kernel);
+      ASSERT_EQ(i + 1, kernel->kernelObject);
+   }
+   ASSERT_EQ(147u, table.getMaxArgumentSegmentSize());
+   ASSERT_STREQ("&__OpenCL_kernel42_kernel", table.findSymbolName(43));
+   ASSERT_EQ(nullptr, table.findSymbolName(0));
+
+   // Prefixes and extensions of known names are unknown.
+   ASSERT_EQ(nullptr, table.find("&__OpenCL_kernel1"));
+   ASSERT_EQ(nullptr, table.find("&__OpenCL_kernel1_kernel_"));
+   ASSERT_EQ(nullptr, table.find(""));
+   ASSERT_THROW(table.get("&__OpenCL_unknown_kernel"), HsaException);
+
+   const HsaKernelTable empty;
+   ASSERT_EQ(nullptr, empty.find("&__OpenCL_kernel1_kernel"));
+}
+
+TEST(HsaKernelTable, Duplicate) {
+   vector<pair<string, HsaAgent::KernelDescriptor>> kernels;
+   kernels.emplace_back("&__OpenCL_a_kernel", descriptor(1, 48));
+   kernels.emplace_back("&__OpenCL_a_kernel", descriptor(2, 48));
+   ASSERT_THROW(HsaKernelTable table(kernels), HsaException);
+}
+
+} // namespace
@@ -0,0 +1,155 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaMemoryAllocator.hpp>
+#include <rts/hsa/HsaMemoryPool.hpp>
+#include <rts/hsa/HsaModuleSource.hpp>
+#include <rts/hsa/HsaRuntime.hpp>
+#include <rts/hsa/HsaUtils.hpp>
+#include <cstdint>
+#include <vector>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+TEST(HsaMemoryPool, SizeClasses) {
+   ASSERT_EQ(0u, HsaMemoryPool::getSizeClass(0));
+   ASSERT_EQ(0u, HsaMemoryPool::getSizeClass(64));
+   ASSERT_EQ(1u, HsaMemoryPool::getSizeClass(65));
+   ASSERT_EQ(HsaMemoryPool::numSizeClasses - 1, HsaMemoryPool::getSizeClass(HsaMemoryPool::maxBlockSize));
+   ASSERT_EQ(HsaMemoryPool::numSizeClasses, HsaMemoryPool::getSizeClass(HsaMemoryPool::maxBlockSize + 1));
+}
+
+TEST(HsaMemoryPool, SmallBlocks) {
+   HsaMemoryPool pool;
+   ASSERT_TRUE(pool.isHostMemory());
+   void* a = pool.allocate(100);
+   void* b = pool.allocate(128);
+   ASSERT_NE(a, b);
+   // Blocks are aligned to their size.
+   ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(a) % 128);
+   ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(b) % 128);
+   HsaMemoryPool::Stats stats = pool.getStats();
+   ASSERT_EQ(1u, stats.numSlabs);
+   ASSERT_EQ(HsaMemoryPool::slabSize, stats.reservedBytes);
+   ASSERT_EQ(256u, stats.inUseBytes);
+
+   // A freed block is recycled.
+   pool.deallocate(a, 100);
+   ASSERT_EQ(a, pool.allocate(120));
+   stats = pool.getStats();
+   ASSERT_EQ(3u, stats.numAllocations);
+   ASSERT_EQ(2u, stats.numReuses);
+   ASSERT_EQ(1u, stats.numSlabs);
+
+   // Blocks of another size class are carved from another slab.
+   void* c = pool.allocate(4096);
+   ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(c) % 4096);
+   ASSERT_EQ(2u, pool.getStats().numSlabs);
+   pool.deallocate(a, 120);
+   pool.deallocate(b, 128);
+   pool.deallocate(c, 4096);
+   ASSERT_EQ(0u, pool.getStats().inUseBytes);
+}
+
+TEST(HsaMemoryPool, LargeBlocks) {
+   HsaMemoryPool pool;
+   const size_t size = 8 * HsaMemoryPool::slabSize + 1;
+   char* a = reinterpret_cast<char*>(pool.allocate(size));
+   ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(a) % HsaMemoryPool::slabSize);
+   a[0] = 1;
+   a[size - 1] = 1;
+   pool.deallocate(a, size);
+   HsaMemoryPool::Stats stats = pool.getStats();
+   ASSERT_EQ(9 * HsaMemoryPool::slabSize, stats.cachedBytes);
+   ASSERT_EQ(0u, stats.inUseBytes);
+
+   // A cached block of (about) the same size is reused, a much larger one is
+   // not.
+   ASSERT_EQ(a, pool.allocate(8 * HsaMemoryPool::slabSize));
+   ASSERT_EQ(1u, pool.getStats().numReuses);
+   void* b = pool.allocate(2 * HsaMemoryPool::slabSize);
+   ASSERT_NE(a, b);
+   pool.deallocate(a, 8 * HsaMemoryPool::slabSize);
+   pool.deallocate(b, 2 * HsaMemoryPool::slabSize);
+   stats = pool.getStats();
+   ASSERT_EQ(2u, stats.numLargeBlocks);
+   ASSERT_EQ(11 * HsaMemoryPool::slabSize, stats.cachedBytes);
+
+   // The largest blocks are released first.
+   pool.setMaxCachedBytes(4 * HsaMemoryPool::slabSize);
+   stats = pool.getStats();
+   ASSERT_EQ(2 * HsaMemoryPool::slabSize, stats.cachedBytes);
+   ASSERT_EQ(2 * HsaMemoryPool::slabSize, stats.reservedBytes);
+   pool.trim();
+   ASSERT_EQ(0u, pool.getStats().reservedBytes);
+
+   ASSERT_THROW(pool.deallocate(a, size), HsaException);
+}
+
+TEST(HsaMemoryPool, Allocator) {
+   HsaMemoryPool pool;
+   HsaPoolAllocator<uint64_t> allocator(pool);
+   {
+      vector<uint64_t, HsaPoolAllocator<uint64_t>> v(allocator);
+      for (uint64_t i = 0; i < 1024 * 1024; i++) {
+         v.push_back(i);
+      }
+      ASSERT_EQ(1024u * 1024 - 1, v.back());
+      ASSERT_TRUE(v.get_allocator() == allocator);
+      ASSERT_LT(0u, pool.getStats().inUseBytes);
+   }
+   ASSERT_EQ(0u, pool.getStats().inUseBytes);
+
+   HsaMemoryPool other;
+   ASSERT_TRUE(HsaPoolAllocator<uint32_t>(allocator) == allocator);
+   ASSERT_TRUE(HsaPoolAllocator<uint64_t>(other) != allocator);
+}
+
+TEST(HsaMemoryPool, Regions) {
+   HsaRuntime rt;
+   rt.initialize();
+   {
+      HsaMemoryAllocator allocator(HsaUtils::determineKernelAgent());
+      ASSERT_FALSE(allocator.getRegions().empty());
+      bool kernarg = false;
+      for (const HsaRegion& region : allocator.getRegions()) {
+         kernarg |= region.kernarg;
+         ASSERT_LT(0u, region.size);
+         if (region.allocAllowed) {
+            ASSERT_LT(0u, region.allocGranule);
+            ASSERT_LE(region.allocMaxSize, region.size);
+         }
+      }
+      ASSERT_TRUE(kernarg);
+      ASSERT_FALSE(allocator.getKernargPool().isHostMemory());
+
+      // Dispatch a kernel on a pooled buffer of the fine-grained region.
+      HsaContext ctx(rt);
+      const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
+      ctx.addModule(module1);
+      ctx.finalize();
+      ctx.createQueue();
+
+      HsaMemoryPool& pool = allocator.getFineGrainedPool();
+      const size_t n = 1024;
+      HsaPoolAllocator<size_t> outputAllocator(pool);
+      for (size_t r = 0; r < 2; r++) {
+         size_t* output = outputAllocator.allocate(n);
+         ctx.dispatch<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel", {n, 128}, output, n);
+         for (size_t i = 0; i < n; i++) {
+            ASSERT_EQ(i, output[i]);
+         }
+         outputAllocator.deallocate(output, n);
+      }
+      ASSERT_EQ(1u, pool.getStats().numReuses);
+   }
+   rt.shutDown();
+}
+
+} // namespace
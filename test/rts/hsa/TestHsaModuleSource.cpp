@@ -0,0 +1,102 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaModuleSource.hpp>
+#include <rts/hsa/HsaRuntime.hpp>
+#include <test/rts/hsa/kernel/EmbeddedKernels.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+static const string storeGlobalIdPath = "bin/test/rts/hsa/kernel/StoreGlobalId.brig";
+
+static string writeFile(const string& name, const string& contents) {
+   const string path = "/tmp/HsaModuleSource." + to_string(getpid()) + "." + name;
+   ofstream out(path, ios::binary | ios::trunc);
+   out << contents;
+   return path;
+}
+
+TEST(HsaModuleSource, Embedded) {
+   const HsaModuleSource module(kernel::StoreGlobalIdKernelBrig, kernel::StoreGlobalIdKernelBrigSize);
+   ASSERT_FALSE(module.isMapped());
+   ASSERT_EQ(kernel::StoreGlobalIdKernelBrig, module.getData());
+   ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(module.getData()) % HsaModuleSource::alignment);
+   ASSERT_EQ(kernel::StoreGlobalIdKernelBrigSize, module.getSize());
+}
+
+TEST(HsaModuleSource, Map) {
+   // The embedded module is a copy of the module file.
+   HsaModuleSource module = HsaModuleSource::map(storeGlobalIdPath);
+   ASSERT_TRUE(module.isMapped());
+   ASSERT_EQ(kernel::StoreGlobalIdKernelBrigSize, module.getSize());
+   ASSERT_EQ(0, memcmp(kernel::StoreGlobalIdKernelBrig, module.getData(), module.getSize()));
+
+   // The mapping moves along with the module.
+   const char* data = module.getData();
+   HsaModuleSource moved(std::move(module));
+   ASSERT_FALSE(module.isMapped());
+   ASSERT_TRUE(moved.isMapped());
+   ASSERT_EQ(data, moved.getData());
+   module = HsaModuleSource::map(storeGlobalIdPath);
+   moved = std::move(module);
+   ASSERT_TRUE(moved.isMapped());
+}
+
+TEST(HsaModuleSource, Invalid) {
+   ASSERT_THROW(HsaModuleSource::map("/nonexistent.brig"), HsaException);
+   ASSERT_THROW(HsaModuleSource(nullptr, 0), HsaException);
+
+   const string notBrig = writeFile("notBrig", string(200, 'x'));
+   ASSERT_THROW(HsaModuleSource::map(notBrig), HsaException);
+   remove(notBrig.c_str());
+
+   // The header states a larger module than the file contains.
+   string brig(kernel::StoreGlobalIdKernelBrig, kernel::StoreGlobalIdKernelBrigSize);
+   const string truncated = writeFile("truncated", brig.substr(0, brig.size() - 1));
+   ASSERT_THROW(HsaModuleSource::map(truncated), HsaException);
+   ASSERT_THROW(HsaModuleSource(brig.data(), brig.size() - 1), HsaException);
+   remove(truncated.c_str());
+
+   // Trailing bytes are not part of the module.
+   const string padded = writeFile("padded", brig + "padding");
+   ASSERT_EQ(brig.size(), HsaModuleSource::map(padded).getSize());
+   remove(padded.c_str());
+}
+
+TEST(HsaModuleSource, DispatchEmbedded) {
+   HsaRuntime rt;
+   rt.initialize();
+   {
+      HsaContext ctx(rt);
+      const HsaModuleSource storeGlobalId(kernel::StoreGlobalIdKernelBrig, kernel::StoreGlobalIdKernelBrigSize);
+      const HsaModuleSource add(kernel::AddKernelBrig, kernel::AddKernelBrigSize);
+      ctx.addModule(storeGlobalId);
+      ctx.addModule(add);
+      ctx.finalize();
+      ctx.createQueue();
+
+      const size_t n = 1024;
+      vector<size_t> output(n);
+      ctx.dispatch<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel", { n, 128 }, output.data(), n);
+      for (size_t i = 0; i < n; i++) {
+         ASSERT_EQ(i, output[i]);
+      }
+   }
+   rt.shutDown();
+}
+
+} // namespace
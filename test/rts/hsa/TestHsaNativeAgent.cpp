@@ -0,0 +1,523 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaNativeAgent.hpp>
+#include <utils/Utils.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <vector>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+/// Host implementation of the StoreGlobalId.cl kernel.
+static HsaHostKernel storeGlobalIdKernel() {
+   return HsaHostKernel::forEachWorkItem<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel",
+         [](uint64_t gid, size_t* output, size_t n) {
+            if (gid < n) output[gid] = gid;
+         });
+}
+
+/// Host implementation of the Add.cl kernel.
+static HsaHostKernel addKernel() {
+   return HsaHostKernel::forEachWorkItem<size_t*, size_t, size_t>("&__OpenCL_add_kernel",
+         [](uint64_t gid, size_t* output, size_t value, size_t n) {
+            if (gid < n) output[gid] += value;
+         });
+}
+
+/// Host implementation of the Nothing.cl kernel.
+static HsaHostKernel nothingKernel() {
+   return HsaHostKernel::forEachWorkGroup<size_t*, size_t>("&__OpenCL_nothing_kernel",
+         [](const HsaWorkGroup& /* group */, size_t* /* output */, size_t /* value */) {
+         });
+}
+
+/// A kernel that blocks its worker until the gate is opened.
+static HsaHostKernel gateKernel() {
+   return HsaHostKernel::forEachWorkGroup<atomic<bool>*>("&gate",
+         [](const HsaWorkGroup& /* group */, atomic<bool>* open) {
+            while (!open->load()) {
+               this_thread::yield();
+            }
+         });
+}
+
+static double clockSec(function<void(void)> fn) {
+   std::chrono::time_point<std::chrono::high_resolution_clock> start, end;
+   start = std::chrono::high_resolution_clock::now();
+   fn();
+   end = std::chrono::high_resolution_clock::now();
+   return std::chrono::duration<double>(end - start).count();
+}
+
+TEST(HsaNativeAgent, Dispatch) {
+   HsaNativeAgent agent;
+   agent.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx(agent);
+   ctx.finalize();
+   ctx.createQueue();
+
+   const size_t n = 1024 * 1024;
+   size_t* output = new size_t[n];
+   memset(output, 0, n * sizeof(size_t));
+
+   std::string kernelName = "&__OpenCL_storeGlobalId_kernel";
+   ctx.dispatch<size_t*, size_t>(kernelName, {n, 128}, output, n);
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i, output[i]);
+   }
+
+   delete[] output;
+}
+
+TEST(HsaNativeAgent, PartialWorkgroup) {
+   HsaNativeAgent agent;
+   agent.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   const size_t n = 1000;
+   size_t* output = new size_t[n + 1];
+   memset(output, 0, (n + 1) * sizeof(size_t));
+
+   ctx.dispatch<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel", {n, 128}, output, n + 1);
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i, output[i]);
+   }
+   ASSERT_EQ(0u, output[n]);
+
+   delete[] output;
+}
+
+TEST(HsaNativeAgent, MultipleDispatches) {
+   HsaNativeAgent agent;
+   agent.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   const size_t n = 1024;
+   size_t* output = new size_t[n];
+   memset(output, 42, n * sizeof(size_t));
+
+   for (size_t i = 0; i < n; i++) {
+      ctx.dispatch<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel", {1, 128}, &output[i], 1);
+   }
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(0u, output[i]);
+   }
+
+   delete[] output;
+}
+
+TEST(HsaNativeAgent, BundleKernels) {
+   HsaNativeAgent agent;
+   agent.registerKernel(storeGlobalIdKernel());
+   agent.registerKernel(addKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   const size_t n = 1024 * 1024;
+   size_t* output = new size_t[n];
+   memset(output, 0, n * sizeof(size_t));
+
+   ctx.dispatch<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel", {n, 128}, output, n);
+   ctx.dispatch<size_t*, size_t, size_t>("&__OpenCL_add_kernel", {n, 128}, output, 42, n);
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i + 42, output[i]);
+   }
+
+   delete[] output;
+}
+
+TEST(HsaNativeAgent, DispatchAsync) {
+   HsaNativeAgent agent;
+   agent.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   constexpr size_t n = 128;
+   size_t* output = new size_t[n];
+   memset(output, 42, n * sizeof(size_t));
+
+   const auto kernelObject = ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel");
+   HsaContext::Future tasks[n];
+   for (size_t i = 0; i < n; i++) {
+      tasks[i] = ctx.dispatchAsync<size_t*, size_t>(kernelObject, {1, 128}, &output[i], 1);
+   }
+   HsaContext::Future::waitAll(tasks, n);
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(0u, output[i]);
+   }
+
+   delete[] output;
+}
+
+TEST(HsaNativeAgent, DispatchBatch) {
+   HsaNativeAgent agent;
+   agent.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   constexpr size_t n = 128;
+   size_t* output = new size_t[n];
+   memset(output, 42, n * sizeof(size_t));
+
+   const auto kernelObject = ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel");
+   for (size_t i = 0; i < n; i++) {
+      ctx.dispatchBatch<size_t*, size_t>(kernelObject, {1, 128}, &output[i], 1);
+   }
+   ctx.waitForBatchCompletion();
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(0u, output[i]);
+   }
+
+   delete[] output;
+}
+
+TEST(HsaNativeAgent, DispatchChunked) {
+   HsaNativeAgent agent(2);
+   agent.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+   // Rounded down to a multiple of the work-group size (896 elements).
+   ctx.setMaxGridSize(1000);
+
+   // More chunks than queue entries.
+   const size_t n = 100 * 1000 + 1;
+   vector<size_t> output(n, 0);
+   ctx.dispatch<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel", {n, 128}, output.data(), n);
+
+   // The global IDs are continuous.
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i, output[i]);
+   }
+   ASSERT_EQ(0u, ctx.getSignalPool().getStats().numInUse);
+
+   // Batches are not split.
+   ASSERT_THROW((ctx.dispatchBatch<size_t*, size_t>(ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel"),
+         {n, 128}, output.data(), n)), HsaException);
+}
+
+TEST(HsaNativeAgent, Dispatch64BitGrid) {
+   // Counts the work-items and tracks the largest global ID.
+   HsaNativeAgent agent(2);
+   agent.registerKernel(HsaHostKernel::forEachWorkGroup<atomic<uint64_t>*, atomic<uint64_t>*>("&__OpenCL_count_kernel",
+         [](const HsaWorkGroup& group, atomic<uint64_t>* count, atomic<uint64_t>* maxEnd) {
+            count->fetch_add(group.end - group.begin);
+            uint64_t current = maxEnd->load();
+            while (current < group.end && !maxEnd->compare_exchange_weak(current, group.end)) {
+            }
+         }));
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   const uint64_t n = 5ull << 30;
+   ASSERT_GT(n, ctx.getMaxGridSize());
+   atomic<uint64_t> count(0);
+   atomic<uint64_t> maxEnd(0);
+   ctx.dispatch<atomic<uint64_t>*, atomic<uint64_t>*>("&__OpenCL_count_kernel", {n, 32768}, &count, &maxEnd);
+   ASSERT_EQ(n, count.load());
+   ASSERT_EQ(n, maxEnd.load());
+}
+
+TEST(HsaNativeAgent, DispatchSpan) {
+   HsaNativeAgent agent(2);
+   agent.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   const size_t n = 3 * ctx.getAgent().getQueueSize() + 1;
+   vector<size_t> output(n, 42);
+   vector<tuple<size_t*, size_t>> args;
+   for (size_t i = 0; i < n; i++) {
+      args.emplace_back(&output[i], 1);
+   }
+   ctx.dispatchSpan<size_t*, size_t>(ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel"),
+         {1, 128}, args.data(), n).wait();
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(0u, output[i]);
+   }
+}
+
+TEST(HsaNativeAgent, DispatchAfter) {
+   // The dependencies run on other queues, which are blocked by gates.
+   HsaNativeAgent buildAgent(1);
+   buildAgent.registerKernel(gateKernel());
+   HsaContext buildCtx(buildAgent);
+   buildCtx.createQueue();
+   HsaNativeAgent probeAgent(2);
+   probeAgent.registerKernel(storeGlobalIdKernel());
+   HsaContext probeCtx(probeAgent);
+   probeCtx.createQueue();
+   const auto gate = buildCtx.getKernelObject("&gate");
+   const auto storeGlobalId = probeCtx.getKernelObject("&__OpenCL_storeGlobalId_kernel");
+
+   // More dependencies than a single barrier packet can hold.
+   const size_t numBuilds = HsaAgent::maxBarrierDependencies + 2;
+   vector<unique_ptr<atomic<bool>>> open;
+   vector<HsaFuture> builds;
+   for (size_t i = 0; i < numBuilds; i++) {
+      open.emplace_back(new atomic<bool>(false));
+      builds.push_back(buildCtx.dispatchAsync<atomic<bool>*>(gate, {1, 1}, open.back().get()));
+   }
+   HsaContext::Dependencies dependencies(builds.begin(), builds.end());
+
+   const size_t n = 1000;
+   vector<size_t> output(n, 42);
+   vector<size_t> next(n, 42);
+   HsaFuture probe = probeCtx.dispatchAfter<size_t*, size_t>(dependencies, storeGlobalId, {n, 64}, output.data(), n);
+   // Subsequent packets wait as well.
+   HsaFuture subsequent = probeCtx.dispatchAsync<size_t*, size_t>(storeGlobalId, {n, 64}, next.data(), n);
+
+   for (size_t i = 0; i < numBuilds - 1; i++) {
+      *open[i] = true;
+   }
+   this_thread::sleep_for(chrono::milliseconds(10));
+   ASSERT_FALSE(probe.isReady());
+   ASSERT_FALSE(subsequent.isReady());
+   ASSERT_EQ(42u, output[0]);
+   ASSERT_EQ(42u, next[0]);
+
+   // The dependencies can be waited for before the dispatch has completed.
+   *open.back() = true;
+   HsaFuture::waitAll(builds);
+   probe.wait();
+   subsequent.wait();
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i, output[i]);
+      ASSERT_EQ(i, next[i]);
+   }
+
+   // Completed dependencies do not block.
+   probeCtx.dispatchAfter<size_t*, size_t>(dependencies, storeGlobalId, {n, 64}, output.data(), n).wait();
+   ASSERT_EQ(0u, probeCtx.getSignalPool().getStats().numInUse);
+}
+
+TEST(HsaNativeAgent, DispatchAfterAny) {
+   HsaNativeAgent agent1(1);
+   agent1.registerKernel(gateKernel());
+   HsaContext ctx1(agent1);
+   ctx1.createQueue();
+   HsaNativeAgent agent2(1);
+   agent2.registerKernel(gateKernel());
+   agent2.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx2(agent2);
+   ctx2.createQueue();
+   HsaNativeAgent agent3(1);
+   agent3.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx3(agent3);
+   ctx3.createQueue();
+
+   atomic<bool> open1(false);
+   atomic<bool> open2(false);
+   HsaFuture first = ctx1.dispatchAsync<atomic<bool>*>(ctx1.getKernelObject("&gate"), {1, 1}, &open1);
+   HsaFuture second = ctx2.dispatchAsync<atomic<bool>*>(ctx2.getKernelObject("&gate"), {1, 1}, &open2);
+
+   vector<size_t> output(100, 42);
+   HsaFuture probe = ctx3.dispatchAfterAny<size_t*, size_t>({first, second},
+         ctx3.getKernelObject("&__OpenCL_storeGlobalId_kernel"), {output.size(), 0}, output.data(), output.size());
+   this_thread::sleep_for(chrono::milliseconds(10));
+   ASSERT_FALSE(probe.isReady());
+
+   open2 = true;
+   probe.wait();
+   ASSERT_EQ(99u, output[99]);
+   ASSERT_FALSE(first.isReady());
+
+   // A barrier-OR packet holds a limited number of alternatives.
+   vector<HsaFuture> alternatives;
+   for (size_t i = 0; i <= HsaAgent::maxBarrierDependencies; i++) {
+      alternatives.push_back(ctx1.dispatchAsync<atomic<bool>*>(ctx1.getKernelObject("&gate"), {1, 1}, &open1));
+   }
+   const HsaContext::Dependencies tooMany(alternatives.begin(), alternatives.end());
+   ASSERT_THROW((ctx3.dispatchAfterAny<size_t*, size_t>(tooMany,
+         ctx3.getKernelObject("&__OpenCL_storeGlobalId_kernel"), {1, 1}, output.data(), 1)), HsaException);
+   open1 = true;
+}
+
+TEST(HsaNativeAgent, QueueFullPolicies) {
+   HsaNativeAgent agent(1);
+   agent.registerKernel(gateKernel());
+   agent.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue(3);
+   ASSERT_EQ(4u, agent.getQueueSize());
+   const auto gate = ctx.getKernelObject("&gate");
+   const auto storeGlobalId = ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel");
+
+   for (const HsaQueueFullPolicy policy : {HsaQueueFullPolicy::Spin, HsaQueueFullPolicy::Yield,
+         HsaQueueFullPolicy::Sleep}) {
+      ctx.setQueueFullPolicy(policy);
+      agent.resetQueueStats();
+
+      // The gate occupies the worker, thus the queue fills up.
+      atomic<bool> open(false);
+      HsaFuture closed = ctx.dispatchAsync<atomic<bool>*>(gate, {1, 1}, &open);
+      thread opener([&] {
+         this_thread::sleep_for(chrono::milliseconds(5));
+         open = true;
+      });
+      vector<size_t> output(100, 0);
+      vector<HsaFuture> tasks;
+      for (size_t i = 0; i < 8; i++) {
+         tasks.push_back(ctx.dispatchAsync<size_t*, size_t>(storeGlobalId, {output.size(), 0}, output.data(),
+               output.size()));
+      }
+      HsaFuture::waitAll(tasks);
+      closed.wait();
+      opener.join();
+      ASSERT_EQ(99u, output[99]);
+
+      const HsaAgent::QueueStats stats = ctx.getQueueStats();
+      ASSERT_LE(1u, stats.numStalls);
+      ASSERT_LT(0, stats.stallTime.count());
+   }
+}
+
+TEST(HsaNativeAgent, Spill) {
+   HsaNativeAgent agent(1);
+   agent.registerKernel(gateKernel());
+   agent.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue(4);
+   HsaNativeAgent spillAgent(1);
+   spillAgent.registerKernel(storeGlobalIdKernel());
+   HsaContext spillCtx(spillAgent);
+   spillCtx.createQueue();
+   ASSERT_THROW(ctx.setSpillContext(&ctx), HsaException);
+   ctx.setSpillContext(&spillCtx);
+
+   // The gate blocks the queue, thus the dispatches that do not fit spill.
+   atomic<bool> open(false);
+   HsaFuture closed = ctx.dispatchAsync<atomic<bool>*>(ctx.getKernelObject("&gate"), {1, 1}, &open);
+   const auto storeGlobalId = ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel");
+   const size_t numTasks = 10;
+   vector<vector<size_t>> outputs(numTasks, vector<size_t>(100, 0));
+   vector<HsaFuture> tasks;
+   for (size_t i = 0; i < numTasks; i++) {
+      tasks.push_back(ctx.dispatchAsync<size_t*, size_t>(storeGlobalId, {100, 0}, outputs[i].data(), 100));
+   }
+   ASSERT_EQ(numTasks - (agent.getQueueSize() - 1), ctx.getNumSpilledDispatches());
+   ASSERT_EQ(0u, ctx.getQueueStats().numStalls);
+
+   // The spilled dispatches run while the queue is blocked.
+   tasks.back().wait();
+   ASSERT_EQ(99u, outputs.back()[99]);
+   ASSERT_FALSE(tasks.front().isReady());
+
+   open = true;
+   HsaFuture::waitAll(tasks);
+   for (const auto& output : outputs) {
+      ASSERT_EQ(99u, output[99]);
+   }
+   closed.wait();
+}
+
+TEST(HsaNativeAgent, UnknownKernel) {
+   HsaNativeAgent agent;
+   HsaContext ctx(agent);
+   ASSERT_THROW(ctx.addModule("HSA BRIG"), HsaException);
+   ctx.createQueue();
+   ASSERT_THROW(ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel"), HsaException);
+   ASSERT_THROW(agent.registerKernel(storeGlobalIdKernel()), HsaException);
+}
+
+TEST(HsaNativePerformance, DispatchSync) {
+   HsaNativeAgent agent;
+   agent.registerKernel(nothingKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   const size_t n = 128;
+   size_t* output = new size_t[n];
+   memset(output, 0, n * sizeof(size_t));
+
+   const auto kernelObject = ctx.getKernelObject("&__OpenCL_nothing_kernel");
+
+   const size_t repeats = 8;
+   const double duration = clockSec([&] {
+      for (size_t r = 0; r < repeats; r++) {
+         for (size_t i = 0; i < n; i++) {
+            ctx.dispatch<size_t*, size_t>(kernelObject, {1, 128}, &output[i], i);
+         }
+      }
+   });
+   cout << "threads = " << agent.getNumThreads() << endl;
+   cout << "milliseconds/dispatch = " << (duration * 1000 / (n * repeats)) << endl;
+   cout << "dispatches/seconds = " << ((n * repeats) / duration) << endl;
+
+   delete[] output;
+}
+
+TEST(HsaNativePerformance, SeqRead) {
+   const size_t sizeInMiB = 256;
+   constexpr size_t n = (sizeInMiB * 1024 * 1024) / sizeof(uint32_t);
+   uint32_t* input = reinterpret_cast<uint32_t*>(Utils::mallocHuge(n * sizeof(uint32_t)));
+   uint64_t expectedResult = 0;
+   for (size_t i = 0; i < n; i++) {
+      input[i] = i;
+      expectedResult += input[i];
+   }
+
+   cout << "threads|throughput[GiB/sec]" << endl;
+   const uint32_t maxNumThreads = Utils::numProcessors();
+   for (uint32_t t = 1; t <= maxNumThreads; t <<= 1) {
+      HsaNativeAgent agent(t);
+      // Each work-group sums up a contiguous range of 64Ki elements.
+      agent.registerKernel(HsaHostKernel::forEachWorkGroup<uint32_t*, uint64_t*, size_t>("&__OpenCL_sumBlocks_kernel",
+            [](const HsaWorkGroup& group, uint32_t* in, uint64_t* out, size_t n) {
+               constexpr size_t blockSize = 1 << 16;
+               uint64_t sum = 0;
+               const size_t end = std::min(n, (group.groupId + 1) * blockSize);
+               for (size_t i = group.groupId * blockSize; i < end; i++) {
+                  sum += in[i];
+               }
+               out[group.groupId] = sum;
+            }));
+      HsaContext ctx(agent);
+      ctx.createQueue();
+
+      const auto kernelObject = ctx.getKernelObject("&__OpenCL_sumBlocks_kernel");
+      const uint32_t numBlocks = (n + (1 << 16) - 1) >> 16;
+      uint64_t* output = new uint64_t[numBlocks];
+
+      const size_t repeats = 10;
+      const double duration = clockSec([&] {
+         for (size_t r = 0; r < repeats; r++) {
+            ctx.dispatch<uint32_t*, uint64_t*, size_t>(kernelObject, {numBlocks, 1}, input, output, n);
+         }
+      });
+      cout << t << "|" << ((sizeInMiB / 1024.0) * repeats) / duration << endl;
+
+      // validate results
+      uint64_t val = 0;
+      for (uint32_t i = 0; i < numBlocks; i++) {
+         val += output[i];
+      }
+      ASSERT_EQ(expectedResult, val);
+      delete[] output;
+   }
+
+   Utils::freeHuge(input, n * sizeof(uint32_t));
+}
+
+} // namespace
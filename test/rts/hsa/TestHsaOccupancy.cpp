@@ -0,0 +1,125 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaNativeAgent.hpp>
+#include <rts/hsa/HsaOccupancy.hpp>
+#include <vector>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+/// A GCN-like GPU: 8 compute units with 40 wavefront slots and 64 KiB of
+/// group memory each.
+static HsaAgent::Properties gpu() {
+   HsaAgent::Properties properties;
+   properties.numComputeUnits = 8;
+   properties.wavefrontSize = 64;
+   properties.maxWavefrontsPerComputeUnit = 40;
+   properties.maxWorkgroupsPerComputeUnit = 16;
+   properties.maxWorkgroupSize = 1024;
+   properties.groupSegmentSize = 64 * 1024;
+   properties.privateSegmentSize = 0;
+   return properties;
+}
+
+static HsaAgent::KernelDescriptor kernel(const uint32_t groupSegmentSize, const uint32_t privateSegmentSize) {
+   return HsaAgent::KernelDescriptor { 1, 0, groupSegmentSize, privateSegmentSize };
+}
+
+TEST(HsaOccupancy, WavefrontLimited) {
+   const HsaOccupancy occupancy(gpu());
+   const auto k = kernel(0, 0);
+   ASSERT_EQ(16u, occupancy.getNumResidentWorkgroups(k, 64)); // work-group slots
+   ASSERT_EQ(16u, occupancy.getNumResidentWorkgroups(k, 128));
+   ASSERT_EQ(10u, occupancy.getNumResidentWorkgroups(k, 256));
+   ASSERT_EQ(5u, occupancy.getNumResidentWorkgroups(k, 512));
+   ASSERT_EQ(2u, occupancy.getNumResidentWorkgroups(k, 1024));
+   ASSERT_EQ(0u, occupancy.getNumResidentWorkgroups(k, 2048));
+   // Partial wavefronts occupy a full slot.
+   ASSERT_EQ(13u, occupancy.getNumResidentWorkgroups(k, 129));
+   ASSERT_DOUBLE_EQ(0.4, occupancy.getOccupancy(k, 64));
+   ASSERT_DOUBLE_EQ(1.0, occupancy.getOccupancy(k, 256));
+   ASSERT_DOUBLE_EQ(0.8, occupancy.getOccupancy(k, 1024));
+
+   // 256 and 512 achieve full occupancy, the larger one is recommended.
+   ASSERT_EQ(512u, occupancy.recommendWorkgroupSize(k));
+   ASSERT_EQ(8u * 5 * 512, occupancy.recommendGridSize(k, 512));
+   ASSERT_EQ(8u * 10 * 256, occupancy.recommendGridSize(k, 256));
+}
+
+TEST(HsaOccupancy, GroupMemoryLimited) {
+   const HsaOccupancy occupancy(gpu());
+   // 16 KiB per work-group, thus at most 4 work-groups per compute unit.
+   const auto k = kernel(16 * 1024, 0);
+   ASSERT_EQ(4u, occupancy.getNumResidentWorkgroups(k, 64));
+   ASSERT_EQ(4u, occupancy.getNumResidentWorkgroups(k, 256));
+   ASSERT_EQ(2u, occupancy.getNumResidentWorkgroups(k, 1024));
+   ASSERT_EQ(1024u, occupancy.recommendWorkgroupSize(k));
+
+   // The kernel does not fit at all.
+   const auto huge = kernel(128 * 1024, 0);
+   ASSERT_EQ(0u, occupancy.getNumResidentWorkgroups(huge, 64));
+   ASSERT_EQ(64u, occupancy.recommendWorkgroupSize(huge));
+   ASSERT_EQ(8u * 64, occupancy.recommendGridSize(huge, 64));
+}
+
+TEST(HsaOccupancy, PrivateMemoryLimited) {
+   HsaAgent::Properties properties = gpu();
+   properties.privateSegmentSize = 256 * 1024;
+   const HsaOccupancy occupancy(properties);
+   // 256 bytes per work-item, thus at most 1024 work-items per compute unit.
+   const auto k = kernel(0, 256);
+   ASSERT_EQ(16u, occupancy.getNumResidentWorkgroups(k, 64));
+   ASSERT_EQ(4u, occupancy.getNumResidentWorkgroups(k, 256));
+   ASSERT_EQ(1u, occupancy.getNumResidentWorkgroups(k, 1024));
+   ASSERT_EQ(1024u, occupancy.recommendWorkgroupSize(k));
+}
+
+TEST(HsaOccupancy, SmallGrids) {
+   const HsaOccupancy occupancy(gpu());
+   const auto k = kernel(0, 0);
+   // 8 compute units, 5 resident work-groups of 512 each: 20480 work-items
+   // occupy all compute units.
+   ASSERT_EQ(512u, occupancy.recommendWorkgroupSize(k, 20480));
+   ASSERT_EQ(128u, occupancy.recommendWorkgroupSize(k, 19968));
+   ASSERT_EQ(64u, occupancy.recommendWorkgroupSize(k, 100));
+   ASSERT_EQ(64u, occupancy.recommendWorkgroupSize(k, 1));
+   ASSERT_EQ(64u, occupancy.recommendWorkgroupSize(k, 0));
+}
+
+TEST(HsaOccupancy, InvalidProperties) {
+   HsaAgent::Properties properties = gpu();
+   properties.numComputeUnits = 0;
+   ASSERT_THROW(HsaOccupancy occupancy(properties), HsaException);
+}
+
+TEST(HsaOccupancy, NativeAgent) {
+   HsaNativeAgent agent(4);
+   agent.registerKernel(HsaHostKernel::forEachWorkItem<uint64_t*>("&__OpenCL_storeGlobalId_kernel",
+         [](uint64_t gid, uint64_t* dst) {
+            dst[gid] = gid;
+         }));
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   // A worker executes one work-group at a time, thus the work-groups are as
+   // large as possible while every worker gets one.
+   const auto kernelObject = ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel");
+   ASSERT_EQ(4u, ctx.getOccupancy().getAgentProperties().numComputeUnits);
+   ASSERT_EQ(256u, ctx.getOccupancy().recommendWorkgroupSize(kernelObject, 1000));
+
+   // Dispatches without a work-group size use the recommendation.
+   vector<uint64_t> output(1000);
+   ctx.dispatch<uint64_t*>(kernelObject, { output.size(), 0 }, output.data());
+   for (uint64_t i = 0; i < output.size(); i++) {
+      ASSERT_EQ(i, output[i]);
+   }
+}
+
+} // namespace
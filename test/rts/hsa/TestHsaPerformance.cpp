@@ -1,17 +1,23 @@
 #include "gtest/gtest.h"
 #include <rts/hsa/HsaContext.hpp>
 #include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaMemoryPool.hpp>
 #include <rts/hsa/HsaRuntime.hpp>
+#include <rts/hsa/HsaSignalPool.hpp>
+#include <rts/hsa/HsaTaskGraph.hpp>
+#include <rts/hsa/HsaTaskServer.hpp>
 #include <rts/hsa/HsaUtils.hpp>
 #include <rts/hsa/KernelArgs.hpp>
+#include <test/rts/hsa/kernel/TaskServer.hpp>
+#include <utils/Numa.hpp>
 #include <utils/Utils.hpp>
 #include <atomic>
-#include <fstream>
 #include <chrono>
 #include <iostream>
 #include <memory>
 #include <sstream>
 #include <thread>
+#include <vector>
 //---------------------------------------------------------------------------
 // SIM[DT] Lab
 // (c) Harald Lang 2015
@@ -71,16 +77,28 @@ static double clockNano(function<void(void)> fn) {
    return std::chrono::duration<double, nano>(end - start).count();
 }
 
-static string loadFromFile(const string& filename) {
-   ifstream file(filename, ifstream::binary);
-   if (file.fail()) {
-      throw "couldn't open file: " + filename;
-   }
-   string contents((istreambuf_iterator<char>(file)), (istreambuf_iterator<char>()));
-   if (contents.substr(0, 8) != "HSA BRIG") {
-      throw "invalid magic number";
-   }
-   return contents;
+/// Dispatches a kernel that ignores its arguments with a newly created
+/// completion signal (as HsaContext did before it pooled the signals).
+static void dispatchUnpooled(HsaAgent& agent, const HsaAgent::KernelDescriptor& kernel) {
+   const uint64_t packetId = agent.requestPacketId();
+   const hsa_signal_t completionSignal = agent.createSignal(1);
+   agent.publishPacket(packetId, kernel, {1, 128}, completionSignal);
+   agent.ringDoorbell(packetId);
+   while (agent.waitSignal(completionSignal, HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX,
+         HSA_WAIT_STATE_BLOCKED) != 0) {};
+   agent.destroySignal(completionSignal);
+}
+
+static void printSignalPoolStats(HsaContext& ctx) {
+   const HsaSignalPool::Stats stats = ctx.getSignalPool().getStats();
+   cout << "signal pool: capacity = " << stats.capacity << ", peak = " << stats.peakInUse
+         << ", growths = " << stats.numGrowths << endl;
+}
+
+static void printQueueStats(HsaContext& ctx) {
+   const HsaAgent::QueueStats stats = ctx.getQueueStats();
+   cout << "queue: size = " << ctx.getAgent().getQueueSize() << ", stalls = " << stats.numStalls
+         << ", stall time = " << chrono::duration<double, micro>(stats.stallTime).count() << " us" << endl;
 }
 
 template<typename T>
@@ -95,14 +113,21 @@ static void freeHuge(T* ptr,size_t n) {
    munmap(ptr,n * sizeof(T));
 }
 
+/// The large input and output buffers are recycled across the tests, rather
+/// than mapped (and faulted in) by each of them.
+static HsaMemoryPool& getBufferPool() {
+   static HsaMemoryPool pool;
+   return pool;
+}
+
 TEST(HsaPerformance, DispatchSync) {
    HsaRuntime rt;
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/Nothing.brig");
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/Nothing.brig");
 
-   ctx.addModule(module1.c_str());
+   ctx.addModule(module1);
    ctx.finalize();
    ctx.createQueue();
 
@@ -133,6 +158,17 @@ TEST(HsaPerformance, DispatchSync) {
    });
    cout << "cycles/dispatch = " << (cycles / (n * repeats)) << endl;
 
+   // Baseline: one signal per dispatch.
+   const uint64_t cyclesUnpooled = cpuCycles([&] {
+      for (size_t r = 0; r < repeats; r++) {
+         for (size_t i = 0; i < n; i++) {
+            dispatchUnpooled(ctx.getAgent(), kernelObject);
+         }
+      }
+   });
+   cout << "cycles/dispatch (unpooled signals) = " << (cyclesUnpooled / (n * repeats)) << endl;
+   printSignalPoolStats(ctx);
+
    delete[] output;
    rt.shutDown();
 }
@@ -142,9 +178,9 @@ TEST(HsaPerformance, DispatchAsync) {
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/Nothing.brig");
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/Nothing.brig");
 
-   ctx.addModule(module1.c_str());
+   ctx.addModule(module1);
    ctx.finalize();
    ctx.createQueue();
 
@@ -158,35 +194,33 @@ TEST(HsaPerformance, DispatchAsync) {
    const size_t repeats = 8;
    const double duration = clock([&] {
       for (size_t r = 0; r < repeats; r++) {
-         uint64_t handles[n];
-         HsaContext::Future* tasks = reinterpret_cast<HsaContext::Future*>(&handles);
+         HsaContext::Future tasks[n];
          for (size_t i = 0; i < n; i++) {
             tasks[i] = ctx.dispatchAsync<size_t*, size_t>(kernelObject, {1, 128}, &output[i], i);
          }
-         for (size_t i = 0; i < n; i++) {
-            tasks[i].wait();
-         }
+         HsaContext::Future::waitAll(tasks, n);
       }
    });
    cout << "milliseconds/dispatch = " << (duration / (n * repeats)) << endl;
    cout << "dispatches/seconds = " << ((n * repeats) / duration) * 1000 << endl;
+   printSignalPoolStats(ctx);
 
    delete[] output;
    rt.shutDown();
 }
 
-TEST(HsaPerformance, DISABLED_DispatchBatch) {
+TEST(HsaPerformance, DispatchBatch) {
    HsaRuntime rt;
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/Nothing.brig");
-
-   ctx.addModule(module1.c_str());
-   ctx.finalize();
-   ctx.createQueue();
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/Nothing.brig");
 
+   // The queue holds all packets of a batch.
    constexpr size_t n = 256;
+   ctx.addModule(module1);
+   ctx.finalize();
+   ctx.createQueue(n);
    size_t* output = new size_t[n];
    memset(output, 0, n * sizeof(size_t));
 
@@ -209,23 +243,24 @@ TEST(HsaPerformance, DISABLED_DispatchBatch) {
    });
    cout << "milliseconds/dispatch = " << (duration / (n * repeats)) << endl;
    cout << "dispatches/seconds = " << ((n * repeats) / duration) * 1000 << endl;
+   printQueueStats(ctx);
 
    delete[] output;
    rt.shutDown();
 }
 
-TEST(HsaPerformance, DISABLED_DispatchBatchDelayedExecution) {
+TEST(HsaPerformance, DispatchBatchDelayedExecution) {
    HsaRuntime rt;
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/Nothing.brig");
-
-   ctx.addModule(module1.c_str());
-   ctx.finalize();
-   ctx.createQueue();
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/Nothing.brig");
 
+   // The queue holds all packets of a batch.
    constexpr size_t n = 256;
+   ctx.addModule(module1);
+   ctx.finalize();
+   ctx.createQueue(n);
    size_t* output = new size_t[n];
    memset(output, 0, n * sizeof(size_t));
 
@@ -255,6 +290,7 @@ TEST(HsaPerformance, DISABLED_DispatchBatchDelayedExecution) {
    });
    cout << "milliseconds/dispatch = " << (duration / (n * repeats)) << endl;
    cout << "dispatches/seconds = " << ((n * repeats) / duration) * 1000 << endl;
+   printQueueStats(ctx);
 
    delete[] output;
    rt.shutDown();
@@ -265,9 +301,9 @@ TEST(HsaPerformance, DispatchBusyWait) {
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/NothingBusyWait.brig");
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/NothingBusyWait.brig");
 
-   ctx.addModule(module1.c_str());
+   ctx.addModule(module1);
    ctx.finalize();
    ctx.createQueue();
 
@@ -304,14 +340,147 @@ TEST(HsaPerformance, DispatchBusyWait) {
    rt.shutDown();
 }
 
+/// Compares two-stage pipelines (e.g., build then probe), where the second
+/// kernel waits for the first one either on the host or in the queue.
+TEST(HsaPerformance, DispatchAfter) {
+   HsaRuntime rt;
+   rt.initialize();
+   HsaContext ctx(rt);
+
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/Nothing.brig");
+
+   ctx.addModule(module1);
+   ctx.finalize();
+   ctx.createQueue();
+
+   const auto kernelObject = ctx.getKernelObject("&__OpenCL_nothing_kernel");
+   const size_t repeats = 1 * 1024;
+   size_t output = 0;
+
+   const double durationHostWait = clockMicro([&] {
+      for (size_t i = 0; i < repeats; i++) {
+         ctx.dispatchAsync<size_t*, size_t>(kernelObject, {1, 1}, &output, i).wait();
+         ctx.dispatchAsync<size_t*, size_t>(kernelObject, {1, 1}, &output, i).wait();
+      }
+   });
+   const double durationQueueWait = clockMicro([&] {
+      for (size_t i = 0; i < repeats; i++) {
+         HsaContext::Future build = ctx.dispatchAsync<size_t*, size_t>(kernelObject, {1, 1}, &output, i);
+         ctx.dispatchAfter<size_t*, size_t>({build}, kernelObject, {1, 1}, &output, i).wait();
+      }
+   });
+
+   cout << "microseconds/pipeline (host wait) = " << (durationHostWait / repeats) << endl;
+   cout << "microseconds/pipeline (barrier packet) = " << (durationQueueWait / repeats) << endl;
+   printSignalPoolStats(ctx);
+
+   rt.shutDown();
+}
+
+/// Compares the round trip of a task server call with the one of a dispatch.
+TEST(HsaPerformance, DispatchTaskServer) {
+   HsaRuntime rt;
+   rt.initialize();
+   HsaContext ctx(rt);
+
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/Nothing.brig");
+   const HsaModuleSource module2 = HsaModuleSource::map("bin/test/rts/hsa/kernel/TaskServer.brig");
+
+   ctx.addModule(module1);
+   ctx.addModule(module2);
+   ctx.finalize();
+   ctx.createQueue();
+
+   const size_t repeats = 1 * 1024;
+   size_t output = 0;
+   const auto nothingKernel = ctx.getKernelObject("&__OpenCL_nothing_kernel");
+   const double durationDispatch = clockMicro([&] {
+      for (size_t i = 0; i < repeats; i++) {
+         ctx.dispatch<size_t*, size_t>(nothingKernel, {1, 1}, &output, i);
+      }
+   });
+
+   double durationFirstStart;
+   double durationCall;
+   {
+      HsaTaskServer<kernel::AddTask, uint64_t> server(ctx, ctx.getKernelObject("&__OpenCL_addServer_kernel"));
+      durationFirstStart = clockMicro([&] {
+         server.waitUntilRunning();
+      });
+      uint64_t sum = 0;
+      durationCall = clockMicro([&] {
+         for (size_t i = 0; i < repeats; i++) {
+            sum = server.call({sum, i});
+         }
+      });
+      ASSERT_EQ(repeats * (repeats - 1) / 2, sum);
+      server.shutDown();
+   }
+
+   cout << "startup time = " << durationFirstStart << " us" << endl;
+   cout << "microseconds/dispatch = " << (durationDispatch / repeats) << endl;
+   cout << "microseconds/call = " << (durationCall / repeats) << endl;
+
+   rt.shutDown();
+}
+
+/// A pipeline of four stages with four dispatches each, every dispatch depends
+/// on all dispatches of the previous stage.
+TEST(HsaPerformance, TaskGraph) {
+   HsaRuntime rt;
+   rt.initialize();
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/Nothing.brig");
+   HsaContext ctx1(rt);
+   ctx1.addModule(module1);
+   ctx1.finalize();
+   ctx1.createQueue();
+   HsaContext ctx2(rt);
+   ctx2.addModule(module1);
+   ctx2.finalize();
+   ctx2.createQueue();
+
+   const size_t numStages = 4;
+   const size_t width = 4;
+   size_t output = 0;
+   HsaTaskGraph graph;
+   for (size_t stage = 0; stage < numStages; stage++) {
+      for (size_t i = 0; i < width; i++) {
+         const auto id = graph.addNode<size_t*, size_t>("nothing", "&__OpenCL_nothing_kernel", {1, 1}, &output, i);
+         for (size_t dependency = 0; stage > 0 && dependency < width; dependency++) {
+            graph.addDependency(id, (stage - 1) * width + dependency);
+         }
+      }
+   }
+
+   const size_t repeats = 1 * 1024;
+   for (const auto mode : {HsaTaskGraphExecutor::EdgeMode::BarrierPackets, HsaTaskGraphExecutor::EdgeMode::HostTracking}) {
+      for (const size_t numQueues : {1, 2}) {
+         vector<HsaContext*> contexts {&ctx1, &ctx2};
+         contexts.resize(numQueues);
+         HsaTaskGraphExecutor executor(graph, contexts, mode);
+         const double duration = clockMicro([&] {
+            for (size_t i = 0; i < repeats; i++) {
+               executor.run();
+            }
+         });
+         cout << "queues = " << numQueues << ", edges = "
+               << (mode == HsaTaskGraphExecutor::EdgeMode::BarrierPackets ? "barrier packets" : "host tracking")
+               << ", microseconds/run = " << (duration / repeats) << endl;
+      }
+   }
+   printSignalPoolStats(ctx1);
+
+   rt.shutDown();
+}
+
 TEST(HsaPerformance, DISABLED_SimtUtilizationWorkitems) {
    HsaRuntime rt;
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/SimtUtil.brig");
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/SimtUtil.brig");
 
-   ctx.addModule(module1.c_str());
+   ctx.addModule(module1);
    ctx.finalize();
    ctx.createQueue();
 
@@ -353,9 +522,9 @@ TEST(HsaPerformance, DISABLED_SimtUtilizationLoop) {
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/SimtUtil.brig");
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/SimtUtil.brig");
 
-   ctx.addModule(module1.c_str());
+   ctx.addModule(module1);
    ctx.finalize();
    ctx.createQueue();
 
@@ -397,9 +566,9 @@ TEST(HsaPerformance, SeqRead) {
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/Sum.brig");
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/Sum.brig");
 
-   ctx.addModule(module1.c_str());
+   ctx.addModule(module1);
    ctx.finalize();
    ctx.createQueue();
 
@@ -408,8 +577,10 @@ TEST(HsaPerformance, SeqRead) {
    const size_t maxNumGpuThreads = 64*8*1024;
    constexpr size_t n = (sizeInMiB * 1024 * 1024) / sizeof(uint32_t);
    cout << n << endl;
-   uint32_t* input = mallocHuge<uint32_t>(n);
-   uint64_t* output = mallocHuge<uint64_t>(n);
+   HsaPoolAllocator<uint32_t> inputAllocator(getBufferPool());
+   HsaPoolAllocator<uint64_t> outputAllocator(getBufferPool());
+   uint32_t* input = inputAllocator.allocate(n);
+   uint64_t* output = outputAllocator.allocate(n);
    uint64_t expectedResult = 0;
    for (size_t i = 0; i < n; i++) {
       input[i] = i;
@@ -440,6 +611,53 @@ TEST(HsaPerformance, SeqRead) {
       }
    }
 
+   {
+      // CPU performance per NUMA node: all threads of a node scan a copy of the input that resides on the
+      // node itself or on a remote node
+      const size_t repeats = 10;
+      cout << "cpuNode|memoryNode|#threads|throughput[GiB/sec]" << endl;
+      for (const Numa::Node& memoryNode : Numa::nodes()) {
+         uint32_t* nodeInput = reinterpret_cast<uint32_t*>(Numa::mallocHugeOnNode(n * sizeof(uint32_t), memoryNode.id));
+         Numa::firstTouch(nodeInput, n * sizeof(uint32_t), memoryNode.id);
+         memcpy(nodeInput, input, n * sizeof(uint32_t));
+         for (const Numa::Node& cpuNode : Numa::nodes()) {
+            const size_t numThreads = cpuNode.cpus.size();
+            vector<uint64_t> sums(numThreads * 8);
+            const double duration = clockSec([&] {
+               vector<thread> threads;
+               for (size_t t = 0; t < numThreads; t++) {
+                  threads.emplace_back([&, t] {
+                     Numa::setAffinity(t, cpuNode.id);
+                     const size_t begin = (n * t) / numThreads;
+                     const size_t end = (n * (t + 1)) / numThreads;
+                     for (size_t r = 0; r < repeats; r++) {
+                        uint64_t sum = 0;
+                        for (size_t i = begin; i < end; i++) {
+                           sum += nodeInput[i];
+                        }
+                        // one cache line per thread
+                        sums[t * 8] = sum;
+                     }
+                  });
+               }
+               for (thread& t : threads) {
+                  t.join();
+               }
+            });
+            uint64_t sum = 0;
+            for (size_t t = 0; t < numThreads; t++) {
+               sum += sums[t * 8];
+            }
+            if (sum != expectedResult) {
+               cout << "[CPU] validation failed: expected " << expectedResult << ", but got " << sum << endl;
+            }
+            cout << cpuNode.id << "|" << memoryNode.id << "|" << numThreads << "|";
+            cout << ((sizeInMiB / 1024.0) * repeats) / duration << endl;
+         }
+         Utils::freeHuge(nodeInput, n * sizeof(uint32_t));
+      }
+   }
+
    memset(output, 0, maxNumGpuThreads * sizeof(uint64_t));
 
    const std::string kernelName = "&__OpenCL_sumLoop_kernel";
@@ -473,8 +691,19 @@ TEST(HsaPerformance, SeqRead) {
       }
    }
 
-   freeHuge(input, n);
-   freeHuge(output, n);
+   // The launch configuration recommended by the occupancy model.
+   {
+      const uint16_t w = ctx.getOccupancy().recommendWorkgroupSize(kernelObject);
+      const uint64_t t = std::min<uint64_t>(ctx.getOccupancy().recommendGridSize(kernelObject, w), maxNumGpuThreads);
+      cout << "recommended: " << w << "|" << t << "|" << flush;
+      const double duration = clockSec([&] {
+         ctx.dispatch<uint32_t*, uint64_t*, size_t>(kernelObject, {t, w}, input, output, n);
+      });
+      cout << (n / t) << '|' << (sizeInMiB / 1024.0) / duration << endl;
+   }
+
+   inputAllocator.deallocate(input, n);
+   outputAllocator.deallocate(output, n);
    rt.shutDown();
 }
 
@@ -483,9 +712,9 @@ TEST(HsaPerformance, GroupReduction) {
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/Sum.brig");
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/Sum.brig");
 
-   ctx.addModule(module1.c_str());
+   ctx.addModule(module1);
    ctx.finalize();
    ctx.createQueue();
 
@@ -494,8 +723,10 @@ TEST(HsaPerformance, GroupReduction) {
    constexpr size_t n = (sizeInMiB * 1024 * 1024) / sizeof(uint32_t);
    cout << n << endl;
 
-   uint32_t* input = mallocHuge<uint32_t>(n);
-   uint64_t* output = mallocHuge<uint64_t>(n);
+   HsaPoolAllocator<uint32_t> inputAllocator(getBufferPool());
+   HsaPoolAllocator<uint64_t> outputAllocator(getBufferPool());
+   uint32_t* input = inputAllocator.allocate(n);
+   uint64_t* output = outputAllocator.allocate(n);
    uint64_t expectedResult = 0;
    for (size_t i = 0; i < n; i++) {
       input[i] = i;
@@ -537,8 +768,8 @@ TEST(HsaPerformance, GroupReduction) {
       }
    }
 
-   freeHuge(input, n);
-   freeHuge(output, n);
+   inputAllocator.deallocate(input, n);
+   outputAllocator.deallocate(output, n);
    rt.shutDown();
 }
 
@@ -547,9 +778,9 @@ TEST(HsaPerformance, GroupReductionLoop) {
    rt.initialize();
    HsaContext ctx(rt);
 
-   const string module1 = loadFromFile("bin/test/rts/hsa/kernel/Sum.brig");
+   const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/Sum.brig");
 
-   ctx.addModule(module1.c_str());
+   ctx.addModule(module1);
    ctx.finalize();
    ctx.createQueue();
 
@@ -558,8 +789,10 @@ TEST(HsaPerformance, GroupReductionLoop) {
    constexpr size_t n = (sizeInMiB * 1024 * 1024) / sizeof(uint32_t);
    cout << n << endl;
 
-   uint32_t* input = mallocHuge<uint32_t>(n);
-   uint64_t* output = mallocHuge<uint64_t>(n);
+   HsaPoolAllocator<uint32_t> inputAllocator(getBufferPool());
+   HsaPoolAllocator<uint64_t> outputAllocator(getBufferPool());
+   uint32_t* input = inputAllocator.allocate(n);
+   uint64_t* output = outputAllocator.allocate(n);
    uint64_t expectedResult = 0;
    for (size_t i = 0; i < n; i++) {
       input[i] = i;
@@ -605,8 +838,8 @@ TEST(HsaPerformance, GroupReductionLoop) {
       }
    }
 
-   freeHuge(input, n);
-   freeHuge(output, n);
+   inputAllocator.deallocate(input, n);
+   outputAllocator.deallocate(output, n);
    rt.shutDown();
 }
 
@@ -0,0 +1,189 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaHostBuffer.hpp>
+#include <rts/hsa/HsaModuleSource.hpp>
+#include <rts/hsa/HsaRegistrationCache.hpp>
+#include <rts/hsa/HsaRuntime.hpp>
+#include <utils/Utils.hpp>
+#include <cstdint>
+#include <vector>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+TEST(HsaRegistrationCache, Ranges) {
+   HsaRuntime rt;
+   rt.initialize();
+   HsaRegistrationCache& cache = HsaRegistrationCache::getInstance();
+   cache.clear();
+   const HsaRegistrationCache::Stats stats = cache.getStats();
+   char* buffer = new char[4096];
+
+   // A range is registered once, a covered range is a hit.
+   cache.acquire(buffer, 1024);
+   cache.acquire(buffer, 1024);
+   cache.acquire(buffer + 512, 256);
+   ASSERT_EQ(stats.numMisses + 1, cache.getStats().numMisses);
+   ASSERT_EQ(stats.numHits + 2, cache.getStats().numHits);
+   ASSERT_EQ(1u, cache.getStats().numRanges);
+   ASSERT_EQ(1024u, cache.getStats().registeredBytes);
+
+   // An adjacent range is registered on its own.
+   cache.acquire(buffer + 1024, 1024);
+   ASSERT_EQ(2u, cache.getStats().numRanges);
+
+   // An overlapping range is merged with the registered ones.
+   cache.acquire(buffer + 3072, 1024);
+   ASSERT_EQ(3u, cache.getStats().numRanges);
+   cache.acquire(buffer + 512, 3072);
+   ASSERT_EQ(1u, cache.getStats().numRanges);
+   ASSERT_EQ(4096u, cache.getStats().registeredBytes);
+   cache.acquire(buffer, 4096);
+   ASSERT_EQ(stats.numMisses + 4, cache.getStats().numMisses);
+
+   // The merged range is in use until all acquisitions have been released.
+   cache.release(buffer, 1024);
+   cache.release(buffer, 1024);
+   cache.release(buffer + 512, 256);
+   cache.release(buffer + 1024, 1024);
+   cache.release(buffer + 3072, 1024);
+   cache.release(buffer + 512, 3072);
+   cache.setMaxRegisteredBytes(0);
+   ASSERT_EQ(1u, cache.getStats().numRanges);
+   cache.release(buffer, 4096);
+   ASSERT_EQ(0u, cache.getStats().numRanges);
+   cache.setMaxRegisteredBytes(size_t(16) << 30);
+
+   cache.acquire(buffer, 4096);
+   cache.invalidate(buffer + 100, 1);
+   ASSERT_EQ(0u, cache.getStats().numRanges);
+   ASSERT_EQ(0u, cache.getStats().registeredBytes);
+   // Releasing an invalidated range has no effect.
+   cache.release(buffer, 4096);
+
+   delete[] buffer;
+   rt.shutDown();
+}
+
+TEST(HsaRegistrationCache, Eviction) {
+   HsaRuntime rt;
+   rt.initialize();
+   HsaRegistrationCache& cache = HsaRegistrationCache::getInstance();
+   cache.clear();
+   const uint64_t numEvictions = cache.getStats().numEvictions;
+   char* buffer = new char[4 * 4096];
+   cache.setMaxRegisteredBytes(2 * 1024);
+   const auto use = [&](char* ptr, const size_t size) {
+      cache.acquire(ptr, size);
+      cache.release(ptr, size);
+   };
+
+   // The least recently used range is unregistered first.
+   use(buffer, 1024);
+   use(buffer + 4096, 1024);
+   use(buffer, 1024);
+   use(buffer + 2 * 4096, 1024);
+   ASSERT_EQ(numEvictions + 1, cache.getStats().numEvictions);
+   ASSERT_EQ(2u, cache.getStats().numRanges);
+   const uint64_t numHits = cache.getStats().numHits;
+   use(buffer, 1024);
+   ASSERT_EQ(numHits + 1, cache.getStats().numHits);
+
+   // Ranges in use remain registered, even if they exceed the bound.
+   cache.acquire(buffer + 3 * 4096, 4096);
+   cache.acquire(buffer + 4096, 1024);
+   ASSERT_EQ(numEvictions + 3, cache.getStats().numEvictions);
+   ASSERT_EQ(2u, cache.getStats().numRanges);
+   ASSERT_EQ(5u * 1024, cache.getStats().registeredBytes);
+
+   // Released ranges are unregistered (the least recently used first).
+   cache.release(buffer + 3 * 4096, 4096);
+   ASSERT_EQ(1u, cache.getStats().numRanges);
+   ASSERT_EQ(1024u, cache.getStats().registeredBytes);
+   cache.release(buffer + 4096, 1024);
+   ASSERT_EQ(1u, cache.getStats().numRanges);
+
+   cache.setMaxRegisteredBytes(size_t(16) << 30);
+   delete[] buffer;
+   // The registrations are undone on shut down.
+   rt.shutDown();
+   ASSERT_EQ(0u, cache.getStats().numRanges);
+}
+
+TEST(HsaRegistrationCache, Dispatch) {
+   HsaRuntime rt;
+   rt.initialize();
+   HsaRegistrationCache& cache = HsaRegistrationCache::getInstance();
+   cache.clear();
+   {
+      HsaContext ctx(rt);
+      const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
+      ctx.addModule(module1);
+      ctx.finalize();
+      ctx.createQueue();
+      const HsaContext::KernelDescriptor kernel = ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel");
+      const size_t n = 1024 * 1024;
+      vector<size_t> output(n);
+      const HsaHostBuffer<size_t> buffer(output.data(), n);
+
+      // Repeated dispatches over the same buffer register it once.
+      const uint64_t numMisses = cache.getStats().numMisses;
+      for (size_t r = 0; r < 4; r++) {
+         ctx.dispatch<HsaHostBuffer<size_t>, size_t>(kernel, { n, 128 }, buffer, n);
+      }
+      ASSERT_EQ(numMisses + 1, cache.getStats().numMisses);
+      for (size_t i = 0; i < n; i++) {
+         ASSERT_EQ(i, output[i]);
+      }
+
+      // The buffer is in use until the kernel has completed.
+      HsaContext::Future task = ctx.dispatchAsync<HsaHostBuffer<size_t>, size_t>(kernel, { n, 128 }, buffer, n);
+      cache.setMaxRegisteredBytes(0);
+      ASSERT_EQ(1u, cache.getStats().numRanges);
+      task.wait();
+      ASSERT_EQ(0u, cache.getStats().numRanges);
+
+      // Batch packets release their buffers once the batch has completed.
+      ctx.dispatchBatch<HsaHostBuffer<size_t>, size_t>(kernel, { n, 128 }, buffer, n);
+      ASSERT_EQ(1u, cache.getStats().numRanges);
+      ctx.waitForBatchCompletion();
+      ASSERT_EQ(0u, cache.getStats().numRanges);
+      cache.setMaxRegisteredBytes(size_t(16) << 30);
+   }
+   rt.shutDown();
+}
+
+TEST(HsaRegistrationCache, FreeHuge) {
+   HsaRuntime rt;
+   rt.initialize();
+   HsaRegistrationCache& cache = HsaRegistrationCache::getInstance();
+   cache.clear();
+   {
+      HsaContext ctx(rt);
+      const HsaModuleSource module1 = HsaModuleSource::map("bin/test/rts/hsa/kernel/StoreGlobalId.brig");
+      ctx.addModule(module1);
+      ctx.finalize();
+      ctx.createQueue();
+
+      const size_t n = 1024 * 1024;
+      size_t* output = reinterpret_cast<size_t*>(Utils::mallocHuge(n * sizeof(size_t)));
+      ctx.dispatch<HsaHostBuffer<size_t>, size_t>("&__OpenCL_storeGlobalId_kernel", { n, 128 },
+            HsaHostBuffer<size_t>(output, n), n);
+      for (size_t i = 0; i < n; i++) {
+         ASSERT_EQ(i, output[i]);
+      }
+      ASSERT_EQ(1u, cache.getStats().numRanges);
+
+      // Freeing the buffer undoes its registration.
+      Utils::freeHuge(output, n * sizeof(size_t));
+      ASSERT_EQ(0u, cache.getStats().numRanges);
+   }
+   rt.shutDown();
+}
+
+} // namespace
@@ -0,0 +1,156 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaNativeAgent.hpp>
+#include <rts/hsa/HsaSignalPool.hpp>
+#include <utils/Utils.hpp>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+TEST(HsaSignalPool, AcquireRelease) {
+   HsaNativeAgent agent(1);
+   HsaSignalPool pool(agent, 4);
+   ASSERT_EQ(4u, pool.getStats().capacity);
+
+   const HsaSignalPool::Slot slot = pool.acquire();
+   const hsa_signal_t signal = pool.getSignal(slot);
+   ASSERT_EQ(1, agent.loadSignal(signal));
+
+   // The signal is reset when it is released.
+   agent.addSignal(signal, -1);
+   pool.release(slot);
+   ASSERT_EQ(1, agent.loadSignal(signal));
+
+   // Released signals are reused.
+   ASSERT_EQ(slot, pool.acquire());
+   pool.release(slot);
+
+   const HsaSignalPool::Stats stats = pool.getStats();
+   ASSERT_EQ(0u, stats.numInUse);
+   ASSERT_EQ(1u, stats.peakInUse);
+   ASSERT_EQ(0u, stats.numGrowths);
+   pool.destroySignals();
+}
+
+TEST(HsaSignalPool, Retain) {
+   HsaNativeAgent agent(1);
+   HsaSignalPool pool(agent, 4);
+   const HsaSignalPool::Slot slot = pool.acquire();
+   const hsa_signal_t signal = pool.getSignal(slot);
+   agent.addSignal(signal, -1);
+
+   // A retained signal stays out of the pool (and keeps its value) until the
+   // last reference has been released.
+   pool.retain(slot);
+   pool.release(slot);
+   ASSERT_EQ(0, agent.loadSignal(signal));
+   ASSERT_EQ(1u, pool.getStats().numInUse);
+   ASSERT_NE(slot, pool.acquire());
+   pool.release(slot);
+   ASSERT_EQ(1, agent.loadSignal(signal));
+   ASSERT_EQ(1u, pool.getStats().numInUse);
+   pool.destroySignals();
+}
+
+TEST(HsaSignalPool, Grow) {
+   HsaNativeAgent agent(1);
+   HsaSignalPool pool(agent, 4);
+
+   constexpr uint32_t n = 10;
+   vector<HsaSignalPool::Slot> slots;
+   set<uint64_t> signals;
+   for (uint32_t i = 0; i < n; i++) {
+      slots.push_back(pool.acquire());
+      signals.insert(pool.getSignal(slots.back()).handle);
+   }
+   ASSERT_EQ(n, signals.size());
+
+   HsaSignalPool::Stats stats = pool.getStats();
+   ASSERT_EQ(12u, stats.capacity);
+   ASSERT_EQ(2u, stats.numGrowths);
+   ASSERT_EQ(n, stats.numInUse);
+
+   for (const HsaSignalPool::Slot slot : slots) {
+      pool.release(slot);
+   }
+   stats = pool.getStats();
+   ASSERT_EQ(0u, stats.numInUse);
+   ASSERT_EQ(n, stats.peakInUse);
+   pool.destroySignals();
+}
+
+TEST(HsaSignalPool, Concurrent) {
+   HsaNativeAgent agent(1);
+   HsaSignalPool pool(agent, 8);
+
+   const uint32_t numThreads = 4;
+   const uint32_t repeats = 1 << 14;
+   // A slot must never be handed out twice at the same time.
+   unique_ptr<atomic<uint32_t>[]> owners(new atomic<uint32_t>[1 << 12]);
+   for (uint32_t i = 0; i < (1 << 12); i++) {
+      owners[i] = 0;
+   }
+   atomic<uint32_t> numConflicts(0);
+
+   vector<thread> threads;
+   for (uint32_t t = 0; t < numThreads; t++) {
+      threads.emplace_back([&, t] {
+         HsaSignalPool::Slot slots[3];
+         for (uint32_t r = 0; r < repeats; r++) {
+            for (HsaSignalPool::Slot& slot : slots) {
+               slot = pool.acquire();
+               uint32_t expected = 0;
+               if (!owners[slot].compare_exchange_strong(expected, t + 1)) numConflicts++;
+            }
+            for (const HsaSignalPool::Slot slot : slots) {
+               owners[slot] = 0;
+               pool.release(slot);
+            }
+         }
+      });
+   }
+   for (thread& t : threads) {
+      t.join();
+   }
+
+   ASSERT_EQ(0u, numConflicts.load());
+   const HsaSignalPool::Stats stats = pool.getStats();
+   ASSERT_EQ(0u, stats.numInUse);
+   ASSERT_LE(stats.peakInUse, numThreads * 3);
+   ASSERT_LE(stats.peakInUse, stats.capacity);
+   pool.destroySignals();
+}
+
+TEST(HsaSignalPoolPerformance, AcquireRelease) {
+   HsaNativeAgent agent(1);
+   HsaSignalPool pool(agent);
+
+   const uint32_t n = 1 << 16;
+   uint64_t begin = Utils::rdtsc();
+   for (uint32_t i = 0; i < n; i++) {
+      agent.destroySignal(agent.createSignal(1));
+   }
+   const uint64_t createCycles = Utils::rdtsc() - begin;
+
+   begin = Utils::rdtsc();
+   for (uint32_t i = 0; i < n; i++) {
+      pool.release(pool.acquire());
+   }
+   const uint64_t poolCycles = Utils::rdtsc() - begin;
+
+   cout << "cycles/signal (create + destroy) = " << (createCycles / n) << endl;
+   cout << "cycles/signal (pool acquire + release) = " << (poolCycles / n) << endl;
+   pool.destroySignals();
+}
+
+} // namespace
@@ -0,0 +1,657 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaAqlPacketProcessor.hpp>
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaHostSignal.hpp>
+#include <rts/hsa/HsaSignalPool.hpp>
+#include <rts/hsa/HsaSoftAqlAgent.hpp>
+#include <utils/Utils.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <tuple>
+#include <vector>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+/// Host implementation of the StoreGlobalId.cl kernel.
+static HsaHostKernel storeGlobalIdKernel() {
+   return HsaHostKernel::forEachWorkItem<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel",
+         [](uint64_t gid, size_t* output, size_t n) {
+            if (gid < n) output[gid] = gid;
+         });
+}
+
+/// Host implementation of the Add.cl kernel.
+static HsaHostKernel addKernel() {
+   return HsaHostKernel::forEachWorkItem<size_t*, size_t, size_t>("&__OpenCL_add_kernel",
+         [](uint64_t gid, size_t* output, size_t value, size_t n) {
+            if (gid < n) output[gid] += value;
+         });
+}
+
+/// Host implementation of the Nothing.cl kernel.
+static HsaHostKernel nothingKernel() {
+   return HsaHostKernel::forEachWorkGroup<size_t*, size_t>("&__OpenCL_nothing_kernel",
+         [](const HsaWorkGroup& /* group */, size_t* /* output */, size_t /* value */) {
+         });
+}
+
+static double clockSec(function<void(void)> fn) {
+   std::chrono::time_point<std::chrono::high_resolution_clock> start, end;
+   start = std::chrono::high_resolution_clock::now();
+   fn();
+   end = std::chrono::high_resolution_clock::now();
+   return std::chrono::duration<double>(end - start).count();
+}
+
+/// Dispatches a kernel that ignores its arguments with a newly created
+/// completion signal (as HsaContext did before it pooled the signals).
+static void dispatchUnpooled(HsaAgent& agent, const HsaAgent::KernelDescriptor& kernel) {
+   const uint64_t packetId = agent.requestPacketId();
+   const hsa_signal_t completionSignal = agent.createSignal(1);
+   agent.publishPacket(packetId, kernel, {1, 128}, completionSignal);
+   agent.ringDoorbell(packetId);
+   while (agent.waitSignal(completionSignal, HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX,
+         HSA_WAIT_STATE_BLOCKED) != 0) {};
+   agent.destroySignal(completionSignal);
+}
+
+static void printSignalPoolStats(HsaContext& ctx) {
+   const HsaSignalPool::Stats stats = ctx.getSignalPool().getStats();
+   cout << "signal pool: capacity = " << stats.capacity << ", peak = " << stats.peakInUse
+         << ", growths = " << stats.numGrowths << endl;
+}
+
+static void printQueueStats(HsaContext& ctx) {
+   const HsaAgent::QueueStats stats = ctx.getQueueStats();
+   cout << "queue: size = " << ctx.getAgent().getQueueSize() << ", stalls = " << stats.numStalls
+         << ", stall time = " << chrono::duration<double, micro>(stats.stallTime).count() << " us" << endl;
+}
+
+static const uint16_t dispatchPacketHeader =
+      (HSA_PACKET_TYPE_KERNEL_DISPATCH << HSA_PACKET_HEADER_TYPE) |
+      (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_ACQUIRE_FENCE_SCOPE) |
+      (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_RELEASE_FENCE_SCOPE);
+
+/// Writes a dispatch packet to the queue (without ringing the doorbell).
+static uint64_t writePacket(HsaAqlPacketProcessor& processor, const HsaHostKernel& kernel,
+      const void* kernargs, const uint32_t gridSize, const uint16_t workgroupSize,
+      const hsa_signal_t completionSignal, const uint16_t header = dispatchPacketHeader) {
+   hsa_queue_t* queue = processor.getQueue();
+   const uint64_t packetId = processor.addWriteIndex(1);
+   while (packetId - processor.loadReadIndex() >= queue->size);
+   hsa_kernel_dispatch_packet_t* packet =
+         reinterpret_cast<hsa_kernel_dispatch_packet_t*>(queue->base_address) + (packetId & (queue->size - 1));
+   std::memset(reinterpret_cast<uint8_t*>(packet) + 4, 0, sizeof(hsa_kernel_dispatch_packet_t) - 4);
+   packet->workgroup_size_x = workgroupSize;
+   packet->workgroup_size_y = 1;
+   packet->workgroup_size_z = 1;
+   packet->grid_size_x = gridSize;
+   packet->grid_size_y = 1;
+   packet->grid_size_z = 1;
+   packet->kernel_object = reinterpret_cast<uint64_t>(&kernel);
+   packet->kernarg_address = const_cast<void*>(kernargs);
+   packet->completion_signal = completionSignal;
+   const uint32_t headerAndSetup = header | (1 << HSA_KERNEL_DISPATCH_PACKET_SETUP_DIMENSIONS) << 16;
+   __atomic_store_n(reinterpret_cast<uint32_t*>(packet), headerAndSetup, __ATOMIC_RELEASE);
+   return packetId;
+}
+
+TEST(HsaAqlPacketProcessor, QueueProtocol) {
+   const HsaHostKernel kernel = storeGlobalIdKernel();
+   HsaAqlPacketProcessor processor(4, 2);
+   hsa_queue_t* queue = processor.getQueue();
+   ASSERT_EQ(4u, queue->size);
+
+   const size_t n = 1000;
+   size_t* output = new size_t[n];
+   memset(output, 0, n * sizeof(size_t));
+   struct alignas(16) {
+      void* leading[HsaAgent::numLeadingParameters];
+      size_t* output;
+      size_t n;
+   } kernargs = {{nullptr}, output, n};
+
+   const hsa_signal_t signal = HsaHostSignal::create(1);
+   const uint64_t packetId = writePacket(processor, kernel, &kernargs, n, 64, signal);
+   processor.ringDoorbell(packetId);
+   HsaHostSignal::wait(signal, HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX, HSA_WAIT_STATE_BLOCKED);
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i, output[i]);
+   }
+   // The packet has been consumed and released.
+   ASSERT_EQ(1u, processor.loadReadIndex());
+   const hsa_kernel_dispatch_packet_t* packet = reinterpret_cast<hsa_kernel_dispatch_packet_t*>(queue->base_address);
+   ASSERT_EQ(HSA_PACKET_TYPE_INVALID, (packet->header >> HSA_PACKET_HEADER_TYPE) & 0xff);
+   ASSERT_EQ(HSA_STATUS_SUCCESS, processor.getStatus());
+
+   HsaHostSignal::destroy(signal);
+   delete[] output;
+}
+
+TEST(HsaAqlPacketProcessor, InOrderCompletion) {
+   std::atomic<uint64_t> counter(0);
+   // Each packet checks that all preceding packets have completed.
+   const HsaHostKernel kernel = HsaHostKernel::forEachWorkGroup<std::atomic<uint64_t>*, uint64_t>("&check",
+         [](const HsaWorkGroup& group, std::atomic<uint64_t>* counter, uint64_t packetIndex) {
+            // An out-of-order execution spoils the result.
+            const uint64_t increment = counter->load() / 8 == packetIndex ? 1 : 1000;
+            counter->fetch_add(increment * (group.end - group.begin));
+         });
+   HsaAqlPacketProcessor processor(8, 4);
+
+   const uint64_t numPackets = 100;
+   struct alignas(16) Kernargs {
+      void* leading[HsaAgent::numLeadingParameters];
+      std::atomic<uint64_t>* counter;
+      uint64_t packetIndex;
+   };
+   Kernargs* kernargs = new Kernargs[numPackets]();
+   const hsa_signal_t signal = HsaHostSignal::create(numPackets);
+   for (uint64_t i = 0; i < numPackets; i++) {
+      kernargs[i].counter = &counter;
+      kernargs[i].packetIndex = i;
+      processor.ringDoorbell(writePacket(processor, kernel, &kernargs[i], 8, 1, signal));
+   }
+   HsaHostSignal::wait(signal, HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX, HSA_WAIT_STATE_BLOCKED);
+   ASSERT_EQ(numPackets * 8, counter.load());
+   ASSERT_EQ(numPackets, processor.loadReadIndex());
+
+   HsaHostSignal::destroy(signal);
+   delete[] kernargs;
+}
+
+TEST(HsaAqlPacketProcessor, InvalidPacket) {
+   const HsaHostKernel kernel = nothingKernel();
+   std::atomic<hsa_status_t> error(HSA_STATUS_SUCCESS);
+   HsaAqlPacketProcessor processor(4, 2, [&](hsa_status_t status) {
+      error = status;
+   });
+   const uint16_t vendorSpecificHeader = HSA_PACKET_TYPE_VENDOR_SPECIFIC << HSA_PACKET_HEADER_TYPE;
+   processor.ringDoorbell(writePacket(processor, kernel, nullptr, 1, 1, {0}, vendorSpecificHeader));
+   while (error.load() == HSA_STATUS_SUCCESS) {
+      std::this_thread::yield();
+   }
+   ASSERT_EQ(HSA_STATUS_ERROR_INVALID_PACKET_FORMAT, error.load());
+   ASSERT_EQ(HSA_STATUS_ERROR_INVALID_PACKET_FORMAT, processor.getStatus());
+}
+
+/// Writes a barrier packet to the queue (without ringing the doorbell).
+static uint64_t writeBarrierPacket(HsaAqlPacketProcessor& processor, const hsa_packet_type_t type,
+      const vector<hsa_signal_t>& dependencies, const hsa_signal_t completionSignal) {
+   hsa_queue_t* queue = processor.getQueue();
+   const uint64_t packetId = processor.addWriteIndex(1);
+   while (packetId - processor.loadReadIndex() >= queue->size);
+   hsa_barrier_and_packet_t* packet =
+         reinterpret_cast<hsa_barrier_and_packet_t*>(queue->base_address) + (packetId & (queue->size - 1));
+   std::memset(reinterpret_cast<uint8_t*>(packet) + 4, 0, sizeof(hsa_barrier_and_packet_t) - 4);
+   for (size_t i = 0; i < dependencies.size(); i++) {
+      packet->dep_signal[i] = dependencies[i];
+   }
+   packet->completion_signal = completionSignal;
+   const uint32_t header = (type << HSA_PACKET_HEADER_TYPE)
+         | (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_ACQUIRE_FENCE_SCOPE)
+         | (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_RELEASE_FENCE_SCOPE);
+   __atomic_store_n(reinterpret_cast<uint32_t*>(packet), header, __ATOMIC_RELEASE);
+   return packetId;
+}
+
+TEST(HsaAqlPacketProcessor, BarrierPacket) {
+   const HsaHostKernel kernel = storeGlobalIdKernel();
+   HsaAqlPacketProcessor processor(4, 2);
+
+   size_t output = 42;
+   struct alignas(16) {
+      void* leading[HsaAgent::numLeadingParameters];
+      size_t* output;
+      size_t n;
+   } kernargs = {{nullptr}, &output, 1};
+
+   // The dispatch waits for both dependencies of the barrier-AND packet.
+   const hsa_signal_t dependency1 = HsaHostSignal::create(1);
+   const hsa_signal_t dependency2 = HsaHostSignal::create(1);
+   const hsa_signal_t barrierSignal = HsaHostSignal::create(1);
+   const hsa_signal_t signal = HsaHostSignal::create(1);
+   writeBarrierPacket(processor, HSA_PACKET_TYPE_BARRIER_AND, {dependency1, {0}, dependency2}, barrierSignal);
+   processor.ringDoorbell(writePacket(processor, kernel, &kernargs, 1, 1, signal));
+   HsaHostSignal::store(dependency1, 0);
+   this_thread::sleep_for(chrono::milliseconds(10));
+   ASSERT_EQ(1, HsaHostSignal::load(barrierSignal));
+   ASSERT_EQ(42u, output);
+
+   HsaHostSignal::store(dependency2, 0);
+   HsaHostSignal::wait(signal, HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX, HSA_WAIT_STATE_BLOCKED);
+   ASSERT_EQ(0, HsaHostSignal::load(barrierSignal));
+   ASSERT_EQ(0u, output);
+
+   // A barrier-OR packet waits for one of its dependencies.
+   HsaHostSignal::store(dependency1, 1);
+   HsaHostSignal::store(signal, 1);
+   output = 42;
+   writeBarrierPacket(processor, HSA_PACKET_TYPE_BARRIER_OR, {dependency1, dependency2}, {0});
+   processor.ringDoorbell(writePacket(processor, kernel, &kernargs, 1, 1, signal));
+   HsaHostSignal::wait(signal, HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX, HSA_WAIT_STATE_BLOCKED);
+   ASSERT_EQ(0u, output);
+   ASSERT_EQ(4u, processor.loadReadIndex());
+   ASSERT_EQ(HSA_STATUS_SUCCESS, processor.getStatus());
+
+   for (const hsa_signal_t s : {dependency1, dependency2, barrierSignal, signal}) {
+      HsaHostSignal::destroy(s);
+   }
+}
+
+TEST(HsaSoftAqlAgent, Dispatch) {
+   HsaSoftAqlAgent agent;
+   agent.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx(agent);
+   ctx.finalize();
+   ctx.createQueue();
+
+   const size_t n = 1024 * 1024;
+   size_t* output = new size_t[n];
+   memset(output, 0, n * sizeof(size_t));
+
+   ctx.dispatch<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel", {n, 128}, output, n);
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i, output[i]);
+   }
+
+   delete[] output;
+}
+
+TEST(HsaSoftAqlAgent, MultipleDispatches) {
+   HsaSoftAqlAgent agent;
+   agent.registerKernel(storeGlobalIdKernel());
+   agent.registerKernel(addKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   const size_t n = 1024;
+   size_t* output = new size_t[n];
+   memset(output, 42, n * sizeof(size_t));
+
+   // Wraps around the queue several times.
+   for (size_t i = 0; i < n; i++) {
+      ctx.dispatch<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel", {1, 128}, &output[i], 1);
+      ctx.dispatch<size_t*, size_t, size_t>("&__OpenCL_add_kernel", {1, 128}, &output[i], i, 1);
+   }
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i, output[i]);
+   }
+
+   delete[] output;
+}
+
+TEST(HsaSoftAqlAgent, DispatchAsync) {
+   HsaSoftAqlAgent agent;
+   agent.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   constexpr size_t n = 128;
+   size_t* output = new size_t[n];
+   memset(output, 42, n * sizeof(size_t));
+
+   const auto kernelObject = ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel");
+   HsaContext::Future tasks[n];
+   for (size_t i = 0; i < n; i++) {
+      tasks[i] = ctx.dispatchAsync<size_t*, size_t>(kernelObject, {1, 128}, &output[i], 1);
+   }
+   HsaContext::Future::waitAll(tasks, n);
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(0u, output[i]);
+   }
+
+   delete[] output;
+}
+
+TEST(HsaSoftAqlAgent, DispatchBatch) {
+   HsaSoftAqlAgent agent;
+   agent.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   constexpr size_t n = 128;
+   size_t* output = new size_t[n];
+   memset(output, 42, n * sizeof(size_t));
+
+   const auto kernelObject = ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel");
+   for (size_t i = 0; i < n; i++) {
+      ctx.dispatchBatch<size_t*, size_t>(kernelObject, {1, 128}, &output[i], 1);
+   }
+   ctx.waitForBatchCompletion();
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(0u, output[i]);
+   }
+
+   delete[] output;
+}
+
+TEST(HsaSoftAqlAgent, DispatchBatchCoalescing) {
+   HsaSoftAqlAgent agent;
+   agent.registerKernel(storeGlobalIdKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+   // More than the queue size (16), the doorbell is rung anyway.
+   ctx.setBatchCoalescing(64);
+
+   constexpr size_t n = 100;
+   size_t* output = new size_t[n];
+   memset(output, 42, n * sizeof(size_t));
+
+   const auto kernelObject = ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel");
+   for (size_t i = 0; i < n; i++) {
+      ctx.dispatchBatch<size_t*, size_t>(kernelObject, {1, 128}, &output[i], 1);
+   }
+   ctx.waitForBatchCompletion();
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(0u, output[i]);
+   }
+
+   delete[] output;
+}
+
+TEST(HsaSoftAqlAgent, DispatchSpan) {
+   HsaSoftAqlAgent agent;
+   agent.registerKernel(addKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+   const auto kernel = ctx.getKernel<size_t*, size_t, size_t>("&__OpenCL_add_kernel");
+
+   // Several queue-sized chunks.
+   constexpr size_t n = 100;
+   vector<size_t> output(n, 0);
+   vector<tuple<size_t*, size_t, size_t>> args;
+   for (size_t i = 0; i < n; i++) {
+      args.emplace_back(&output[i], i, 1);
+   }
+   HsaContext::Future task = ctx.dispatchSpan(kernel, {1, 128}, args.data(), n);
+   task.wait();
+
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i, output[i]);
+   }
+   ASSERT_FALSE(ctx.dispatchSpan(kernel, {1, 128}, args.data(), 0).valid());
+}
+
+TEST(HsaSoftAqlAgent, DispatchAfter) {
+   HsaSoftAqlAgent agent(2);
+   agent.registerKernel(addKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+   const auto kernel = ctx.getKernel<size_t*, size_t, size_t>("&__OpenCL_add_kernel");
+
+   // Barrier packets and dispatches share the queue slots, which wrap around
+   // several times.
+   constexpr size_t n = 100;
+   vector<size_t> output(n, 0);
+   for (size_t i = 0; i < n; i++) {
+      HsaContext::Future build = ctx.dispatchAsync(kernel, {1, 1}, &output[i], i, 1);
+      HsaContext::Future probe = ctx.dispatchAfter(HsaContext::Dependencies{build}, kernel, {1, 1}, &output[i], 1, 1);
+      build.wait();
+      probe.wait();
+   }
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(i + 1, output[i]);
+   }
+   ASSERT_EQ(0u, ctx.getSignalPool().getStats().numInUse);
+}
+
+TEST(HsaSoftAqlAgent, DispatchAfterPendingBatch) {
+   HsaSoftAqlAgent buildAgent(1);
+   buildAgent.registerKernel(addKernel());
+   HsaContext buildCtx(buildAgent);
+   buildCtx.createQueue();
+   HsaSoftAqlAgent agent(1);
+   agent.registerKernel(addKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue(16);
+   ctx.setBatchCoalescing(16);
+   const auto kernel = ctx.getKernel<size_t*, size_t, size_t>("&__OpenCL_add_kernel");
+
+   vector<size_t> output(16, 0);
+   HsaContext::Future build = buildCtx.dispatchAsync<size_t*, size_t, size_t>(
+         buildCtx.getKernelObject("&__OpenCL_add_kernel"), {1, 1}, &output[0], 1, 1);
+   // The pending batch packets and the barrier packet occupy the queue, the
+   // batch is submitted before the barrier packet is enqueued.
+   for (size_t i = 1; i < 16; i++) {
+      ctx.dispatchBatch<size_t*, size_t, size_t>(kernel.getDescriptor(), {1, 1}, &output[i], i, 1);
+   }
+   ctx.dispatchAfter(HsaContext::Dependencies{build}, kernel, {1, 1}, &output[0], 1, 1).wait();
+   ctx.waitForBatchCompletion();
+   ASSERT_EQ(2u, output[0]);
+   for (size_t i = 1; i < 16; i++) {
+      ASSERT_EQ(i, output[i]);
+   }
+}
+
+TEST(HsaSoftAqlAgent, DispatchAfterManyDependencies) {
+   HsaSoftAqlAgent buildAgent(1);
+   buildAgent.registerKernel(addKernel());
+   HsaContext buildCtx(buildAgent);
+   buildCtx.createQueue(16);
+   HsaSoftAqlAgent agent(1);
+   agent.registerKernel(addKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue(16);
+   const auto kernel = ctx.getKernel<size_t*, size_t, size_t>("&__OpenCL_add_kernel");
+
+   // More barrier packets than the queue holds.
+   const size_t numBuilds = HsaAgent::maxBarrierDependencies * 16 + 1;
+   vector<size_t> output(numBuilds + 1, 0);
+   vector<HsaFuture> builds;
+   const auto buildKernel = buildCtx.getKernelObject("&__OpenCL_add_kernel");
+   for (size_t i = 0; i < numBuilds; i++) {
+      builds.push_back(buildCtx.dispatchAsync<size_t*, size_t, size_t>(buildKernel, {1, 1}, &output[i], 1, 1));
+   }
+   HsaContext::Dependencies dependencies(builds.begin(), builds.end());
+   ctx.dispatchAfter(dependencies, kernel, {1, 1}, &output[numBuilds], 1, 1).wait();
+   for (size_t i = 0; i <= numBuilds; i++) {
+      ASSERT_EQ(1u, output[i]);
+   }
+}
+
+TEST(HsaSoftAqlAgent, QueueSize) {
+   HsaSoftAqlAgent invalid(1);
+   ASSERT_THROW(invalid.createQueue(0), HsaException);
+
+   HsaSoftAqlAgent agent(1);
+   const auto kernelObject = agent.registerKernel(nothingKernel());
+   agent.createQueue(100);
+   ASSERT_EQ(128u, agent.getQueueSize());
+
+   // All packets are reserved before any is published (the processor may
+   // launch published packets before the doorbell is rung).
+   const hsa_signal_t completionSignal = agent.createSignal(agent.getQueueSize());
+   const uint64_t firstPacketId = agent.requestPacketId();
+   for (uint32_t i = 1; i < agent.getQueueSize(); i++) {
+      agent.requestPacketId();
+   }
+   uint64_t nextPacketId;
+   ASSERT_FALSE(agent.tryRequestPacketId(nextPacketId));
+   const uint64_t packetId = firstPacketId + agent.getQueueSize() - 1;
+   for (uint64_t id = firstPacketId; id <= packetId; id++) {
+      agent.publishPacket(id, kernelObject, {1, 1}, completionSignal);
+   }
+   agent.ringDoorbell(packetId);
+   while (agent.waitSignal(completionSignal, HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX,
+         HSA_WAIT_STATE_BLOCKED) != 0) {
+   }
+   ASSERT_EQ(0u, agent.getQueueStats().numStalls);
+
+   ASSERT_TRUE(agent.tryRequestPacketId(nextPacketId));
+   ASSERT_EQ(packetId + 1, nextPacketId);
+   agent.storeSignal(completionSignal, 1);
+   agent.publishPacket(nextPacketId, kernelObject, {1, 1}, completionSignal);
+   agent.ringDoorbell(nextPacketId);
+   while (agent.waitSignal(completionSignal, HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX,
+         HSA_WAIT_STATE_BLOCKED) != 0) {
+   }
+   agent.destroySignal(completionSignal);
+}
+
+TEST(HsaSoftAqlAgent, QueueFullPolicies) {
+   HsaSoftAqlAgent agent(1);
+   agent.registerKernel(addKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue(4);
+   const auto kernel = ctx.getKernelObject("&__OpenCL_add_kernel");
+
+   // Many more batch packets than the queue holds.
+   const size_t n = 256;
+   size_t output = 0;
+   for (const HsaQueueFullPolicy policy : {HsaQueueFullPolicy::Spin, HsaQueueFullPolicy::Yield,
+         HsaQueueFullPolicy::Sleep}) {
+      ctx.setQueueFullPolicy(policy);
+      for (size_t i = 0; i < n; i++) {
+         ctx.dispatchBatch<size_t*, size_t, size_t>(kernel, {1, 1}, &output, 1, 1);
+      }
+      ctx.waitForBatchCompletion();
+   }
+   ASSERT_EQ(3 * n, output);
+   printQueueStats(ctx);
+}
+
+TEST(HsaSoftAqlAgent, UnknownKernel) {
+   HsaSoftAqlAgent agent;
+   HsaContext ctx(agent);
+   ASSERT_THROW(ctx.addModule("HSA BRIG"), HsaException);
+   ctx.createQueue();
+   ASSERT_THROW(ctx.getKernelObject("&__OpenCL_storeGlobalId_kernel"), HsaException);
+   ASSERT_THROW(agent.registerKernel(storeGlobalIdKernel()), HsaException);
+}
+
+TEST(HsaSoftAqlPerformance, DispatchSync) {
+   HsaSoftAqlAgent agent(1);
+   agent.registerKernel(nothingKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   const size_t n = 128;
+   size_t* output = new size_t[n];
+   memset(output, 0, n * sizeof(size_t));
+
+   const auto kernelObject = ctx.getKernelObject("&__OpenCL_nothing_kernel");
+
+   const size_t repeats = 8;
+   const double duration = clockSec([&] {
+      for (size_t r = 0; r < repeats; r++) {
+         for (size_t i = 0; i < n; i++) {
+            ctx.dispatch<size_t*, size_t>(kernelObject, {1, 128}, &output[i], i);
+         }
+      }
+   });
+   cout << "milliseconds/dispatch = " << (duration * 1000 / (n * repeats)) << endl;
+   cout << "dispatches/seconds = " << ((n * repeats) / duration) << endl;
+
+   // Name-based dispatch (symbol table lookup).
+   const double durationByName = clockSec([&] {
+      for (size_t r = 0; r < repeats; r++) {
+         for (size_t i = 0; i < n; i++) {
+            ctx.dispatch<size_t*, size_t>("&__OpenCL_nothing_kernel", {1, 128}, &output[i], i);
+         }
+      }
+   });
+   cout << "dispatches/seconds (by name) = " << ((n * repeats) / durationByName) << endl;
+
+   // Baseline: one signal per dispatch.
+   const double durationUnpooled = clockSec([&] {
+      for (size_t r = 0; r < repeats; r++) {
+         for (size_t i = 0; i < n; i++) {
+            dispatchUnpooled(agent, kernelObject);
+         }
+      }
+   });
+   cout << "dispatches/seconds (unpooled signals) = " << ((n * repeats) / durationUnpooled) << endl;
+   printSignalPoolStats(ctx);
+
+   delete[] output;
+}
+
+TEST(HsaSoftAqlPerformance, DispatchBatch) {
+   HsaSoftAqlAgent agent(1);
+   agent.registerKernel(nothingKernel());
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   const size_t n = 1 << 10;
+   size_t output = 0;
+   const auto kernelObject = ctx.getKernelObject("&__OpenCL_nothing_kernel");
+
+   const double duration = clockSec([&] {
+      for (size_t i = 0; i < n; i++) {
+         ctx.dispatchBatch<size_t*, size_t>(kernelObject, {1, 128}, &output, i);
+      }
+      ctx.waitForBatchCompletion();
+   });
+   cout << "microseconds/dispatch = " << (duration * 1000 * 1000 / n) << endl;
+
+   // Hold the doorbell for up to 8 packets.
+   ctx.setBatchCoalescing(8);
+   const double durationCoalesced = clockSec([&] {
+      for (size_t i = 0; i < n; i++) {
+         ctx.dispatchBatch<size_t*, size_t>(kernelObject, {1, 128}, &output, i);
+      }
+      ctx.waitForBatchCompletion();
+   });
+   cout << "microseconds/dispatch (coalesced) = " << (durationCoalesced * 1000 * 1000 / n) << endl;
+
+   vector<tuple<size_t*, size_t>> args;
+   for (size_t i = 0; i < n; i++) {
+      args.emplace_back(&output, i);
+   }
+   const double durationSpan = clockSec([&] {
+      ctx.dispatchSpan<size_t*, size_t>(kernelObject, {1, 128}, args.data(), n).wait();
+   });
+   cout << "microseconds/dispatch (span) = " << (durationSpan * 1000 * 1000 / n) << endl;
+}
+
+TEST(HsaSoftAqlPerformance, EnqueueDelayedExecution) {
+   for (const uint32_t queueSize : {16u, 256u}) {
+      HsaSoftAqlAgent agent(1);
+      agent.registerKernel(nothingKernel());
+      HsaContext ctx(agent);
+      ctx.createQueue(queueSize);
+      const auto kernelObject = ctx.getKernelObject("&__OpenCL_nothing_kernel");
+
+      // Fills the queue before the doorbell is rung.
+      const size_t n = queueSize - 1;
+      const size_t repeats = (1 << 16) / queueSize;
+      const hsa_signal_t completionSignal = agent.createSignal(0);
+      uint64_t enqueueCycles = 0;
+      for (size_t r = 0; r < repeats; r++) {
+         agent.storeSignal(completionSignal, n);
+         uint64_t packetId = 0;
+         const uint64_t begin = Utils::rdtsc();
+         for (size_t i = 0; i < n; i++) {
+            packetId = agent.requestPacketId();
+            agent.publishPacket(packetId, kernelObject, {1, 128}, completionSignal);
+         }
+         enqueueCycles += Utils::rdtsc() - begin;
+         agent.ringDoorbell(packetId);
+         while (agent.waitSignal(completionSignal, HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX,
+               HSA_WAIT_STATE_ACTIVE) != 0) {
+         }
+      }
+      cout << "queue size = " << queueSize << ", enqueue-cycles = " << (enqueueCycles / (n * repeats)) << endl;
+      agent.destroySignal(completionSignal);
+   }
+}
+
+} // namespace
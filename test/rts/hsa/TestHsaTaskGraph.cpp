@@ -0,0 +1,204 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaNativeAgent.hpp>
+#include <rts/hsa/HsaTaskGraph.hpp>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+
+typedef HsaTaskGraphExecutor::EdgeMode EdgeMode;
+
+/// Host implementation of the StoreGlobalId.cl kernel.
+static HsaHostKernel storeGlobalIdKernel() {
+   return HsaHostKernel::forEachWorkItem<size_t*, size_t>("&__OpenCL_storeGlobalId_kernel",
+         [](uint64_t gid, size_t* output, size_t n) {
+            if (gid < n) output[gid] = gid;
+         });
+}
+
+/// Host implementation of the Add.cl kernel.
+static HsaHostKernel addKernel() {
+   return HsaHostKernel::forEachWorkItem<size_t*, size_t, size_t>("&__OpenCL_add_kernel",
+         [](uint64_t gid, size_t* output, size_t value, size_t n) {
+            if (gid < n) output[gid] += value;
+         });
+}
+
+/// Adds two vectors element-wise.
+static HsaHostKernel sumKernel() {
+   return HsaHostKernel::forEachWorkItem<size_t*, const size_t*, const size_t*, size_t>("&sum",
+         [](uint64_t gid, size_t* output, const size_t* a, const size_t* b, size_t n) {
+            if (gid < n) output[gid] = a[gid] + b[gid];
+         });
+}
+
+/// The CPU executor: contexts of native agents, which provide the kernels of
+/// the tests.
+struct NativeContexts {
+   vector<unique_ptr<HsaNativeAgent>> agents;
+   vector<unique_ptr<HsaContext>> contexts;
+   vector<HsaContext*> pointers;
+
+   explicit NativeContexts(const size_t numContexts) {
+      for (size_t i = 0; i < numContexts; i++) {
+         agents.emplace_back(new HsaNativeAgent(2));
+         agents.back()->registerKernel(storeGlobalIdKernel());
+         agents.back()->registerKernel(addKernel());
+         agents.back()->registerKernel(sumKernel());
+         contexts.emplace_back(new HsaContext(*agents.back()));
+         contexts.back()->createQueue();
+         pointers.push_back(contexts.back().get());
+      }
+   }
+};
+
+/// A diamond: both branches double the input, the sink adds them up.
+struct Diamond {
+   static constexpr size_t n = 1000;
+   vector<size_t> input;
+   vector<size_t> left;
+   vector<size_t> right;
+   vector<size_t> output;
+   HsaTaskGraph::NodeId source, leftBranch, rightBranch, sink;
+
+   Diamond() :
+         input(n, 0), left(n, 0), right(n, 0), output(n, 0), source(0), leftBranch(0), rightBranch(0), sink(0) {
+   }
+
+   void addTo(HsaTaskGraph& graph) {
+      source = graph.addNode<size_t*, size_t>("source", "&__OpenCL_storeGlobalId_kernel", {n, 64}, input.data(), n);
+      leftBranch = graph.addNode<size_t*, const size_t*, const size_t*, size_t>("left", "&sum", {n, 64},
+            left.data(), input.data(), input.data(), n);
+      rightBranch = graph.addNode<size_t*, const size_t*, const size_t*, size_t>("right", "&sum", {n, 0},
+            right.data(), input.data(), input.data(), n);
+      sink = graph.addNode<size_t*, const size_t*, const size_t*, size_t>("sink", "&sum", {n, 64},
+            output.data(), left.data(), right.data(), n);
+      graph.addDependency(leftBranch, source);
+      graph.addDependency(rightBranch, source);
+      graph.addDependency(sink, leftBranch);
+      graph.addDependency(sink, rightBranch);
+   }
+};
+
+constexpr size_t Diamond::n;
+
+TEST(HsaTaskGraph, TopologicalOrder) {
+   HsaTaskGraph graph;
+   const auto a = graph.addNode("a", "&a", {1, 1});
+   const auto b = graph.addNode("b", "&b", {1, 1});
+   const auto c = graph.addNode("c", "&c", {1, 1});
+   const auto d = graph.addNode("d", "&d", {1, 1});
+   graph.addDependency(a, c);
+   graph.addDependency(c, b);
+   graph.addDependency(c, b);
+   ASSERT_EQ(1u, graph.getNode(c).dependencies.size());
+   ASSERT_EQ((vector<HsaTaskGraph::NodeId> {b, d, c, a}), graph.getTopologicalOrder());
+
+   ASSERT_THROW(graph.addDependency(a, 4), HsaException);
+   ASSERT_THROW(graph.addDependency(a, a), HsaException);
+   graph.addDependency(b, a);
+   ASSERT_THROW(graph.getTopologicalOrder(), HsaException);
+}
+
+TEST(HsaTaskGraph, Diamond) {
+   for (const EdgeMode mode : {EdgeMode::BarrierPackets, EdgeMode::HostTracking}) {
+      Diamond diamond;
+      HsaTaskGraph graph;
+      diamond.addTo(graph);
+      NativeContexts native(2);
+      HsaTaskGraphExecutor executor(graph, native.pointers, mode);
+      // The branches run on different queues.
+      ASSERT_EQ(0u, executor.getQueueIndex(diamond.source));
+      ASSERT_EQ(0u, executor.getQueueIndex(diamond.leftBranch));
+      ASSERT_EQ(1u, executor.getQueueIndex(diamond.rightBranch));
+      ASSERT_EQ(0u, executor.getQueueIndex(diamond.sink));
+
+      executor.run();
+      for (size_t i = 0; i < Diamond::n; i++) {
+         ASSERT_EQ(4 * i, diamond.output[i]);
+      }
+      const auto& timings = executor.getTimings();
+      for (const auto& timing : timings) {
+         ASSERT_LE(timing.submitted.count(), timing.completed.count());
+         ASSERT_LE(timing.completed.count(), executor.getDuration().count());
+      }
+      if (mode == EdgeMode::HostTracking) {
+         // A node is submitted once its dependencies have completed.
+         ASSERT_LE(timings[diamond.leftBranch].completed.count(), timings[diamond.sink].submitted.count());
+         ASSERT_LE(timings[diamond.rightBranch].completed.count(), timings[diamond.sink].submitted.count());
+      }
+      for (const auto& ctx : native.contexts) {
+         ASSERT_EQ(0u, ctx->getSignalPool().getStats().numInUse);
+      }
+   }
+}
+
+TEST(HsaTaskGraph, RepeatedRuns) {
+   // A chain, that increments the values by 1 + 2 + ... + 10 per run.
+   const size_t n = 100;
+   vector<size_t> values(n, 0);
+   HsaTaskGraph graph;
+   for (size_t i = 1; i <= 10; i++) {
+      const auto id = graph.addNode<size_t*, size_t, size_t>("add", "&__OpenCL_add_kernel", {n, 32},
+            values.data(), i, n);
+      if (i > 1) graph.addDependency(id, id - 1);
+   }
+   for (const EdgeMode mode : {EdgeMode::BarrierPackets, EdgeMode::HostTracking}) {
+      NativeContexts native(3);
+      HsaTaskGraphExecutor executor(graph, native.pointers, mode);
+      for (size_t run = 0; run < 100; run++) {
+         executor.run();
+      }
+   }
+   for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(2u * 100 * 55, values[i]);
+   }
+}
+
+TEST(HsaTaskGraph, UnknownKernel) {
+   HsaTaskGraph graph;
+   graph.addNode("unknown", "&unknown", {1, 1});
+   NativeContexts native(1);
+   ASSERT_THROW(HsaTaskGraphExecutor executor(graph, native.pointers), HsaException);
+   ASSERT_THROW(HsaTaskGraphExecutor executor(graph, {}), HsaException);
+}
+
+TEST(HsaNativePerformance, TaskGraph) {
+   // Eight independent diamonds, i.e., a wide and shallow pipeline.
+   const size_t numDiamonds = 8;
+   vector<unique_ptr<Diamond>> diamonds;
+   HsaTaskGraph graph;
+   for (size_t d = 0; d < numDiamonds; d++) {
+      diamonds.emplace_back(new Diamond());
+      diamonds.back()->addTo(graph);
+   }
+
+   const size_t repeats = 256;
+   for (const size_t numQueues : {1, 2, 4}) {
+      for (const EdgeMode mode : {EdgeMode::BarrierPackets, EdgeMode::HostTracking}) {
+         NativeContexts native(numQueues);
+         HsaTaskGraphExecutor executor(graph, native.pointers, mode);
+         const auto start = chrono::steady_clock::now();
+         for (size_t r = 0; r < repeats; r++) {
+            executor.run();
+         }
+         const double duration = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+         cout << "queues = " << numQueues << ", edges = "
+               << (mode == EdgeMode::BarrierPackets ? "barrier packets" : "host tracking")
+               << ", microseconds/run = " << (duration / repeats) << endl;
+      }
+   }
+}
+
+} // namespace
@@ -0,0 +1,104 @@
+#include "gtest/gtest.h"
+#include <rts/hsa/HsaContext.hpp>
+#include <rts/hsa/HsaException.hpp>
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaNativeAgent.hpp>
+#include <rts/hsa/HsaTaskServer.hpp>
+#include <test/rts/hsa/kernel/TaskServer.hpp>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+using namespace rts::hsa::kernel;
+
+typedef HsaTaskServer<AddTask, uint64_t> AddServer;
+
+TEST(HsaTaskServer, Call) {
+   AddServer server([](const AddTask& task) {
+      return task.a + task.b;
+   });
+   server.waitUntilRunning();
+   for (uint64_t i = 0; i < 1000; i++) {
+      ASSERT_EQ(2 * i + 1, server.call( { i, i + 1 }));
+   }
+}
+
+TEST(HsaTaskServer, Pipelined) {
+   AddServer server([](const AddTask& task) {
+      return task.a + task.b;
+   }, 5);
+   ASSERT_EQ(8u, server.getCapacity());
+
+   // Tasks complete in order, thus the first ticket is polled repeatedly.
+   vector<AddServer::Ticket> tickets;
+   for (uint64_t i = 0; i < server.getCapacity(); i++) {
+      tickets.push_back(server.submit( { i, 10 }));
+   }
+   for (uint64_t i = 0; i < tickets.size(); i++) {
+      ASSERT_EQ(i, tickets[i]);
+      ASSERT_EQ(i + 10, server.wait(tickets[i]));
+   }
+
+   // The ring wraps around.
+   for (uint64_t i = 0; i < 10 * server.getCapacity(); i++) {
+      const AddServer::Ticket ticket = server.submit( { i, 1 });
+      uint64_t result = 0;
+      while (!server.poll(ticket, result)) {
+      }
+      ASSERT_EQ(i + 1, result);
+   }
+}
+
+TEST(HsaTaskServer, ShutDown) {
+   atomic<bool> proceed(false);
+   AddServer server([&](const AddTask& task) {
+      while (!proceed) {
+      }
+      return task.a + task.b;
+   });
+   const AddServer::Ticket first = server.submit( { 1, 2 });
+   const AddServer::Ticket second = server.submit( { 3, 4 });
+
+   // The submitted tasks are served before the worker stops.
+   proceed = true;
+   server.shutDown();
+   uint64_t result = 0;
+   ASSERT_TRUE(server.poll(first, result));
+   ASSERT_EQ(3u, result);
+   ASSERT_TRUE(server.poll(second, result));
+   ASSERT_EQ(7u, result);
+   ASSERT_THROW(server.submit( { 5, 6 }), HsaException);
+   server.shutDown();
+}
+
+TEST(HsaTaskServer, PersistentKernel) {
+   HsaNativeAgent agent(2);
+   agent.registerKernel(addServerKernel());
+   agent.registerKernel(HsaHostKernel::forEachWorkItem<uint64_t*>("&__OpenCL_storeGlobalId_kernel",
+         [](uint64_t gid, uint64_t* dst) {
+            dst[gid] = gid;
+         }));
+   HsaContext ctx(agent);
+   ctx.createQueue();
+
+   AddServer server(ctx, ctx.getKernelObject("&__OpenCL_addServer_kernel"));
+   server.waitUntilRunning();
+   for (uint64_t i = 0; i < 1000; i++) {
+      ASSERT_EQ(i + 42, server.call( { i, 42 }));
+   }
+   server.shutDown();
+
+   // The persistent kernel has completed.
+   vector<uint64_t> output(100);
+   ctx.dispatch<uint64_t*>("&__OpenCL_storeGlobalId_kernel", { output.size(), 64 }, output.data());
+   ASSERT_EQ(99u, output[99]);
+}
+
+} // namespace
@@ -0,0 +1,24 @@
+#pragma once
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+// The BRIG modules that are embedded into the tester (see
+// embed_test_rts_hsa_kernel in LocalMakefile.mk).
+//---------------------------------------------------------------------------
+#include <rts/hsa/HsaModuleSource.hpp>
+#include <cstddef>
+
+namespace rts {
+namespace hsa {
+namespace kernel {
+
+extern const char AddKernelBrig[];
+extern const std::size_t AddKernelBrigSize;
+
+extern const char StoreGlobalIdKernelBrig[];
+extern const std::size_t StoreGlobalIdKernelBrigSize;
+
+}
+}
+}
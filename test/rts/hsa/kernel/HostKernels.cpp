@@ -0,0 +1,256 @@
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+// Host implementations of the OpenCL test kernels. They replace the kernels
+// when the tests are executed by the mock HSA runtime (HSA_MOCK=1).
+//---------------------------------------------------------------------------
+#include <rts/hsa/mock/HsaMock.hpp>
+#include <test/rts/hsa/kernel/TaskServer.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+using namespace std;
+using namespace rts::hsa;
+using namespace rts::hsa::mock;
+
+// see MurmurHash.h
+const uint64_t murmurHash64a_m = 0xc6a4a7935bd1e995;
+const int32_t murmurHash64a_r = 47;
+const uint64_t murmurHash64a_h = 0x8445d61a4e774912 ^ (8 * murmurHash64a_m);
+
+inline uint64_t murmurHash64a(uint64_t k) {
+   uint64_t h = murmurHash64a_h;
+   k *= murmurHash64a_m;
+   k ^= k >> murmurHash64a_r;
+   k *= murmurHash64a_m;
+   h ^= k;
+   h *= murmurHash64a_m;
+   h ^= h >> murmurHash64a_r;
+   h *= murmurHash64a_m;
+   h ^= h >> murmurHash64a_r;
+   return h;
+}
+
+inline uint64_t murmurHash64aX10(const uint64_t k) {
+   return murmurHash64a(murmurHash64a(murmurHash64a(murmurHash64a(murmurHash64a(
+         murmurHash64a(murmurHash64a(murmurHash64a(murmurHash64a(murmurHash64a(k))))))))));
+}
+
+inline uint32_t localId(const HsaWorkGroup& group, const uint64_t gid) {
+   return gid - group.groupId * group.workgroupSize;
+}
+
+//===----------------------------------------------------------------------===//
+// Add.cl, StoreGlobalId.cl, StoreValue.cl, GroupLocalMemory.cl
+//===----------------------------------------------------------------------===//
+
+const KernelRegistration add(HsaHostKernel::forEachWorkItem<size_t*, size_t, size_t>(
+      "&__OpenCL_add_kernel",
+      [](uint64_t gid, size_t* a, size_t b, size_t n) {
+         if (gid < n) a[gid] = a[gid] + b;
+      }));
+
+const KernelRegistration storeGlobalId(HsaHostKernel::forEachWorkItem<size_t*, size_t>(
+      "&__OpenCL_storeGlobalId_kernel",
+      [](uint64_t gid, size_t* output, size_t n) {
+         if (gid < n) output[gid] = gid;
+      }));
+
+const KernelRegistration storeGlobalId2(HsaHostKernel::forEachWorkItem<size_t*, size_t>(
+      "&__OpenCL_storeGlobalId2_kernel",
+      [](uint64_t gid, size_t* output, size_t n) {
+         if (gid < n) output[gid] = gid;
+      }));
+
+const KernelRegistration storeValue(HsaHostKernel::forEachWorkItem<size_t*, size_t>(
+      "&__OpenCL_storeValue_kernel",
+      [](uint64_t gid, size_t* dst, size_t value) {
+         if (gid == 0) dst[0] = value;
+      }));
+
+const KernelRegistration groupLocalMemory(HsaHostKernel::forEachWorkItem<uint32_t*>(
+      "&__OpenCL_groupLocalMemory_kernel",
+      [](uint64_t gid, uint32_t* output) {
+         output[gid] = gid;
+      }));
+
+//===----------------------------------------------------------------------===//
+// Nothing.cl, NothingBusyWait.cl (both define the kernel `nothing`)
+//===----------------------------------------------------------------------===//
+
+const KernelRegistration nothing(HsaHostKernel::forEachWorkItem<size_t*, size_t>(
+      "&__OpenCL_nothing_kernel",
+      [](uint64_t /* gid */, size_t* /* dst */, size_t /* value */) {
+      }), "Nothing");
+
+// Only the first work-item runs the loop. The remaining work-items would
+// never terminate when executed one after another.
+const KernelRegistration nothingBusyWait(HsaHostKernel::forEachWorkGroup<atomic<int32_t>*, atomic<int32_t>*>(
+      "&__OpenCL_nothing_kernel",
+      [](const HsaWorkGroup& group, atomic<int32_t>* controlSignal, atomic<int32_t>* completionSignal) {
+         if (group.groupId != 0) return;
+         int32_t control = 0;
+         while (true) {
+            while (control == 0) {
+               control = controlSignal->load();
+            }
+            controlSignal->store(0);
+            if (control == 255) {
+               completionSignal->store(1);
+               return;
+            }
+            control = 0;
+         }
+      }), "NothingBusyWait");
+
+//===----------------------------------------------------------------------===//
+// TaskServer.cl
+//===----------------------------------------------------------------------===//
+
+const KernelRegistration addServer(kernel::addServerKernel(), "TaskServer");
+
+//===----------------------------------------------------------------------===//
+// Hash.cl, SimtUtil.cl
+//===----------------------------------------------------------------------===//
+
+const KernelRegistration hash64(HsaHostKernel::forEachWorkGroup<const uint64_t*, uint64_t*, size_t>(
+      "&__OpenCL_hash64_kernel",
+      [](const HsaWorkGroup& group, const uint64_t* in, uint64_t* out, size_t n) {
+         for (uint64_t gid = group.begin; gid < group.end; gid++) {
+            if (localId(group, gid) > 16) continue;
+            if (gid < n) out[gid] = murmurHash64aX10(in[gid]);
+         }
+      }));
+
+const KernelRegistration hash64Loop(HsaHostKernel::forEachWorkGroup<const uint64_t*, uint64_t*, size_t>(
+      "&__OpenCL_hash64Loop_kernel",
+      [](const HsaWorkGroup& group, const uint64_t* in, uint64_t* out, size_t n) {
+         const uint32_t numThreads = group.gridSize;
+         const uint32_t iterLimit = n / numThreads;
+         for (uint64_t gid = group.begin; gid < group.end; gid++) {
+            uint32_t pos = gid;
+            for (uint32_t i = 0; i < iterLimit; i++) {
+               if (pos % 1024 <= 512) {
+                  out[pos] = murmurHash64aX10(in[pos]);
+                  pos += numThreads;
+               }
+            }
+         }
+      }));
+
+const KernelRegistration simtUtilization(HsaHostKernel::forEachWorkGroup<const uint64_t*, uint64_t*, uint32_t, uint32_t>(
+      "&__OpenCL_simtUtilization_kernel",
+      [](const HsaWorkGroup& group, const uint64_t* in, uint64_t* out, uint32_t n, uint32_t active) {
+         for (uint64_t gid = group.begin; gid < group.end; gid++) {
+            if (localId(group, gid) > active) continue;
+            if (gid < n) out[gid] = murmurHash64aX10(in[gid]);
+         }
+      }));
+
+const KernelRegistration simtUtilizationLoop(HsaHostKernel::forEachWorkGroup<const uint64_t*, uint64_t*, uint32_t, uint32_t>(
+      "&__OpenCL_simtUtilizationLoop_kernel",
+      [](const HsaWorkGroup& group, const uint64_t* in, uint64_t* out, uint32_t n, uint32_t active) {
+         const uint32_t numThreads = group.gridSize;
+         const uint32_t iterLimit = n / numThreads;
+         for (uint64_t gid = group.begin; gid < group.end; gid++) {
+            uint32_t pos = gid;
+            for (uint32_t i = 0; i < iterLimit; i++) {
+               if (pos % group.workgroupSize <= active) {
+                  out[pos] = murmurHash64aX10(in[pos]);
+                  pos += numThreads;
+               }
+            }
+         }
+      }));
+
+//===----------------------------------------------------------------------===//
+// Sum.cl
+//===----------------------------------------------------------------------===//
+
+const KernelRegistration sumLoop(HsaHostKernel::forEachWorkGroup<const uint32_t*, uint64_t*, size_t>(
+      "&__OpenCL_sumLoop_kernel",
+      [](const HsaWorkGroup& group, const uint32_t* in, uint64_t* out, size_t n) {
+         const uint64_t numThreads = group.gridSize;
+         const uint64_t iterLimit = n / numThreads;
+         for (uint64_t gid = group.begin; gid < group.end; gid++) {
+            uint64_t pos = gid;
+            uint64_t localSum = 0;
+            for (uint64_t i = 0; i < iterLimit; i++) {
+               localSum += in[pos];
+               pos += numThreads;
+            }
+            out[gid] = localSum;
+         }
+      }));
+
+// work_group_reduce_add of a uint yields a uint.
+const KernelRegistration sumLoopReduction(HsaHostKernel::forEachWorkGroup<const uint32_t*, uint64_t*, size_t>(
+      "&__OpenCL_sumLoopReduction_kernel",
+      [](const HsaWorkGroup& group, const uint32_t* in, uint64_t* out, size_t n) {
+         const uint64_t globalSize = group.gridSize;
+         const uint64_t iterLimit = n / globalSize;
+         uint64_t sum = 0;
+         for (uint64_t i = 0; i < iterLimit; i++) {
+            uint32_t groupSum = 0;
+            for (uint64_t gid = group.begin; gid < group.end; gid++) {
+               groupSum += in[gid + i * globalSize];
+            }
+            sum += groupSum;
+         }
+         for (uint64_t gid = group.begin; gid < group.end; gid++) {
+            out[gid] = sum;
+         }
+      }));
+
+const KernelRegistration sumGroupReduction(HsaHostKernel::forEachWorkGroup<const uint32_t*, uint64_t*>(
+      "&__OpenCL_sumGroupReduction_kernel",
+      [](const HsaWorkGroup& group, const uint32_t* in, uint64_t* out) {
+         uint64_t sum = 0;
+         for (uint64_t gid = group.begin; gid < group.end; gid++) {
+            sum += in[gid];
+         }
+         out[group.groupId] = sum;
+      }));
+
+/// The tree reduction of the hand-written kernels (group memory is buf).
+inline uint64_t reduceGroup(const HsaWorkGroup& group, vector<uint64_t>& buf) {
+   for (uint32_t stride = group.workgroupSize / 2; stride > 1; stride >>= 1) {
+      for (uint32_t lid = 0; lid < stride; lid++) {
+         buf[lid] += buf[lid + stride];
+      }
+   }
+   return buf[0] + buf[1];
+}
+
+const KernelRegistration sumGroupReductionHand(HsaHostKernel::forEachWorkGroup<const uint32_t*, uint64_t*>(
+      "&__OpenCL_sumGroupReductionHand_kernel",
+      [](const HsaWorkGroup& group, const uint32_t* in, uint64_t* out) {
+         vector<uint64_t> buf(max<uint32_t>(group.workgroupSize, 2), 0);
+         for (uint64_t gid = group.begin; gid < group.end; gid++) {
+            buf[localId(group, gid)] = in[gid];
+         }
+         out[group.groupId] = reduceGroup(group, buf);
+      }));
+
+const KernelRegistration sumGroupReductionHandLoop(HsaHostKernel::forEachWorkGroup<const uint32_t*, uint64_t*, uint32_t>(
+      "&__OpenCL_sumGroupReductionHandLoop_kernel",
+      [](const HsaWorkGroup& group, const uint32_t* in, uint64_t* out, uint32_t n) {
+         const uint32_t globalSize = group.gridSize;
+         const uint32_t iterLimit = n / globalSize;
+         vector<uint64_t> buf(max<uint32_t>(group.workgroupSize, 2), 0);
+         uint64_t sum = 0;
+         for (uint32_t i = 0; i < iterLimit; i++) {
+            for (uint64_t gid = group.begin; gid < group.end; gid++) {
+               buf[localId(group, gid)] = in[gid * i];
+            }
+            sum += reduceGroup(group, buf);
+         }
+         out[group.groupId] = sum;
+      }));
+
+}
@@ -7,6 +7,17 @@ src_test_rts_hsa_kernel:= \
 	test/rts/hsa/kernel/Hash.cl \
 	test/rts/hsa/kernel/SimtUtil.cl \
 	test/rts/hsa/kernel/Sum.cl \
+	test/rts/hsa/kernel/TaskServer.cl \
 	test/rts/hsa/kernel/Add.cl
 #	test/rts/hsa/kernel/StoreArgs.hsail \
 #	test/rts/hsa/kernel/DeviceSideEnqueue.cl \
+
+# Modules that are embedded into the tester (see EmbeddedKernels.hpp).
+embed_test_rts_hsa_kernel:= \
+	test/rts/hsa/kernel/Add.cl \
+	test/rts/hsa/kernel/StoreGlobalId.cl
+src_test_rts_hsa_kernel+=$(patsubst %.cl,%KernelBrig.cpp,$(embed_test_rts_hsa_kernel))
+
+ifeq ($(HSA_MOCK),1)
+ src_test_rts_hsa_kernel+=test/rts/hsa/kernel/HostKernels.cpp
+endif
@@ -1,14 +1,15 @@
 #include "Types.h"
 
 __kernel void sumLoop(__global const uint32_t* in, __global uint64_t* out, const size_t n) {
-   const uint32_t numThreads = get_global_size(0);
-   const uint32_t gid = get_global_id(0);
+   const size_t numThreads = get_global_size(0);
+   const size_t gid = get_global_id(0);
 
-   uint32_t pos = gid;
+   // 64-bit positions, the input may exceed 4G elements.
+   size_t pos = gid;
    uint64_t localSum = 0;
 
-   const uint32_t iterLimit = (n / numThreads);
-   for (uint32_t i = 0; i < iterLimit; i++) {
+   const size_t iterLimit = (n / numThreads);
+   for (size_t i = 0; i < iterLimit; i++) {
       localSum += in[pos];
       pos += numThreads;
    }
@@ -18,16 +19,16 @@ __kernel void sumLoop(__global const uint32_t* in, __global uint64_t* out, const
 //#define GROUP_SIZE 128
 
 __kernel void sumLoopReduction(__global const uint32_t* in, __global uint64_t* out, const size_t n) {
-   const uint32_t globalSize = get_global_size(0);
+   const size_t globalSize = get_global_size(0);
    const uint32_t groupId = get_group_id(0);
    const uint32_t groupSize = get_local_size(0);
    const uint32_t localId = get_local_id(0);
 
-   uint32_t pos = groupSize * groupId + localId; // = global_id
+   size_t pos = (size_t) groupSize * groupId + localId; // = global_id
    uint64_t sum = 0;
 
-   const uint32_t iterLimit = (n / globalSize);
-   for (uint32_t i = 0; i < iterLimit; i++) {
+   const size_t iterLimit = (n / globalSize);
+   for (size_t i = 0; i < iterLimit; i++) {
       sum += work_group_reduce_add(in[pos]);
 //      sum += in[pos];
       pos += globalSize;
@@ -0,0 +1,48 @@
+#include "Types.h"
+
+// A persistent kernel that serves AddTasks (see HsaTaskServer.hpp). The
+// structs have the layout of HsaTaskMailbox<AddTask, uint64_t>.
+// Note: only one workitem
+
+#define SLOT_FREE 0
+#define SLOT_SUBMITTED 1
+#define SLOT_COMPLETED 2
+
+typedef struct {
+   uint64_t a;
+   uint64_t b;
+} AddTask;
+
+typedef struct __attribute__((aligned(64))) {
+   atomic_uint state;
+   AddTask task;
+   uint64_t result;
+} Slot;
+
+typedef struct {
+   atomic_uint running;
+   atomic_uint stop;
+   uint64_t mask;
+   __global Slot* slots;
+} Mailbox;
+
+__kernel void addServer(__global Mailbox* mailbox) {
+   atomic_store_explicit(&mailbox->running, 1, memory_order_release, memory_scope_all_svm_devices);
+
+   // the main loop
+   for (uint64_t readIndex = 0;; readIndex++) {
+      __global Slot* slot = &mailbox->slots[readIndex & mailbox->mask];
+
+      // wait for the next task
+      while (atomic_load_explicit(&slot->state, memory_order_acquire, memory_scope_all_svm_devices) != SLOT_SUBMITTED) {
+         // shut down, once all submitted tasks are done
+         if (atomic_load_explicit(&mailbox->stop, memory_order_acquire, memory_scope_all_svm_devices) != 0
+               && atomic_load_explicit(&slot->state, memory_order_acquire, memory_scope_all_svm_devices) != SLOT_SUBMITTED) {
+            return;
+         }
+      }
+
+      slot->result = slot->task.a + slot->task.b;
+      atomic_store_explicit(&slot->state, SLOT_COMPLETED, memory_order_release, memory_scope_all_svm_devices);
+   }
+}
@@ -0,0 +1,40 @@
+#pragma once
+//---------------------------------------------------------------------------
+// SIM[DT] Lab
+// (c) Harald Lang 2016
+//---------------------------------------------------------------------------
+// The task of the TaskServer.cl kernel and its host implementation (see
+// HsaTaskServer.hpp).
+//---------------------------------------------------------------------------
+#include <rts/hsa/HsaHostKernel.hpp>
+#include <rts/hsa/HsaTaskServer.hpp>
+#include <cstdint>
+
+namespace rts {
+namespace hsa {
+namespace kernel {
+
+/// The task of the TaskServer.cl kernel.
+struct AddTask {
+   uint64_t a;
+   uint64_t b;
+};
+
+typedef HsaTaskMailbox<AddTask, uint64_t> AddMailbox;
+
+/// Host implementation of the TaskServer.cl kernel. Only the first work-item
+/// serves the tasks, the remaining ones would never run when executed one
+/// after another.
+inline HsaHostKernel addServerKernel() {
+   return HsaHostKernel::forEachWorkGroup<AddMailbox*>("&__OpenCL_addServer_kernel",
+         [](const HsaWorkGroup& group, AddMailbox* mailbox) {
+            if (group.groupId != 0) return;
+            mailbox->serve([](const AddTask& task) {
+               return task.a + task.b;
+            });
+         });
+}
+
+}
+}
+}